@@ -83,6 +83,9 @@ typedef unsigned __int16 uint16_t;
 #   ifndef uint8_t
 typedef unsigned __int8 uint8_t;
 #   endif
+#   ifndef uint64_t
+typedef unsigned __int64 uint64_t;
+#   endif
 #else
 #   include <stdint.h>
 #endif
@@ -178,16 +181,24 @@ ZMQ_EXPORT const char *zmq_strerror (int errnum);
 /*  Context options                                                           */
 #define ZMQ_IO_THREADS  1
 #define ZMQ_MAX_SOCKETS 2
+#define ZMQ_CRYPTO_THREADS 3
+#define ZMQ_ZAP_CACHE_TTL 4
+#define ZMQ_ZAP_CACHE_SIZE 5
+#define ZMQ_SOCKET_POOL 6
 
 /*  Default for new contexts                                                  */
 #define ZMQ_IO_THREADS_DFLT  1
 #define ZMQ_MAX_SOCKETS_DFLT 1023
+#define ZMQ_CRYPTO_THREADS_DFLT 0
+#define ZMQ_ZAP_CACHE_SIZE_DFLT 10000
+#define ZMQ_SOCKET_POOL_DFLT 64
 
 ZMQ_EXPORT void *zmq_ctx_new (void);
 ZMQ_EXPORT int zmq_ctx_term (void *context);
 ZMQ_EXPORT int zmq_ctx_shutdown (void *ctx_);
 ZMQ_EXPORT int zmq_ctx_set (void *context, int option, int optval);
 ZMQ_EXPORT int zmq_ctx_get (void *context, int option);
+ZMQ_EXPORT int zmq_ctx_zap_invalidate (void *context, const char *domain);
 
 /*  Old (legacy) API                                                          */
 ZMQ_EXPORT void *zmq_init (int io_threads);
@@ -288,6 +299,25 @@ ZMQ_EXPORT int zmq_msg_set (zmq_msg_t *msg, int option, int optval);
 #define ZMQ_REQ_RELAXED 53
 #define ZMQ_CONFLATE 54
 #define ZMQ_ZAP_DOMAIN 55
+#define ZMQ_CURVE_TICKET_TTL 56
+#define ZMQ_SNDHWM_BYTES 57
+#define ZMQ_RCVHWM_BYTES 58
+#define ZMQ_CONFLATE_KEY 59
+#define ZMQ_XPUB_BATCH 60
+#define ZMQ_LB_POLICY 61
+#define ZMQ_LB_WEIGHT 62
+#define ZMQ_RCVPRIORITY 63
+#define ZMQ_STATS 64
+#define ZMQ_PIPE_STATS 65
+#define ZMQ_TRACE 66
+#define ZMQ_TRACE_STATS 67
+#define ZMQ_SPILL_DIR 68
+#define ZMQ_SPILL_SIZE 69
+#define ZMQ_RESEND_UNSENT 70
+#define ZMQ_HEARTBEAT_IVL 71
+#define ZMQ_HEARTBEAT_TTL 72
+#define ZMQ_HEARTBEAT_TIMEOUT 73
+#define ZMQ_THREAD_SAFE 74
 
 /*  Message options                                                           */
 #define ZMQ_MORE 1
@@ -296,6 +326,69 @@ ZMQ_EXPORT int zmq_msg_set (zmq_msg_t *msg, int option, int optval);
 #define ZMQ_DONTWAIT 1
 #define ZMQ_SNDMORE 2
 
+/*  Load balancing policies                                                   */
+#define ZMQ_LB_ROUND_ROBIN 0
+#define ZMQ_LB_CREDIT 1
+#define ZMQ_LB_LEAST_OUTSTANDING 2
+#define ZMQ_LB_LATENCY 3
+
+/*  Socket statistics, read with ZMQ_STATS                                    */
+typedef struct
+{
+    uint64_t msgs_sent;
+    uint64_t bytes_sent;
+    uint64_t msgs_received;
+    uint64_t bytes_received;
+    uint64_t hwm_blocked;
+    uint64_t dropped;
+    uint64_t commands;
+    uint64_t pipes;
+    uint64_t engine_bytes_in;
+    uint64_t engine_bytes_out;
+    uint64_t engine_reads;
+    uint64_t engine_writes;
+} zmq_socket_stats_t;
+
+/*  Per-peer statistics, read as an array with ZMQ_PIPE_STATS                 */
+typedef struct
+{
+    unsigned char identity [255];
+    uint8_t identity_size;
+    uint64_t outbound_depth;
+    uint64_t msgs_written;
+    uint64_t msgs_read;
+    uint64_t write_blocked;
+    uint64_t dropped;
+} zmq_pipe_stats_t;
+
+/*  Stages of the latency trace, see ZMQ_TRACE                                */
+#define ZMQ_TRACE_SEND_TO_PIPE 0
+#define ZMQ_TRACE_PIPE_TO_ENCODER 1
+#define ZMQ_TRACE_ENCODER_TO_WIRE 2
+#define ZMQ_TRACE_WIRE_TO_DECODER 3
+#define ZMQ_TRACE_DECODER_TO_SESSION 4
+#define ZMQ_TRACE_SESSION_TO_RECV 5
+#define ZMQ_TRACE_STAGES 6
+
+/*  Latency histogram of a stage, in nanoseconds. Bucket i counts the        */
+/*  samples in [2^i, 2^(i+1)), the last bucket everything above.              */
+typedef struct
+{
+    uint64_t samples;
+    uint64_t min;
+    uint64_t max;
+    uint64_t total;
+    uint64_t buckets [32];
+} zmq_trace_stage_t;
+
+/*  Latency histograms, read with ZMQ_TRACE_STATS                             */
+typedef struct
+{
+    uint64_t traced;
+    uint64_t abandoned;
+    zmq_trace_stage_t stages [ZMQ_TRACE_STAGES];
+} zmq_trace_stats_t;
+
 /*  Security mechanisms                                                       */
 #define ZMQ_NULL 0
 #define ZMQ_PLAIN 1
@@ -328,6 +421,10 @@ ZMQ_EXPORT int zmq_msg_set (zmq_msg_t *msg, int option, int optval);
 #define ZMQ_EVENT_DISCONNECTED 512
 #define ZMQ_EVENT_MONITOR_STOPPED 1024
 
+/*  Reported only when explicitly asked for, or by the monitor ring          */
+#define ZMQ_EVENT_HANDSHAKE_SUCCEEDED 2048
+#define ZMQ_EVENT_MONITOR_OVERFLOW 4096
+
 #define ZMQ_EVENT_ALL ( ZMQ_EVENT_CONNECTED | ZMQ_EVENT_CONNECT_DELAYED | \
                         ZMQ_EVENT_CONNECT_RETRIED | ZMQ_EVENT_LISTENING | \
                         ZMQ_EVENT_BIND_FAILED | ZMQ_EVENT_ACCEPTED | \
@@ -341,6 +438,22 @@ typedef struct {
     int32_t  value ; // value is either error code, fd or reconnect interval
 } zmq_event_t;
 
+/*  Record of the structured monitor, see zmq_socket_monitor_ring            */
+typedef struct {
+    uint64_t timestamp;       /*  microseconds, monotonic clock              */
+    uint64_t handshake_time;  /*  microseconds, HANDSHAKE_SUCCEEDED          */
+    uint64_t bytes_in;        /*  totals of the connection, DISCONNECTED     */
+    uint64_t bytes_out;
+    uint64_t msgs_in;
+    uint64_t msgs_out;
+    uint32_t event;
+    int32_t value;            /*  as in zmq_event_t; count for OVERFLOW      */
+    int32_t mechanism;        /*  ZMQ_NULL, ZMQ_PLAIN or ZMQ_CURVE           */
+    char endpoint [128];
+    char peer_address [64];
+    int32_t resumed;          /*  1 if a ticket resumed the session          */
+} zmq_monitor_record_t;
+
 ZMQ_EXPORT void *zmq_socket (void *, int type);
 ZMQ_EXPORT int zmq_close (void *s);
 ZMQ_EXPORT int zmq_setsockopt (void *s, int option, const void *optval,
@@ -355,6 +468,9 @@ ZMQ_EXPORT int zmq_send (void *s, const void *buf, size_t len, int flags);
 ZMQ_EXPORT int zmq_send_const (void *s, const void *buf, size_t len, int flags);
 ZMQ_EXPORT int zmq_recv (void *s, void *buf, size_t len, int flags);
 ZMQ_EXPORT int zmq_socket_monitor (void *s, const char *addr, int events);
+ZMQ_EXPORT int zmq_socket_monitor_ring (void *s, int events, int capacity);
+ZMQ_EXPORT int zmq_monitor_read (void *s, zmq_monitor_record_t *records,
+    int count);
 
 ZMQ_EXPORT int zmq_sendmsg (void *s, zmq_msg_t *msg, int flags);
 ZMQ_EXPORT int zmq_recvmsg (void *s, zmq_msg_t *msg, int flags);
@@ -389,6 +505,43 @@ typedef struct
 
 ZMQ_EXPORT int zmq_poll (zmq_pollitem_t *items, int nitems, long timeout);
 
+/*  Persistent poller; registration is kept across waits and only the        */
+/*  ready items are reported.                                                */
+
+typedef struct
+{
+    void *socket;
+#if defined _WIN32
+    SOCKET fd;
+#else
+    int fd;
+#endif
+    void *user_data;
+    short events;
+} zmq_poller_event_t;
+
+ZMQ_EXPORT void *zmq_poller_new (void);
+ZMQ_EXPORT int zmq_poller_destroy (void **poller_p);
+ZMQ_EXPORT int zmq_poller_add (void *poller, void *socket, void *user_data,
+    short events);
+ZMQ_EXPORT int zmq_poller_modify (void *poller, void *socket, short events);
+ZMQ_EXPORT int zmq_poller_remove (void *poller, void *socket);
+#if defined _WIN32
+ZMQ_EXPORT int zmq_poller_add_fd (void *poller, SOCKET fd, void *user_data,
+    short events);
+ZMQ_EXPORT int zmq_poller_modify_fd (void *poller, SOCKET fd, short events);
+ZMQ_EXPORT int zmq_poller_remove_fd (void *poller, SOCKET fd);
+#else
+ZMQ_EXPORT int zmq_poller_add_fd (void *poller, int fd, void *user_data,
+    short events);
+ZMQ_EXPORT int zmq_poller_modify_fd (void *poller, int fd, short events);
+ZMQ_EXPORT int zmq_poller_remove_fd (void *poller, int fd);
+#endif
+ZMQ_EXPORT int zmq_poller_wait (void *poller, zmq_poller_event_t *event,
+    long timeout);
+ZMQ_EXPORT int zmq_poller_wait_all (void *poller, zmq_poller_event_t *events,
+    int n_events, long timeout);
+
 /*  Built-in message proxy (3-way) */
 
 ZMQ_EXPORT int zmq_proxy (void *frontend, void *backend, void *capture);
@@ -0,0 +1,868 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//  Parameterised benchmark driver. Runs every combination of the given
+//  socket patterns, transports, message sizes, frame counts, high water
+//  marks, I/O thread counts and security mechanisms, and reports
+//  throughput and latency percentiles as a text table, CSV or JSON.
+//
+//  Both ends of a connection run in this process, the receiving or
+//  echoing end in a thread of its own, so that every transport can be
+//  measured the same way.
+
+#include "../include/zmq.h"
+#include "../include/zmq_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "platform.hpp"
+
+#if defined ZMQ_HAVE_WINDOWS
+#include <windows.h>
+#else
+#include <time.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#endif
+
+#define MAX_VALUES 16
+#define MAX_PARTS 64
+
+//  Socket pattern under test. The client is the sending (throughput) or
+//  requesting (latency) end, the server binds and receives or echoes.
+//  A client type of -1 means a plain TCP socket talks to the server.
+struct pattern_t
+{
+    const char *name;
+    int client_type;
+    int server_type;
+    bool throughput;
+    bool latency;
+};
+
+static const pattern_t patterns [] = {
+    {"pair", ZMQ_PAIR, ZMQ_PAIR, true, true},
+    {"reqrep", ZMQ_REQ, ZMQ_REP, false, true},
+    {"dealer", ZMQ_DEALER, ZMQ_ROUTER, true, true},
+    {"pushpull", ZMQ_PUSH, ZMQ_PULL, true, false},
+    {"stream", -1, ZMQ_STREAM, true, true}
+};
+
+static const int pattern_count = sizeof (patterns) / sizeof (patterns [0]);
+
+//  Values to sweep, as given on the command line.
+struct sweep_t
+{
+    const pattern_t *patterns [MAX_VALUES];
+    int pattern_count;
+    const char *transports [MAX_VALUES];
+    int transport_count;
+    int sizes [MAX_VALUES];
+    int size_count;
+    int parts [MAX_VALUES];
+    int parts_count;
+    int hwms [MAX_VALUES];
+    int hwm_count;
+    int io_threads [MAX_VALUES];
+    int io_threads_count;
+    const char *mechanisms [MAX_VALUES];
+    int mechanism_count;
+    int message_count;
+    int roundtrip_count;
+    int port;
+    const char *format;
+};
+
+//  One measurement.
+struct run_t
+{
+    const pattern_t *pattern;
+    const char *transport;
+    int size;
+    int parts;
+    int hwm;
+    int io_threads;
+    const char *mechanism;
+    bool latency;
+    int count;
+    char endpoint [256];
+};
+
+//  Latency histogram in the style of HdrHistogram: values below 128 are
+//  counted exactly, larger values in buckets of 1/64 of their power of
+//  two, i.e. with a relative error below 1.6%.
+#define HIST_SUB_BUCKETS 64
+#define HIST_BUCKETS (2 * HIST_SUB_BUCKETS + 40 * HIST_SUB_BUCKETS)
+
+struct histogram_t
+{
+    unsigned long long counts [HIST_BUCKETS];
+    unsigned long long total;
+    unsigned long long max;
+};
+
+struct result_t
+{
+    double msgs_per_sec;
+    double mb_per_sec;
+    double p50;
+    double p90;
+    double p99;
+    double p999;
+    double max;
+};
+
+//  State shared with the server thread.
+struct server_t
+{
+    void *socket;
+    const run_t *run;
+    unsigned long long elapsed_ns;
+};
+
+static char curve_public [41];
+static char curve_secret [41];
+static int runs_reported = 0;
+
+static void fail (const char *what_)
+{
+    printf ("error in %s: %s\n", what_, zmq_strerror (errno));
+    exit (1);
+}
+
+static unsigned long long now_ns ()
+{
+#if defined ZMQ_HAVE_WINDOWS
+    LARGE_INTEGER frequency, ticks;
+    QueryPerformanceFrequency (&frequency);
+    QueryPerformanceCounter (&ticks);
+    return (unsigned long long) ((double) ticks.QuadPart * 1000000000.0 /
+        (double) frequency.QuadPart);
+#elif defined CLOCK_MONOTONIC && !defined ZMQ_HAVE_OSX
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+    struct timeval tv;
+    gettimeofday (&tv, NULL);
+    return (unsigned long long) tv.tv_sec * 1000000000ULL +
+        tv.tv_usec * 1000ULL;
+#endif
+}
+
+static int histogram_index (unsigned long long value_)
+{
+    if (value_ < 2 * HIST_SUB_BUCKETS)
+        return (int) value_;
+    int msb = 0;
+    while (value_ >> (msb + 1))
+        msb++;
+    const int shift = msb - 6;
+    const int index = 2 * HIST_SUB_BUCKETS + (shift - 1) * HIST_SUB_BUCKETS +
+        (int) (value_ >> shift) - HIST_SUB_BUCKETS;
+    return index < HIST_BUCKETS ? index : HIST_BUCKETS - 1;
+}
+
+//  Middle of the range of values counted in the bucket.
+static double histogram_value (int index_)
+{
+    if (index_ < 2 * HIST_SUB_BUCKETS)
+        return index_;
+    const int shift = (index_ - 2 * HIST_SUB_BUCKETS) / HIST_SUB_BUCKETS + 1;
+    const unsigned long long sub =
+        (index_ - 2 * HIST_SUB_BUCKETS) % HIST_SUB_BUCKETS + HIST_SUB_BUCKETS;
+    return (double) (sub << shift) + (double) (1ULL << shift) / 2;
+}
+
+static void histogram_record (histogram_t *hist_, unsigned long long value_)
+{
+    hist_->counts [histogram_index (value_)]++;
+    hist_->total++;
+    if (value_ > hist_->max)
+        hist_->max = value_;
+}
+
+static double histogram_percentile (const histogram_t *hist_, double p_)
+{
+    unsigned long long rank =
+        (unsigned long long) (p_ / 100.0 * (double) hist_->total + 0.5);
+    if (rank < 1)
+        rank = 1;
+    unsigned long long seen = 0;
+    for (int i = 0; i != HIST_BUCKETS; i++) {
+        seen += hist_->counts [i];
+        if (seen >= rank) {
+            const double value = histogram_value (i);
+            return value < hist_->max ? value : (double) hist_->max;
+        }
+    }
+    return (double) hist_->max;
+}
+
+static void set_int (void *socket_, int option_, int value_)
+{
+    int rc = zmq_setsockopt (socket_, option_, &value_, sizeof (int));
+    if (rc != 0)
+        fail ("zmq_setsockopt");
+}
+
+static void set_string (void *socket_, int option_, const char *value_)
+{
+    int rc = zmq_setsockopt (socket_, option_, value_, strlen (value_));
+    if (rc != 0)
+        fail ("zmq_setsockopt");
+}
+
+static void configure (void *socket_, const run_t *run_, bool server_)
+{
+    set_int (socket_, ZMQ_SNDHWM, run_->hwm);
+    set_int (socket_, ZMQ_RCVHWM, run_->hwm);
+
+    if (strcmp (run_->mechanism, "plain") == 0) {
+        if (server_)
+            set_int (socket_, ZMQ_PLAIN_SERVER, 1);
+        else {
+            set_string (socket_, ZMQ_PLAIN_USERNAME, "bench");
+            set_string (socket_, ZMQ_PLAIN_PASSWORD, "bench");
+        }
+    }
+    else
+    if (strcmp (run_->mechanism, "curve") == 0) {
+        if (server_) {
+            set_int (socket_, ZMQ_CURVE_SERVER, 1);
+            set_string (socket_, ZMQ_CURVE_SECRETKEY, curve_secret);
+        }
+        else {
+            //  The client reuses the server's key pair; only the
+            //  handshake cost matters here.
+            set_string (socket_, ZMQ_CURVE_SERVERKEY, curve_public);
+            set_string (socket_, ZMQ_CURVE_PUBLICKEY, curve_public);
+            set_string (socket_, ZMQ_CURVE_SECRETKEY, curve_secret);
+        }
+    }
+}
+
+//  Receives all frames of one message into msgs_. Returns the number of
+//  frames.
+static int recv_message (void *socket_, zmq_msg_t *msgs_)
+{
+    int frames = 0;
+    while (true) {
+        if (frames == MAX_PARTS + 1) {
+            printf ("message has too many frames\n");
+            exit (1);
+        }
+        int rc = zmq_msg_init (&msgs_ [frames]);
+        if (rc != 0)
+            fail ("zmq_msg_init");
+        rc = zmq_msg_recv (&msgs_ [frames], socket_, 0);
+        if (rc < 0)
+            fail ("zmq_msg_recv");
+        if (!zmq_msg_more (&msgs_ [frames++]))
+            return frames;
+    }
+}
+
+//  Sends frames_ frames and closes them.
+static void send_message (void *socket_, zmq_msg_t *msgs_, int frames_)
+{
+    for (int i = 0; i != frames_; i++) {
+        int rc = zmq_msg_send (&msgs_ [i], socket_,
+            i + 1 < frames_ ? ZMQ_SNDMORE : 0);
+        if (rc < 0)
+            fail ("zmq_msg_send");
+    }
+}
+
+static void send_new_message (void *socket_, const run_t *run_)
+{
+    zmq_msg_t msgs [MAX_PARTS];
+    for (int i = 0; i != run_->parts; i++) {
+        int rc = zmq_msg_init_size (&msgs [i], run_->size);
+        if (rc != 0)
+            fail ("zmq_msg_init_size");
+    }
+    send_message (socket_, msgs, run_->parts);
+}
+
+static void close_message (zmq_msg_t *msgs_, int frames_)
+{
+    for (int i = 0; i != frames_; i++) {
+        int rc = zmq_msg_close (&msgs_ [i]);
+        if (rc != 0)
+            fail ("zmq_msg_close");
+    }
+}
+
+//  Server side of a throughput run: receives the messages and measures
+//  the time from the first to the last one.
+static void server_throughput (server_t *server_)
+{
+    const run_t *run = server_->run;
+    zmq_msg_t msgs [MAX_PARTS + 1];
+    unsigned long long start = 0;
+
+    if (run->pattern->client_type == -1) {
+        //  STREAM delivers the byte stream in chunks of arbitrary size.
+        const unsigned long long total =
+            (unsigned long long) run->count * run->size;
+        unsigned long long received = 0;
+        while (received < total) {
+            //  Peer identity followed by the data.
+            int frames = recv_message (server_->socket, msgs);
+            if (!start)
+                start = now_ns ();
+            received += zmq_msg_size (&msgs [frames - 1]);
+            close_message (msgs, frames);
+        }
+    }
+    else {
+        for (int i = 0; i != run->count; i++) {
+            int frames = recv_message (server_->socket, msgs);
+            if (i == 0)
+                start = now_ns ();
+            close_message (msgs, frames);
+        }
+    }
+    server_->elapsed_ns = now_ns () - start;
+}
+
+//  Server side of a latency run: sends every message back.
+static void server_echo (server_t *server_)
+{
+    const run_t *run = server_->run;
+    zmq_msg_t msgs [MAX_PARTS + 1];
+
+    if (run->pattern->client_type == -1) {
+        const unsigned long long total =
+            (unsigned long long) run->count * run->size;
+        unsigned long long echoed = 0;
+        while (echoed < total) {
+            int frames = recv_message (server_->socket, msgs);
+            echoed += zmq_msg_size (&msgs [frames - 1]);
+            send_message (server_->socket, msgs, frames);
+        }
+    }
+    else {
+        for (int i = 0; i != run->count; i++) {
+            int frames = recv_message (server_->socket, msgs);
+            send_message (server_->socket, msgs, frames);
+        }
+    }
+}
+
+static void server_thread (void *arg_)
+{
+    server_t *server = (server_t *) arg_;
+    if (server->run->latency)
+        server_echo (server);
+    else
+        server_throughput (server);
+}
+
+#if !defined ZMQ_HAVE_WINDOWS
+
+//  Plain TCP client of the STREAM server.
+static int raw_connect (int port_)
+{
+    int s = socket (AF_INET, SOCK_STREAM, 0);
+    if (s == -1)
+        fail ("socket");
+    int flag = 1;
+    setsockopt (s, IPPROTO_TCP, TCP_NODELAY, (char *) &flag, sizeof (int));
+    struct sockaddr_in addr;
+    memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons ((unsigned short) port_);
+    addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    if (connect (s, (struct sockaddr *) &addr, sizeof (addr)) != 0)
+        fail ("connect");
+    return s;
+}
+
+static void raw_send (int s_, const char *data_, size_t size_)
+{
+    while (size_ > 0) {
+        ssize_t n = send (s_, data_, size_, 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            fail ("send");
+        }
+        data_ += n;
+        size_ -= n;
+    }
+}
+
+static void raw_recv (int s_, char *data_, size_t size_)
+{
+    while (size_ > 0) {
+        ssize_t n = recv (s_, data_, size_, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            fail ("recv");
+        data_ += n;
+        size_ -= n;
+    }
+}
+
+static void client_raw (const run_t *run_, histogram_t *hist_, int port_)
+{
+    int s = raw_connect (port_);
+    char *buffer = (char *) calloc (1, run_->size);
+    if (!buffer)
+        fail ("calloc");
+
+    for (int i = 0; i != run_->count; i++) {
+        if (run_->latency) {
+            const unsigned long long start = now_ns ();
+            raw_send (s, buffer, run_->size);
+            raw_recv (s, buffer, run_->size);
+            histogram_record (hist_, (now_ns () - start) / 2);
+        }
+        else
+            raw_send (s, buffer, run_->size);
+    }
+
+    free (buffer);
+    close (s);
+}
+
+#endif
+
+static void client (void *socket_, const run_t *run_, histogram_t *hist_)
+{
+    zmq_msg_t msgs [MAX_PARTS];
+    for (int i = 0; i != run_->count; i++) {
+        if (run_->latency) {
+            const unsigned long long start = now_ns ();
+            send_new_message (socket_, run_);
+            int frames = recv_message (socket_, msgs);
+            histogram_record (hist_, (now_ns () - start) / 2);
+            close_message (msgs, frames);
+        }
+        else
+            send_new_message (socket_, run_);
+    }
+}
+
+static void measure (run_t *run_, result_t *result_, int port_)
+{
+    void *ctx = zmq_ctx_new ();
+    if (!ctx)
+        fail ("zmq_ctx_new");
+    int rc = zmq_ctx_set (ctx, ZMQ_IO_THREADS, run_->io_threads);
+    if (rc != 0)
+        fail ("zmq_ctx_set");
+
+    server_t server;
+    server.run = run_;
+    server.elapsed_ns = 0;
+    server.socket = zmq_socket (ctx, run_->pattern->server_type);
+    if (!server.socket)
+        fail ("zmq_socket");
+    configure (server.socket, run_, true);
+    rc = zmq_bind (server.socket, run_->endpoint);
+    if (rc != 0)
+        fail ("zmq_bind");
+
+    void *client_socket = NULL;
+    if (run_->pattern->client_type != -1) {
+        client_socket = zmq_socket (ctx, run_->pattern->client_type);
+        if (!client_socket)
+            fail ("zmq_socket");
+        configure (client_socket, run_, false);
+        rc = zmq_connect (client_socket, run_->endpoint);
+        if (rc != 0)
+            fail ("zmq_connect");
+    }
+
+    void *thread = zmq_threadstart (server_thread, &server);
+
+    histogram_t *hist = (histogram_t *) calloc (1, sizeof (histogram_t));
+    if (!hist)
+        fail ("calloc");
+
+    const unsigned long long start = now_ns ();
+#if !defined ZMQ_HAVE_WINDOWS
+    if (!client_socket)
+        client_raw (run_, hist, port_);
+    else
+#endif
+        client (client_socket, run_, hist);
+    zmq_threadclose (thread);
+    const unsigned long long elapsed_ns = run_->latency ?
+        now_ns () - start : server.elapsed_ns;
+
+    const double seconds = elapsed_ns > 0 ? (double) elapsed_ns / 1e9 : 1e-9;
+    const int parts = client_socket ? run_->parts : 1;
+    result_->msgs_per_sec = (double) run_->count / seconds;
+    result_->mb_per_sec = (double) run_->count * parts * run_->size /
+        seconds / 1e6;
+    if (run_->latency) {
+        //  Latencies are kept in nanoseconds and reported in microseconds.
+        result_->p50 = histogram_percentile (hist, 50) / 1e3;
+        result_->p90 = histogram_percentile (hist, 90) / 1e3;
+        result_->p99 = histogram_percentile (hist, 99) / 1e3;
+        result_->p999 = histogram_percentile (hist, 99.9) / 1e3;
+        result_->max = (double) hist->max / 1e3;
+    }
+    else
+        result_->p50 = result_->p90 = result_->p99 = result_->p999 =
+            result_->max = 0;
+    free (hist);
+
+    if (client_socket) {
+        set_int (client_socket, ZMQ_LINGER, 0);
+        rc = zmq_close (client_socket);
+        if (rc != 0)
+            fail ("zmq_close");
+    }
+    set_int (server.socket, ZMQ_LINGER, 0);
+    rc = zmq_close (server.socket);
+    if (rc != 0)
+        fail ("zmq_close");
+    rc = zmq_ctx_term (ctx);
+    if (rc != 0)
+        fail ("zmq_ctx_term");
+}
+
+static void report (const run_t *run_, const result_t *result_,
+    const char *format_)
+{
+    const char *mode = run_->latency ? "lat" : "thr";
+
+    if (strcmp (format_, "csv") == 0) {
+        if (runs_reported == 0)
+            printf ("pattern,transport,size,parts,hwm,io_threads,mechanism,"
+                "mode,count,msgs_per_sec,mb_per_sec,p50_us,p90_us,p99_us,"
+                "p999_us,max_us\n");
+        printf ("%s,%s,%d,%d,%d,%d,%s,%s,%d,%.0f,%.2f,%.2f,%.2f,%.2f,%.2f,"
+            "%.2f\n", run_->pattern->name, run_->transport, run_->size,
+            run_->parts, run_->hwm, run_->io_threads, run_->mechanism, mode,
+            run_->count, result_->msgs_per_sec, result_->mb_per_sec,
+            result_->p50, result_->p90, result_->p99, result_->p999,
+            result_->max);
+    }
+    else
+    if (strcmp (format_, "json") == 0) {
+        printf ("%s  {\"pattern\": \"%s\", \"transport\": \"%s\", "
+            "\"size\": %d, \"parts\": %d, \"hwm\": %d, \"io_threads\": %d, "
+            "\"mechanism\": \"%s\", \"mode\": \"%s\", \"count\": %d, "
+            "\"msgs_per_sec\": %.0f, \"mb_per_sec\": %.2f, "
+            "\"p50_us\": %.2f, \"p90_us\": %.2f, \"p99_us\": %.2f, "
+            "\"p999_us\": %.2f, \"max_us\": %.2f}",
+            runs_reported == 0 ? "[\n" : ",\n", run_->pattern->name,
+            run_->transport, run_->size, run_->parts, run_->hwm,
+            run_->io_threads, run_->mechanism, mode, run_->count,
+            result_->msgs_per_sec, result_->mb_per_sec, result_->p50,
+            result_->p90, result_->p99, result_->p999, result_->max);
+    }
+    else {
+        if (runs_reported == 0)
+            printf ("%-8s %-9s %8s %5s %6s %3s %-5s %-4s %12s %10s %9s %9s "
+                "%9s %9s %9s\n", "pattern", "transport", "size", "parts",
+                "hwm", "io", "mech", "mode", "msgs/s", "MB/s", "p50[us]",
+                "p90[us]", "p99[us]", "p99.9[us]", "max[us]");
+        printf ("%-8s %-9s %8d %5d %6d %3d %-5s %-4s %12.0f %10.2f",
+            run_->pattern->name, run_->transport, run_->size, run_->parts,
+            run_->hwm, run_->io_threads, run_->mechanism, mode,
+            result_->msgs_per_sec, result_->mb_per_sec);
+        if (run_->latency)
+            printf (" %9.2f %9.2f %9.2f %9.2f %9.2f", result_->p50,
+                result_->p90, result_->p99, result_->p999, result_->max);
+        printf ("\n");
+    }
+    fflush (stdout);
+    runs_reported++;
+}
+
+//  Returns a reason why the combination can't be measured, or NULL.
+static const char *unsupported (const run_t *run_)
+{
+    const bool raw = run_->pattern->client_type == -1;
+    if (raw && strcmp (run_->transport, "tcp") != 0)
+        return "STREAM is measured over tcp only";
+#if defined ZMQ_HAVE_WINDOWS
+    if (raw)
+        return "STREAM client is not available on this platform";
+#endif
+    if (raw && (run_->parts != 1 || strcmp (run_->mechanism, "null") != 0))
+        return "STREAM carries single-frame unsecured messages only";
+    if (strcmp (run_->mechanism, "null") != 0 &&
+          (strcmp (run_->transport, "inproc") == 0 ||
+           strcmp (run_->transport, "shm") == 0))
+        return "security mechanisms need the tcp or ipc transport";
+    if (run_->parts > MAX_PARTS)
+        return "too many frames per message";
+    return NULL;
+}
+
+static void make_endpoint (run_t *run_, int port_)
+{
+    //  Every run gets an endpoint of its own so that lingering connections
+    //  of the previous run don't interfere.
+    if (strcmp (run_->transport, "tcp") == 0)
+        sprintf (run_->endpoint, "tcp://127.0.0.1:%d", port_);
+    else
+    if (strcmp (run_->transport, "inproc") == 0)
+        sprintf (run_->endpoint, "inproc://bench-%d", port_);
+    else
+        sprintf (run_->endpoint, "%s:///tmp/zmq-bench-%d", run_->transport,
+            port_);
+}
+
+static int split (char *list_, char **items_)
+{
+    int count = 0;
+    for (char *item = strtok (list_, ","); item; item = strtok (NULL, ",")) {
+        if (count == MAX_VALUES) {
+            printf ("too many values in list\n");
+            exit (1);
+        }
+        items_ [count++] = item;
+    }
+    return count;
+}
+
+static int parse_ints (char *list_, int *values_, int min_)
+{
+    char *items [MAX_VALUES];
+    const int count = split (list_, items);
+    for (int i = 0; i != count; i++) {
+        values_ [i] = atoi (items [i]);
+        if (values_ [i] < min_) {
+            printf ("invalid value: %s\n", items [i]);
+            exit (1);
+        }
+    }
+    return count;
+}
+
+static int parse_names (char *list_, const char **values_,
+    const char *const *known_)
+{
+    char *items [MAX_VALUES];
+    const int count = split (list_, items);
+    for (int i = 0; i != count; i++) {
+        bool found = false;
+        for (const char *const *k = known_; *k; k++)
+            if (strcmp (items [i], *k) == 0)
+                found = true;
+        if (!found) {
+            printf ("unknown value: %s\n", items [i]);
+            exit (1);
+        }
+        values_ [i] = items [i];
+    }
+    return count;
+}
+
+static void usage ()
+{
+    printf ("usage: bench [options]\n"
+        "  -p patterns    pair,reqrep,dealer,pushpull,stream (default: all)\n"
+        "  -t transports  inproc,ipc,tcp,shm (default: inproc,ipc,tcp)\n"
+        "  -s sizes       message frame sizes in bytes (default: 64,1024,65536)\n"
+        "  -m parts       frames per message (default: 1)\n"
+        "  -w hwms        send and receive high water marks (default: 1000)\n"
+        "  -i threads     I/O threads (default: 1)\n"
+        "  -x mechanisms  null,plain,curve (default: null)\n"
+        "  -n count       messages per throughput run (default: 100000)\n"
+        "  -r count       roundtrips per latency run (default: 10000)\n"
+        "  -b port        first TCP port to use (default: 5590)\n"
+        "  -f format      text, csv or json (default: text)\n");
+}
+
+int main (int argc, char *argv [])
+{
+    static const char *const transport_names [] =
+        {"inproc", "ipc", "tcp", "shm", NULL};
+    static const char *const mechanism_names [] =
+        {"null", "plain", "curve", NULL};
+    static const char *const format_names [] =
+        {"text", "csv", "json", NULL};
+
+    sweep_t sweep;
+    memset (&sweep, 0, sizeof (sweep));
+    sweep.message_count = 100000;
+    sweep.roundtrip_count = 10000;
+    sweep.port = 5590;
+    sweep.format = "text";
+
+    for (int i = 1; i < argc; i++) {
+        if (argv [i][0] != '-' || !argv [i][1] || argv [i][2] ||
+              i + 1 == argc) {
+            usage ();
+            return 1;
+        }
+        char *value = argv [++i];
+        switch (argv [i - 1][1]) {
+            case 'p': {
+                char *items [MAX_VALUES];
+                const int count = split (value, items);
+                for (int j = 0; j != count; j++) {
+                    int k = 0;
+                    while (k != pattern_count &&
+                          strcmp (patterns [k].name, items [j]) != 0)
+                        k++;
+                    if (k == pattern_count) {
+                        printf ("unknown pattern: %s\n", items [j]);
+                        return 1;
+                    }
+                    sweep.patterns [j] = &patterns [k];
+                }
+                sweep.pattern_count = count;
+                break;
+            }
+            case 't':
+                sweep.transport_count = parse_names (value, sweep.transports,
+                    transport_names);
+                break;
+            case 's':
+                sweep.size_count = parse_ints (value, sweep.sizes, 0);
+                break;
+            case 'm':
+                sweep.parts_count = parse_ints (value, sweep.parts, 1);
+                break;
+            case 'w':
+                sweep.hwm_count = parse_ints (value, sweep.hwms, 0);
+                break;
+            case 'i':
+                sweep.io_threads_count = parse_ints (value, sweep.io_threads,
+                    1);
+                break;
+            case 'x':
+                sweep.mechanism_count = parse_names (value, sweep.mechanisms,
+                    mechanism_names);
+                break;
+            case 'n':
+                sweep.message_count = atoi (value);
+                break;
+            case 'r':
+                sweep.roundtrip_count = atoi (value);
+                break;
+            case 'b':
+                sweep.port = atoi (value);
+                break;
+            case 'f': {
+                const char *formats [MAX_VALUES];
+                parse_names (value, formats, format_names);
+                sweep.format = formats [0];
+                break;
+            }
+            default:
+                usage ();
+                return 1;
+        }
+    }
+
+    if (!sweep.pattern_count) {
+        for (int i = 0; i != pattern_count; i++)
+            sweep.patterns [i] = &patterns [i];
+        sweep.pattern_count = pattern_count;
+    }
+    if (!sweep.transport_count) {
+        sweep.transports [0] = "inproc";
+        sweep.transports [1] = "ipc";
+        sweep.transports [2] = "tcp";
+        sweep.transport_count = 3;
+    }
+    if (!sweep.size_count) {
+        sweep.sizes [0] = 64;
+        sweep.sizes [1] = 1024;
+        sweep.sizes [2] = 65536;
+        sweep.size_count = 3;
+    }
+    if (!sweep.parts_count) {
+        sweep.parts [0] = 1;
+        sweep.parts_count = 1;
+    }
+    if (!sweep.hwm_count) {
+        sweep.hwms [0] = 1000;
+        sweep.hwm_count = 1;
+    }
+    if (!sweep.io_threads_count) {
+        sweep.io_threads [0] = 1;
+        sweep.io_threads_count = 1;
+    }
+    if (!sweep.mechanism_count) {
+        sweep.mechanisms [0] = "null";
+        sweep.mechanism_count = 1;
+    }
+    if (sweep.message_count < 1 || sweep.roundtrip_count < 1) {
+        usage ();
+        return 1;
+    }
+
+    for (int i = 0; i != sweep.mechanism_count; i++)
+        if (strcmp (sweep.mechanisms [i], "curve") == 0 &&
+              zmq_curve_keypair (curve_public, curve_secret) != 0)
+            fail ("zmq_curve_keypair");
+
+    int port = sweep.port;
+    for (int p = 0; p != sweep.pattern_count; p++)
+    for (int t = 0; t != sweep.transport_count; t++)
+    for (int s = 0; s != sweep.size_count; s++)
+    for (int m = 0; m != sweep.parts_count; m++)
+    for (int w = 0; w != sweep.hwm_count; w++)
+    for (int i = 0; i != sweep.io_threads_count; i++)
+    for (int x = 0; x != sweep.mechanism_count; x++)
+    for (int mode = 0; mode != 2; mode++) {
+        run_t run;
+        run.pattern = sweep.patterns [p];
+        run.transport = sweep.transports [t];
+        run.size = sweep.sizes [s];
+        run.parts = sweep.parts [m];
+        run.hwm = sweep.hwms [w];
+        run.io_threads = sweep.io_threads [i];
+        run.mechanism = sweep.mechanisms [x];
+        run.latency = mode == 1;
+        run.count = run.latency ? sweep.roundtrip_count : sweep.message_count;
+
+        if (run.latency ? !run.pattern->latency : !run.pattern->throughput)
+            continue;
+        const char *reason = unsupported (&run);
+        if (reason) {
+            fprintf (stderr, "skipping %s over %s with %s: %s\n",
+                run.pattern->name, run.transport, run.mechanism, reason);
+            continue;
+        }
+
+        make_endpoint (&run, port);
+        result_t result;
+        measure (&run, &result, port);
+        port++;
+        report (&run, &result, sweep.format);
+    }
+
+    if (strcmp (sweep.format, "json") == 0)
+        printf (runs_reported ? "\n]\n" : "[]\n");
+
+    return 0;
+}
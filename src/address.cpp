@@ -40,7 +40,7 @@ zmq::address_t::~address_t() {
         }
     }
 #if !defined ZMQ_HAVE_WINDOWS && !defined ZMQ_HAVE_OPENVMS
-    else if (protocol == "ipc") {
+    else if (protocol == "ipc" || protocol == "shm") {
         if (resolved.ipc_addr) {
             delete resolved.ipc_addr;
             resolved.ipc_addr = 0;
@@ -55,9 +55,9 @@ int zmq::address_t::to_string(std::string &addr_) const {
             return resolved.tcp_addr->to_string(addr_);
     }
 #if !defined ZMQ_HAVE_WINDOWS && !defined ZMQ_HAVE_OPENVMS
-    else if (protocol == "ipc") {
+    else if (protocol == "ipc" || protocol == "shm") {
         if (resolved.ipc_addr)
-            return resolved.ipc_addr->to_string(addr_);
+            return resolved.ipc_addr->to_string(addr_, protocol.c_str());
     }
 #endif
 
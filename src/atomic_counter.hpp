@@ -159,6 +159,50 @@ namespace zmq {
 #endif
         }
 
+        //  Atomic 'compare and swap'. If the counter equals 'cmp' it is
+        //  set to 'val'. Returns the old value.
+        inline integer_t cas(integer_t cmp_, integer_t val_) {
+            integer_t old_value;
+
+#if defined ZMQ_ATOMIC_COUNTER_WINDOWS
+            old_value = InterlockedCompareExchange ((LONG*) &value, val_, cmp_);
+#elif defined ZMQ_ATOMIC_COUNTER_ATOMIC_H
+            old_value = atomic_cas_32 (&value, cmp_, val_);
+#elif defined ZMQ_ATOMIC_COUNTER_TILE
+            old_value = arch_atomic_val_compare_and_exchange (&value, cmp_, val_);
+#elif defined ZMQ_ATOMIC_COUNTER_X86
+            __asm__ volatile (
+            "lock; cmpxchgl %2, %3 \n\t"
+            : "=a" (old_value), "=m" (value)
+            : "r" (val_), "m" (value), "0" (cmp_)
+            : "cc", "memory");
+#elif defined ZMQ_ATOMIC_COUNTER_ARM
+            integer_t flag;
+            __asm__ volatile (
+                "       dmb     sy\n\t"
+                "1:     ldrex   %1, [%3]\n\t"
+                "       mov     %0, #0\n\t"
+                "       teq     %1, %4\n\t"
+                "       it      eq\n\t"
+                "       strexeq %0, %5, [%3]\n\t"
+                "       teq     %0, #0\n\t"
+                "       bne     1b\n\t"
+                "       dmb     sy\n\t"
+                : "=&r"(flag), "=&r"(old_value), "+Qo"(value)
+                : "r"(&value), "r"(cmp_), "r"(val_)
+                : "cc");
+#elif defined ZMQ_ATOMIC_COUNTER_MUTEX
+            sync.lock ();
+            old_value = value;
+            if (value == cmp_)
+                value = val_;
+            sync.unlock ();
+#else
+#error atomic_counter is not implemented for this platform
+#endif
+            return old_value;
+        }
+
         inline integer_t get() {
             return value;
         }
@@ -177,6 +221,12 @@ namespace zmq {
 
 }
 
+//  Counters that keep no process-local state can be placed in memory
+//  shared between processes.
+#if !defined ZMQ_ATOMIC_COUNTER_MUTEX
+#define ZMQ_ATOMIC_COUNTER_SHAREABLE
+#endif
+
 //  Remove macros local to this file.
 #if defined ZMQ_ATOMIC_COUNTER_WINDOWS
 #undef ZMQ_ATOMIC_COUNTER_WINDOWS
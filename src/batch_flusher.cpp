@@ -0,0 +1,61 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "batch_flusher.hpp"
+#include "xpub.hpp"
+#include "config.hpp"
+#include "err.hpp"
+
+zmq::batch_flusher_t::batch_flusher_t(io_thread_t *io_thread_, xpub_t *xpub_,
+                                      const options_t &options_) :
+        own_t(io_thread_, options_),
+        io_object_t(io_thread_),
+        xpub(xpub_),
+        timer_started(false) {
+}
+
+zmq::batch_flusher_t::~batch_flusher_t() {
+    zmq_assert (!timer_started);
+}
+
+void zmq::batch_flusher_t::process_plug() {
+    //  Nothing to do till the publisher holds messages back.
+}
+
+void zmq::batch_flusher_t::process_flush() {
+    if (!timer_started) {
+        add_timer(xpub_batch_delay, flush_timer_id);
+        timer_started = true;
+    }
+}
+
+void zmq::batch_flusher_t::process_term(int linger_) {
+    if (timer_started) {
+        cancel_timer(flush_timer_id);
+        timer_started = false;
+    }
+
+    own_t::process_term(linger_);
+}
+
+void zmq::batch_flusher_t::timer_event(int id_) {
+    zmq_assert (id_ == flush_timer_id);
+    timer_started = false;
+    xpub->flush_batch();
+}
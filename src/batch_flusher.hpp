@@ -0,0 +1,74 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __ZMQ_BATCH_FLUSHER_HPP_INCLUDED__
+#define __ZMQ_BATCH_FLUSHER_HPP_INCLUDED__
+
+#include "own.hpp"
+#include "io_object.hpp"
+
+namespace zmq {
+
+    class io_thread_t;
+
+    class xpub_t;
+
+    //  Flushes the messages a publisher holds back for ZMQ_XPUB_BATCH
+    //  when the publisher doesn't get to it, e.g. because the application
+    //  is not calling the socket anymore. The publisher asks for a flush
+    //  whenever it starts holding messages back.
+    class batch_flusher_t : public own_t, public io_object_t {
+    public:
+
+        batch_flusher_t(zmq::io_thread_t *io_thread_, zmq::xpub_t *xpub_,
+                        const options_t &options_);
+
+        ~batch_flusher_t();
+
+    private:
+
+        //  ID of the timer delaying the flush.
+        enum {
+            flush_timer_id = 1
+        };
+
+        //  Handlers for incoming commands.
+        void process_plug();
+
+        void process_flush();
+
+        void process_term(int linger_);
+
+        //  Handlers for I/O events.
+        void timer_event(int id_);
+
+        //  The publisher to flush. It outlives the flusher, its child.
+        zmq::xpub_t *xpub;
+
+        //  True iff a flush is due.
+        bool timer_started;
+
+        batch_flusher_t(const batch_flusher_t &);
+
+        const batch_flusher_t &operator=(const batch_flusher_t &);
+    };
+
+}
+
+#endif
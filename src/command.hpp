@@ -34,6 +34,8 @@ namespace zmq {
 
     class socket_base_t;
 
+    class crypto_job_t;
+
     //  This structure defines the commands that can be sent between threads.
 
     struct command_t {
@@ -57,6 +59,9 @@ namespace zmq {
             reap,
             reaped,
             inproc_connected,
+            crypto_req,
+            crypto_done,
+            flush,
             done
         } type;
 
@@ -94,9 +99,10 @@ namespace zmq {
             } activate_read;
 
             //  Sent by pipe reader to inform pipe writer about how many
-            //  messages it has read so far.
+            //  messages, and bytes, it has read so far.
             struct {
                 uint64_t msgs_read;
+                uint64_t bytes_read;
             } activate_write;
 
             //  Sent by pipe reader to writer after creating a new inpipe.
@@ -141,6 +147,22 @@ namespace zmq {
             struct {
             } reaped;
 
+            //  Sent by session to a crypto thread to have the job executed.
+            //  Session have used inc_seqnum beforehand sending the command.
+            struct {
+                zmq::crypto_job_t *job;
+            } crypto_req;
+
+            //  Sent by crypto thread back to the session once the job is done.
+            struct {
+                zmq::crypto_job_t *job;
+            } crypto_done;
+
+            //  Sent by a publisher to its batch flusher when it holds
+            //  messages back, to have them flushed after a while.
+            struct {
+            } flush;
+
             //  Sent by reaper thread to the term thread when all the sockets
             //  are successfully deallocated.
             struct {
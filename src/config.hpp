@@ -53,12 +53,50 @@ namespace zmq {
         //  unnecessary network stack traversals.
                 out_batch_size = 8192,
 
+        //  Size of each of the two rings of a shm:// connection. It has to
+        //  be a power of two. Larger rings let the peers run further apart
+        //  before one of them has to wait for the other.
+                shm_ring_size = 4194304,
+
         //  Maximal delta between high and low watermark.
                 max_wm_delta = 1024,
 
         //  Maximum number of events the I/O thread can process in one go.
                 max_io_events = 256,
 
+        //  Maximum number of messages the proxy moves in one direction
+        //  before looking at the other direction and the control socket.
+                proxy_burst_size = 256,
+
+        //  Maximum number of messages fair queueing takes from higher
+        //  priority pipes in a row while lower priority pipes are waiting.
+        //  The next message is then taken from a lower priority pipe, so
+        //  that no peer is starved completely.
+                fq_priority_quantum = 32,
+
+        //  Time in milliseconds after which a latency trace that did not
+        //  make it through all its stages, e.g. because the message was
+        //  dropped or the connection failed, is given up.
+                trace_timeout = 1000,
+
+        //  Longest time in milliseconds an engine keeps the traffic it has
+        //  seen before reporting it to the socket's ZMQ_STATS counters.
+                engine_stats_ivl = 100,
+
+        //  Number of messages after which the reader of a pipe balanced
+        //  with ZMQ_LB_CREDIT reports its progress to the writer.
+                lb_credit_report = 16,
+
+        //  Longest time in milliseconds messages of an incomplete
+        //  ZMQ_XPUB_BATCH batch are held back when the publisher doesn't
+        //  call the socket again. An I/O thread flushes them then.
+                xpub_batch_delay = 1,
+
+        //  Longest time in milliseconds a thread blocked in a send or recv
+        //  on a ZMQ_THREAD_SAFE socket sleeps before it tries again. A
+        //  command waking it up may have been taken by another thread.
+                thread_safe_wait_slice = 1,
+
         //  Maximal delay to process command in API thread (in CPU ticks).
         //  3,000,000 ticks equals to 1 - 2 milliseconds on current CPUs.
         //  Note that delay is only applied when there is continuous stream of
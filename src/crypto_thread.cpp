@@ -0,0 +1,73 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <new>
+
+#include "crypto_thread.hpp"
+#include "session_base.hpp"
+#include "err.hpp"
+
+zmq::crypto_thread_t::crypto_thread_t(ctx_t *ctx_, uint32_t tid_) :
+        object_t(ctx_, tid_),
+        stopping(false) {
+}
+
+zmq::crypto_thread_t::~crypto_thread_t() {
+    worker.stop();
+}
+
+void zmq::crypto_thread_t::start() {
+    worker.start(worker_routine, this);
+}
+
+void zmq::crypto_thread_t::stop() {
+    send_stop();
+}
+
+zmq::mailbox_t *zmq::crypto_thread_t::get_mailbox() {
+    return &mailbox;
+}
+
+void zmq::crypto_thread_t::worker_routine(void *arg_) {
+    ((crypto_thread_t *) arg_)->loop();
+}
+
+void zmq::crypto_thread_t::loop() {
+    while (!stopping) {
+        command_t cmd;
+        int rc = mailbox.recv(&cmd, -1);
+        if (rc != 0 && errno == EINTR)
+            continue;
+        errno_assert (rc == 0);
+
+        cmd.destination->process_command(cmd);
+    }
+}
+
+void zmq::crypto_thread_t::process_stop() {
+    stopping = true;
+}
+
+void zmq::crypto_thread_t::process_crypto_req(crypto_job_t *job_) {
+    //  The session can't go away while the job is in flight as it has
+    //  incremented its seqnum before sending the request.
+    job_->execute();
+    send_crypto_done(job_->session, job_);
+}
@@ -0,0 +1,116 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ZMQ_CRYPTO_THREAD_HPP_INCLUDED__
+#define __ZMQ_CRYPTO_THREAD_HPP_INCLUDED__
+
+#include "stdint.hpp"
+#include "object.hpp"
+#include "mailbox.hpp"
+#include "thread.hpp"
+
+namespace zmq {
+
+    class ctx_t;
+
+    class session_base_t;
+
+    //  A unit of handshake work that can be run off the I/O thread. The job
+    //  must own copies of all the data it touches, as the mechanism that
+    //  created it may be destroyed while the job is being executed.
+
+    class crypto_job_t {
+    public:
+
+        inline crypto_job_t() :
+                session(NULL),
+                cancelled(false) {
+        }
+
+        virtual ~crypto_job_t() {
+        }
+
+        //  Performs the work. Called from the crypto thread.
+        virtual void execute() = 0;
+
+        //  Session the result is delivered to.
+        zmq::session_base_t *session;
+
+        //  Set by the owning mechanism when it is destroyed before the result
+        //  arrives. Accessed from the I/O thread only.
+        bool cancelled;
+
+    private:
+
+        crypto_job_t(const crypto_job_t &);
+
+        const crypto_job_t &operator=(const crypto_job_t &);
+    };
+
+    //  Worker thread executing crypto jobs. Unlike I/O threads it does not
+    //  poll any file descriptors, it just blocks on its mailbox.
+
+    class crypto_thread_t : public object_t {
+    public:
+
+        crypto_thread_t(zmq::ctx_t *ctx_, uint32_t tid_);
+
+        //  Clean-up. If the thread was started, it's neccessary to call 'stop'
+        //  before invoking destructor. Otherwise the destructor would hang up.
+        ~crypto_thread_t();
+
+        //  Launch the physical thread.
+        void start();
+
+        //  Ask underlying thread to stop.
+        void stop();
+
+        //  Returns mailbox associated with this crypto thread.
+        mailbox_t *get_mailbox();
+
+    private:
+
+        //  Main routine of the worker thread.
+        static void worker_routine(void *arg_);
+
+        void loop();
+
+        //  Command handlers.
+        void process_stop();
+
+        void process_crypto_req(zmq::crypto_job_t *job_);
+
+        //  Crypto thread accesses incoming commands via this mailbox.
+        mailbox_t mailbox;
+
+        //  Handle of the physical thread.
+        thread_t worker;
+
+        //  If true, thread is in the process of shutting down.
+        bool stopping;
+
+        crypto_thread_t(const crypto_thread_t &);
+
+        const crypto_thread_t &operator=(const crypto_thread_t &);
+    };
+
+}
+
+#endif
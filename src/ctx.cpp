@@ -33,6 +33,7 @@
 #include "ctx.hpp"
 #include "socket_base.hpp"
 #include "io_thread.hpp"
+#include "crypto_thread.hpp"
 #include "reaper.hpp"
 #include "pipe.hpp"
 #include "err.hpp"
@@ -64,7 +65,9 @@ zmq::ctx_t::ctx_t() :
         slots(NULL),
         max_sockets(clipped_maxsocket(ZMQ_MAX_SOCKETS_DFLT)),
         io_thread_count(ZMQ_IO_THREADS_DFLT),
-        ipv6(false) {
+        crypto_thread_count(ZMQ_CRYPTO_THREADS_DFLT),
+        ipv6(false),
+        socket_pool_size(ZMQ_SOCKET_POOL_DFLT) {
 
 }
 
@@ -88,9 +91,18 @@ zmq::ctx_t::~ctx_t() {
     for (io_threads_t::size_type i = 0; i != io_threads.size(); i++)
         delete io_threads[i];
 
+    //  I/O threads are gone so there's no one to submit crypto jobs anymore.
+    for (crypto_threads_t::size_type i = 0; i != crypto_threads.size(); i++)
+        crypto_threads[i]->stop();
+    for (crypto_threads_t::size_type i = 0; i != crypto_threads.size(); i++)
+        delete crypto_threads[i];
+
     //  Deallocate the reaper thread object.
     delete reaper;
 
+    for (size_t i = 0; i != mailbox_pool.size(); i++)
+        delete mailbox_pool[i];
+
     //  Deallocate the array of mailboxes. No special work is
     //  needed as mailboxes themselves were deallocated with their
     //  corresponding io_thread/socket objects.
@@ -103,11 +115,15 @@ zmq::ctx_t::~ctx_t() {
 
 int zmq::ctx_t::terminate() {
     // Connect up any pending inproc connections, otherwise we will hang
-    pending_connections_t copy = pending_connections;
-    for (pending_connections_t::iterator p = copy.begin(); p != copy.end(); ++p) {
-        zmq::socket_base_t *s = create_socket(ZMQ_PAIR);
-        s->bind(p->first.c_str());
-        s->close();
+    for (int i = 0; i != endpoint_shard_count; i++) {
+        endpoint_shards[i].sync.lock();
+        pending_connections_t copy = endpoint_shards[i].pending_connections;
+        endpoint_shards[i].sync.unlock();
+        for (pending_connections_t::iterator p = copy.begin(); p != copy.end(); ++p) {
+            zmq::socket_base_t *s = create_socket(ZMQ_PAIR);
+            s->bind(p->first.c_str());
+            s->close();
+        }
     }
 
     slot_sync.lock();
@@ -124,6 +140,11 @@ int zmq::ctx_t::terminate() {
             }
 
             term_mailbox.forked();
+
+            mailbox_pool_sync.lock();
+            for (size_t i = 0; i != mailbox_pool.size(); i++)
+                mailbox_pool[i]->forked();
+            mailbox_pool_sync.unlock();
         }
 #endif
         //  Check whether termination was already underway, but interrupted and now
@@ -192,11 +213,29 @@ int zmq::ctx_t::set(int option_, int optval_) {
         io_thread_count = optval_;
         opt_sync.unlock();
     }
+    else if (option_ == ZMQ_CRYPTO_THREADS && optval_ >= 0) {
+        opt_sync.lock();
+        crypto_thread_count = optval_;
+        opt_sync.unlock();
+    }
+    else if (option_ == ZMQ_ZAP_CACHE_TTL && optval_ >= 0)
+        zap_cache.set_ttl(optval_);
+    else if (option_ == ZMQ_ZAP_CACHE_SIZE && optval_ >= 0)
+        zap_cache.set_max_size(optval_);
     else if (option_ == ZMQ_IPV6 && optval_ >= 0) {
         opt_sync.lock();
         ipv6 = (optval_ != 0);
         opt_sync.unlock();
     }
+    else if (option_ == ZMQ_SOCKET_POOL && optval_ >= 0) {
+        mailbox_pool_sync.lock();
+        socket_pool_size = optval_;
+        while (mailbox_pool.size() > (size_t) socket_pool_size) {
+            delete mailbox_pool.back();
+            mailbox_pool.pop_back();
+        }
+        mailbox_pool_sync.unlock();
+    }
     else {
         errno = EINVAL;
         rc = -1;
@@ -210,8 +249,16 @@ int zmq::ctx_t::get(int option_) {
         rc = max_sockets;
     else if (option_ == ZMQ_IO_THREADS)
         rc = io_thread_count;
+    else if (option_ == ZMQ_CRYPTO_THREADS)
+        rc = crypto_thread_count;
+    else if (option_ == ZMQ_ZAP_CACHE_TTL)
+        rc = zap_cache.get_ttl();
+    else if (option_ == ZMQ_ZAP_CACHE_SIZE)
+        rc = zap_cache.get_max_size();
     else if (option_ == ZMQ_IPV6)
         rc = ipv6;
+    else if (option_ == ZMQ_SOCKET_POOL)
+        rc = socket_pool_size;
     else {
         errno = EINVAL;
         rc = -1;
@@ -236,11 +283,12 @@ zmq::socket_base_t *zmq::ctx_t::create_socket(int type_) {
         opt_sync.lock();
         int mazmq = max_sockets;
         int ios = io_thread_count;
+        int cts = crypto_thread_count;
         opt_sync.unlock();
         
         // 1. 创建 slots
         //    这么多slots做什么用? 为什么每个socket对应一个mailbox
-        slot_count = mazmq + ios + 2;
+        slot_count = mazmq + ios + cts + 2;
         slots = (mailbox_t **) malloc(sizeof(mailbox_t * ) * slot_count);
         alloc_assert (slots);
 
@@ -268,10 +316,20 @@ zmq::socket_base_t *zmq::ctx_t::create_socket(int type_) {
             io_thread->start(); // 开始监控fd的变化
         }
 
+        //  Create crypto threads. They take the slots following I/O threads.
+        for (int i = ios + 2; i != ios + cts + 2; i++) {
+            crypto_thread_t *crypto_thread =
+                    new(std::nothrow) crypto_thread_t(this, i);
+            alloc_assert (crypto_thread);
+            crypto_threads.push_back(crypto_thread);
+            slots[i] = crypto_thread->get_mailbox();
+            crypto_thread->start();
+        }
+
         //  In the unused part of the slot array, create a list of empty slots.
         // 将准备给socket的 slots清空，并且添加到 empty_slots中
         //
-        for (int32_t i = (int32_t) slot_count - 1; i >= (int32_t) ios + 2; i--) {
+        for (int32_t i = (int32_t) slot_count - 1; i >= (int32_t) ios + cts + 2; i--) {
             empty_slots.push_back(i);
             slots[i] = NULL;
         }
@@ -326,6 +384,34 @@ zmq::socket_base_t *zmq::ctx_t::create_socket(int type_) {
     return s;
 }
 
+zmq::mailbox_t *zmq::ctx_t::acquire_mailbox() {
+    mailbox_pool_sync.lock();
+    if (!mailbox_pool.empty()) {
+        mailbox_t *mailbox = mailbox_pool.back();
+        mailbox_pool.pop_back();
+        mailbox_pool_sync.unlock();
+        return mailbox;
+    }
+    mailbox_pool_sync.unlock();
+
+    mailbox_t *mailbox = new(std::nothrow) mailbox_t();
+    alloc_assert (mailbox);
+    return mailbox;
+}
+
+void zmq::ctx_t::release_mailbox(mailbox_t *mailbox_) {
+    //  A mailbox with commands left over must not reach another socket.
+    if (mailbox_->reset()) {
+        mailbox_pool_sync.lock();
+        if (mailbox_pool.size() < (size_t) socket_pool_size) {
+            mailbox_pool.push_back(mailbox_);
+            mailbox_ = NULL;
+        }
+        mailbox_pool_sync.unlock();
+    }
+    delete mailbox_;
+}
+
 void zmq::ctx_t::destroy_socket(class socket_base_t *socket_) {
     slot_sync.lock();
 
@@ -345,6 +431,18 @@ void zmq::ctx_t::destroy_socket(class socket_base_t *socket_) {
     slot_sync.unlock();
 }
 
+zmq::crypto_thread_t *zmq::ctx_t::choose_crypto_thread() {
+    if (crypto_threads.empty())
+        return NULL;
+
+    uint32_t n = next_crypto_thread.add(1);
+    return crypto_threads[n % crypto_threads.size()];
+}
+
+zmq::zap_cache_t *zmq::ctx_t::get_zap_cache() {
+    return &zap_cache;
+}
+
 zmq::object_t *zmq::ctx_t::get_reaper() {
     return reaper;
 }
@@ -375,16 +473,25 @@ zmq::io_thread_t *zmq::ctx_t::choose_io_thread(uint64_t affinity_) {
     return selected_io_thread;
 }
 
+zmq::ctx_t::endpoint_shard_t &zmq::ctx_t::endpoint_shard(const char *addr_) {
+    //  FNV-1a.
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *) addr_; *p; p++)
+        hash = (hash ^ *p) * 16777619u;
+    return endpoint_shards[hash % endpoint_shard_count];
+}
+
 //
 // 将endpoint添加到endpoints中
 //
 int zmq::ctx_t::register_endpoint(const char *addr_, endpoint_t &endpoint_) {
-    endpoints_sync.lock();
+    endpoint_shard_t &shard = endpoint_shard(addr_);
+    shard.sync.lock();
 
-    bool inserted = endpoints.insert(endpoints_t::value_type(
+    bool inserted = shard.endpoints.insert(endpoints_t::value_type(
             std::string(addr_), endpoint_)).second;
 
-    endpoints_sync.unlock();
+    shard.sync.unlock();
 
     if (!inserted) {
         errno = EADDRINUSE;
@@ -398,28 +505,32 @@ int zmq::ctx_t::register_endpoint(const char *addr_, endpoint_t &endpoint_) {
 // 删除所有和socket相关的endpoints
 //
 void zmq::ctx_t::unregister_endpoints(socket_base_t *socket_) {
-    endpoints_sync.lock();
-
-    endpoints_t::iterator it = endpoints.begin();
-    while (it != endpoints.end()) {
-        if (it->second.socket == socket_) {
-            endpoints_t::iterator to_erase = it;
+    for (int i = 0; i != endpoint_shard_count; i++) {
+        endpoint_shard_t &shard = endpoint_shards[i];
+        shard.sync.lock();
+
+        endpoints_t::iterator it = shard.endpoints.begin();
+        while (it != shard.endpoints.end()) {
+            if (it->second.socket == socket_) {
+                endpoints_t::iterator to_erase = it;
+                ++it;
+                shard.endpoints.erase(to_erase);
+                continue;
+            }
             ++it;
-            endpoints.erase(to_erase);
-            continue;
         }
-        ++it;
-    }
 
-    endpoints_sync.unlock();
+        shard.sync.unlock();
+    }
 }
 
 zmq::endpoint_t zmq::ctx_t::find_endpoint(const char *addr_) {
-    endpoints_sync.lock();
+    endpoint_shard_t &shard = endpoint_shard(addr_);
+    shard.sync.lock();
 
-    endpoints_t::iterator it = endpoints.find(addr_);
-    if (it == endpoints.end()) {
-        endpoints_sync.unlock();
+    endpoints_t::iterator it = shard.endpoints.find(addr_);
+    if (it == shard.endpoints.end()) {
+        shard.sync.unlock();
         errno = ECONNREFUSED;
         endpoint_t empty = {NULL, options_t()};
         return empty;
@@ -432,40 +543,42 @@ zmq::endpoint_t zmq::ctx_t::find_endpoint(const char *addr_) {
     //  set to false, so that the seqnum isn't incremented twice.
     endpoint.socket->inc_seqnum();
 
-    endpoints_sync.unlock();
+    shard.sync.unlock();
     return endpoint;
 }
 
 void zmq::ctx_t::pend_connection(const char *addr_, pending_connection_t &pending_connection_) {
-    endpoints_sync.lock();
+    endpoint_shard_t &shard = endpoint_shard(addr_);
+    shard.sync.lock();
 
-    endpoints_t::iterator it = endpoints.find(addr_);
-    if (it == endpoints.end()) {
+    endpoints_t::iterator it = shard.endpoints.find(addr_);
+    if (it == shard.endpoints.end()) {
         // Still no bind.
         pending_connection_.endpoint.socket->inc_seqnum();
-        pending_connections.insert(pending_connections_t::value_type(std::string(addr_), pending_connection_));
+        shard.pending_connections.insert(pending_connections_t::value_type(std::string(addr_), pending_connection_));
     }
     else {
         // Bind has happened in the mean time, connect directly
         connect_inproc_sockets(it->second.socket, it->second.options, pending_connection_, connect_side);
     }
 
-    endpoints_sync.unlock();
+    shard.sync.unlock();
 }
 
 void zmq::ctx_t::connect_pending(const char *addr_, zmq::socket_base_t *bind_socket_) {
-    endpoints_sync.lock();
+    endpoint_shard_t &shard = endpoint_shard(addr_);
+    shard.sync.lock();
 
-    std::pair<pending_connections_t::iterator, pending_connections_t::iterator> pending = pending_connections.equal_range(
+    std::pair<pending_connections_t::iterator, pending_connections_t::iterator> pending = shard.pending_connections.equal_range(
             addr_);
 
     for (pending_connections_t::iterator p = pending.first; p != pending.second; ++p) {
-        connect_inproc_sockets(bind_socket_, endpoints[addr_].options, p->second, bind_side);
+        connect_inproc_sockets(bind_socket_, shard.endpoints[addr_].options, p->second, bind_side);
     }
 
-    pending_connections.erase(pending.first, pending.second);
+    shard.pending_connections.erase(pending.first, pending.second);
 
-    endpoints_sync.unlock();
+    shard.sync.unlock();
 }
 
 void zmq::ctx_t::connect_inproc_sockets(zmq::socket_base_t *bind_socket_, options_t &bind_options,
@@ -481,6 +594,11 @@ void zmq::ctx_t::connect_inproc_sockets(zmq::socket_base_t *bind_socket_, option
         errno_assert (rc == 0);
     }
 
+    //  The binding socket's options apply to its end of the pipe, as for
+    //  a connect after the bind.
+    pending_connection_.bind_pipe->set_weight(bind_options.lb_weight);
+    pending_connection_.bind_pipe->set_priority(bind_options.rcvpriority);
+
     if (side_ == bind_side) {
         command_t cmd;
         cmd.type = command_t::bind;
@@ -510,6 +628,18 @@ void zmq::ctx_t::connect_inproc_sockets(zmq::socket_base_t *bind_socket_, option
     pending_connection_.connect_pipe->set_hwms(hwms[1], hwms[0]);
     pending_connection_.bind_pipe->set_hwms(hwms[0], hwms[1]);
 
+    //  Byte HWMs add up the same way. Zero on either side means no limit.
+    int64_t sndhwm_bytes = 0;
+    if (pending_connection_.endpoint.options.sndhwm_bytes != 0 && bind_options.rcvhwm_bytes != 0)
+        sndhwm_bytes = pending_connection_.endpoint.options.sndhwm_bytes + bind_options.rcvhwm_bytes;
+    int64_t rcvhwm_bytes = 0;
+    if (pending_connection_.endpoint.options.rcvhwm_bytes != 0 && bind_options.sndhwm_bytes != 0)
+        rcvhwm_bytes = pending_connection_.endpoint.options.rcvhwm_bytes + bind_options.sndhwm_bytes;
+
+    int64_t byte_hwms[2] = {conflate ? 0 : sndhwm_bytes, conflate ? 0 : rcvhwm_bytes};
+    pending_connection_.connect_pipe->set_byte_hwms(byte_hwms[1], byte_hwms[0]);
+    pending_connection_.bind_pipe->set_byte_hwms(byte_hwms[0], byte_hwms[1]);
+
     if (pending_connection_.endpoint.options.recv_identity) {
         msg_t id;
         int rc = id.init_size(bind_options.identity_size);
@@ -32,6 +32,7 @@
 #include "stdint.hpp"
 #include "options.hpp"
 #include "atomic_counter.hpp"
+#include "zap_cache.hpp"
 
 namespace zmq {
 
@@ -39,6 +40,8 @@ namespace zmq {
 
     class io_thread_t;
 
+    class crypto_thread_t;
+
     class socket_base_t;
 
     class reaper_t;
@@ -96,6 +99,13 @@ namespace zmq {
 
         void destroy_socket(zmq::socket_base_t *socket_);
 
+        //  Returns a mailbox for a new socket, reused from a closed socket
+        //  if there is one.
+        zmq::mailbox_t *acquire_mailbox();
+
+        //  Takes the mailbox of a deallocated socket back for reuse.
+        void release_mailbox(zmq::mailbox_t *mailbox_);
+
         //  Send command to the destination thread.
         void send_command(uint32_t tid_, const command_t &command_);
 
@@ -104,6 +114,13 @@ namespace zmq {
         //  Returns NULL if no I/O thread is available.
         zmq::io_thread_t *choose_io_thread(uint64_t affinity_);
 
+        //  Returns the crypto thread to run the next handshake job on, in
+        //  round-robin fashion. Returns NULL if there are no crypto threads.
+        zmq::crypto_thread_t *choose_crypto_thread();
+
+        //  Returns the cache of ZAP handler decisions.
+        zmq::zap_cache_t *get_zap_cache();
+
         //  Returns reaper thread object.
         zmq::object_t *get_reaper();
 
@@ -161,6 +178,13 @@ namespace zmq {
         typedef std::vector<zmq::io_thread_t *> io_threads_t;
         io_threads_t io_threads;
 
+        //  Crypto threads.
+        typedef std::vector<zmq::crypto_thread_t *> crypto_threads_t;
+        crypto_threads_t crypto_threads;
+
+        //  Used to distribute handshake jobs among crypto threads.
+        atomic_counter_t next_crypto_thread;
+
         //  Array of pointers to mailboxes for both application and I/O threads.
         uint32_t slot_count;
         mailbox_t **slots;
@@ -170,14 +194,29 @@ namespace zmq {
 
         //  List of inproc endpoints within this context.
         typedef std::map<std::string, endpoint_t> endpoints_t;
-        endpoints_t endpoints;
 
         // List of inproc connection endpoints pending a bind
         typedef std::multimap<std::string, pending_connection_t> pending_connections_t;
-        pending_connections_t pending_connections;
 
-        //  Synchronisation of access to the list of inproc endpoints.
-        mutex_t endpoints_sync;
+        //  The inproc endpoints are spread over shards by a hash of the
+        //  address, each with its own lock, so that sockets binding and
+        //  connecting to different endpoints don't contend. Connections
+        //  pending a bind live in the shard of their address.
+        struct endpoint_shard_t {
+            endpoints_t endpoints;
+            pending_connections_t pending_connections;
+            mutex_t sync;
+        };
+        enum {
+            endpoint_shard_count = 16
+        };
+        endpoint_shard_t endpoint_shards[endpoint_shard_count];
+
+        //  Returns the shard holding the endpoint.
+        endpoint_shard_t &endpoint_shard(const char *addr_);
+
+        //  Decisions of the ZAP handler cached on behalf of all sessions.
+        zap_cache_t zap_cache;
 
         //  Maximum socket ID.
         static atomic_counter_t max_socket_id;
@@ -188,12 +227,22 @@ namespace zmq {
         //  Number of I/O threads to launch.
         int io_thread_count;
 
+        //  Number of crypto threads to launch.
+        int crypto_thread_count;
+
         //  Is IPv6 enabled on this context?
         bool ipv6;
 
         //  Synchronisation of access to context options.
         mutex_t opt_sync;
 
+        //  Mailboxes of closed sockets kept for reuse, so that creating a
+        //  socket allocates nothing and needs no system call to set up its
+        //  signaler, and the maximal number of them.
+        std::vector<mailbox_t *> mailbox_pool;
+        int socket_pool_size;
+        mutex_t mailbox_pool_sync;
+
         ctx_t(const ctx_t &);
 
         const ctx_t &operator=(const ctx_t &);
@@ -33,9 +33,15 @@
 #include "curve_client.hpp"
 #include "wire.hpp"
 
-zmq::curve_client_t::curve_client_t (const options_t &options_) :
+zmq::curve_client_t::curve_client_t (session_base_t *session_,
+                                     const options_t &options_) :
     mechanism_t (options_),
-    state (send_hello)
+    session (session_),
+    state (send_hello),
+    ticket_sent (false),
+    resumed (false),
+    new_ticket_received (false),
+    new_ticket_key_received (false)
 {
     memcpy (public_key, options_.curve_public_key, crypto_box_PUBLICKEYBYTES);
     memcpy (secret_key, options_.curve_secret_key, crypto_box_SECRETKEYBYTES);
@@ -48,6 +54,8 @@ zmq::curve_client_t::curve_client_t (const options_t &options_) :
 
 zmq::curve_client_t::~curve_client_t ()
 {
+    memset (resumption_key, 0, sizeof resumption_key);
+    memset (new_ticket_key, 0, sizeof new_ticket_key);
 }
 
 int zmq::curve_client_t::next_handshake_command (msg_t *msg_)
@@ -108,6 +116,8 @@ int zmq::curve_client_t::encode (msg_t *msg_)
     uint8_t flags = 0;
     if (msg_->flags () & msg_t::more)
         flags |= 0x01;
+    if (msg_->flags () & msg_t::command)
+        flags |= 0x02;
 
     uint8_t message_nonce [crypto_box_NONCEBYTES];
     memcpy (message_nonce, "CurveZMQMESSAGEC", 16);
@@ -194,6 +204,8 @@ int zmq::curve_client_t::decode (msg_t *msg_)
         const uint8_t flags = message_plaintext [crypto_box_ZEROBYTES];
         if (flags & 0x01)
             msg_->set_flags (msg_t::more);
+        if (flags & 0x02)
+            msg_->set_flags (msg_t::command);
 
         memcpy (msg_->data (),
                 message_plaintext + crypto_box_ZEROBYTES + 1,
@@ -213,6 +225,11 @@ bool zmq::curve_client_t::is_handshake_complete () const
     return state == connected;
 }
 
+bool zmq::curve_client_t::is_resumed () const
+{
+    return resumed;
+}
+
 int zmq::curve_client_t::produce_hello (msg_t *msg_)
 {
     uint8_t hello_nonce [crypto_box_NONCEBYTES];
@@ -238,8 +255,11 @@ int zmq::curve_client_t::produce_hello (msg_t *msg_)
     memcpy (hello, "\x05HELLO", 6);
     //  CurveZMQ major and minor version numbers
     memcpy (hello + 6, "\1\0", 2);
-    //  Anti-amplification padding
-    memset (hello + 8, 0, 72);
+    //  Anti-amplification padding, carrying resumption ticket if we have one
+    ticket_sent = options.curve_ticket_ttl > 0
+               && session->get_curve_ticket (hello + 8, resumption_key);
+    if (!ticket_sent)
+        memset (hello + 8, 0, 72);
     //  Client public connection key
     memcpy (hello + 80, cn_public, crypto_box_PUBLICKEYBYTES);
     //  Short nonce, prefixed by "CurveZMQHELLO---"
@@ -269,14 +289,27 @@ int zmq::curve_client_t::process_welcome (msg_t *msg_)
     uint8_t welcome_plaintext [crypto_box_ZEROBYTES + 128];
     uint8_t welcome_box [crypto_box_BOXZEROBYTES + 144];
 
-    //  Open Box [S' + cookie](C'->S)
     memset (welcome_box, 0, crypto_box_BOXZEROBYTES);
     memcpy (welcome_box + crypto_box_BOXZEROBYTES, welcome + 24, 144);
 
     memcpy (welcome_nonce, "WELCOME-", 8);
     memcpy (welcome_nonce + 8, welcome + 8, 16);
 
-    int rc = crypto_box_open (welcome_plaintext, welcome_box,
+    //  Server that accepted our ticket boxes WELCOME with the
+    //  resumption key. Otherwise the ticket is of no use anymore.
+    int rc = -1;
+    if (ticket_sent) {
+        rc = crypto_secretbox_open (welcome_plaintext, welcome_box,
+                                    sizeof welcome_box,
+                                    welcome_nonce, resumption_key);
+        resumed = rc == 0;
+        if (!resumed)
+            session->clear_curve_ticket ();
+    }
+
+    //  Open Box [S' + cookie](C'->S)
+    if (!resumed)
+        rc = crypto_box_open (welcome_plaintext, welcome_box,
                               sizeof welcome_box,
                               welcome_nonce, server_key, cn_secret);
     if (rc != 0) {
@@ -308,10 +341,16 @@ int zmq::curve_client_t::produce_initiate (msg_t *msg_)
     memcpy (vouch_nonce, "VOUCH---", 8);
     randombytes (vouch_nonce + 8, 16);
 
-    int rc = crypto_box (vouch_box, vouch_plaintext,
+    //  Server that accepted our ticket does not check the vouch.
+    int rc;
+    if (resumed)
+        memset (vouch_box, 0, sizeof vouch_box);
+    else {
+        rc = crypto_box (vouch_box, vouch_plaintext,
                          sizeof vouch_plaintext,
                          vouch_nonce, cn_server, secret_key);
-    zmq_assert (rc == 0);
+        zmq_assert (rc == 0);
+    }
 
     //  Assume here that metadata is limited to 256 bytes
     uint8_t initiate_nonce [crypto_box_NONCEBYTES];
@@ -341,6 +380,10 @@ int zmq::curve_client_t::produce_initiate (msg_t *msg_)
         ptr += add_property (ptr, "Identity",
                              options.identity, options.identity_size);
 
+    //  Ask for a resumption ticket
+    if (options.curve_ticket_ttl > 0)
+        ptr += add_property (ptr, "Ticket", "", 0);
+
     const size_t mlen = ptr - initiate_plaintext;
 
     memcpy (initiate_nonce, "CurveZMQINITIATE", 16);
@@ -370,7 +413,7 @@ int zmq::curve_client_t::produce_initiate (msg_t *msg_)
 
 int zmq::curve_client_t::process_ready (msg_t *msg_)
 {
-    if (msg_->size () < 30) {
+    if (msg_->size () < 30 || msg_->size () > 14 + 16 + 512) {
         errno = EPROTO;
         return -1;
     }
@@ -384,8 +427,8 @@ int zmq::curve_client_t::process_ready (msg_t *msg_)
     const size_t clen = (msg_->size () - 14) + crypto_box_BOXZEROBYTES;
 
     uint8_t ready_nonce [crypto_box_NONCEBYTES];
-    uint8_t ready_plaintext [crypto_box_ZEROBYTES + 256];
-    uint8_t ready_box [crypto_box_BOXZEROBYTES + 16 + 256];
+    uint8_t ready_plaintext [crypto_box_ZEROBYTES + 512];
+    uint8_t ready_box [crypto_box_BOXZEROBYTES + 16 + 512];
 
     memset (ready_box, 0, crypto_box_BOXZEROBYTES);
     memcpy (ready_box + crypto_box_BOXZEROBYTES,
@@ -404,7 +447,24 @@ int zmq::curve_client_t::process_ready (msg_t *msg_)
 
     rc = parse_metadata (ready_plaintext + crypto_box_ZEROBYTES,
                          clen - crypto_box_ZEROBYTES);
+    if (rc == 0 && new_ticket_received && new_ticket_key_received)
+        session->set_curve_ticket (new_ticket, new_ticket_key);
     return rc;
 }
 
+int zmq::curve_client_t::property (const std::string name_,
+                                   const void *value_, size_t length_)
+{
+    if (name_ == "Ticket" && length_ == sizeof new_ticket) {
+        memcpy (new_ticket, value_, length_);
+        new_ticket_received = true;
+    }
+    else
+    if (name_ == "Ticket-Key" && length_ == sizeof new_ticket_key) {
+        memcpy (new_ticket_key, value_, length_);
+        new_ticket_key_received = true;
+    }
+    return 0;
+}
+
 #endif
@@ -35,6 +35,7 @@
 
 #include "mechanism.hpp"
 #include "options.hpp"
+#include "curve_ticket_keys.hpp"
 
 namespace zmq
 {
@@ -46,7 +47,8 @@ namespace zmq
     {
     public:
 
-        curve_client_t (const options_t &options_);
+        curve_client_t (session_base_t *session_,
+                        const options_t &options_);
         virtual ~curve_client_t ();
 
         // mechanism implementation
@@ -55,6 +57,7 @@ namespace zmq
         virtual int encode (msg_t *msg_);
         virtual int decode (msg_t *msg_);
         virtual bool is_handshake_complete () const;
+        virtual bool is_resumed () const;
 
     private:
 
@@ -66,6 +69,8 @@ namespace zmq
             connected
         };
 
+        session_base_t * const session;
+
         //  Current FSM state
         state_t state;
 
@@ -96,6 +101,24 @@ namespace zmq
         //  Nonce
         uint64_t cn_nonce;
 
+        //  True if we have presented a resumption ticket in HELLO.
+        bool ticket_sent;
+
+        //  True if the server has accepted the ticket.
+        bool resumed;
+
+        //  Key going with the ticket we have presented.
+        uint8_t resumption_key [curve_ticket_keys_t::key_size];
+
+        //  New ticket and its key received in READY.
+        bool new_ticket_received;
+        bool new_ticket_key_received;
+        uint8_t new_ticket [curve_ticket_keys_t::ticket_size];
+        uint8_t new_ticket_key [curve_ticket_keys_t::key_size];
+
+        virtual int property (const std::string name_,
+                              const void *value_, size_t length_);
+
         int produce_hello (msg_t *msg_);
         int process_welcome (msg_t *msg_);
         int produce_initiate (msg_t *msg_);
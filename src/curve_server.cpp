@@ -26,6 +26,8 @@
 #include "windows.hpp"
 #endif
 
+#include <new>
+
 #include "msg.hpp"
 #include "session_base.hpp"
 #include "err.hpp"
@@ -40,7 +42,10 @@ zmq::curve_server_t::curve_server_t (session_base_t *session_,
     peer_address (peer_address_),
     state (expect_hello),
     expecting_zap_reply (false),
-    cn_nonce (1)
+    cn_nonce (1),
+    job (NULL),
+    resumed (false),
+    ticket_requested (false)
 {
     //  Fetch our secret key from socket options
     memcpy (secret_key, options_.curve_secret_key, crypto_box_SECRETKEYBYTES);
@@ -52,6 +57,12 @@ zmq::curve_server_t::curve_server_t (session_base_t *session_,
 
 zmq::curve_server_t::~curve_server_t ()
 {
+    //  If the job is still being processed by a crypto thread,
+    //  the session will dispose of it once it gets back.
+    if (job)
+        job->cancelled = true;
+
+    memset (resumption_key, 0, sizeof resumption_key);
 }
 
 int zmq::curve_server_t::next_handshake_command (msg_t *msg_)
@@ -84,13 +95,9 @@ int zmq::curve_server_t::process_handshake_command (msg_t *msg_)
     switch (state) {
         case expect_hello:
             rc = process_hello (msg_);
-            if (rc == 0)
-                state = send_welcome;
             break;
         case expect_initiate:
             rc = process_initiate (msg_);
-            if (rc == 0)
-                state = expecting_zap_reply? expect_zap_reply: send_ready;
             break;
         default:
             errno = EPROTO;
@@ -119,6 +126,8 @@ int zmq::curve_server_t::encode (msg_t *msg_)
     uint8_t flags = 0;
     if (msg_->flags () & msg_t::more)
         flags |= 0x01;
+    if (msg_->flags () & msg_t::command)
+        flags |= 0x02;
 
     uint8_t *message_plaintext = static_cast <uint8_t *> (malloc (mlen));
     alloc_assert (message_plaintext);
@@ -199,6 +208,8 @@ int zmq::curve_server_t::decode (msg_t *msg_)
         const uint8_t flags = message_plaintext [crypto_box_ZEROBYTES];
         if (flags & 0x01)
             msg_->set_flags (msg_t::more);
+        if (flags & 0x02)
+            msg_->set_flags (msg_t::command);
 
         memcpy (msg_->data (),
                 message_plaintext + crypto_box_ZEROBYTES + 1,
@@ -225,11 +236,27 @@ int zmq::curve_server_t::zap_msg_available ()
     return rc;
 }
 
+int zmq::curve_server_t::crypto_done ()
+{
+    if (state == processing_hello)
+        return finish_hello ();
+    if (state == processing_initiate)
+        return finish_initiate ();
+
+    errno = EFSM;
+    return -1;
+}
+
 bool zmq::curve_server_t::is_handshake_complete () const
 {
     return state == connected;
 }
 
+bool zmq::curve_server_t::is_resumed () const
+{
+    return resumed;
+}
+
 int zmq::curve_server_t::process_hello (msg_t *msg_)
 {
     if (msg_->size () != 200) {
@@ -254,26 +281,56 @@ int zmq::curve_server_t::process_hello (msg_t *msg_)
     //  Save client's short-term public key (C')
     memcpy (cn_client, hello + 80, 32);
 
-    uint8_t hello_nonce [crypto_box_NONCEBYTES];
-    uint8_t hello_plaintext [crypto_box_ZEROBYTES + 64];
-    uint8_t hello_box [crypto_box_BOXZEROBYTES + 80];
+    curve_hello_job_t *hello_job =
+        new (std::nothrow) curve_hello_job_t (hello, secret_key);
+    alloc_assert (hello_job);
+
+    if (options.curve_ticket_ttl > 0) {
+        uint8_t current [curve_ticket_keys_t::key_size];
+        uint8_t previous [curve_ticket_keys_t::key_size];
+        const uint64_t now = session->get_socket ()->
+            get_curve_ticket_keys ()->get (options.curve_ticket_ttl,
+                current, previous);
+        hello_job->set_ticket_keys (current, previous, now);
+    }
 
-    memcpy (hello_nonce, "CurveZMQHELLO---", 16);
-    memcpy (hello_nonce + 16, hello + 112, 8);
+    job = hello_job;
+    state = processing_hello;
 
-    memset (hello_box, 0, crypto_box_BOXZEROBYTES);
-    memcpy (hello_box + crypto_box_BOXZEROBYTES, hello + 120, 80);
+    //  Without crypto threads the job is run in place.
+    if (session->submit_crypto_job (job) == -1) {
+        job->execute ();
+        return finish_hello ();
+    }
+
+    return 0;
+}
+
+int zmq::curve_server_t::finish_hello ()
+{
+    zmq_assert (state == processing_hello && job);
+
+    curve_hello_job_t *hello_job = static_cast <curve_hello_job_t *> (job);
+    const int rc = hello_job->rc;
+    if (rc == 0 && hello_job->resumed) {
+        resumed = true;
+        memcpy (client_key, hello_job->ticket_client_key, 32);
+        memcpy (resumption_key, hello_job->resumption_key,
+                sizeof resumption_key);
+    }
+    else
+    if (rc == 0)
+        memcpy (hello_precom, hello_job->precom, crypto_box_BEFORENMBYTES);
+    delete job;
+    job = NULL;
 
-    //  Open Box [64 * %x0](C'->S)
-    int rc = crypto_box_open (hello_plaintext, hello_box,
-                              sizeof hello_box,
-                              hello_nonce, cn_client, secret_key);
     if (rc != 0) {
         errno = EPROTO;
         return -1;
     }
 
-    return rc;
+    state = send_welcome;
+    return 0;
 }
 
 int zmq::curve_server_t::produce_welcome (msg_t *msg_)
@@ -320,9 +377,16 @@ int zmq::curve_server_t::produce_welcome (msg_t *msg_)
     memcpy (welcome_plaintext + crypto_box_ZEROBYTES + 48,
             cookie_ciphertext + crypto_secretbox_BOXZEROBYTES, 80);
 
-    rc = crypto_box (welcome_ciphertext, welcome_plaintext,
-                     sizeof welcome_plaintext,
-                     welcome_nonce, cn_client, secret_key);
+    //  Resuming client proves the knowledge of the resumption key
+    //  instead of us proving the knowledge of our long-term key.
+    if (resumed)
+        rc = crypto_secretbox (welcome_ciphertext, welcome_plaintext,
+                               sizeof welcome_plaintext,
+                               welcome_nonce, resumption_key);
+    else
+        rc = crypto_box_afternm (welcome_ciphertext, welcome_plaintext,
+                                 sizeof welcome_plaintext,
+                                 welcome_nonce, hello_precom);
     zmq_assert (rc == 0);
 
     rc = msg_->init_size (168);
@@ -338,7 +402,7 @@ int zmq::curve_server_t::produce_welcome (msg_t *msg_)
 
 int zmq::curve_server_t::process_initiate (msg_t *msg_)
 {
-    if (msg_->size () < 257) {
+    if (msg_->size () < 257 || msg_->size () > curve_initiate_job_t::max_size) {
         errno = EPROTO;
         return -1;
     }
@@ -349,107 +413,65 @@ int zmq::curve_server_t::process_initiate (msg_t *msg_)
         return -1;
     }
 
-    uint8_t cookie_nonce [crypto_secretbox_NONCEBYTES];
-    uint8_t cookie_plaintext [crypto_secretbox_ZEROBYTES + 64];
-    uint8_t cookie_box [crypto_secretbox_BOXZEROBYTES + 80];
+    job = new (std::nothrow) curve_initiate_job_t (initiate, msg_->size (),
+        cookie_key, cn_client, cn_secret, resumed? client_key: NULL);
+    alloc_assert (job);
+    state = processing_initiate;
 
-    //  Open Box [C' + s'](t)
-    memset (cookie_box, 0, crypto_secretbox_BOXZEROBYTES);
-    memcpy (cookie_box + crypto_secretbox_BOXZEROBYTES, initiate + 25, 80);
-
-    memcpy (cookie_nonce, "COOKIE--", 8);
-    memcpy (cookie_nonce + 8, initiate + 9, 16);
-
-    int rc = crypto_secretbox_open (cookie_plaintext, cookie_box,
-                                    sizeof cookie_box,
-                                    cookie_nonce, cookie_key);
-    if (rc != 0) {
-        errno = EPROTO;
-        return -1;
+    //  Without crypto threads the job is run in place.
+    if (session->submit_crypto_job (job) == -1) {
+        job->execute ();
+        return finish_initiate ();
     }
 
-    //  Check cookie plain text is as expected [C' + s']
-    if (memcmp (cookie_plaintext + crypto_secretbox_ZEROBYTES, cn_client, 32)
-    ||  memcmp (cookie_plaintext + crypto_secretbox_ZEROBYTES + 32, cn_secret, 32)) {
-        errno = EPROTO;
-        return -1;
-    }
-
-    const size_t clen = (msg_->size () - 113) + crypto_box_BOXZEROBYTES;
-
-    uint8_t initiate_nonce [crypto_box_NONCEBYTES];
-    uint8_t initiate_plaintext [crypto_box_ZEROBYTES + 128 + 256];
-    uint8_t initiate_box [crypto_box_BOXZEROBYTES + 144 + 256];
-
-    //  Open Box [C + vouch + metadata](C'->S')
-    memset (initiate_box, 0, crypto_box_BOXZEROBYTES);
-    memcpy (initiate_box + crypto_box_BOXZEROBYTES,
-            initiate + 113, clen - crypto_box_BOXZEROBYTES);
-
-    memcpy (initiate_nonce, "CurveZMQINITIATE", 16);
-    memcpy (initiate_nonce + 16, initiate + 105, 8);
-
-    rc = crypto_box_open (initiate_plaintext, initiate_box,
-                          clen, initiate_nonce, cn_client, cn_secret);
-    if (rc != 0) {
-        errno = EPROTO;
-        return -1;
-    }
-
-    const uint8_t *client_key = initiate_plaintext + crypto_box_ZEROBYTES;
-
-    uint8_t vouch_nonce [crypto_box_NONCEBYTES];
-    uint8_t vouch_plaintext [crypto_box_ZEROBYTES + 64];
-    uint8_t vouch_box [crypto_box_BOXZEROBYTES + 80];
-
-    //  Open Box Box [C',S](C->S') and check contents
-    memset (vouch_box, 0, crypto_box_BOXZEROBYTES);
-    memcpy (vouch_box + crypto_box_BOXZEROBYTES,
-            initiate_plaintext + crypto_box_ZEROBYTES + 48, 80);
+    return 0;
+}
 
-    memcpy (vouch_nonce, "VOUCH---", 8);
-    memcpy (vouch_nonce + 8,
-            initiate_plaintext + crypto_box_ZEROBYTES + 32, 16);
+int zmq::curve_server_t::finish_initiate ()
+{
+    zmq_assert (state == processing_initiate && job);
 
-    rc = crypto_box_open (vouch_plaintext, vouch_box,
-                          sizeof vouch_box,
-                          vouch_nonce, client_key, cn_secret);
-    if (rc != 0) {
-        errno = EPROTO;
-        return -1;
-    }
+    curve_initiate_job_t *initiate_job =
+        static_cast <curve_initiate_job_t *> (job);
+    job = NULL;
 
-    //  What we decrypted must be the client's short-term public key
-    if (memcmp (vouch_plaintext + crypto_box_ZEROBYTES, cn_client, 32)) {
+    if (initiate_job->rc != 0) {
+        delete initiate_job;
         errno = EPROTO;
         return -1;
     }
 
-    //  Precompute connection secret from client key
-    rc = crypto_box_beforenm (cn_precom, cn_client, cn_secret);
-    zmq_assert (rc == 0);
+    memcpy (cn_precom, initiate_job->precom, crypto_box_BEFORENMBYTES);
+    memcpy (client_key, initiate_job->client_key, 32);
 
     //  Use ZAP protocol (RFC 27) to authenticate the user.
-    rc = session->zap_connect ();
+    int rc = session->zap_connect ();
     if (rc == 0) {
         send_zap_request (client_key);
         rc = receive_and_process_zap_reply ();
         if (rc != 0) {
-            if (errno != EAGAIN)
+            if (errno != EAGAIN) {
+                delete initiate_job;
                 return -1;
+            }
             expecting_zap_reply = true;
         }
     }
 
-    return parse_metadata (initiate_plaintext + crypto_box_ZEROBYTES + 128,
-                           clen - crypto_box_ZEROBYTES - 128);
+    rc = parse_metadata (initiate_job->metadata,
+                         initiate_job->metadata_size);
+    delete initiate_job;
+
+    if (rc == 0)
+        state = expecting_zap_reply? expect_zap_reply: send_ready;
+    return rc;
 }
 
 int zmq::curve_server_t::produce_ready (msg_t *msg_)
 {
     uint8_t ready_nonce [crypto_box_NONCEBYTES];
-    uint8_t ready_plaintext [crypto_box_ZEROBYTES + 256];
-    uint8_t ready_box [crypto_box_BOXZEROBYTES + 16 + 256];
+    uint8_t ready_plaintext [crypto_box_ZEROBYTES + 512];
+    uint8_t ready_box [crypto_box_BOXZEROBYTES + 16 + 512];
 
     //  Create Box [metadata](S'->C')
     memset (ready_plaintext, 0, crypto_box_ZEROBYTES);
@@ -466,6 +488,26 @@ int zmq::curve_server_t::produce_ready (msg_t *msg_)
         ptr += add_property (ptr, "Identity",
             options.identity, options.identity_size);
 
+    //  Issue resumption ticket if asked to
+    if (ticket_requested && options.curve_ticket_ttl > 0) {
+        uint8_t current [curve_ticket_keys_t::key_size];
+        uint8_t previous [curve_ticket_keys_t::key_size];
+        const uint64_t now = session->get_socket ()->
+            get_curve_ticket_keys ()->get (options.curve_ticket_ttl,
+                current, previous);
+
+        uint8_t ticket [curve_ticket_keys_t::ticket_size];
+        uint8_t ticket_key [curve_ticket_keys_t::key_size];
+        curve_ticket_keys_t::seal (current, client_key,
+            now + options.curve_ticket_ttl, ticket, ticket_key);
+
+        ptr += add_property (ptr, "Ticket", ticket, sizeof ticket);
+        ptr += add_property (ptr, "Ticket-Key", ticket_key, sizeof ticket_key);
+        memset (current, 0, sizeof current);
+        memset (previous, 0, sizeof previous);
+        memset (ticket_key, 0, sizeof ticket_key);
+    }
+
     const size_t mlen = ptr - ready_plaintext;
 
     memcpy (ready_nonce, "CurveZMQREADY---", 16);
@@ -560,6 +602,17 @@ void zmq::curve_server_t::send_zap_request (const uint8_t *key)
     errno_assert (rc == 0);
 }
 
+int zmq::curve_server_t::property (const std::string name_,
+                                   const void *value_, size_t length_)
+{
+    //  The request for a ticket carries no value.
+    (void) value_;
+    (void) length_;
+    if (name_ == "Ticket")
+        ticket_requested = true;
+    return 0;
+}
+
 int zmq::curve_server_t::receive_and_process_zap_reply ()
 {
     int rc = 0;
@@ -626,4 +679,162 @@ error:
     return rc;
 }
 
+zmq::curve_hello_job_t::curve_hello_job_t (const uint8_t *hello_,
+                                           const uint8_t *secret_key_) :
+    rc (-1),
+    resumed (false),
+    check_ticket (false),
+    now (0)
+{
+    memcpy (hello, hello_, sizeof hello);
+    memcpy (secret_key, secret_key_, crypto_box_SECRETKEYBYTES);
+}
+
+void zmq::curve_hello_job_t::set_ticket_keys (const uint8_t *current_,
+    const uint8_t *previous_, uint64_t now_)
+{
+    memcpy (ticket_keys [0], current_, curve_ticket_keys_t::key_size);
+    memcpy (ticket_keys [1], previous_, curve_ticket_keys_t::key_size);
+    now = now_;
+    check_ticket = true;
+}
+
+void zmq::curve_hello_job_t::execute ()
+{
+    uint8_t hello_nonce [crypto_box_NONCEBYTES];
+    uint8_t hello_plaintext [crypto_box_ZEROBYTES + 64];
+    uint8_t hello_box [crypto_box_BOXZEROBYTES + 80];
+
+    memcpy (hello_nonce, "CurveZMQHELLO---", 16);
+    memcpy (hello_nonce + 16, hello + 112, 8);
+
+    memset (hello_box, 0, crypto_box_BOXZEROBYTES);
+    memcpy (hello_box + crypto_box_BOXZEROBYTES, hello + 120, 80);
+
+    //  Resuming client puts its ticket into the anti-amplification
+    //  padding, which is otherwise all zeroes.
+    if (check_ticket) {
+        const uint8_t *ticket = hello + 8;
+        for (int i = 0; i != 2 && !resumed; i++)
+            resumed = curve_ticket_keys_t::open (ticket_keys [i], ticket,
+                now, ticket_client_key, resumption_key) == 0;
+        memset (ticket_keys, 0, sizeof ticket_keys);
+        if (resumed) {
+            rc = 0;
+            return;
+        }
+    }
+
+    //  Precompute key for C' and s, this is the costly part
+    rc = crypto_box_beforenm (precom, hello + 80, secret_key);
+    zmq_assert (rc == 0);
+
+    //  Open Box [64 * %x0](C'->S)
+    rc = crypto_box_open_afternm (hello_plaintext, hello_box,
+                                  sizeof hello_box, hello_nonce, precom);
+}
+
+zmq::curve_initiate_job_t::curve_initiate_job_t (const uint8_t *initiate_,
+        size_t size_, const uint8_t *cookie_key_, const uint8_t *cn_client_,
+        const uint8_t *cn_secret_, const uint8_t *ticket_client_key_) :
+    rc (-1),
+    metadata_size (0),
+    size (size_),
+    resumed (ticket_client_key_ != NULL)
+{
+    zmq_assert (size <= max_size);
+    memcpy (initiate, initiate_, size);
+    memcpy (cookie_key, cookie_key_, crypto_secretbox_KEYBYTES);
+    memcpy (cn_client, cn_client_, crypto_box_PUBLICKEYBYTES);
+    memcpy (cn_secret, cn_secret_, crypto_box_SECRETKEYBYTES);
+    if (resumed)
+        memcpy (ticket_client_key, ticket_client_key_, 32);
+}
+
+void zmq::curve_initiate_job_t::execute ()
+{
+    uint8_t cookie_nonce [crypto_secretbox_NONCEBYTES];
+    uint8_t cookie_plaintext [crypto_secretbox_ZEROBYTES + 64];
+    uint8_t cookie_box [crypto_secretbox_BOXZEROBYTES + 80];
+
+    //  Open Box [C' + s'](t)
+    memset (cookie_box, 0, crypto_secretbox_BOXZEROBYTES);
+    memcpy (cookie_box + crypto_secretbox_BOXZEROBYTES, initiate + 25, 80);
+
+    memcpy (cookie_nonce, "COOKIE--", 8);
+    memcpy (cookie_nonce + 8, initiate + 9, 16);
+
+    rc = crypto_secretbox_open (cookie_plaintext, cookie_box,
+                                sizeof cookie_box,
+                                cookie_nonce, cookie_key);
+    if (rc != 0)
+        return;
+
+    //  Check cookie plain text is as expected [C' + s']
+    if (memcmp (cookie_plaintext + crypto_secretbox_ZEROBYTES, cn_client, 32)
+    ||  memcmp (cookie_plaintext + crypto_secretbox_ZEROBYTES + 32, cn_secret, 32)) {
+        rc = -1;
+        return;
+    }
+
+    //  Precompute connection secret from client key
+    rc = crypto_box_beforenm (precom, cn_client, cn_secret);
+    zmq_assert (rc == 0);
+
+    const size_t clen = (size - 113) + crypto_box_BOXZEROBYTES;
+
+    uint8_t initiate_nonce [crypto_box_NONCEBYTES];
+    uint8_t initiate_plaintext [crypto_box_ZEROBYTES + 128 + 256];
+    uint8_t initiate_box [crypto_box_BOXZEROBYTES + 144 + 256];
+
+    //  Open Box [C + vouch + metadata](C'->S')
+    memset (initiate_box, 0, crypto_box_BOXZEROBYTES);
+    memcpy (initiate_box + crypto_box_BOXZEROBYTES,
+            initiate + 113, clen - crypto_box_BOXZEROBYTES);
+
+    memcpy (initiate_nonce, "CurveZMQINITIATE", 16);
+    memcpy (initiate_nonce + 16, initiate + 105, 8);
+
+    rc = crypto_box_open_afternm (initiate_plaintext, initiate_box,
+                                  clen, initiate_nonce, precom);
+    if (rc != 0)
+        return;
+
+    memcpy (client_key, initiate_plaintext + crypto_box_ZEROBYTES, 32);
+
+    metadata_size = clen - crypto_box_ZEROBYTES - 128;
+    memcpy (metadata, initiate_plaintext + crypto_box_ZEROBYTES + 128,
+            metadata_size);
+
+    //  The ticket already vouches for the client
+    if (resumed) {
+        if (memcmp (client_key, ticket_client_key, 32))
+            rc = -1;
+        return;
+    }
+
+    uint8_t vouch_nonce [crypto_box_NONCEBYTES];
+    uint8_t vouch_plaintext [crypto_box_ZEROBYTES + 64];
+    uint8_t vouch_box [crypto_box_BOXZEROBYTES + 80];
+
+    //  Open Box Box [C',S](C->S') and check contents
+    memset (vouch_box, 0, crypto_box_BOXZEROBYTES);
+    memcpy (vouch_box + crypto_box_BOXZEROBYTES,
+            initiate_plaintext + crypto_box_ZEROBYTES + 48, 80);
+
+    memcpy (vouch_nonce, "VOUCH---", 8);
+    memcpy (vouch_nonce + 8,
+            initiate_plaintext + crypto_box_ZEROBYTES + 32, 16);
+
+    rc = crypto_box_open (vouch_plaintext, vouch_box,
+                          sizeof vouch_box,
+                          vouch_nonce, client_key, cn_secret);
+    if (rc != 0)
+        return;
+
+    //  What we decrypted must be the client's short-term public key
+    if (memcmp (vouch_plaintext + crypto_box_ZEROBYTES, cn_client, 32))
+        rc = -1;
+}
+
 #endif
@@ -38,6 +38,8 @@
 
 #include "mechanism.hpp"
 #include "options.hpp"
+#include "crypto_thread.hpp"
+#include "curve_ticket_keys.hpp"
 
 namespace zmq
 {
@@ -45,6 +47,90 @@ namespace zmq
     class msg_t;
     class session_base_t;
 
+    //  Opens the HELLO box. All inputs are copied in so that the job
+    //  can run on a crypto thread. If the client presents a valid
+    //  resumption ticket the box is not opened at all.
+    class curve_hello_job_t : public crypto_job_t
+    {
+    public:
+
+        curve_hello_job_t (const uint8_t *hello_,
+                           const uint8_t *secret_key_);
+
+        //  Makes the job accept tickets sealed by either of the keys.
+        void set_ticket_keys (const uint8_t *current_,
+                              const uint8_t *previous_, uint64_t now_);
+
+        void execute ();
+
+        //  Result of opening the box; 0 on success.
+        int rc;
+
+        //  Precomputed key for C' and s, used to open HELLO and to
+        //  produce WELCOME without further public-key operations.
+        uint8_t precom [crypto_box_BEFORENMBYTES];
+
+        //  True if the client presented a valid ticket.
+        bool resumed;
+
+        //  Client's long-term public key (C) and the resumption key,
+        //  both taken from the ticket.
+        uint8_t ticket_client_key [crypto_box_PUBLICKEYBYTES];
+        uint8_t resumption_key [curve_ticket_keys_t::key_size];
+
+    private:
+
+        uint8_t hello [200];
+        uint8_t secret_key [crypto_box_SECRETKEYBYTES];
+
+        bool check_ticket;
+        uint64_t now;
+        uint8_t ticket_keys [2][curve_ticket_keys_t::key_size];
+    };
+
+    //  Opens the cookie, the INITIATE box and the vouch.
+    class curve_initiate_job_t : public crypto_job_t
+    {
+    public:
+
+        //  Maximum size of INITIATE command the server accepts.
+        enum { max_size = 113 + 144 + 256 };
+
+        //  If ticket_client_key_ is not NULL the connection is being
+        //  resumed; the vouch is not checked, the client's long-term key
+        //  must match the one from the ticket instead.
+        curve_initiate_job_t (const uint8_t *initiate_, size_t size_,
+                              const uint8_t *cookie_key_,
+                              const uint8_t *cn_client_,
+                              const uint8_t *cn_secret_,
+                              const uint8_t *ticket_client_key_);
+
+        void execute ();
+
+        //  Result of the verification; 0 on success.
+        int rc;
+
+        //  Precomputed key for C' and s'.
+        uint8_t precom [crypto_box_BEFORENMBYTES];
+
+        //  Client's long-term public key (C)
+        uint8_t client_key [crypto_box_PUBLICKEYBYTES];
+
+        //  Metadata carried by INITIATE.
+        uint8_t metadata [256];
+        size_t metadata_size;
+
+    private:
+
+        uint8_t initiate [max_size];
+        size_t size;
+        uint8_t cookie_key [crypto_secretbox_KEYBYTES];
+        uint8_t cn_client [crypto_box_PUBLICKEYBYTES];
+        uint8_t cn_secret [crypto_box_SECRETKEYBYTES];
+        bool resumed;
+        uint8_t ticket_client_key [crypto_box_PUBLICKEYBYTES];
+    };
+
     class curve_server_t : public mechanism_t
     {
     public:
@@ -60,14 +146,18 @@ namespace zmq
         virtual int encode (msg_t *msg_);
         virtual int decode (msg_t *msg_);
         virtual int zap_msg_available ();
+        virtual int crypto_done ();
         virtual bool is_handshake_complete () const;
+        virtual bool is_resumed () const;
 
     private:
 
         enum state_t {
             expect_hello,
+            processing_hello,
             send_welcome,
             expect_initiate,
+            processing_initiate,
             expect_zap_reply,
             send_ready,
             connected
@@ -103,13 +193,36 @@ namespace zmq
         //  Intermediary buffer used to speed up boxing and unboxing.
         uint8_t cn_precom [crypto_box_BEFORENMBYTES];
 
+        //  Precomputed key for C' and s, used to produce WELCOME.
+        uint8_t hello_precom [crypto_box_BEFORENMBYTES];
+
+        //  Handshake job in progress, if any.
+        crypto_job_t *job;
+
+        //  Client's long-term public key (C)
+        uint8_t client_key [crypto_box_PUBLICKEYBYTES];
+
+        //  True if the connection is resumed using a ticket.
+        bool resumed;
+
+        //  Key shared with a resuming client, used to box WELCOME.
+        uint8_t resumption_key [curve_ticket_keys_t::key_size];
+
+        //  True if the client asked for a resumption ticket.
+        bool ticket_requested;
+
         int process_hello (msg_t *msg_);
+        int finish_hello ();
         int produce_welcome (msg_t *msg_);
         int process_initiate (msg_t *msg_);
+        int finish_initiate ();
         int produce_ready (msg_t *msg_);
 
         void send_zap_request (const uint8_t *key);
         int receive_and_process_zap_reply ();
+
+        virtual int property (const std::string name_,
+                              const void *value_, size_t length_);
     };
 
 }
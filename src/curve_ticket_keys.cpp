@@ -0,0 +1,131 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "platform.hpp"
+
+#ifdef HAVE_LIBSODIUM
+#include <sodium.h>
+#endif
+
+#include <string.h>
+
+#include "curve_ticket_keys.hpp"
+#include "clock.hpp"
+#include "err.hpp"
+#include "wire.hpp"
+
+zmq::curve_ticket_keys_t::curve_ticket_keys_t () :
+    generated (0)
+{
+}
+
+zmq::curve_ticket_keys_t::~curve_ticket_keys_t ()
+{
+    //  Don't leave the keys lying around in memory.
+    memset (current, 0, key_size);
+    memset (previous, 0, key_size);
+}
+
+uint64_t zmq::curve_ticket_keys_t::get (int ttl_, uint8_t *current_,
+    uint8_t *previous_)
+{
+    zmq_assert (ttl_ > 0);
+    const uint64_t now = clock_t::now_us () / 1000;
+
+    sync.lock ();
+#ifdef HAVE_LIBSODIUM
+    if (!generated) {
+        randombytes (current, key_size);
+        randombytes (previous, key_size);
+        generated = now;
+    }
+    else
+    if (now - generated >= (uint64_t) ttl_) {
+        memcpy (previous, current, key_size);
+        randombytes (current, key_size);
+        generated = now;
+    }
+#endif
+    memcpy (current_, current, key_size);
+    memcpy (previous_, previous, key_size);
+    sync.unlock ();
+
+    return now;
+}
+
+#ifdef HAVE_LIBSODIUM
+
+void zmq::curve_ticket_keys_t::seal (const uint8_t *key_,
+    const uint8_t *client_key_, uint64_t expiry_, uint8_t *ticket_,
+    uint8_t *rkey_)
+{
+    uint8_t ticket_nonce [crypto_secretbox_NONCEBYTES];
+    uint8_t ticket_plaintext [crypto_secretbox_ZEROBYTES + 40];
+    uint8_t ticket_box [crypto_secretbox_BOXZEROBYTES + 56];
+
+    memcpy (ticket_nonce, "TICKET--", 8);
+    randombytes (ticket_nonce + 8, 16);
+
+    memset (ticket_plaintext, 0, crypto_secretbox_ZEROBYTES);
+    memcpy (ticket_plaintext + crypto_secretbox_ZEROBYTES, client_key_, 32);
+    put_uint64 (ticket_plaintext + crypto_secretbox_ZEROBYTES + 32, expiry_);
+
+    int rc = crypto_secretbox (ticket_box, ticket_plaintext,
+                               sizeof ticket_plaintext, ticket_nonce, key_);
+    zmq_assert (rc == 0);
+
+    memcpy (ticket_, ticket_nonce + 8, 16);
+    memcpy (ticket_ + 16, ticket_box + crypto_secretbox_BOXZEROBYTES, 56);
+
+    rc = crypto_auth (rkey_, ticket_, ticket_size, key_);
+    zmq_assert (rc == 0);
+}
+
+int zmq::curve_ticket_keys_t::open (const uint8_t *key_,
+    const uint8_t *ticket_, uint64_t now_, uint8_t *client_key_,
+    uint8_t *rkey_)
+{
+    uint8_t ticket_nonce [crypto_secretbox_NONCEBYTES];
+    uint8_t ticket_plaintext [crypto_secretbox_ZEROBYTES + 40];
+    uint8_t ticket_box [crypto_secretbox_BOXZEROBYTES + 56];
+
+    memcpy (ticket_nonce, "TICKET--", 8);
+    memcpy (ticket_nonce + 8, ticket_, 16);
+
+    memset (ticket_box, 0, crypto_secretbox_BOXZEROBYTES);
+    memcpy (ticket_box + crypto_secretbox_BOXZEROBYTES, ticket_ + 16, 56);
+
+    int rc = crypto_secretbox_open (ticket_plaintext, ticket_box,
+                                    sizeof ticket_box, ticket_nonce, key_);
+    if (rc != 0)
+        return -1;
+
+    const uint64_t expiry =
+        get_uint64 (ticket_plaintext + crypto_secretbox_ZEROBYTES + 32);
+    if (expiry <= now_)
+        return -1;
+
+    memcpy (client_key_, ticket_plaintext + crypto_secretbox_ZEROBYTES, 32);
+    rc = crypto_auth (rkey_, ticket_, ticket_size, key_);
+    zmq_assert (rc == 0);
+    return 0;
+}
+
+#endif
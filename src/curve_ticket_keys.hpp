@@ -0,0 +1,85 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ZMQ_CURVE_TICKET_KEYS_HPP_INCLUDED__
+#define __ZMQ_CURVE_TICKET_KEYS_HPP_INCLUDED__
+
+#include "stdint.hpp"
+#include "mutex.hpp"
+
+namespace zmq
+{
+
+    //  Keys used by a CURVE server socket to seal resumption tickets.
+    //  A ticket is 16-byte nonce followed by Box [C + expiry](t), where
+    //  C is client's long-term public key and t is the ticket key. It is
+    //  small enough to travel in the padding of the HELLO command. Both
+    //  sides derive the resumption key as HMAC of the ticket under t; the
+    //  server sends it to the client in READY along with the ticket.
+    //  The current key is replaced once per ticket lifetime; the previous
+    //  one is kept so that tickets issued just before the rotation stay
+    //  valid for their whole lifetime. Shared by all the sessions of the
+    //  socket, hence accessed from multiple I/O threads.
+
+    class curve_ticket_keys_t
+    {
+    public:
+
+        enum {
+            key_size = 32,
+            ticket_size = 72
+        };
+
+        curve_ticket_keys_t ();
+        ~curve_ticket_keys_t ();
+
+        //  Copies out the current and the previous key, rotating them
+        //  first if the current one is older than ttl_ milliseconds.
+        //  Returns current time in milliseconds.
+        uint64_t get (int ttl_, uint8_t *current_, uint8_t *previous_);
+
+        //  Seals a ticket for client_key_, valid till expiry_, under key_.
+        //  Stores the ticket to ticket_ and resumption key to rkey_.
+        static void seal (const uint8_t *key_, const uint8_t *client_key_,
+            uint64_t expiry_, uint8_t *ticket_, uint8_t *rkey_);
+
+        //  Opens the ticket using key_. Returns 0 and fills in the client
+        //  key and resumption key if the ticket is genuine and has not
+        //  expired by now_; -1 otherwise.
+        static int open (const uint8_t *key_, const uint8_t *ticket_,
+            uint64_t now_, uint8_t *client_key_, uint8_t *rkey_);
+
+    private:
+
+        mutex_t sync;
+
+        //  Time the current key was generated at; zero if not generated yet.
+        uint64_t generated;
+
+        uint8_t current [key_size];
+        uint8_t previous [key_size];
+
+        curve_ticket_keys_t (const curve_ticket_keys_t&);
+        const curve_ticket_keys_t &operator = (const curve_ticket_keys_t&);
+    };
+
+}
+
+#endif
@@ -22,26 +22,30 @@
 
 #include <stdlib.h>
 #include <stddef.h>
-#include <algorithm>
 
-#include "mutex.hpp"
+#include "atomic_ptr.hpp"
+#include "atomic_counter.hpp"
+#include "err.hpp"
 #include "msg.hpp"
 
 namespace zmq {
 
-    //  dbuffer is a single-producer single-consumer double-buffer
-    //  implementation.
+    //  dbuffer is a single-producer single-consumer lock-free buffer
+    //  keeping only the most recently written value.
     //
-    //  The producer writes to a back buffer and then tries to swap
-    //  pointers between the back and front buffers. If it fails, (只有拿锁失败时，才放弃)
-    //  due to the consumer reading from the front buffer, it just
-    //  gives up, which is ok since writes are many and redundant.
+    //  There are three slots. The producer owns one (back), the consumer
+    //  owns one (front) and the third one is published in 'middle'. The
+    //  producer fills its slot and swaps it into 'middle'; whatever comes
+    //  back (either a value nobody read or the slot the consumer has
+    //  drained) becomes the new back and is overwritten by the next write.
+    //  The consumer swaps its slot into 'middle' to pick up the latest
+    //  value. Neither side ever waits for the other.
     //
-    //  The reader simply reads from the front buffer.
-    //
-    //  has_msg keeps track of whether there has been a not yet read
-    //  value written, it is used by ypipe_conflate to mimic ypipe
-    //  functionality regarding a reader being asleep
+    //  The low bits of the pointer stored in 'middle' carry the state:
+    //  'fresh' means the published slot holds a value not picked up yet,
+    //  'asleep' means the consumer found nothing and has to be woken up.
+    //  ypipe_conflate uses the latter to mimic ypipe's reader-asleep
+    //  behaviour (see 'c' pointer being NULL in ypipe.hpp).
 
     template<typename T>
     class dbuffer_t;
@@ -51,77 +55,123 @@ namespace zmq {
     public:
 
         inline dbuffer_t()
-                : back(&storage[0]), front(&storage[1]), has_msg(false) {
-            back->init();
-            front->init();
+                : back(&storage[0]), front(&storage[2]), has_msg(false) {
+            for (int i = 0; i != 3; i++)
+                storage[i].init();
+            middle.set(&storage[1]);
         }
 
         inline ~dbuffer_t() {
-            back->close();
-            front->close();
+            for (int i = 0; i != 3; i++)
+                storage[i].close();
         }
 
-        inline void write(const msg_t &value_) {
+        //  Publishes the value. Returns false if the consumer was asleep,
+        //  in which case the caller has to wake it up.
+        inline bool write(const msg_t &value_) {
             msg_t &xvalue = const_cast<msg_t &>(value_);
 
             zmq_assert (xvalue.check());
 
-            // 1. 将数据从xvalue写入到back中
-            back->move(xvalue);    // cannot just overwrite, might leak
+            // 1. 将数据从xvalue写入到back中 (move关闭旧数据, 不会泄漏)
+            back->move(xvalue);
 
             zmq_assert (back->check());
 
-            // 2. 将back/front切换，并且标记有数据
-            if (sync.try_lock()) {
-                std::swap(back, front);
-                has_msg = true;
-
-                sync.unlock();
-            }
+            // 2. 将back发布到middle, 拿回的slot作为新的back
+            msg_t *prev = middle.xchg(tag(back, fresh_flag));
+            if (bits(prev) & fresh_flag)
+                drops.add(1);
+            back = untag(prev);
+            return !(bits(prev) & asleep_flag);
         }
 
         inline bool read(msg_t *value_) {
-            if (!value_)
+            if (!value_ || !check_read())
                 return false;
-            else {
-                scoped_lock_t lock(sync);
-                if (!has_msg)
-                    return false;
 
-                zmq_assert (front->check());
+            zmq_assert (front->check());
 
-                // 读取front的数据, 并且重置front
-                *value_ = *front;
-                front->init();     // avoid double free
+            // 读取front的数据, 并且重置front
+            *value_ = *front;
+            front->init();     // avoid double free
 
-                has_msg = false;
-                return true;
-            }
+            has_msg = false;
+            return true;
         }
 
-
-        //
-        // 如果有消息，就能 read
-        //
+        //  Picks up the latest published value, if any. If there is none
+        //  the consumer is marked as asleep and false is returned.
         inline bool check_read() {
-            scoped_lock_t lock(sync);
+            msg_t *cur = middle.cas(NULL, NULL);
+            while (!(bits(cur) & fresh_flag)) {
+                if (has_msg)
+                    return true;
+                if (bits(cur) & asleep_flag)
+                    return false;
+                msg_t *prev = middle.cas(cur, tag(untag(cur), asleep_flag));
+                if (prev == cur)
+                    return false;
+                cur = prev;
+            }
 
-            return has_msg;
+            //  Hand our slot to the producer. If it still holds a value
+            //  that was never read, the newer one simply supersedes it.
+            if (has_msg)
+                drops.add(1);
+            front = untag(middle.xchg(front));
+            has_msg = true;
+            return true;
         }
 
+        //  The buffer mustn't be empty, i.e. check_read must have
+        //  returned true before.
         inline bool probe(bool (*fn)(msg_t &)) {
-            scoped_lock_t lock(sync);
             return (*fn)(*front);
         }
 
+        //  Number of values superseded before the consumer read them.
+        //  Both sides may discard a value, hence the atomic counter.
+        inline uint32_t dropped() {
+            return drops.get();
+        }
+
 
     private:
-        msg_t storage[2];
-        msg_t *back, *front;
+        enum {
+            fresh_flag = 1,
+            asleep_flag = 2,
+            flags_mask = 3
+        };
+
+        static inline msg_t *tag(msg_t *slot_, size_t flags_) {
+            return (msg_t *) ((size_t) slot_ | flags_);
+        }
+
+        static inline msg_t *untag(msg_t *slot_) {
+            return (msg_t *) ((size_t) slot_ & ~(size_t) flags_mask);
+        }
+
+        static inline size_t bits(msg_t *slot_) {
+            return (size_t) slot_ & flags_mask;
+        }
+
+        msg_t storage[3];
+
+        //  Owned by the producer.
+        msg_t *back;
 
-        mutex_t sync;
+        //  Owned by the consumer; has_msg tells whether it holds a value
+        //  that was not read yet.
+        msg_t *front;
         bool has_msg;
 
+        //  The slot shared between producer and consumer, plus state bits.
+        atomic_ptr_t<msg_t> middle;
+
+        //  Values discarded so far.
+        atomic_counter_t drops;
+
         //  Disable copying of dbuffer.
         dbuffer_t(const dbuffer_t &);
 
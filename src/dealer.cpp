@@ -60,6 +60,7 @@ void zmq::dealer_t::xattach_pipe(pipe_t *pipe_, bool subscribe_to_all_) {
     fq.attach(pipe_);
     
     // 输出采用 lb
+    lb.set_policy(options.lb_policy);
     lb.attach(pipe_);
 }
 
@@ -127,5 +128,15 @@ int zmq::dealer_t::sendpipe(msg_t *msg_, pipe_t **pipe_) {
 // 通过 fq 来读取msg
 //
 int zmq::dealer_t::recvpipe(msg_t *msg_, pipe_t **pipe_) {
-    return fq.recvpipe(msg_, pipe_);
+    pipe_t *pipe = NULL;
+    int rc = fq.recvpipe(msg_, &pipe);
+
+    //  A complete message from a peer counts as the reply to the oldest
+    //  request sent to it.
+    if (rc == 0 && !(msg_->flags() & msg_t::more))
+        lb.replied(pipe);
+
+    if (pipe_)
+        *pipe_ = pipe;
+    return rc;
 }
@@ -27,7 +27,9 @@ zmq::dist_t::dist_t () :
     matching (0),
     active (0),
     eligible (0),
-    more (false)
+    more (false),
+    batch (1),
+    unflushed (0)
 {
 }
 
@@ -128,6 +130,10 @@ int zmq::dist_t::send_to_matching (msg_t *msg_)
 
     more = msg_more;
 
+    //  Flush the pipes once the batch is complete.
+    if (!msg_more && batch > 1 && ++unflushed >= batch)
+        flush ();
+
     return 0;
 }
 
@@ -178,9 +184,35 @@ bool zmq::dist_t::has_out ()
     return true;
 }
 
+void zmq::dist_t::set_batch (int batch_)
+{
+    batch = batch_;
+    if (batch <= 1)
+        flush ();
+}
+
+void zmq::dist_t::flush ()
+{
+    //  Flushing a pipe with nothing new written is cheap, so there's no
+    //  need to track which pipes were written to. Only complete messages
+    //  are flushed, so this is safe in the middle of a multipart message.
+    for (pipes_t::size_type i = 0; i != pipes.size (); ++i)
+        pipes [i]->flush ();
+    unflushed = 0;
+}
+
+bool zmq::dist_t::has_unflushed ()
+{
+    return unflushed > 0;
+}
+
 bool zmq::dist_t::write (pipe_t *pipe_, msg_t *msg_)
 {
     if (!pipe_->write (msg_)) {
+        //  Let the reader see what was batched so far, otherwise it would
+        //  never drain the pipe below the high water mark.
+        if (batch > 1)
+            pipe_->flush ();
         pipes.swap (pipes.index (pipe_), matching - 1);
         matching--;
         pipes.swap (pipes.index (pipe_), active - 1);
@@ -189,7 +221,7 @@ bool zmq::dist_t::write (pipe_t *pipe_, msg_t *msg_)
         eligible--;
         return false;
     }
-    if (!(msg_->flags () & msg_t::more))
+    if (batch <= 1 && !(msg_->flags () & msg_t::more))
         pipe_->flush ();
     return true;
 }
@@ -64,6 +64,16 @@ namespace zmq
 
         bool has_out ();
 
+        //  Sets the number of complete messages written to the pipes
+        //  before they are flushed. One flushes after every message.
+        void set_batch (int batch_);
+
+        //  Flushes the messages written so far to all the pipes.
+        void flush ();
+
+        //  True if complete messages were written but not flushed yet.
+        bool has_unflushed ();
+
     private:
 
         //  Write the message to the pipe. Make the pipe inactive if writing
@@ -95,6 +105,13 @@ namespace zmq
         //  True if last we are in the middle of a multipart message.
         bool more;
 
+        //  Number of complete messages per flush, and number of messages
+        //  sent since the last flush. Flushing once per batch means that
+        //  an idle reader is woken up once per batch rather than once
+        //  per message.
+        int batch;
+        int unflushed;
+
         dist_t (const dist_t&);
         const dist_t &operator = (const dist_t&);
     };
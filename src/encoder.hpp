@@ -123,6 +123,10 @@ namespace zmq {
             (static_cast <T *> (this)->*next)();
         }
 
+        inline bool message_done() {
+            return in_progress == NULL || (!to_write && new_msg_flag);
+        }
+
     protected:
 
         //  Prototype of state machine action.
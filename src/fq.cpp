@@ -21,11 +21,14 @@
 #include "pipe.hpp"
 #include "err.hpp"
 #include "msg.hpp"
+#include "config.hpp"
 
 zmq::fq_t::fq_t() :
         active(0),
         current(0),
-        more(false) {
+        more(false),
+        prioritised(0),
+        streak(0) {
 }
 
 zmq::fq_t::~fq_t() {
@@ -36,6 +39,8 @@ void zmq::fq_t::attach(pipe_t *pipe_) {
     pipes.push_back(pipe_);
     pipes.swap(active, pipes.size() - 1);
     active++;
+    if (pipe_->get_priority() != 0)
+        prioritised++;
 }
 
 void zmq::fq_t::pipe_terminated(pipe_t *pipe_) {
@@ -50,6 +55,8 @@ void zmq::fq_t::pipe_terminated(pipe_t *pipe_) {
             current = 0;
     }
     pipes.erase(pipe_);
+    if (pipe_->get_priority() != 0)
+        prioritised--;
 }
 
 void zmq::fq_t::activated(pipe_t *pipe_) {
@@ -73,6 +80,11 @@ int zmq::fq_t::recvpipe(msg_t *msg_, pipe_t **pipe_) {
     //  Round-robin over the pipes to get the next message.
     while (active > 0) {
 
+        //  With priorities in use, pick the pipe to read the next message
+        //  from. Parts of a multipart message come from the same pipe.
+        if (!more && prioritised > 0)
+            select();
+
         //  Try to fetch new message. If we've already read part of the message
         //  subsequent part should be immediately available.
         bool fetched = pipes[current]->read(msg_);
@@ -111,6 +123,48 @@ int zmq::fq_t::recvpipe(msg_t *msg_, pipe_t **pipe_) {
     return -1;
 }
 
+void zmq::fq_t::select() {
+    //  Find the highest priority among the active pipes. Scanning from
+    //  'current' keeps pipes of the same priority in round-robin order.
+    pipes_t::size_type best = current;
+    int top = pipes[current]->get_priority();
+    int bottom = top;
+    for (pipes_t::size_type i = 1; i != active; i++) {
+        const pipes_t::size_type index = (current + i) % active;
+        const int priority = pipes[index]->get_priority();
+        if (priority < bottom)
+            bottom = priority;
+        if (priority > top) {
+            top = priority;
+            best = index;
+        }
+    }
+
+    //  Nobody is kept waiting.
+    if (bottom == top) {
+        streak = 0;
+        current = best;
+        return;
+    }
+
+    if (streak < fq_priority_quantum) {
+        streak++;
+        current = best;
+        return;
+    }
+
+    //  Lower priority pipes have waited long enough. Serve the next one
+    //  of them in round-robin order.
+    streak = 0;
+    for (pipes_t::size_type i = 0; i != active; i++) {
+        const pipes_t::size_type index = (current + i) % active;
+        if (pipes[index]->get_priority() < top) {
+            current = index;
+            return;
+        }
+    }
+}
+
 bool zmq::fq_t::has_in() {
     //  There are subsequent parts of the partly-read message available.
     if (more)
@@ -53,6 +53,11 @@ namespace zmq {
 
     private:
 
+        //  Points 'current' to the active pipe of the highest priority,
+        //  or to a lower priority one once the higher priority pipes were
+        //  served fq_priority_quantum messages in a row.
+        void select();
+
         //  Inbound pipes.
         typedef array_t<pipe_t, 1> pipes_t;
         pipes_t pipes;
@@ -68,6 +73,14 @@ namespace zmq {
         //  there are following parts still waiting in the current pipe.
         bool more;
 
+        //  Number of attached pipes with non-zero priority. As long as it
+        //  is zero, plain round-robin is used.
+        int prioritised;
+
+        //  Number of messages read in a row while lower priority pipes
+        //  were kept waiting.
+        int streak;
+
         fq_t(const fq_t &);
 
         const fq_t &operator=(const fq_t &);
@@ -41,6 +41,10 @@ namespace zmq {
         //  Load a new message into encoder.
         virtual void load_msg(msg_t *msg_) = 0;
 
+        //  Returns true if all the data of the message loaded last have
+        //  been returned by encode.
+        virtual bool message_done() = 0;
+
     };
 
 }
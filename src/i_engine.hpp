@@ -48,6 +48,10 @@ namespace zmq
         virtual void restart_output () = 0;
 
         virtual void zap_msg_available () = 0;
+
+        //  This method is called by the session when the handshake job
+        //  the engine's mechanism has submitted to a crypto thread is done.
+        virtual void crypto_done () = 0;
     };
 
 }
@@ -72,14 +72,19 @@ void zmq::io_object_t::reset_pollout(handle_t handle_) {
     poller->reset_pollout(handle_);
 }
 
-void zmq::io_object_t::add_timer(int timeout_, int id_) {
-    poller->add_timer(timeout_, this, id_);
+zmq::io_object_t::timer_handle_t zmq::io_object_t::add_timer(int timeout_,
+                                                              int id_) {
+    return poller->add_timer(timeout_, this, id_);
 }
 
 void zmq::io_object_t::cancel_timer(int id_) {
     poller->cancel_timer(this, id_);
 }
 
+void zmq::io_object_t::cancel_timer(timer_handle_t handle_) {
+    poller->cancel_timer(handle_);
+}
+
 void zmq::io_object_t::in_event() {
     zmq_assert (false);
 }
@@ -68,7 +68,8 @@ int zmq::ipc_address_t::resolve (const char *path_)
     return 0;
 }
 
-int zmq::ipc_address_t::to_string (std::string &addr_)
+int zmq::ipc_address_t::to_string (std::string &addr_,
+    const char *protocol_)
 {
     if (address.sun_family != AF_UNIX) {
         addr_.clear ();
@@ -77,9 +78,9 @@ int zmq::ipc_address_t::to_string (std::string &addr_)
 
     std::stringstream s;
 #if !defined ZMQ_HAVE_LINUX
-    s << "ipc://" << address.sun_path;
+    s << protocol_ << "://" << address.sun_path;
 #else
-    s << "ipc://";
+    s << protocol_ << "://";
     if (!address.sun_path[0] && address.sun_path[1])
        s << "@" << address.sun_path + 1;
     else
@@ -43,8 +43,9 @@ namespace zmq
         //  This function sets up the address for UNIX domain transport.
         int resolve (const char* path_);
 
-        //  The opposite to resolve()
-        int to_string (std::string &addr_);
+        //  The opposite to resolve(). The shm:// transport shares the
+        //  address format and passes its own protocol name.
+        int to_string (std::string &addr_, const char *protocol_ = "ipc");
 
         const sockaddr *addr () const;
         socklen_t addrlen () const;
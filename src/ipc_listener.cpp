@@ -26,6 +26,7 @@
 #include <string.h>
 
 #include "stream_engine.hpp"
+#include "shm_engine.hpp"
 #include "ipc_address.hpp"
 #include "io_thread.hpp"
 #include "session_base.hpp"
@@ -40,11 +41,12 @@
 #include <sys/un.h>
 
 zmq::ipc_listener_t::ipc_listener_t (io_thread_t *io_thread_,
-      socket_base_t *socket_, const options_t &options_) :
+      socket_base_t *socket_, const options_t &options_, bool shm_) :
     own_t (io_thread_, options_),
     io_object_t (io_thread_),
     has_file (false),
     s (retired_fd),
+    shm (shm_),
     socket (socket_)
 {
 }
@@ -80,8 +82,13 @@ void zmq::ipc_listener_t::in_event ()
     }
 
     //  Create the engine object for this connection.
-    stream_engine_t *engine = new (std::nothrow)
-        stream_engine_t (fd, options, endpoint);
+    i_engine *engine;
+#if defined ZMQ_HAVE_SHM
+    if (shm)
+        engine = new (std::nothrow) shm_engine_t (fd, options, endpoint, true);
+    else
+#endif
+        engine = new (std::nothrow) stream_engine_t (fd, options, endpoint);
     alloc_assert (engine);
 
     //  Choose I/O thread to run connecter in. Given that we are already
@@ -114,7 +121,7 @@ int zmq::ipc_listener_t::get_address (std::string &addr_)
     }
 
     ipc_address_t addr ((struct sockaddr *) &ss, sl);
-    return addr.to_string (addr_);
+    return addr.to_string (addr_, shm ? "shm" : "ipc");
 }
 
 int zmq::ipc_listener_t::set_address (const char *addr_)
@@ -145,7 +152,7 @@ int zmq::ipc_listener_t::set_address (const char *addr_)
     if (s == -1)
         return -1;
 
-    address.to_string (endpoint);
+    address.to_string (endpoint, shm ? "shm" : "ipc");
 
     //  Bind the socket to the file path.
     rc = bind (s, address.addr (), address.addrlen ());
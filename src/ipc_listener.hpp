@@ -41,8 +41,11 @@ namespace zmq
     {
     public:
 
+        //  If 'shm_' is true, accepted connections run the shm://
+        //  transport rather than ipc://.
         ipc_listener_t (zmq::io_thread_t *io_thread_,
-            zmq::socket_base_t *socket_, const options_t &options_);
+            zmq::socket_base_t *socket_, const options_t &options_,
+            bool shm_);
         ~ipc_listener_t ();
 
         //  Set address to listen on.
@@ -80,6 +83,9 @@ namespace zmq
         //  Handle corresponding to the listening socket.
         handle_t handle;
 
+        //  True if this listener serves the shm:// transport.
+        bool shm;
+
         //  Socket the listerner belongs to.
         zmq::socket_base_t *socket;
 
@@ -17,16 +17,20 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+
 #include "lb.hpp"
 #include "pipe.hpp"
 #include "err.hpp"
 #include "msg.hpp"
+#include "clock.hpp"
 
 zmq::lb_t::lb_t() :
         active(0),
         current(0),
         more(false),
-        dropping(false) {
+        dropping(false),
+        policy(ZMQ_LB_ROUND_ROBIN) {
     // 初始状态下没有 active, current也设置为0
 }
 
@@ -36,6 +40,12 @@ zmq::lb_t::~lb_t() {
 
 void zmq::lb_t::attach(pipe_t *pipe_) {
     pipes.push_back(pipe_);
+
+    peer_t peer = {pipe_->get_weight(), 0, 0, 0, 0, 0, 0};
+    peers.push_back(peer);
+
+    if (policy == ZMQ_LB_CREDIT)
+        pipe_->set_prompt_reads();
     
     // 将pipe_加入到队列最尾部
     // 然后再交换，扩充 active的个数
@@ -57,12 +67,15 @@ void zmq::lb_t::pipe_terminated(pipe_t *pipe_) {
     //  accordingly.
     if (index < active) {
         active--;
-        pipes.swap(index, active);
+        swap(index, active);
         if (current == active)
             current = 0;
     }
     
-    // 从 pipes中删除 pipe_
+    // 从 pipes中删除 pipe_ (array_t moves the last item into its slot)
+    index = pipes.index(pipe_);
+    peers[index] = peers.back();
+    peers.pop_back();
     pipes.erase(pipe_);
 }
 
@@ -71,7 +84,7 @@ void zmq::lb_t::pipe_terminated(pipe_t *pipe_) {
 //
 void zmq::lb_t::activated(pipe_t *pipe_) {
     //  Move the pipe to the list of active pipes.
-    pipes.swap(pipes.index(pipe_), active);
+    swap(pipes.index(pipe_), active);
     active++;
 }
 
@@ -101,6 +114,14 @@ int zmq::lb_t::sendpipe(msg_t *msg_, pipe_t **pipe_) {
         return 0;
     }
 
+    //  At the start of a message, route it to the pipe whose peer has
+    //  the most room left rather than blindly to the next one.
+    if (!more && policy == ZMQ_LB_CREDIT)
+        select_by_credit();
+    else if (!more && (policy == ZMQ_LB_LEAST_OUTSTANDING ||
+                       policy == ZMQ_LB_LATENCY))
+        select_by_cost();
+
     // 
     // 可以认为: active是当前可用的 pipes的个数
     //
@@ -119,7 +140,7 @@ int zmq::lb_t::sendpipe(msg_t *msg_, pipe_t **pipe_) {
         // 将 current切换到 active的位置，表示pipe不可用
         active--;
         if (current < active)
-            pipes.swap(current, active);
+            swap(current, active);
         else
             // 如果没有可用的pipes, 则: active也似乎为0了
             current = 0;
@@ -135,6 +156,15 @@ int zmq::lb_t::sendpipe(msg_t *msg_, pipe_t **pipe_) {
     //  continue round-robining (load balance).
     more = msg_->flags() & msg_t::more ? true : false;
     if (!more) {
+        //  Account for the request the peer now owes us a reply for.
+        peer_t &peer = peers[current];
+        peer.sent++;
+        peer.outstanding++;
+        if (policy == ZMQ_LB_LATENCY && !peer.probe) {
+            peer.probe = peer.sent;
+            peer.probe_time = clock_t::now_us();
+        }
+
         // 如果数据写出去成功，则切换到下一个 active的pipes, 并且flush
         pipes[current]->flush();
         current = (current + 1) % active;
@@ -147,6 +177,80 @@ int zmq::lb_t::sendpipe(msg_t *msg_, pipe_t **pipe_) {
     return 0;
 }
 
+void zmq::lb_t::set_policy(int policy_) {
+    policy = policy_;
+}
+
+void zmq::lb_t::select_by_credit() {
+    if (active < 2)
+        return;
+
+    //  Scan starting from the round-robin position, so that pipes with
+    //  equal credit still take turns.
+    pipes_t::size_type best = current;
+    int64_t best_credit = pipes[current]->get_credit();
+    for (pipes_t::size_type i = 1; i < active; i++) {
+        pipes_t::size_type index = (current + i) % active;
+        int64_t credit = pipes[index]->get_credit();
+        if (credit > best_credit) {
+            best = index;
+            best_credit = credit;
+        }
+    }
+    current = best;
+}
+
+void zmq::lb_t::replied(pipe_t *pipe_) {
+    peer_t &peer = peers[pipes.index(pipe_)];
+    peer.replied++;
+    if (peer.outstanding > 0)
+        peer.outstanding--;
+
+    //  Replies are assumed to come back in order, so the probe is answered
+    //  once as many replies as requests up to it have arrived.
+    if (peer.probe && peer.replied >= peer.probe) {
+        uint64_t sample = clock_t::now_us() - peer.probe_time;
+        if (!peer.latency)
+            peer.latency = sample;
+        else
+            peer.latency = (peer.latency * 7 + sample) / 8;
+        peer.probe = 0;
+    }
+}
+
+double zmq::lb_t::cost(pipes_t::size_type index_) {
+    const peer_t &peer = peers[index_];
+    double cost = (double) peer.outstanding + 1;
+
+    //  A peer that is slow to reply is expected to take as long for each
+    //  of the requests queued to it.
+    if (policy == ZMQ_LB_LATENCY)
+        cost *= (double) peer.latency + 1;
+    return cost / peer.weight;
+}
+
+void zmq::lb_t::select_by_cost() {
+    if (active < 2)
+        return;
+
+    pipes_t::size_type best = current;
+    double best_cost = cost(current);
+    for (pipes_t::size_type i = 1; i < active; i++) {
+        pipes_t::size_type index = (current + i) % active;
+        double c = cost(index);
+        if (c < best_cost) {
+            best = index;
+            best_cost = c;
+        }
+    }
+    current = best;
+}
+
+void zmq::lb_t::swap(pipes_t::size_type index1_, pipes_t::size_type index2_) {
+    pipes.swap(index1_, index2_);
+    std::swap(peers[index1_], peers[index2_]);
+}
+
 bool zmq::lb_t::has_out() {
     //  If one part of the message was already written we can definitely
     //  write the rest of the message.
@@ -162,7 +266,7 @@ bool zmq::lb_t::has_out() {
 
         //  Deactivate the pipe.
         active--;
-        pipes.swap(current, active);
+        swap(current, active);
         if (current == active)
             current = 0;
     }
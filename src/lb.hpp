@@ -20,8 +20,11 @@
 #ifndef __ZMQ_LB_HPP_INCLUDED__
 #define __ZMQ_LB_HPP_INCLUDED__
 
+#include <vector>
+
 #include "array.hpp"
 #include "pipe.hpp"
+#include "stdint.hpp"
 
 namespace zmq {
 
@@ -57,12 +60,57 @@ namespace zmq {
 
         bool has_out();
 
+        //  Selects the policy used to pick the pipe for the next message,
+        //  one of the ZMQ_LB_* values.
+        void set_policy(int policy_);
+
+        //  Tells the load balancer that a complete reply has arrived from
+        //  the pipe. Used by the least outstanding and latency policies.
+        void replied(pipe_t *pipe_);
+
     private:
 
         //  List of outbound pipes.
         typedef array_t<pipe_t, 2> pipes_t;
         pipes_t pipes;
 
+        //  State of the peer at the other end of each pipe, kept in the
+        //  same order as 'pipes'.
+        struct peer_t {
+            //  Relative capacity of the peer.
+            int weight;
+
+            //  Messages sent to the peer and not replied to yet.
+            uint32_t outstanding;
+
+            //  Number of messages sent to and replies received from the peer.
+            uint64_t sent;
+            uint64_t replied;
+
+            //  One message at a time is timed to sample the reply latency.
+            //  probe is its sequence number (zero if none is in flight).
+            uint64_t probe;
+            uint64_t probe_time;
+
+            //  Moving average of the reply latency in microseconds.
+            uint64_t latency;
+        };
+        std::vector<peer_t> peers;
+
+        //  Makes 'current' point to the active pipe with the most free
+        //  credit. Ties are broken round-robin.
+        void select_by_credit();
+
+        //  Makes 'current' point to the active pipe with the lowest cost
+        //  relative to its weight. Ties are broken round-robin.
+        void select_by_cost();
+
+        //  Expected cost of sending the next message to the peer.
+        double cost(pipes_t::size_type index_);
+
+        //  Swaps two pipes along with their peer state.
+        void swap(pipes_t::size_type index1_, pipes_t::size_type index2_);
+
         //  Number of active pipes. All the active pipes are located at the
         //  beginning of the pipes array.
         pipes_t::size_type active;
@@ -76,6 +124,9 @@ namespace zmq {
         //  True if we are dropping current message.
         bool dropping;
 
+        //  Load balancing policy.
+        int policy;
+
         lb_t(const lb_t &);
 
         const lb_t &operator=(const lb_t &);
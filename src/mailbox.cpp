@@ -84,3 +84,14 @@ int zmq::mailbox_t::recv(command_t *cmd_, int timeout_) {
     zmq_assert (ok);
     return 0;
 }
+
+int zmq::mailbox_t::wait(int timeout_) {
+    //  The signal stays pending, so the reading thread still gets it.
+    return signaler.wait(timeout_);
+}
+
+bool zmq::mailbox_t::reset() {
+    //  Consumes a signal still pending and makes the pipe passive.
+    command_t cmd;
+    return recv(&cmd, 0) == -1;
+}
@@ -49,6 +49,15 @@ namespace zmq {
 
         int recv(command_t *cmd_, int timeout_);
 
+        //  Waits until a command may be available, without receiving it.
+        //  Unlike recv, this can be called by any thread.
+        int wait(int timeout_);
+
+        //  Brings the mailbox back to the state it is constructed in, so
+        //  that it can serve another socket. Returns false if commands
+        //  were left in it.
+        bool reset();
+
 #ifdef HAVE_FORK
         // close the file descriptors in the signaller. This is used in a forked
         // child process to close the file descriptors so that they do not interfere
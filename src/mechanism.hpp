@@ -53,9 +53,16 @@ namespace zmq
         //  Notifies mechanism about availability of ZAP message.
         virtual int zap_msg_available () { return 0; }
 
+        //  Notifies mechanism that its offloaded crypto job is done.
+        virtual int crypto_done () { return 0; }
+
         //  True iff the handshake stage is complete?
         virtual bool is_handshake_complete () const = 0;
 
+        //  True if the handshake resumed an earlier session rather than
+        //  authenticating the peer from scratch.
+        virtual bool is_resumed () const { return false; }
+
         void set_peer_identity (const void *id_ptr, size_t id_size);
 
         void peer_identity (msg_t *msg_);
@@ -0,0 +1,106 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <new>
+#include <string.h>
+
+#include "monitor_ring.hpp"
+#include "clock.hpp"
+#include "err.hpp"
+
+zmq::monitor_ring_t::monitor_ring_t(uint32_t capacity_) :
+        capacity(2),
+        tail(0),
+        lost_reported(0) {
+    while (capacity < capacity_)
+        capacity <<= 1;
+    slots = new(std::nothrow) slot_t[capacity];
+    alloc_assert (slots);
+    for (uint32_t i = 0; i != capacity; i++)
+        slots[i].sequence.set(i);
+}
+
+zmq::monitor_ring_t::~monitor_ring_t() {
+    delete[] slots;
+}
+
+bool zmq::monitor_ring_t::push(const zmq_monitor_record_t &record_) {
+    uint32_t pos = head.get();
+    slot_t *slot;
+    while (true) {
+        slot = &slots[pos & (capacity - 1)];
+        const int32_t diff = (int32_t) (slot->sequence.get() - pos);
+
+        //  The slot is free; try to claim it.
+        if (diff == 0) {
+            const uint32_t old = head.cas(pos, pos + 1);
+            if (old == pos)
+                break;
+            pos = old;
+        }
+        //  The reader is a whole lap behind.
+        else if (diff < 0) {
+            lost.add(1);
+            return false;
+        }
+        //  Another producer got the slot first.
+        else
+            pos = head.get();
+    }
+
+    memcpy(&slot->record, &record_, sizeof(record_));
+
+    //  Publish. The atomic operation orders the copy before it.
+    slot->sequence.add(1);
+    return true;
+}
+
+int zmq::monitor_ring_t::read(zmq_monitor_record_t *records_, int count_) {
+    int n = 0;
+    while (n < count_) {
+        slot_t *slot = &slots[tail & (capacity - 1)];
+
+        //  Adding zero is used as a barrier, so that the record is read
+        //  only after its sequence says it is complete.
+        const uint32_t sequence = slot->sequence.add(0);
+        if ((int32_t) (sequence - (tail + 1)) < 0)
+            break;
+
+        memcpy(&records_[n++], &slot->record, sizeof(slot->record));
+
+        //  Hand the slot over to the producers of the next lap.
+        slot->sequence.add(capacity - 1);
+        tail++;
+    }
+
+    //  The records lost are newer than the ones queued when the ring
+    //  filled up, so they are reported once the queue is drained.
+    const uint32_t lost_now = lost.get();
+    if (n < count_ && lost_now != lost_reported) {
+        zmq_monitor_record_t *record = &records_[n++];
+        memset(record, 0, sizeof(*record));
+        record->timestamp = clock_t::now_us();
+        record->event = ZMQ_EVENT_MONITOR_OVERFLOW;
+        record->value = (int32_t) (lost_now - lost_reported);
+        lost_reported = lost_now;
+    }
+
+    return n;
+}
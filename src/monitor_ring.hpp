@@ -0,0 +1,85 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ZMQ_MONITOR_RING_HPP_INCLUDED__
+#define __ZMQ_MONITOR_RING_HPP_INCLUDED__
+
+#include "stdint.hpp"
+#include "atomic_counter.hpp"
+#include "../include/zmq.h"
+
+namespace zmq {
+
+    //  Bounded queue of monitor records with many producers (the I/O
+    //  threads and the socket's own thread) and a single reader.
+    //
+    //  Every slot carries a sequence number. A producer claims the next
+    //  position by a CAS on 'head', provided the reader has released the
+    //  slot at that position, copies the record in and publishes it by
+    //  bumping the slot's sequence. The reader releases a slot by moving
+    //  its sequence one lap ahead. Nobody ever waits for anybody: when
+    //  the ring is full the record is only counted as lost.
+
+    class monitor_ring_t {
+    public:
+
+        //  The capacity is rounded up to a power of two, two at least;
+        //  with a single slot a published record would look free.
+        monitor_ring_t(uint32_t capacity_);
+
+        ~monitor_ring_t();
+
+        //  Adds the record. Returns false if the ring was full.
+        bool push(const zmq_monitor_record_t &record_);
+
+        //  Moves up to count_ records out of the ring and returns their
+        //  number. Records lost since the last call are reported by an
+        //  extra ZMQ_EVENT_MONITOR_OVERFLOW record. Only a single thread
+        //  may read at a time.
+        int read(zmq_monitor_record_t *records_, int count_);
+
+    private:
+
+        struct slot_t {
+            atomic_counter_t sequence;
+            zmq_monitor_record_t record;
+        };
+
+        slot_t *slots;
+        uint32_t capacity;
+
+        //  Next position to be claimed by a producer.
+        atomic_counter_t head;
+
+        //  Next position to be read. Owned by the reader.
+        uint32_t tail;
+
+        //  Records lost so far and the number already reported.
+        atomic_counter_t lost;
+        uint32_t lost_reported;
+
+        monitor_ring_t(const monitor_ring_t &);
+
+        const monitor_ring_t &operator=(const monitor_ring_t &);
+    };
+
+}
+
+#endif
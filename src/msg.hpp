@@ -45,6 +45,8 @@ namespace zmq {
         enum {
             more = 1,           //  Followed by more parts
             command = 2,        //  Command frame (see ZMTP spec)
+            trace_out = 16,     //  Outbound message being traced
+            trace_in = 32,      //  Inbound message being traced
             identity = 64,
             shared = 128
         };
@@ -17,7 +17,9 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+
 #include <stdlib.h>
+#include <string.h>
 
 #include <new>
 #include <algorithm>
@@ -27,18 +29,77 @@
 #include "windows.hpp"
 #endif
 
+#if defined __SSE2__ || defined _M_X64 || \
+    (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#define ZMQ_MTRIE_SSE2
+#include <emmintrin.h>
+#endif
+
 #include "err.hpp"
 #include "pipe.hpp"
 #include "mtrie.hpp"
 
+//  Index of the lowest bit set in a non-zero mask.
+static inline int lowest_bit (unsigned int mask_)
+{
+#if defined __GNUC__
+    return __builtin_ctz (mask_);
+#else
+    int pos = 0;
+    while (!(mask_ & 1)) {
+        mask_ >>= 1;
+        pos++;
+    }
+    return pos;
+#endif
+}
+
+//  Returns the length of the common prefix of the two buffers, looking at
+//  most at size_ bytes.
+static inline size_t common_prefix (const unsigned char *a_,
+    const unsigned char *b_, size_t size_)
+{
+    size_t pos = 0;
+#if defined ZMQ_MTRIE_SSE2
+    while (pos + 16 <= size_) {
+        __m128i a = _mm_loadu_si128 ((const __m128i*) (a_ + pos));
+        __m128i b = _mm_loadu_si128 ((const __m128i*) (b_ + pos));
+        unsigned int mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (a, b));
+        if (mask != 0xffff)
+            return pos + lowest_bit (~mask);
+        pos += 16;
+    }
+#endif
+    while (pos < size_ && a_ [pos] == b_ [pos])
+        pos++;
+    return pos;
+}
+
 zmq::mtrie_t::mtrie_t () :
     pipes (0),
-    min (0),
+    label (0),
+    label_size (0),
     count (0),
-    live_nodes (0)
+    capacity (0),
+    first (0),
+    children (0)
 {
 }
 
+zmq::mtrie_t::mtrie_t (const unsigned char *label_, size_t label_size_) :
+    pipes (0),
+    label (0),
+    label_size (label_size_),
+    count (0),
+    capacity (0),
+    first (0),
+    children (0)
+{
+    label = (unsigned char*) malloc (label_size_);
+    alloc_assert (label);
+    memcpy (label, label_, label_size_);
+}
+
 zmq::mtrie_t::~mtrie_t ()
 {
     if (pipes) {
@@ -46,16 +107,93 @@ zmq::mtrie_t::~mtrie_t ()
         pipes = 0;
     }
 
-    if (count == 1) {
-        zmq_assert (next.node);
-        delete next.node;
-        next.node = 0;
+    for (unsigned short i = 0; i != count; ++i)
+        delete children [i];
+    free (children);
+    free (first);
+    free (label);
+}
+
+int zmq::mtrie_t::find (unsigned char c_) const
+{
+#if defined ZMQ_MTRIE_SSE2
+    __m128i needle = _mm_set1_epi8 ((char) c_);
+    for (unsigned short i = 0; i < count; i += 16) {
+        __m128i block = _mm_loadu_si128 ((const __m128i*) (first + i));
+        unsigned int mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (block, needle));
+        if (count - i < 16)
+            mask &= (1u << (count - i)) - 1;
+        if (mask)
+            return i + lowest_bit (mask);
+    }
+#else
+    for (unsigned short i = 0; i != count; ++i)
+        if (first [i] == c_)
+            return i;
+#endif
+    return -1;
+}
+
+zmq::mtrie_t *zmq::mtrie_t::lookup (const unsigned char *data_,
+    size_t size_) const
+{
+    if (!size_)
+        return NULL;
+    int i = find (*data_);
+    if (i < 0)
+        return NULL;
+    mtrie_t *child = children [i];
+    if (child->label_size > size_ ||
+          common_prefix (child->label + 1, data_ + 1, child->label_size - 1) !=
+          child->label_size - 1)
+        return NULL;
+    return child;
+}
+
+void zmq::mtrie_t::add_child (mtrie_t *child_)
+{
+    if (count == capacity) {
+        capacity = capacity ? capacity * 2 : 2;
+        children = (mtrie_t**) realloc (children,
+            sizeof (mtrie_t*) * capacity);
+        alloc_assert (children);
+        first = (unsigned char*) realloc (first, (capacity + 15) & ~15);
+        alloc_assert (first);
     }
-    else 
-    if (count > 1) {
-        for (unsigned short i = 0; i != count; ++i)
-            delete next.table [i];
-        free (next.table);
+    first [count] = child_->label [0];
+    children [count] = child_;
+    count++;
+}
+
+void zmq::mtrie_t::compact (int index_)
+{
+    mtrie_t *child = children [index_];
+
+    //  Prune the node if it was made redundant by the removal.
+    if (child->is_redundant ()) {
+        delete child;
+        count--;
+        children [index_] = children [count];
+        first [index_] = first [count];
+        return;
+    }
+
+    //  A node without pipes and with a single child is merged with the
+    //  child. The first byte of the label doesn't change.
+    if (!child->pipes && child->count == 1) {
+        mtrie_t *grandchild = child->children [0];
+        unsigned char *label = (unsigned char*) malloc (
+            child->label_size + grandchild->label_size);
+        alloc_assert (label);
+        memcpy (label, child->label, child->label_size);
+        memcpy (label + child->label_size, grandchild->label,
+            grandchild->label_size);
+        free (grandchild->label);
+        grandchild->label = label;
+        grandchild->label_size += child->label_size;
+        child->count = 0;
+        delete child;
+        children [index_] = grandchild;
     }
 }
 
@@ -78,72 +216,31 @@ bool zmq::mtrie_t::add_helper (unsigned char *prefix_, size_t size_,
         return result;
     }
 
-    unsigned char c = *prefix_;
-    if (c < min || c >= min + count) {
-
-        //  The character is out of range of currently handled
-        //  charcters. We have to extend the table.
-        if (!count) {
-            min = c;
-            count = 1;
-            next.node = NULL;
-        }
-        else 
-        if (count == 1) {
-            unsigned char oldc = min;
-            mtrie_t *oldp = next.node;
-            count = (min < c ? c - min : min - c) + 1;
-            next.table = (mtrie_t**)
-                malloc (sizeof (mtrie_t*) * count);
-            alloc_assert (next.table);
-            for (unsigned short i = 0; i != count; ++i)
-                next.table [i] = 0;
-            min = std::min (min, c);
-            next.table [oldc - min] = oldp;
-        }
-        else 
-        if (min < c) {
-            //  The new character is above the current character range.
-            unsigned short old_count = count;
-            count = c - min + 1;
-            next.table = (mtrie_t**) realloc (next.table,
-                sizeof (mtrie_t*) * count);
-            alloc_assert (next.table);
-            for (unsigned short i = old_count; i != count; i++)
-                next.table [i] = NULL;
-        }
-        else {
-            //  The new character is below the current character range.
-            unsigned short old_count = count;
-            count = (min + old_count) - c;
-            next.table = (mtrie_t**) realloc (next.table,
-                sizeof (mtrie_t*) * count);
-            alloc_assert (next.table);
-            memmove (next.table + min - c, next.table,
-                old_count * sizeof (mtrie_t*));
-            for (unsigned short i = 0; i != min - c; i++)
-                next.table [i] = NULL;
-            min = c;
-        }
+    //  If there's no child starting with the same byte, the rest of the
+    //  prefix becomes the label of a new leaf node.
+    int i = find (*prefix_);
+    if (i < 0) {
+        mtrie_t *child = new (std::nothrow) mtrie_t (prefix_, size_);
+        alloc_assert (child);
+        add_child (child);
+        return child->add_helper (prefix_ + size_, 0, pipe_);
     }
 
-    //  If next node does not exist, create one.
-    if (count == 1) {
-        if (!next.node) {
-            next.node = new (std::nothrow) mtrie_t;
-            alloc_assert (next.node);
-            ++live_nodes;
-        }
-        return next.node->add_helper (prefix_ + 1, size_ - 1, pipe_);
-    }
-    else {
-        if (!next.table [c - min]) {
-            next.table [c - min] = new (std::nothrow) mtrie_t;
-            alloc_assert (next.table [c - min]);
-            ++live_nodes;
-        }
-        return next.table [c - min]->add_helper (prefix_ + 1, size_ - 1, pipe_);
+    //  If the prefix diverges from the child's label half-way, split the
+    //  child in two at the point of divergence.
+    mtrie_t *child = children [i];
+    size_t common = common_prefix (child->label, prefix_,
+        std::min (child->label_size, size_));
+    if (common < child->label_size) {
+        mtrie_t *split = new (std::nothrow) mtrie_t (child->label, common);
+        alloc_assert (split);
+        child->label_size -= common;
+        memmove (child->label, child->label + common, child->label_size);
+        split->add_child (child);
+        children [i] = split;
+        child = split;
     }
+    return child->add_helper (prefix_ + common, size_ - common, pipe_);
 }
 
 
@@ -152,12 +249,13 @@ void zmq::mtrie_t::rm (pipe_t *pipe_,
     void *arg_)
 {
     unsigned char *buff = NULL;
-    rm_helper (pipe_, &buff, 0, 0, func_, arg_);
+    size_t maxbuffsize = 0;
+    rm_helper (pipe_, &buff, 0, maxbuffsize, func_, arg_);
     free (buff);
 }
 
 void zmq::mtrie_t::rm_helper (pipe_t *pipe_, unsigned char **buff_,
-    size_t buffsize_, size_t maxbuffsize_,
+    size_t buffsize_, size_t &maxbuffsize_,
     void (*func_) (unsigned char *data_, size_t size_, void *arg_),
     void *arg_)
 {
@@ -168,113 +266,22 @@ void zmq::mtrie_t::rm_helper (pipe_t *pipe_, unsigned char **buff_,
         pipes = 0;
     }
 
-    //  Adjust the buffer.
-    if (buffsize_ >= maxbuffsize_) {
-        maxbuffsize_ = buffsize_ + 256;
-        *buff_ = (unsigned char*) realloc (*buff_, maxbuffsize_);
-        alloc_assert (*buff_);
-    }
-
-    //  If there are no subnodes in the trie, return.
-    if (count == 0)
-        return;
-
-    //  If there's one subnode (optimisation).
-    if (count == 1) {
-        (*buff_) [buffsize_] = min;
-        buffsize_++;
-        next.node->rm_helper (pipe_, buff_, buffsize_, maxbuffsize_,
-            func_, arg_);
-
-        //  Prune the node if it was made redundant by the removal
-        if (next.node->is_redundant ()) {
-            delete next.node;
-            next.node = 0;
-            count = 0;
-            --live_nodes;
-            zmq_assert (live_nodes == 0);
+    //  Walk the children backwards as compacting may move the last child
+    //  into the slot being processed.
+    for (int i = count - 1; i >= 0; i--) {
+        mtrie_t *child = children [i];
+
+        //  Adjust the buffer.
+        size_t size = buffsize_ + child->label_size;
+        if (size > maxbuffsize_) {
+            maxbuffsize_ = size + 256;
+            *buff_ = (unsigned char*) realloc (*buff_, maxbuffsize_);
+            alloc_assert (*buff_);
         }
-        return;
-    }
+        memcpy (*buff_ + buffsize_, child->label, child->label_size);
 
-    //  If there are multiple subnodes.
-    //
-    //  New min non-null character in the node table after the removal
-    unsigned char new_min = min + count - 1;
-    //  New max non-null character in the node table after the removal
-    unsigned char new_max = min;
-    for (unsigned short c = 0; c != count; c++) {
-        (*buff_) [buffsize_] = min + c;
-        if (next.table [c]) {
-            next.table [c]->rm_helper (pipe_, buff_, buffsize_ + 1,
-                maxbuffsize_, func_, arg_);
-
-            //  Prune redundant nodes from the mtrie
-            if (next.table [c]->is_redundant ()) {
-                delete next.table [c];
-                next.table [c] = 0;
-
-                zmq_assert (live_nodes > 0);
-                --live_nodes;
-            }
-            else {
-                //  The node is not redundant, so it's a candidate for being
-                //  the new min/max node.
-                //
-                //  We loop through the node array from left to right, so the
-                //  first non-null, non-redundant node encountered is the new
-                //  minimum index. Conversely, the last non-redundant, non-null
-                //  node encountered is the new maximum index.
-                if (c + min < new_min)
-                    new_min = c + min;
-                if (c + min > new_max)
-                    new_max = c + min;
-            }
-        }
-    }
-
-    zmq_assert (count > 1);
-
-    //  Free the node table if it's no longer used.
-    if (live_nodes == 0) {
-        free (next.table);
-        next.table = NULL;
-        count = 0;
-    }
-    //  Compact the node table if possible
-    else 
-    if (live_nodes == 1) {
-        //  If there's only one live node in the table we can
-        //  switch to using the more compact single-node
-        //  representation
-        zmq_assert (new_min == new_max);
-        zmq_assert (new_min >= min && new_min < min + count);
-        mtrie_t *node = next.table [new_min - min];
-        zmq_assert (node);
-        free (next.table);
-        next.node = node;
-        count = 1;
-        min = new_min;
-    }
-    else
-    if (new_min > min || new_max < min + count - 1) {
-        zmq_assert (new_max - new_min + 1 > 1);
-
-        mtrie_t **old_table = next.table;
-        zmq_assert (new_min > min || new_max < min + count - 1);
-        zmq_assert (new_min >= min);
-        zmq_assert (new_max <= min + count - 1);
-        zmq_assert (new_max - new_min + 1 < count);
-
-        count = new_max - new_min + 1;
-        next.table = (mtrie_t**) malloc (sizeof (mtrie_t*) * count);
-        alloc_assert (next.table);
-
-        memmove (next.table, old_table + (new_min - min),
-                 sizeof (mtrie_t*) * count);
-        free (old_table);
-
-        min = new_min;
+        child->rm_helper (pipe_, buff_, size, maxbuffsize_, func_, arg_);
+        compact (i);
     }
 }
 
@@ -298,86 +305,13 @@ bool zmq::mtrie_t::rm_helper (unsigned char *prefix_, size_t size_,
         return !pipes;
     }
 
-    unsigned char c = *prefix_;
-    if (!count || c < min || c >= min + count)
+    mtrie_t *child = lookup (prefix_, size_);
+    if (!child)
         return false;
 
-    mtrie_t *next_node =
-        count == 1 ? next.node : next.table [c - min];
-
-    if (!next_node)
-        return false;
-
-    bool ret = next_node->rm_helper (prefix_ + 1, size_ - 1, pipe_);
-
-    if (next_node->is_redundant ()) {
-        delete next_node;
-        zmq_assert (count > 0);
-
-        if (count == 1) {
-            next.node = 0;
-            count = 0;
-            --live_nodes;
-            zmq_assert (live_nodes == 0);
-        }
-        else {
-            next.table [c - min] = 0;
-            zmq_assert (live_nodes > 1);
-            --live_nodes;
-
-            //  Compact the table if possible
-            if (live_nodes == 1) {
-                //  If there's only one live node in the table we can
-                //  switch to using the more compact single-node
-                //  representation
-                unsigned short i;
-                for (i = 0; i < count; ++i)
-                    if (next.table [i])
-                        break;
-
-                zmq_assert (i < count);
-                min += i;
-                count = 1;
-                mtrie_t *oldp = next.table [i];
-                free (next.table);
-                next.node = oldp;
-            }
-            else
-            if (c == min) {
-                //  We can compact the table "from the left"
-                unsigned short i;
-                for (i = 1; i < count; ++i)
-                    if (next.table [i])
-                        break;
-
-                zmq_assert (i < count);
-                min += i;
-                count -= i;
-                mtrie_t **old_table = next.table;
-                next.table = (mtrie_t**) malloc (sizeof (mtrie_t*) * count);
-                alloc_assert (next.table);
-                memmove (next.table, old_table + i, sizeof (mtrie_t*) * count);
-                free (old_table);
-            }
-            else
-            if (c == min + count - 1) {
-                //  We can compact the table "from the right"
-                unsigned short i;
-                for (i = 1; i < count; ++i)
-                    if (next.table [count - 1 - i])
-                        break;
-
-                zmq_assert (i < count);
-                count -= i;
-                mtrie_t **old_table = next.table;
-                next.table = (mtrie_t**) malloc (sizeof (mtrie_t*) * count);
-                alloc_assert (next.table);
-                memmove (next.table, old_table, sizeof (mtrie_t*) * count);
-                free (old_table);
-            }
-        }
-    }
-
+    bool ret = child->rm_helper (prefix_ + child->label_size,
+        size_ - child->label_size, pipe_);
+    compact (find (*prefix_));
     return ret;
 }
 
@@ -385,7 +319,7 @@ void zmq::mtrie_t::match (unsigned char *data_, size_t size_,
     void (*func_) (pipe_t *pipe_, void *arg_), void *arg_)
 {
     mtrie_t *current = this;
-    while (true) {
+    while (current) {
 
         //  Signal the pipes attached to this node.
         if (current->pipes) {
@@ -394,37 +328,19 @@ void zmq::mtrie_t::match (unsigned char *data_, size_t size_,
                 func_ (*it, arg_);
         }
 
-        //  If we are at the end of the message, there's nothing more to match.
-        if (!size_)
-            break;
-
-        //  If there are no subnodes in the trie, return.
-        if (current->count == 0)
-            break;
-
-        //  If there's one subnode (optimisation).
-		if (current->count == 1) {
-            if (data_ [0] != current->min)
-                break;
-            current = current->next.node;
-            data_++;
-            size_--;
-		    continue;
-		}
-
-		//  If there are multiple subnodes.
-        if (data_ [0] < current->min || data_ [0] >=
-              current->min + current->count)
-            break;
-        if (!current->next.table [data_ [0] - current->min])
-            break;
-        current = current->next.table [data_ [0] - current->min];
-        data_++;
-        size_--;
+        //  Move to the child whose whole label prefixes the rest of the
+        //  message, if any. At the end of the message there's nothing more
+        //  to match.
+        mtrie_t *next = current->lookup (data_, size_);
+        if (next) {
+            data_ += next->label_size;
+            size_ -= next->label_size;
+        }
+        current = next;
     }
 }
 
 bool zmq::mtrie_t::is_redundant () const
 {
-    return !pipes && live_nodes == 0;
+    return !pipes && count == 0;
 }
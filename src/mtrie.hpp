@@ -31,6 +31,12 @@ namespace zmq
     class pipe_t;
 
     //  Multi-trie. Each node in the trie is a set of pointers to pipes.
+    //
+    //  The trie is path-compressed: a node is labelled with the whole run
+    //  of bytes leading to it from its parent rather than with a single
+    //  byte, so matching a topic visits one node per branching point.
+    //  Labels are compared and children are looked up 16 bytes at a time
+    //  using SSE2 where available.
 
     class mtrie_t
     {
@@ -60,26 +66,45 @@ namespace zmq
 
     private:
 
+        mtrie_t (const unsigned char *label_, size_t label_size_);
+
         bool add_helper (unsigned char *prefix_, size_t size_,
             zmq::pipe_t *pipe_);
         void rm_helper (zmq::pipe_t *pipe_, unsigned char **buff_,
-            size_t buffsize_, size_t maxbuffsize_,
+            size_t buffsize_, size_t &maxbuffsize_,
             void (*func_) (unsigned char *data_, size_t size_, void *arg_),
             void *arg_);
         bool rm_helper (unsigned char *prefix_, size_t size_,
             zmq::pipe_t *pipe_);
         bool is_redundant () const;
 
+        //  Returns the index of the child whose label starts with c_,
+        //  or -1 if there is none.
+        int find (unsigned char c_) const;
+
+        //  Returns the child matching the beginning of data_, provided
+        //  its whole label is a prefix of data_.
+        mtrie_t *lookup (const unsigned char *data_, size_t size_) const;
+
+        void add_child (mtrie_t *child_);
+
+        //  Drops the child at index_ if it became redundant, or merges it
+        //  with its only child if it has no pipes of its own.
+        void compact (int index_);
+
         typedef std::set <zmq::pipe_t*> pipes_t;
         pipes_t *pipes;
 
-        unsigned char min;
+        //  Bytes leading from the parent node to this one.
+        unsigned char *label;
+        size_t label_size;
+
+        //  Child nodes. 'first' holds the first byte of each child's label
+        //  and is padded to a multiple of 16 bytes for vector lookups.
         unsigned short count;
-        unsigned short live_nodes;
-        union {
-            class mtrie_t *node;
-            class mtrie_t **table;
-        } next;
+        unsigned short capacity;
+        unsigned char *first;
+        mtrie_t **children;
 
         mtrie_t (const mtrie_t&);
         const mtrie_t &operator = (const mtrie_t&);
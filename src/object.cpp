@@ -27,6 +27,7 @@
 #include "io_thread.hpp"
 #include "session_base.hpp"
 #include "socket_base.hpp"
+#include "crypto_thread.hpp"
 
 zmq::object_t::object_t(ctx_t *ctx_, uint32_t tid_) :
         ctx(ctx_),
@@ -66,7 +67,8 @@ void zmq::object_t::process_command(command_t &cmd_) {
             break;
 
         case command_t::activate_write:
-            process_activate_write(cmd_.args.activate_write.msgs_read);
+            process_activate_write(cmd_.args.activate_write.msgs_read,
+                                   cmd_.args.activate_write.bytes_read);
             break;
 
         case command_t::stop:
@@ -129,6 +131,19 @@ void zmq::object_t::process_command(command_t &cmd_) {
             process_seqnum();
             break;
 
+        case command_t::crypto_req:
+            process_crypto_req(cmd_.args.crypto_req.job);
+            break;
+
+        case command_t::crypto_done:
+            process_crypto_done(cmd_.args.crypto_done.job);
+            process_seqnum();
+            break;
+
+        case command_t::flush:
+            process_flush();
+            break;
+
         case command_t::done:
         default:
             zmq_assert (false);
@@ -163,6 +178,10 @@ zmq::io_thread_t *zmq::object_t::choose_io_thread(uint64_t affinity_) {
     return ctx->choose_io_thread(affinity_);
 }
 
+zmq::crypto_thread_t *zmq::object_t::choose_crypto_thread() {
+    return ctx->choose_crypto_thread();
+}
+
 void zmq::object_t::send_stop() {
     //  'stop' command goes always from administrative thread to
     //  the current object. 
@@ -223,11 +242,13 @@ void zmq::object_t::send_activate_read(pipe_t *destination_) {
 }
 
 void zmq::object_t::send_activate_write(pipe_t *destination_,
-                                        uint64_t msgs_read_) {
+                                        uint64_t msgs_read_,
+                                        uint64_t bytes_read_) {
     command_t cmd;
     cmd.destination = destination_;
     cmd.type = command_t::activate_write;
     cmd.args.activate_write.msgs_read = msgs_read_;
+    cmd.args.activate_write.bytes_read = bytes_read_;
     send_command(cmd);
 }
 
@@ -306,6 +327,31 @@ void zmq::object_t::send_done() {
     ctx->send_command(ctx_t::term_tid, cmd);
 }
 
+void zmq::object_t::send_crypto_req(crypto_thread_t *destination_,
+                                    crypto_job_t *job_) {
+    command_t cmd;
+    cmd.destination = destination_;
+    cmd.type = command_t::crypto_req;
+    cmd.args.crypto_req.job = job_;
+    send_command(cmd);
+}
+
+void zmq::object_t::send_crypto_done(session_base_t *destination_,
+                                     crypto_job_t *job_) {
+    command_t cmd;
+    cmd.destination = destination_;
+    cmd.type = command_t::crypto_done;
+    cmd.args.crypto_done.job = job_;
+    send_command(cmd);
+}
+
+void zmq::object_t::send_flush(own_t *destination_) {
+    command_t cmd;
+    cmd.destination = destination_;
+    cmd.type = command_t::flush;
+    send_command(cmd);
+}
+
 void zmq::object_t::process_stop() {
     zmq_assert (false);
 }
@@ -330,7 +376,7 @@ void zmq::object_t::process_activate_read() {
     zmq_assert (false);
 }
 
-void zmq::object_t::process_activate_write(uint64_t) {
+void zmq::object_t::process_activate_write(uint64_t, uint64_t) {
     zmq_assert (false);
 }
 
@@ -366,6 +412,18 @@ void zmq::object_t::process_reaped() {
     zmq_assert (false);
 }
 
+void zmq::object_t::process_crypto_req(crypto_job_t *) {
+    zmq_assert (false);
+}
+
+void zmq::object_t::process_crypto_done(crypto_job_t *) {
+    zmq_assert (false);
+}
+
+void zmq::object_t::process_flush() {
+    zmq_assert (false);
+}
+
 void zmq::object_t::process_seqnum() {
     zmq_assert (false);
 }
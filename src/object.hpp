@@ -41,6 +41,10 @@ namespace zmq {
 
     class own_t;
 
+    class crypto_thread_t;
+
+    class crypto_job_t;
+
     //  Base class for all objects that participate in inter-thread
     //  communication.
 
@@ -87,6 +91,10 @@ namespace zmq {
         //  Chooses least loaded I/O thread.
         zmq::io_thread_t *choose_io_thread(uint64_t affinity_);
 
+        //  Chooses crypto thread to offload a handshake job to. Returns NULL
+        //  if crypto is to be done on the I/O thread.
+        zmq::crypto_thread_t *choose_crypto_thread();
+
         //  Derived object can use these functions to send commands
         //  to other objects.
         void send_stop();
@@ -103,7 +111,7 @@ namespace zmq {
         void send_activate_read(zmq::pipe_t *destination_);
 
         void send_activate_write(zmq::pipe_t *destination_,
-                                 uint64_t msgs_read_);
+                                 uint64_t msgs_read_, uint64_t bytes_read_);
 
         void send_hiccup(zmq::pipe_t *destination_, void *pipe_);
 
@@ -124,6 +132,14 @@ namespace zmq {
 
         void send_done();
 
+        void send_crypto_req(zmq::crypto_thread_t *destination_,
+                             zmq::crypto_job_t *job_);
+
+        void send_crypto_done(zmq::session_base_t *destination_,
+                              zmq::crypto_job_t *job_);
+
+        void send_flush(zmq::own_t *destination_);
+
         //  These handlers can be overloaded by the derived objects. They are
         //  called when command arrives from another thread.
         virtual void process_stop();
@@ -138,7 +154,8 @@ namespace zmq {
 
         virtual void process_activate_read();
 
-        virtual void process_activate_write(uint64_t msgs_read_);
+        virtual void process_activate_write(uint64_t msgs_read_,
+                                            uint64_t bytes_read_);
 
         virtual void process_hiccup(void *pipe_);
 
@@ -156,6 +173,12 @@ namespace zmq {
 
         virtual void process_reaped();
 
+        virtual void process_crypto_req(zmq::crypto_job_t *job_);
+
+        virtual void process_crypto_done(zmq::crypto_job_t *job_);
+
+        virtual void process_flush();
+
         //  Special handler called after a command that requires a seqnum
         //  was processed. The implementation should catch up with its counter
         //  of processed commands here.
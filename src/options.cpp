@@ -26,6 +26,8 @@
 zmq::options_t::options_t () :
     sndhwm (1000),
     rcvhwm (1000),
+    sndhwm_bytes (0),
+    rcvhwm_bytes (0),
     affinity (0),
     identity_size (0),
     rate (100),
@@ -52,8 +54,19 @@ zmq::options_t::options_t () :
     tcp_keepalive_intvl (-1),
     mechanism (ZMQ_NULL),
     as_server (0),
+    curve_ticket_ttl (0),
     socket_id (0),
-    conflate (false)
+    conflate (false),
+    conflate_key (0),
+    lb_policy (ZMQ_LB_ROUND_ROBIN),
+    lb_weight (1),
+    rcvpriority (0),
+    spill_size (64 * 1024 * 1024),
+    resend_unsent (false),
+    heartbeat_ivl (0),
+    heartbeat_ttl (0),
+    heartbeat_timeout (-1),
+    thread_safe (false)
 {
 }
 
@@ -78,6 +91,20 @@ int zmq::options_t::setsockopt (int option_, const void *optval_,
             }
             break;
 
+        case ZMQ_SNDHWM_BYTES:
+            if (optvallen_ == sizeof (int64_t) && *((int64_t *) optval_) >= 0) {
+                sndhwm_bytes = *((int64_t *) optval_);
+                return 0;
+            }
+            break;
+
+        case ZMQ_RCVHWM_BYTES:
+            if (optvallen_ == sizeof (int64_t) && *((int64_t *) optval_) >= 0) {
+                rcvhwm_bytes = *((int64_t *) optval_);
+                return 0;
+            }
+            break;
+
         case ZMQ_AFFINITY:
             if (optvallen_ == sizeof (uint64_t)) {
                 affinity = *((uint64_t*) optval_);
@@ -345,6 +372,13 @@ int zmq::options_t::setsockopt (int option_, const void *optval_,
                 return 0;
             }
             break;
+
+        case ZMQ_CURVE_TICKET_TTL:
+            if (is_int && value >= 0) {
+                curve_ticket_ttl = value;
+                return 0;
+            }
+            break;
 #       endif
 
         case ZMQ_CONFLATE:
@@ -354,6 +388,91 @@ int zmq::options_t::setsockopt (int option_, const void *optval_,
             }
             break;
 
+        case ZMQ_CONFLATE_KEY:
+            if (is_int && value >= -1) {
+                conflate_key = value;
+                return 0;
+            }
+            break;
+
+        case ZMQ_LB_POLICY:
+            if (is_int && value >= ZMQ_LB_ROUND_ROBIN &&
+                value <= ZMQ_LB_LATENCY) {
+                lb_policy = value;
+                return 0;
+            }
+            break;
+
+        case ZMQ_LB_WEIGHT:
+            if (is_int && value > 0) {
+                lb_weight = value;
+                return 0;
+            }
+            break;
+
+        case ZMQ_RCVPRIORITY:
+            if (is_int && value >= 0) {
+                rcvpriority = value;
+                return 0;
+            }
+            break;
+
+        case ZMQ_SPILL_DIR:
+            if (optvallen_ < 256) {
+                spill_dir.assign ((const char *) optval_, optvallen_);
+                return 0;
+            }
+            break;
+
+        case ZMQ_SPILL_SIZE:
+            if (optvallen_ == sizeof (int64_t) && *((int64_t *) optval_) > 0) {
+                spill_size = *((int64_t *) optval_);
+                return 0;
+            }
+            break;
+
+        case ZMQ_RESEND_UNSENT:
+            if (is_int && (value == 0 || value == 1)) {
+                resend_unsent = (value != 0);
+                return 0;
+            }
+            break;
+
+        case ZMQ_HEARTBEAT_IVL:
+            if (is_int && value >= 0) {
+                heartbeat_ivl = value;
+                return 0;
+            }
+            break;
+
+        case ZMQ_HEARTBEAT_TTL:
+            //  Sent in deciseconds as a 16-bit number.
+            if (is_int && value >= 0 && value / 100 <= 0xffff) {
+                heartbeat_ttl = value;
+                return 0;
+            }
+            break;
+
+        case ZMQ_HEARTBEAT_TIMEOUT:
+            if (is_int && value >= -1) {
+                heartbeat_timeout = value;
+                return 0;
+            }
+            break;
+
+        case ZMQ_THREAD_SAFE:
+            //  Sockets routing by envelope can't do without multi-part
+            //  messages, which can't be shared out among threads.
+            if (is_int && value == 1 &&
+                  (type == ZMQ_ROUTER || type == ZMQ_STREAM ||
+                   type == ZMQ_REQ || type == ZMQ_REP))
+                break;
+            if (is_int && (value == 0 || value == 1)) {
+                thread_safe = (value != 0);
+                return 0;
+            }
+            break;
+
         default:
             break;
     }
@@ -381,6 +500,20 @@ int zmq::options_t::getsockopt (int option_, void *optval_, size_t *optvallen_)
             }
             break;
 
+        case ZMQ_SNDHWM_BYTES:
+            if (*optvallen_ == sizeof (int64_t)) {
+                *((int64_t *) optval_) = sndhwm_bytes;
+                return 0;
+            }
+            break;
+
+        case ZMQ_RCVHWM_BYTES:
+            if (*optvallen_ == sizeof (int64_t)) {
+                *((int64_t *) optval_) = rcvhwm_bytes;
+                return 0;
+            }
+            break;
+
         case ZMQ_AFFINITY:
             if (*optvallen_ == sizeof (uint64_t)) {
                 *((uint64_t *) optval_) = affinity;
@@ -619,6 +752,13 @@ int zmq::options_t::getsockopt (int option_, void *optval_, size_t *optvallen_)
                 return 0;
             }
             break;
+
+        case ZMQ_CURVE_TICKET_TTL:
+            if (is_int) {
+                *value = curve_ticket_ttl;
+                return 0;
+            }
+            break;
 #       endif
 
         case ZMQ_CONFLATE:
@@ -628,6 +768,84 @@ int zmq::options_t::getsockopt (int option_, void *optval_, size_t *optvallen_)
             }
             break;
 
+        case ZMQ_CONFLATE_KEY:
+            if (is_int) {
+                *value = conflate_key;
+                return 0;
+            }
+            break;
+
+        case ZMQ_LB_POLICY:
+            if (is_int) {
+                *value = lb_policy;
+                return 0;
+            }
+            break;
+
+        case ZMQ_LB_WEIGHT:
+            if (is_int) {
+                *value = lb_weight;
+                return 0;
+            }
+            break;
+
+        case ZMQ_RCVPRIORITY:
+            if (is_int) {
+                *value = rcvpriority;
+                return 0;
+            }
+            break;
+
+        case ZMQ_SPILL_DIR:
+            if (*optvallen_ >= spill_dir.size () + 1) {
+                memcpy (optval_, spill_dir.c_str (), spill_dir.size () + 1);
+                *optvallen_ = spill_dir.size () + 1;
+                return 0;
+            }
+            break;
+
+        case ZMQ_SPILL_SIZE:
+            if (*optvallen_ == sizeof (int64_t)) {
+                *((int64_t *) optval_) = spill_size;
+                return 0;
+            }
+            break;
+
+        case ZMQ_RESEND_UNSENT:
+            if (is_int) {
+                *value = resend_unsent;
+                return 0;
+            }
+            break;
+
+        case ZMQ_HEARTBEAT_IVL:
+            if (is_int) {
+                *value = heartbeat_ivl;
+                return 0;
+            }
+            break;
+
+        case ZMQ_HEARTBEAT_TTL:
+            if (is_int) {
+                *value = heartbeat_ttl;
+                return 0;
+            }
+            break;
+
+        case ZMQ_HEARTBEAT_TIMEOUT:
+            if (is_int) {
+                *value = heartbeat_timeout;
+                return 0;
+            }
+            break;
+
+        case ZMQ_THREAD_SAFE:
+            if (is_int) {
+                *value = thread_safe;
+                return 0;
+            }
+            break;
+
     }
     errno = EINVAL;
     return -1;
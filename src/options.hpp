@@ -46,6 +46,10 @@ namespace zmq
         int sndhwm;
         int rcvhwm;
 
+        //  High-water marks for message pipes in bytes, 0 for no limit.
+        int64_t sndhwm_bytes;
+        int64_t rcvhwm_bytes;
+
         //  I/O thread affinity.
         uint64_t affinity;
 
@@ -135,6 +139,10 @@ namespace zmq
         uint8_t curve_secret_key [CURVE_KEYSIZE];
         uint8_t curve_server_key [CURVE_KEYSIZE];
 
+        //  Lifetime of CURVE resumption tickets issued by the server,
+        //  in milliseconds. Zero means no tickets are issued.
+        int curve_ticket_ttl;
+
         //  ID of the socket.
         int socket_id;
 
@@ -143,6 +151,46 @@ namespace zmq
         //  Cannot receive multi-part messages.
         //  Ignores hwm
         bool conflate;
+
+        //  If non-zero, conflation keeps the last message per key instead,
+        //  the key being this many leading bytes of the first frame, or
+        //  the whole first frame if negative. Multi-part messages are
+        //  allowed in this mode.
+        int conflate_key;
+
+        //  Policy used to pick the outbound pipe on load-balancing sockets.
+        int lb_policy;
+
+        //  Load balancing weight given to peers connected or bound
+        //  from now on.
+        int lb_weight;
+
+        //  Fair queueing priority given to peers connected or bound
+        //  from now on. Higher values are read first.
+        int rcvpriority;
+
+        //  Directory for the segment files of connecting sessions to spill
+        //  messages into while disconnected, and the size of a segment.
+        //  Empty directory means messages are only queued in the pipe.
+        std::string spill_dir;
+        int64_t spill_size;
+
+        //  If true, the messages an engine has not completely written
+        //  when the connection fails go back to the session and are sent
+        //  again once it reconnects.
+        bool resend_unsent;
+
+        //  Interval between the PINGs sent to ZMTP/3.0 peers, 0 for none,
+        //  the time to live the PINGs ask the peer to apply and how long
+        //  to wait for traffic after a PING, -1 meaning the interval. In
+        //  milliseconds.
+        int heartbeat_ivl;
+        int heartbeat_ttl;
+        int heartbeat_timeout;
+
+        //  If true, several application threads may send to and receive
+        //  from the socket at the same time.
+        bool thread_safe;
     };
 }
 
@@ -19,47 +19,43 @@
 
 #include <new>
 #include <stddef.h>
+#include <limits.h>
 
 #include "pipe.hpp"
 #include "err.hpp"
 
 #include "ypipe.hpp"
 #include "ypipe_conflate.hpp"
+#include "ypipe_keyed.hpp"
+#include "tracer.hpp"
 
 //
 // 创建两个 pipe objects, 通过 ypipes 双向连接
 // 什么场景下使用呢?
 //
 int zmq::pipepair(class object_t *parents_[2], class pipe_t *pipes_[2],
-                  int hwms_[2], bool conflate_[2]) {
+                  int hwms_[2], bool conflate_[2], int64_t byte_hwms_[2],
+                  int conflate_keys_[2]) {
     //   Creates two pipe objects. These objects are connected by two ypipes,
     //   each to pass messages in one direction.
 
-    typedef ypipe_t <msg_t, message_pipe_granularity> upipe_normal_t;
-    typedef ypipe_conflate_t <msg_t, message_pipe_granularity> upipe_conflate_t;
-
-    pipe_t::upipe_t *upipe1;
-    if (conflate_[0])
-        upipe1 = new(std::nothrow) upipe_conflate_t();
-    else
-        upipe1 = new(std::nothrow) upipe_normal_t();
-    alloc_assert (upipe1);
-
-    pipe_t::upipe_t *upipe2;
-    if (conflate_[1])
-        upipe2 = new(std::nothrow) upipe_conflate_t();
-    else
-        upipe2 = new(std::nothrow) upipe_normal_t();
-    alloc_assert (upipe2);
+    pipe_t::upipe_t *upipe1 = pipe_t::create_upipe(conflate_[0],
+                                                   conflate_keys_[0]);
+    pipe_t::upipe_t *upipe2 = pipe_t::create_upipe(conflate_[1],
+                                                   conflate_keys_[1]);
 
     // pipe_t
     // ypipe_t
     // 创建两个pipe, 分别设置不一样的ypipe
     pipes_[0] = new(std::nothrow) pipe_t(parents_[0], upipe1, upipe2,
-                                         hwms_[1], hwms_[0], conflate_[0]);
+                                         hwms_[1], hwms_[0], conflate_[0],
+                                         byte_hwms_[1], byte_hwms_[0],
+                                         conflate_keys_[0]);
     alloc_assert (pipes_[0]);
     pipes_[1] = new(std::nothrow) pipe_t(parents_[1], upipe2, upipe1,
-                                         hwms_[0], hwms_[1], conflate_[1]);
+                                         hwms_[0], hwms_[1], conflate_[1],
+                                         byte_hwms_[0], byte_hwms_[1],
+                                         conflate_keys_[1]);
     alloc_assert (pipes_[1]);
 
     // upipe1, upipe2是两个双线管道
@@ -73,7 +69,9 @@ int zmq::pipepair(class object_t *parents_[2], class pipe_t *pipes_[2],
 }
 
 zmq::pipe_t::pipe_t(object_t *parent_, upipe_t *inpipe_, upipe_t *outpipe_,
-                    int inhwm_, int outhwm_, bool conflate_) :
+                    int inhwm_, int outhwm_, bool conflate_,
+                    int64_t in_byte_hwm_, int64_t out_byte_hwm_,
+                    int conflate_key_) :
         object_t(parent_),
         inpipe(inpipe_),
         outpipe(outpipe_),
@@ -81,19 +79,52 @@ zmq::pipe_t::pipe_t(object_t *parent_, upipe_t *inpipe_, upipe_t *outpipe_,
         out_active(true),
         hwm(outhwm_),
         lwm(compute_lwm(inhwm_)),
+        cur_lwm(lwm),
+        max_lwm(compute_max_lwm(inhwm_)),
+        write_blocked(0),
         msgs_read(0),
         msgs_written(0),
         peers_msgs_read(0),
+        msgs_read_reported(0),
+        byte_hwm(out_byte_hwm_),
+        byte_lwm(compute_byte_lwm(in_byte_hwm_)),
+        bytes_read(0),
+        bytes_written(0),
+        in_msg_bytes(0),
+        out_msg_bytes(0),
+        peers_bytes_read(0),
+        bytes_read_reported(0),
         peer(NULL),
         sink(NULL),
+        tracer(NULL),
         state(active),
         delay(true),
-        conflate(conflate_) {
+        weight(1),
+        priority(0),
+        conflate(conflate_),
+        conflate_key(conflate_key_) {
 }
 
 zmq::pipe_t::~pipe_t() {
 }
 
+zmq::pipe_t::upipe_t *zmq::pipe_t::create_upipe(bool conflate_,
+                                                int conflate_key_) {
+    upipe_t *upipe;
+    if (conflate_ && conflate_key_ != 0)
+        upipe = new(std::nothrow) ypipe_keyed_t<msg_t,
+                message_pipe_granularity>(conflate_key_);
+    else if (conflate_)
+        // message_pipe_granularity 在这里似乎没有作用
+        upipe = new(std::nothrow) ypipe_conflate_t<msg_t,
+                message_pipe_granularity>();
+    else
+        // 高效的队列
+        upipe = new(std::nothrow) ypipe_t<msg_t, message_pipe_granularity>();
+    alloc_assert (upipe);
+    return upipe;
+}
+
 void zmq::pipe_t::set_peer(pipe_t *peer_) {
     //  Peer can be set once only.
     zmq_assert (!peer);
@@ -106,6 +137,10 @@ void zmq::pipe_t::set_event_sink(i_pipe_events *sink_) {
     sink = sink_;
 }
 
+void zmq::pipe_t::set_tracer(tracer_t *tracer_) {
+    tracer = tracer_;
+}
+
 void zmq::pipe_t::set_identity(const blob_t &identity_) {
     identity = identity_;
 }
@@ -114,6 +149,22 @@ zmq::blob_t zmq::pipe_t::get_identity() {
     return identity;
 }
 
+void zmq::pipe_t::set_weight(int weight_) {
+    weight = weight_;
+}
+
+int zmq::pipe_t::get_weight() {
+    return weight;
+}
+
+void zmq::pipe_t::set_priority(int priority_) {
+    priority = priority_;
+}
+
+int zmq::pipe_t::get_priority() {
+    return priority;
+}
+
 // pipe在 state 为 active  或 waiting_for_delimiter 时数据可读
 //
 bool zmq::pipe_t::check_read() {
@@ -165,15 +216,88 @@ bool zmq::pipe_t::read(msg_t *msg_) {
         return false;
     }
 
-    if (!(msg_->flags() & msg_t::more) && !msg_->is_identity())
+    //  Traces of inbound messages end here, whether or not the socket
+    //  hands the message to the user. Messages traced by an inproc
+    //  sender just lose their flag.
+    if (unlikely (msg_->flags() & (msg_t::trace_in | msg_t::trace_out)) &&
+          tracer) {
+        if (msg_->flags() & msg_t::trace_in)
+            tracer->recv_done(tracer_t::now());
+        msg_->reset_flags(msg_t::trace_in | msg_t::trace_out);
+    }
+
+    in_msg_bytes += msg_->size();
+    if (!(msg_->flags() & msg_t::more) && !msg_->is_identity()) {
         msgs_read++;
+        bytes_read += in_msg_bytes;
+        in_msg_bytes = 0;
+    }
 
-    if (lwm > 0 && msgs_read % lwm == 0)
-        send_activate_write(peer, msgs_read);
+    //  Let the writer know it can go on once LWM messages, or LWM bytes,
+    //  were read since the last report. The writer's flag is only looked
+    //  at past LWM so that the reader doesn't touch it on every message.
+    bool report = false;
+    const uint64_t unreported = msgs_read - msgs_read_reported;
+    if (lwm > 0 && unreported >= uint64_t(lwm)) {
+        if (peer->out_blocked.get()) {
+            peer->out_blocked.set(0);
+            cur_lwm = lwm;
+            report = true;
+        }
+        else if (unreported >= uint64_t(cur_lwm)) {
+            cur_lwm += (max_lwm - cur_lwm + 1) / 2;
+            report = true;
+        }
+    }
+    if (byte_lwm > 0 && bytes_read - bytes_read_reported >= uint64_t(byte_lwm))
+        report = true;
+
+    //  A writer balancing by credit picks peers by how much they've read,
+    //  so it is told every few messages instead, whether it waits or not.
+    const int credit_lwm = lwm > 0 && lwm < lb_credit_report ?
+        lwm : lb_credit_report;
+    if (!report && unreported >= uint64_t(credit_lwm) &&
+          peer->prompt_reads.get())
+        report = true;
+
+    if (report) {
+        send_activate_write(peer, msgs_read, bytes_read);
+        msgs_read_reported = msgs_read;
+        bytes_read_reported = bytes_read;
+    }
 
     return true;
 }
 
+void zmq::pipe_t::set_prompt_reads() {
+    prompt_reads.set(1);
+}
+
+int64_t zmq::pipe_t::get_credit() {
+    int64_t in_flight = (int64_t) (msgs_written - peers_msgs_read);
+    return (hwm > 0 ? hwm : INT_MAX) - in_flight;
+}
+
+uint64_t zmq::pipe_t::get_outbound_depth() {
+    return msgs_written - peers_msgs_read;
+}
+
+uint64_t zmq::pipe_t::get_msgs_written() {
+    return msgs_written;
+}
+
+uint64_t zmq::pipe_t::get_msgs_read() {
+    return msgs_read;
+}
+
+uint64_t zmq::pipe_t::get_write_blocked() {
+    return write_blocked;
+}
+
+uint64_t zmq::pipe_t::get_dropped() {
+    return inpipe ? inpipe->dropped() : 0;
+}
+
 //
 // 如何检查是否可写数据呢?
 //
@@ -183,17 +307,29 @@ bool zmq::pipe_t::check_write() {
         return false;
 
     //  达到了 hwm, 
-    bool full = hwm > 0 && msgs_written - peers_msgs_read == uint64_t(hwm);
+    bool full = !check_hwm();
 
     // 如果full, 则不让写了?
+    //  Tell the reader we are waiting so that it reports back early.
     if (unlikely (full)) {
         out_active = false;
+        out_blocked.set(1);
+        write_blocked++;
         return false;
     }
 
     return true;
 }
 
+bool zmq::pipe_t::check_hwm() {
+    //  Messages vary in size so the byte limit can be overshot by the last
+    //  message admitted; the pipe is full once the limit is reached.
+    bool full = (hwm > 0 && msgs_written - peers_msgs_read == uint64_t(hwm)) ||
+                (byte_hwm > 0 &&
+                 bytes_written - peers_bytes_read >= uint64_t(byte_hwm));
+    return !full;
+}
+
 //
 // 往  outpipe中写出去一个 msg_
 //
@@ -204,12 +340,16 @@ bool zmq::pipe_t::write(msg_t *msg_) {
     bool more = msg_->flags() & msg_t::more ? true : false;
     
     const bool is_identity = msg_->is_identity();
+    out_msg_bytes += msg_->size();
     outpipe->write(*msg_, more);
 
     // 消息的类型
     // 只有: msgs写完毕，并且不是 identity, 则将 msgs_written的计数器增加1
-    if (!more && !is_identity)
+    if (!more && !is_identity) {
         msgs_written++;
+        bytes_written += out_msg_bytes;
+        out_msg_bytes = 0;
+    }
 
     return true;
 }
@@ -228,6 +368,7 @@ void zmq::pipe_t::rollback() {
             errno_assert (rc == 0);
         }
     }
+    out_msg_bytes = 0;
 }
 
 void zmq::pipe_t::flush() {
@@ -246,9 +387,11 @@ void zmq::pipe_t::process_activate_read() {
     }
 }
 
-void zmq::pipe_t::process_activate_write(uint64_t msgs_read_) {
+void zmq::pipe_t::process_activate_write(uint64_t msgs_read_,
+                                         uint64_t bytes_read_) {
     //  Remember the peers's message sequence number.
     peers_msgs_read = msgs_read_;
+    peers_bytes_read = bytes_read_;
 
     if (!out_active && state == active) {
         out_active = true;
@@ -262,9 +405,14 @@ void zmq::pipe_t::process_hiccup(void *pipe_) {
     zmq_assert (outpipe);
     outpipe->flush();
     msg_t msg;
+    uint64_t msg_bytes = 0;
     while (outpipe->read(&msg)) {
-        if (!(msg.flags() & msg_t::more))
+        msg_bytes += msg.size();
+        if (!(msg.flags() & msg_t::more)) {
             msgs_written--;
+            bytes_written -= msg_bytes;
+            msg_bytes = 0;
+        }
         int rc = msg.close();
         errno_assert (rc == 0);
     }
@@ -459,6 +607,22 @@ int zmq::pipe_t::compute_lwm(int hwm_) {
     return result;
 }
 
+int zmq::pipe_t::compute_max_lwm(int hwm_) {
+    //  The reader must report before HWM messages are read, otherwise
+    //  a blocked writer whose flag got lost would never resume. Stop half
+    //  way between LWM and HWM so that a writer that is not blocked yet
+    //  has room to keep going till the report arrives.
+    int lwm = compute_lwm(hwm_);
+    return lwm + (hwm_ - lwm) / 2;
+}
+
+int64_t zmq::pipe_t::compute_byte_lwm(int64_t hwm_) {
+    //  Sizes are not bounded, so there's no max_wm_delta to go by. Report
+    //  progress every half of the HWM; this keeps the writer busy while
+    //  the reader drains the other half.
+    return hwm_ > 0 ? (hwm_ + 1) / 2 : 0;
+}
+
 //
 // 接受到"定界符", 解析来就是状态切换
 //
@@ -486,14 +650,7 @@ void zmq::pipe_t::hiccup() {
     inpipe = NULL;
 
     //  Create new inpipe.
-    if (conflate)
-        // message_pipe_granularity 在这里似乎没有作用
-        inpipe = new(std::nothrow)ypipe_conflate_t<msg_t, message_pipe_granularity>();
-    else
-        // 高效的队列
-        inpipe = new(std::nothrow)ypipe_t<msg_t, message_pipe_granularity>();
-
-    alloc_assert (inpipe);
+    inpipe = create_upipe(conflate, conflate_key);
     in_active = true;
 
     //  Notify the peer about the hiccup.
@@ -502,5 +659,12 @@ void zmq::pipe_t::hiccup() {
 
 void zmq::pipe_t::set_hwms(int inhwm_, int outhwm_) {
     lwm = compute_lwm(inhwm_);
+    cur_lwm = lwm;
+    max_lwm = compute_max_lwm(inhwm_);
     hwm = outhwm_;
 }
+
+void zmq::pipe_t::set_byte_hwms(int64_t inhwm_, int64_t outhwm_) {
+    byte_lwm = compute_byte_lwm(inhwm_);
+    byte_hwm = outhwm_;
+}
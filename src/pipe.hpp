@@ -27,6 +27,7 @@
 #include "stdint.hpp"
 #include "array.hpp"
 #include "blob.hpp"
+#include "atomic_counter.hpp"
 
 namespace zmq {
 
@@ -34,6 +35,8 @@ namespace zmq {
 
     class pipe_t;
 
+    class tracer_t;
+
     //  Create a pipepair for bi-directional transfer of messages.
     //  First HWM is for messages passed from first pipe to the second pipe.
     //  Second HWM is for messages passed from second pipe to the first pipe.
@@ -41,9 +44,14 @@ namespace zmq {
     //  pipe receives all the pending messages before terminating, otherwise it
     //  terminates straight away.
     //  If conflate is true, only the most recently arrived message could be
-    //  read (older messages are discarded)
+    //  read (older messages are discarded). If the conflate key is non-zero
+    //  as well, the most recent message per key is kept instead (see
+    //  ypipe_keyed.hpp).
+    //  Byte HWMs bound the total size of the messages in each direction
+    //  the same way; zero means no limit.
     int pipepair(zmq::object_t *parents_[2], zmq::pipe_t *pipes_[2],
-                 int hwms_[2], bool conflate_[2]);
+                 int hwms_[2], bool conflate_[2],
+                 int64_t byte_hwms_[2], int conflate_keys_[2]);
 
     struct i_pipe_events {
         virtual ~i_pipe_events() { }
@@ -68,18 +76,35 @@ namespace zmq {
             public array_item_t<3> {
         //  This allows pipepair to create pipe objects.
         friend int pipepair(zmq::object_t *parents_[2], zmq::pipe_t *pipes_[2],
-                            int hwms_[2], bool conflate_[2]);
+                            int hwms_[2], bool conflate_[2],
+                            int64_t byte_hwms_[2], int conflate_keys_[2]);
 
     public:
 
         //  Specifies the object to send events to.
         void set_event_sink(i_pipe_events *sink_);
 
+        //  Set on the socket's end of the pipe; traces of inbound messages
+        //  end when they are read from it.
+        void set_tracer(tracer_t *tracer_);
+
         //  Pipe endpoint can store an opaque ID to be used by its clients.
         void set_identity(const blob_t &identity_);
 
         blob_t get_identity();
 
+        //  Relative capacity of the peer, used by the weighted load
+        //  balancing policies. Set from ZMQ_LB_WEIGHT at connect/bind time.
+        void set_weight(int weight_);
+
+        int get_weight();
+
+        //  Fair queueing priority of the peer. Set from ZMQ_RCVPRIORITY
+        //  at connect/bind time.
+        void set_priority(int priority_);
+
+        int get_priority();
+
         //  Returns true if there is at least one message to read in the pipe.
         bool check_read();
 
@@ -90,6 +115,35 @@ namespace zmq {
         //  the message would cause high watermark the function returns false.
         bool check_write();
 
+        //  Returns false if the pipe is at its high water mark, counting
+        //  either messages or bytes.
+        bool check_hwm();
+
+        //  Asks the reader to report its progress every few messages, even
+        //  while the writer isn't blocked, so that get_credit stays close
+        //  to the actual room left in the pipe.
+        void set_prompt_reads();
+
+        //  Returns the number of messages that can still be written before
+        //  the high water mark is reached, as far as the writer knows.
+        //  Without a high water mark the credit only decreases with the
+        //  number of messages in flight.
+        int64_t get_credit();
+
+        //  Statistics, to be called by the owner of the pipe. The depth is
+        //  the number of messages written but not yet read by the peer as
+        //  far as the writer knows; the drop count covers messages the
+        //  inbound pipe discarded because of conflation.
+        uint64_t get_outbound_depth();
+
+        uint64_t get_msgs_written();
+
+        uint64_t get_msgs_read();
+
+        uint64_t get_write_blocked();
+
+        uint64_t get_dropped();
+
         //  Writes a message to the underlying pipe. Returns false if the
         //  message cannot be written because high watermark was reached.
         bool write(msg_t *msg_);
@@ -117,6 +171,9 @@ namespace zmq {
         // set the high water marks.
         void set_hwms(int inhwm_, int outhwm_);
 
+        //  Set the high water marks in bytes.
+        void set_byte_hwms(int64_t inhwm_, int64_t outhwm_);
+
     private:
 
         // pipe的block的大小定义为: 256
@@ -128,7 +185,7 @@ namespace zmq {
         //  Command handlers.
         void process_activate_read();
 
-        void process_activate_write(uint64_t msgs_read_);
+        void process_activate_write(uint64_t msgs_read_, uint64_t bytes_read_);
 
         void process_hiccup(void *pipe_);
 
@@ -142,7 +199,9 @@ namespace zmq {
         //  Constructor is private. Pipe can only be created using
         //  pipepair function.
         pipe_t(object_t *parent_, upipe_t *inpipe_, upipe_t *outpipe_,
-               int inhwm_, int outhwm_, bool conflate_);
+               int inhwm_, int outhwm_, bool conflate_,
+               int64_t in_byte_hwm_, int64_t out_byte_hwm_,
+               int conflate_key_);
 
         //  Pipepair uses this function to let us know about
         //  the peer pipe object.
@@ -165,9 +224,29 @@ namespace zmq {
         //  High watermark for the outbound pipe.
         int hwm;
 
-        //  Low watermark for the inbound pipe.
+        //  Low watermark for the inbound pipe. The reader reports its
+        //  progress to the writer after reading this many messages while
+        //  the writer is blocked.
         int lwm;
 
+        //  While the writer keeps going, progress is reported less often:
+        //  the threshold grows from lwm up to max_lwm with every report
+        //  the writer did not wait for, and drops back to lwm as soon as
+        //  it does.
+        int cur_lwm;
+        int max_lwm;
+
+        //  Set by the writer when the outbound pipe hits the HWM, cleared
+        //  by the reader (i.e. the peer) once it reports its progress.
+        atomic_counter_t out_blocked;
+
+        //  Set by the writer when it balances by credit, read by the reader
+        //  (i.e. the peer) to decide how often to report its progress.
+        atomic_counter_t prompt_reads;
+
+        //  Number of times the writer found the pipe full.
+        uint64_t write_blocked;
+
         //  Number of messages read and written so far.
         uint64_t msgs_read;
         uint64_t msgs_written;
@@ -176,12 +255,39 @@ namespace zmq {
         //  can be higher at the moment.
         uint64_t peers_msgs_read;
 
+        //  Our msgs_read as last reported to the peer.
+        uint64_t msgs_read_reported;
+
+        //  High watermark for the outbound pipe and low watermark for the
+        //  inbound pipe in bytes. Zero means sizes are not limited.
+        int64_t byte_hwm;
+        int64_t byte_lwm;
+
+        //  Total size of the messages read and written so far. Like the
+        //  message counters, these are only updated once a message is
+        //  complete, so a multi-part message is never cut by the HWM.
+        uint64_t bytes_read;
+        uint64_t bytes_written;
+
+        //  Size of the parts of the current message read / written so far.
+        uint64_t in_msg_bytes;
+        uint64_t out_msg_bytes;
+
+        //  Last received peer's bytes_read.
+        uint64_t peers_bytes_read;
+
+        //  Our bytes_read as last reported to the peer.
+        uint64_t bytes_read_reported;
+
         //  The pipe object on the other side of the pipepair.
         pipe_t *peer;
 
         //  Sink to send events to.
         i_pipe_events *sink;
 
+        //  Latency tracer of the socket reading from this end, if any.
+        tracer_t *tracer;
+
         //  States of the pipe endpoint:
         //  active: common state before any termination begins,
         //  delimiter_received: delimiter was read from pipe before
@@ -210,14 +316,32 @@ namespace zmq {
         //  Identity of the writer. Used uniquely by the reader side.
         blob_t identity;
 
+        //  Load balancing weight of the peer.
+        int weight;
+
+        //  Fair queueing priority of the peer.
+        int priority;
+
         //  Returns true if the message is delimiter; false otherwise.
         static bool is_delimiter(msg_t &msg_);
 
         //  Computes appropriate low watermark from the given high watermark.
         static int compute_lwm(int hwm_);
 
+        //  Computes the low watermark to use while the writer isn't blocked.
+        static int compute_max_lwm(int hwm_);
+
+        //  Same for the high watermark in bytes.
+        static int64_t compute_byte_lwm(int64_t hwm_);
+
+        //  Creates the ypipe flavour matching the conflation settings.
+        static upipe_t *create_upipe(bool conflate_, int conflate_key_);
+
         bool conflate;
 
+        //  Key size for keyed conflation, zero if disabled.
+        int conflate_key;
+
         //  Disable copying.
         pipe_t(const pipe_t &);
 
@@ -44,10 +44,11 @@ void zmq::poller_base_t::adjust_load(int amount_) {
         load.sub(-amount_);
 }
 
-void zmq::poller_base_t::add_timer(int timeout_, i_poll_events *sink_, int id_) {
+zmq::poller_base_t::timer_handle_t zmq::poller_base_t::add_timer(
+    int timeout_, i_poll_events *sink_, int id_) {
     uint64_t expiration = clock.now_ms() + timeout_;
     timer_info_t info = {sink_, id_};
-    timers.insert(timers_t::value_type(expiration, info));
+    return timers.insert(timers_t::value_type(expiration, info));
 }
 
 //
@@ -65,6 +66,10 @@ void zmq::poller_base_t::cancel_timer(i_poll_events *sink_, int id_) {
     zmq_assert (false);
 }
 
+void zmq::poller_base_t::cancel_timer(timer_handle_t handle_) {
+    timers.erase(handle_);
+}
+
 uint64_t zmq::poller_base_t::execute_timers() {
     //  Fast track.
     if (timers.empty())
@@ -34,8 +34,20 @@ namespace zmq {
     // 2. execute_timers 会实现timer相关的事情
     //    学习过程中可以关注: kqueue
     class poller_base_t {
+
+        //  List of active timers.
+        struct timer_info_t {
+            zmq::i_poll_events *sink;
+            int id;
+        };
+        typedef std::multimap<uint64_t, timer_info_t> timers_t;
+
     public:
 
+        //  Refers to a timer that is still pending. It becomes invalid
+        //  once the timer has fired or has been cancelled.
+        typedef timers_t::iterator timer_handle_t;
+
         poller_base_t();
 
         virtual ~poller_base_t();
@@ -47,11 +59,16 @@ namespace zmq {
         //  Add a timeout to expire in timeout_ milliseconds. After the
         //  expiration timer_event on sink_ object will be called with
         //  argument set to id_.
-        void add_timer(int timeout_, zmq::i_poll_events *sink_, int id_);
+        timer_handle_t add_timer(int timeout_, zmq::i_poll_events *sink_,
+                                 int id_);
 
         //  Cancel the timer created by sink_ object with ID equal to id_.
         void cancel_timer(zmq::i_poll_events *sink_, int id_);
 
+        //  Cancel the timer add_timer returned handle_ for, in constant
+        //  time. A timer can't be cancelled from its own timer_event.
+        void cancel_timer(timer_handle_t handle_);
+
     protected:
 
         //  Called by individual poller implementations to manage the load.
@@ -66,12 +83,7 @@ namespace zmq {
         //  Clock instance private to this I/O thread.
         clock_t clock;
 
-        //  List of active timers.
-        struct timer_info_t {
-            zmq::i_poll_events *sink;
-            int id;
-        };
-        typedef std::multimap<uint64_t, timer_info_t> timers_t;
+        //  Active timers, soonest first.
         timers_t timers;
 
         //  Load of the poller. Currently the number of file descriptors
@@ -17,10 +17,14 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+
 #include <stddef.h>
+#include <string.h>
 #include "platform.hpp"
 #include "proxy.hpp"
 #include "likely.hpp"
+#include "config.hpp"
+#include "err.hpp"
 
 #define ZMQ_POLL_BASED_ON_POLL
 
@@ -31,25 +35,189 @@
 
 // zmq.h must be included *after* poll.h for AIX to build properly
 
+namespace zmq {
+
+    //  Traffic seen on one side of the proxy, in message parts.
+    struct proxy_stats_t {
+        uint64_t msg_in;
+        uint64_t bytes_in;
+        uint64_t msg_out;
+        uint64_t bytes_out;
+    };
+
+    //  One direction of the proxy. The first part of a message that the
+    //  destination could not take is held here till it can.
+    struct proxy_stream_t {
+        msg_t held;
+        bool holding;
+        bool held_more;
+    };
+
+}
+
+//  Sends a copy of the message part to the capture socket. msg_t::copy
+//  only bumps the reference count of large messages, so the payload is
+//  not copied.
+static int capture(zmq::socket_base_t *capture_, zmq::msg_t &msg_,
+                   bool more_) {
+    if (!capture_)
+        return 0;
+
+    zmq::msg_t ctrl;
+    int rc = ctrl.init();
+    if (unlikely (rc < 0))
+        return -1;
+    rc = ctrl.copy(msg_);
+    if (unlikely (rc < 0))
+        return -1;
+    rc = capture_->send(&ctrl, more_ ? ZMQ_SNDMORE : 0);
+    if (unlikely (rc < 0)) {
+        ctrl.close();
+        return -1;
+    }
+    return 0;
+}
+
+static int recv_part(zmq::socket_base_t *from_, zmq::msg_t &msg_, int flags_,
+                     bool &more_, zmq::socket_base_t *capture_,
+                     zmq::proxy_stats_t &stats_) {
+    int rc = from_->recv(&msg_, flags_);
+    if (rc < 0)
+        return -1;
+
+    int more;
+    size_t moresz = sizeof more;
+    rc = from_->getsockopt(ZMQ_RCVMORE, &more, &moresz);
+    if (unlikely (rc < 0))
+        return -1;
+    more_ = more != 0;
+
+    stats_.msg_in++;
+    stats_.bytes_in += msg_.size();
+    return capture(capture_, msg_, more_);
+}
+
+//  Moves up to proxy_burst_size messages from from_ to to_ without
+//  blocking. Returns the number of messages moved, -1 on error.
+static int forward(zmq::socket_base_t *from_, zmq::socket_base_t *to_,
+                   zmq::socket_base_t *capture_, zmq::proxy_stream_t &stream_,
+                   zmq::msg_t &msg_, zmq::proxy_stats_t &from_stats_,
+                   zmq::proxy_stats_t &to_stats_) {
+    int count = 0;
+    while (count < zmq::proxy_burst_size) {
+        if (!stream_.holding) {
+            int rc = recv_part(from_, stream_.held, ZMQ_DONTWAIT,
+                               stream_.held_more, capture_, from_stats_);
+            if (rc < 0) {
+                if (errno == EAGAIN)
+                    break;
+                return -1;
+            }
+            stream_.holding = true;
+        }
+
+        //  Only the first part can be refused; once it is accepted, the
+        //  rest of the message is guaranteed to get through.
+        size_t size = stream_.held.size();
+        int rc = to_->send(&stream_.held,
+                           (stream_.held_more ? ZMQ_SNDMORE : 0) | ZMQ_DONTWAIT);
+        if (rc < 0) {
+            if (errno == EAGAIN)
+                break;
+            return -1;
+        }
+        stream_.holding = false;
+        to_stats_.msg_out++;
+        to_stats_.bytes_out += size;
+
+        bool more = stream_.held_more;
+        while (more) {
+            rc = recv_part(from_, msg_, 0, more, capture_, from_stats_);
+            if (unlikely (rc < 0))
+                return -1;
+            size = msg_.size();
+            rc = to_->send(&msg_, more ? ZMQ_SNDMORE : 0);
+            if (unlikely (rc < 0))
+                return -1;
+            to_stats_.msg_out++;
+            to_stats_.bytes_out += size;
+        }
+        count++;
+    }
+    return count;
+}
+
+//  Tells whether the socket has an input side. PUSH and PUB sockets fail
+//  any recv, so the proxy never reads from them.
+static int can_recv(zmq::socket_base_t *socket_, bool &can_recv_) {
+    int type;
+    size_t typesz = sizeof type;
+    int rc = socket_->getsockopt(ZMQ_TYPE, &type, &typesz);
+    if (unlikely (rc < 0))
+        return -1;
+    can_recv_ = type != ZMQ_PUSH && type != ZMQ_PUB;
+    return 0;
+}
+
+static int reply_stats(zmq::socket_base_t *control_,
+                       const zmq::proxy_stats_t &frontend_,
+                       const zmq::proxy_stats_t &backend_) {
+    const uint64_t values[] = {
+            frontend_.msg_in, frontend_.bytes_in,
+            frontend_.msg_out, frontend_.bytes_out,
+            backend_.msg_in, backend_.bytes_in,
+            backend_.msg_out, backend_.bytes_out
+    };
+    const int count = sizeof values / sizeof values[0];
+    for (int i = 0; i != count; i++) {
+        zmq::msg_t msg;
+        int rc = msg.init_size(sizeof(uint64_t));
+        if (unlikely (rc < 0))
+            return -1;
+        memcpy(msg.data(), &values[i], sizeof(uint64_t));
+        rc = control_->send(&msg, i < count - 1 ? ZMQ_SNDMORE : 0);
+        if (unlikely (rc < 0)) {
+            msg.close();
+            return -1;
+        }
+    }
+    return 0;
+}
 
 int zmq::proxy(class socket_base_t *frontend_, class socket_base_t *backend_, class socket_base_t *capture_, class socket_base_t *control_) {
+    //  Directions whose source cannot receive are skipped altogether.
+    bool frontend_in;
+    bool backend_in;
+    if (can_recv(frontend_, frontend_in) < 0 ||
+        can_recv(backend_, backend_in) < 0)
+        return -1;
+
     msg_t msg;
     int rc = msg.init();
     if (rc != 0)
         return -1;
 
-    //  The algorithm below assumes ratio of requests and replies processed
-    //  under full load to be 1:1.
+    proxy_stream_t request;
+    rc = request.held.init();
+    errno_assert (rc == 0);
+    request.holding = false;
+    request.held_more = false;
+
+    proxy_stream_t reply;
+    rc = reply.held.init();
+    errno_assert (rc == 0);
+    reply.holding = false;
+    reply.held_more = false;
+
+    proxy_stats_t frontend_stats = {0, 0, 0, 0};
+    proxy_stats_t backend_stats = {0, 0, 0, 0};
 
-    int more;
-    size_t moresz;
-    
-    // 通过监控三路数据?
     zmq_pollitem_t items[] = {
-            {frontend_, 0, ZMQ_POLLIN, 0},
-            {backend_,  0, ZMQ_POLLIN, 0},
+            {frontend_, 0, 0, 0},
+            {backend_,  0, 0, 0},
+            {control_,  0, ZMQ_POLLIN, 0}
     };
-    int qt_poll_items = 2; // (control_ ? 3 : 2);
+    int qt_poll_items = (control_ ? 3 : 2);
 
     //  Proxy can be in these three states
     enum {
@@ -58,76 +226,94 @@ int zmq::proxy(class socket_base_t *frontend_, class socket_base_t *backend_, cl
         terminated
     } state = active;
 
-    while (state != terminated) {
-        //  Wait while there are either requests or replies to process.
-        // poll所有的输入，怎么没有timeout呢?
-        // &items[0] <---> items ??
-        rc = zmq_poll(&items[0], qt_poll_items, -1);
-        
-        // 似乎是出现了interrupt
-        if (unlikely (rc < 0))
-            return -1;
-
+    //  While messages are flowing the sockets are read without polling;
+    //  zmq_poll is only called once a round trip moved nothing.
+    bool busy = false;
 
+    while (state != terminated) {
+        if (!busy) {
+            //  Wait for input, or for the destination of a held message
+            //  to become writable.
+            items[0].events = items[1].events = 0;
+            if (state == active) {
+                if (frontend_in && !request.holding)
+                    items[0].events |= ZMQ_POLLIN;
+                if (reply.holding)
+                    items[0].events |= ZMQ_POLLOUT;
+                if (backend_in && !reply.holding)
+                    items[1].events |= ZMQ_POLLIN;
+                if (request.holding)
+                    items[1].events |= ZMQ_POLLOUT;
+            }
+            rc = zmq_poll(&items[0], qt_poll_items, -1);
+            if (unlikely (rc < 0))
+                break;
+        }
+        busy = false;
 
-        // 通过front有输入，并且backend有输出，则
-        //  Process a request
-        if (state == active && items[0].revents & ZMQ_POLLIN && items[1].revents & ZMQ_POLLOUT) {
-            // 一口气读取一个完整的Message, 从 frontend ---> backend
-            while (true) {
-                // 1. 读取一个msg part
-                rc = frontend_->recv(&msg, 0);
-                if (unlikely (rc < 0))
-                    return -1;
+        //  Process control commands
+        while (control_ && state != terminated) {
+            rc = control_->recv(&msg, ZMQ_DONTWAIT);
+            if (rc < 0) {
+                if (errno == EAGAIN)
+                    rc = 0;
+                break;
+            }
+            int more;
+            size_t moresz = sizeof more;
+            rc = control_->getsockopt(ZMQ_RCVMORE, &more, &moresz);
+            if (unlikely (rc < 0) || more)
+                break;
 
-                // 2. 读取msg的状态，是否有 more
-                moresz = sizeof more;
-                rc = frontend_->getsockopt(ZMQ_RCVMORE, &more, &moresz);
-                if (unlikely (rc < 0))
-                    return -1;
-                
-                // 将数据拷贝到backend中
-                rc = backend_->send(&msg, more ? ZMQ_SNDMORE : 0);
+            size_t size = msg.size();
+            const char *command = (const char *) msg.data();
+            if (size == 5 && memcmp(command, "PAUSE", 5) == 0)
+                state = paused;
+            else if (size == 6 && memcmp(command, "RESUME", 6) == 0)
+                state = active;
+            else if (size == 9 && memcmp(command, "TERMINATE", 9) == 0)
+                state = terminated;
+            else if (size == 10 && memcmp(command, "STATISTICS", 10) == 0) {
+                rc = reply_stats(control_, frontend_stats, backend_stats);
                 if (unlikely (rc < 0))
-                    return -1;
-                if (more == 0)
                     break;
             }
+            //  Unknown commands are ignored.
         }
-        //  Process a reply
-        if (state == active  && items[1].revents & ZMQ_POLLIN  && items[0].revents & ZMQ_POLLOUT) {
-            // 从: backend ---> frontend
-            while (true) {
-                rc = backend_->recv(&msg, 0);
-                if (unlikely (rc < 0))
-                    return -1;
+        if (unlikely (rc < 0))
+            break;
 
-                moresz = sizeof more;
-                rc = backend_->getsockopt(ZMQ_RCVMORE, &more, &moresz);
-                if (unlikely (rc < 0))
-                    return -1;
-
-                //  Copy message to capture socket if any
-                if (capture_) {
-                    msg_t ctrl;
-                    rc = ctrl.init();
-                    if (unlikely (rc < 0))
-                        return -1;
-                    rc = ctrl.copy(msg);
-                    if (unlikely (rc < 0))
-                        return -1;
-                    rc = capture_->send(&ctrl, more ? ZMQ_SNDMORE : 0);
-                    if (unlikely (rc < 0))
-                        return -1;
-                }
-                rc = frontend_->send(&msg, more ? ZMQ_SNDMORE : 0);
-                if (unlikely (rc < 0))
-                    return -1;
-                if (more == 0)
-                    break;
-            }
+        if (state != active)
+            continue;
+
+        //  Process requests
+        int requests = 0;
+        if (frontend_in)
+            requests = forward(frontend_, backend_, capture_, request, msg,
+                               frontend_stats, backend_stats);
+        if (unlikely (requests < 0)) {
+            rc = -1;
+            break;
         }
 
+        //  Process replies
+        int replies = 0;
+        if (backend_in)
+            replies = forward(backend_, frontend_, capture_, reply, msg,
+                              backend_stats, frontend_stats);
+        if (unlikely (replies < 0)) {
+            rc = -1;
+            break;
+        }
+
+        busy = requests > 0 || replies > 0;
     }
-    return 0;
+
+    //  Preserve errno of the failure while cleaning up.
+    int err = errno;
+    msg.close();
+    request.held.close();
+    reply.held.close();
+    errno = err;
+    return rc < 0 ? -1 : 0;
 }
@@ -268,18 +268,21 @@ zmq::req_session_t::~req_session_t() {
 }
 
 int zmq::req_session_t::push_msg(msg_t *msg_) {
+    //  A traced message is just as good as any other.
+    const unsigned char flags = msg_->flags() & ~msg_t::trace_in;
+
     switch (state) {
         case bottom:
             // 在bottom状态下，只接受长度为0的消息?
-            if (msg_->flags() == msg_t::more && msg_->size() == 0) {
+            if (flags == msg_t::more && msg_->size() == 0) {
                 state = body;
                 return session_base_t::push_msg(msg_);
             }
             break;
         case body:
-            if (msg_->flags() == msg_t::more)
+            if (flags == msg_t::more)
                 return session_base_t::push_msg(msg_);
-            if (msg_->flags() == 0) {
+            if (flags == 0) {
                 state = bottom;
                 return session_base_t::push_msg(msg_);
             }
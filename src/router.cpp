@@ -174,13 +174,16 @@ int zmq::router_t::xsend(msg_t *msg_) {
                         errno = EAGAIN;
                         return -1;
                     }
+                    message_dropped();
                 }
             } else if (mandatory) {
                 // 路由失败: 
                 more_out = false;
+                message_dropped();
                 errno = EHOSTUNREACH;
                 return -1;
-            }
+            } else
+                message_dropped();
         }
 
         int rc = msg_->close();
@@ -216,8 +219,10 @@ int zmq::router_t::xsend(msg_t *msg_) {
 
         // 直接将msg写入到pipe中
         bool ok = current_out->write(msg_);
-        if (unlikely (!ok))
+        if (unlikely (!ok)) {
             current_out = NULL;
+            message_dropped();
+        }
         else if (!more_out) {
             // 如果没有数据了，则flush, 并且准备下一次路由
             current_out->flush();
@@ -17,6 +17,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <string.h>
+
 #include "session_base.hpp"
 #include "i_engine.hpp"
 #include "err.hpp"
@@ -27,6 +29,9 @@
 #include "pgm_sender.hpp"
 #include "pgm_receiver.hpp"
 #include "address.hpp"
+#include "wire.hpp"
+#include "crypto_thread.hpp"
+#include "spill.hpp"
 
 #include "ctx.hpp"
 #include "req.hpp"
@@ -76,13 +81,16 @@ zmq::session_base_t::session_base_t(class io_thread_t *io_thread_,
         connect(connect_),
         pipe(NULL),
         zap_pipe(NULL),
+        zap_reply_frames(0),
         incomplete_in(false),
         pending(false),
         engine(NULL),
         socket(socket_),
         io_thread(io_thread_),
         has_linger_timer(false),
-        addr(addr_) {
+        addr(addr_),
+        spill(NULL),
+        has_curve_ticket(false) {
 }
 
 zmq::session_base_t::~session_base_t() {
@@ -100,6 +108,20 @@ zmq::session_base_t::~session_base_t() {
         engine->terminate();
 
     delete addr;
+    delete spill;
+    while (!returned.empty()) {
+        int rc = returned.front().close();
+        errno_assert (rc == 0);
+        returned.pop_front();
+    }
+
+    clear_zap_frames();
+    while (!zap_cached_reply.empty()) {
+        int rc = zap_cached_reply.front().close();
+        errno_assert (rc == 0);
+        zap_cached_reply.pop_front();
+    }
+    clear_curve_ticket();
 }
 
 void zmq::session_base_t::attach_pipe(pipe_t *pipe_) {
@@ -115,6 +137,21 @@ void zmq::session_base_t::attach_pipe(pipe_t *pipe_) {
 // session读取数据: pip-read
 //
 int zmq::session_base_t::pull_msg(msg_t *msg_) {
+    //  Messages the last engine failed to send go first.
+    if (unlikely (!returned.empty())) {
+        int rc = msg_->move(returned.front());
+        errno_assert (rc == 0);
+        returned.pop_front();
+        incomplete_in = msg_->flags() & msg_t::more ? true : false;
+        return 0;
+    }
+
+    //  Messages spilled while disconnected go first.
+    if (unlikely (spill != NULL) && spill->pull(msg_)) {
+        incomplete_in = msg_->flags() & msg_t::more ? true : false;
+        return 0;
+    }
+
     if (!pipe || !pipe->read(msg_)) {
         errno = EAGAIN;
         return -1;
@@ -126,6 +163,12 @@ int zmq::session_base_t::pull_msg(msg_t *msg_) {
     return 0;
 }
 
+void zmq::session_base_t::return_msg(msg_t *msg_) {
+    returned.push_front(*msg_);
+    int rc = msg_->init();
+    errno_assert (rc == 0);
+}
+
 int zmq::session_base_t::push_msg(msg_t *msg_) {
     // 往pipe中写入数据，如果成功了，则reset msg
     if (pipe && pipe->write(msg_)) {
@@ -139,6 +182,13 @@ int zmq::session_base_t::push_msg(msg_t *msg_) {
 }
 
 int zmq::session_base_t::read_zap_msg(msg_t *msg_) {
+    if (!zap_cached_reply.empty()) {
+        int rc = msg_->move(zap_cached_reply.front());
+        errno_assert (rc == 0);
+        zap_cached_reply.pop_front();
+        return 0;
+    }
+
     if (zap_pipe == NULL) {
         errno = ENOTCONN;
         return -1;
@@ -149,6 +199,25 @@ int zmq::session_base_t::read_zap_msg(msg_t *msg_) {
         return -1;
     }
 
+    //  Remember the decision so that it can be cached.
+    //  Frames 3 to 6 are status code, status text, user id and metadata.
+    if (!zap_cache_key.empty()) {
+        const std::string value((char *) msg_->data(), msg_->size());
+        switch (zap_reply_frames++) {
+            case 3: zap_reply.status_code = value; break;
+            case 4: zap_reply.status_text = value; break;
+            case 5: zap_reply.user_id = value; break;
+            case 6: zap_reply.metadata = value; break;
+        }
+        if (!(msg_->flags() & msg_t::more)) {
+            if (zap_reply_frames == 7)
+                get_ctx()->get_zap_cache()->insert(zap_cache_key,
+                                                   zap_cache_domain, zap_reply);
+            zap_cache_key.clear();
+            zap_cache_domain.clear();
+        }
+    }
+
     return 0;
 }
 
@@ -158,17 +227,113 @@ int zmq::session_base_t::write_zap_msg(msg_t *msg_) {
         return -1;
     }
 
-    const bool ok = zap_pipe->write(msg_);
-    zmq_assert (ok);
+    //  Without the cache frames go straight to the ZAP handler.
+    if (zap_request.empty() && !get_ctx()->get_zap_cache()->enabled()) {
+        const bool ok = zap_pipe->write(msg_);
+        zmq_assert (ok);
 
-    if ((msg_->flags() & msg_t::more) == 0)
-        zap_pipe->flush();
+        if ((msg_->flags() & msg_t::more) == 0)
+            zap_pipe->flush();
 
+        const int rc = msg_->init();
+        errno_assert (rc == 0);
+        return 0;
+    }
+
+    zap_request.push_back(*msg_);
     const int rc = msg_->init();
     errno_assert (rc == 0);
+
+    if ((zap_request.back().flags() & msg_t::more) == 0)
+        send_zap_request();
     return 0;
 }
 
+void zmq::session_base_t::send_zap_request() {
+    //  ZAP request consists of delimiter, version, request id, domain,
+    //  address, identity, mechanism and credentials frames. The cache key
+    //  is made of all of them from the domain on, size-prefixed, as the
+    //  handler may decide on any of them.
+    if (zap_request.size() >= 7) {
+        std::string key;
+        for (size_t i = 3; i != zap_request.size(); i++) {
+            unsigned char size[4];
+            put_uint32(size, (uint32_t) zap_request[i].size());
+            key.append((char *) size, 4);
+            key.append((char *) zap_request[i].data(), zap_request[i].size());
+        }
+
+        zap_reply_t reply;
+        if (get_ctx()->get_zap_cache()->find(key, reply)) {
+            push_cached_zap_reply(zap_request[2], reply);
+            clear_zap_frames();
+            return;
+        }
+
+        zap_cache_key = key;
+        zap_cache_domain.assign((char *) zap_request[3].data(),
+                                zap_request[3].size());
+        zap_reply_frames = 0;
+    }
+
+    for (size_t i = 0; i != zap_request.size(); i++) {
+        const bool ok = zap_pipe->write(&zap_request[i]);
+        zmq_assert (ok);
+    }
+    zap_pipe->flush();
+    zap_request.clear();
+}
+
+void zmq::session_base_t::push_cached_zap_reply(const msg_t &request_id_,
+                                                const zap_reply_t &reply_) {
+    const std::string frames[] = {
+            std::string(),
+            std::string("1.0"),
+            std::string((char *) const_cast<msg_t &>(request_id_).data(),
+                        const_cast<msg_t &>(request_id_).size()),
+            reply_.status_code,
+            reply_.status_text,
+            reply_.user_id,
+            reply_.metadata
+    };
+
+    for (int i = 0; i != 7; i++) {
+        msg_t msg;
+        int rc = msg.init_size(frames[i].size());
+        errno_assert (rc == 0);
+        memcpy(msg.data(), frames[i].data(), frames[i].size());
+        if (i < 6)
+            msg.set_flags(msg_t::more);
+        zap_cached_reply.push_back(msg);
+    }
+}
+
+void zmq::session_base_t::clear_zap_frames() {
+    for (size_t i = 0; i != zap_request.size(); i++) {
+        int rc = zap_request[i].close();
+        errno_assert (rc == 0);
+    }
+    zap_request.clear();
+}
+
+void zmq::session_base_t::spill_pending() {
+    if (!spill) {
+        spill = new(std::nothrow) spill_t(options.spill_dir,
+                                          options.spill_size, options.sndhwm);
+        alloc_assert (spill);
+    }
+
+    //  Once the spill queue is full, the rest stays in the pipe and the
+    //  socket runs into the high water mark as usual.
+    msg_t msg;
+    int rc = msg.init();
+    errno_assert (rc == 0);
+    while (!spill->full() && pipe && pipe->read(&msg))
+        spill->push(&msg);
+    rc = msg.close();
+    errno_assert (rc == 0);
+}
+
 void zmq::session_base_t::reset() {
 }
 
@@ -185,8 +350,9 @@ void zmq::session_base_t::clean_pipes() {
         pipe->rollback();
         pipe->flush();
 
-        //  Remove any half-read message from the in pipe.
-        while (incomplete_in) {
+        //  Remove any half-read message from the in pipe, unless its head
+        //  was returned by the engine to be sent again.
+        while (incomplete_in && returned.empty()) {
             msg_t msg;
             int rc = msg.init();
             errno_assert (rc == 0);
@@ -237,7 +403,10 @@ void zmq::session_base_t::read_activated(pipe_t *pipe_) {
     }
 
     if (unlikely (engine == NULL)) {
-        pipe->check_read();
+        if (pipe_ == pipe && connect && !options.spill_dir.empty())
+            spill_pending();
+        else
+            pipe->check_read();
         return;
     }
 
@@ -264,13 +433,63 @@ void zmq::session_base_t::hiccuped(pipe_t *) {
     zmq_assert (false);
 }
 
+void zmq::session_base_t::set_curve_ticket(const uint8_t *ticket_,
+                                           const uint8_t *key_) {
+    memcpy(curve_ticket, ticket_, sizeof curve_ticket);
+    memcpy(curve_ticket_key, key_, sizeof curve_ticket_key);
+    has_curve_ticket = true;
+}
+
+bool zmq::session_base_t::get_curve_ticket(uint8_t *ticket_, uint8_t *key_) {
+    if (!has_curve_ticket)
+        return false;
+    memcpy(ticket_, curve_ticket, sizeof curve_ticket);
+    memcpy(key_, curve_ticket_key, sizeof curve_ticket_key);
+    return true;
+}
+
+void zmq::session_base_t::clear_curve_ticket() {
+    memset(curve_ticket_key, 0, sizeof curve_ticket_key);
+    has_curve_ticket = false;
+}
+
 zmq::socket_base_t *zmq::session_base_t::get_socket() {
     return socket;
 }
 
+int zmq::session_base_t::submit_crypto_job(crypto_job_t *job_) {
+    crypto_thread_t *crypto_thread = choose_crypto_thread();
+    if (!crypto_thread) {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    //  Keep the session alive till the result arrives.
+    job_->session = this;
+    inc_seqnum();
+    send_crypto_req(crypto_thread, job_);
+    return 0;
+}
+
+void zmq::session_base_t::process_crypto_done(crypto_job_t *job_) {
+    //  The engine that submitted the job may have failed in the meantime.
+    if (job_->cancelled) {
+        delete job_;
+        return;
+    }
+
+    zmq_assert (engine != NULL);
+    engine->crypto_done();
+}
+
 void zmq::session_base_t::process_plug() {
-    if (connect)
+    if (connect) {
+        //  The pipe only reports messages once a read has failed, so
+        //  start draining it now in case the peer never comes up.
+        if (pipe && !engine && !options.spill_dir.empty())
+            spill_pending();
         start_connecting(false);
+    }
 }
 
 int zmq::session_base_t::zap_connect() {
@@ -293,7 +512,10 @@ int zmq::session_base_t::zap_connect() {
     pipe_t *new_pipes[2] = {NULL, NULL};
     int hwms[2] = {0, 0};
     bool conflates[2] = {false, false};
-    int rc = pipepair(parents, new_pipes, hwms, conflates);
+    int64_t byte_hwms[2] = {0, 0};
+    int conflate_keys[2] = {0, 0};
+    int rc = pipepair(parents, new_pipes, hwms, conflates, byte_hwms,
+                      conflate_keys);
     errno_assert (rc == 0);
 
     //  Attach local end of the pipe to this socket object.
@@ -343,7 +565,11 @@ void zmq::session_base_t::process_attach(i_engine *engine_) {
         int hwms[2] = {conflate ? -1 : options.rcvhwm,
                        conflate ? -1 : options.sndhwm};
         bool conflates[2] = {conflate, conflate};
-        int rc = pipepair(parents, pipes, hwms, conflates);
+        int64_t byte_hwms[2] = {conflate ? 0 : options.rcvhwm_bytes,
+                                conflate ? 0 : options.sndhwm_bytes};
+        int conflate_keys[2] = {options.conflate_key, options.conflate_key};
+        int rc = pipepair(parents, pipes, hwms, conflates, byte_hwms,
+                          conflate_keys);
         errno_assert (rc == 0);
 
         //  Plug the local end of the pipe.
@@ -353,7 +579,11 @@ void zmq::session_base_t::process_attach(i_engine *engine_) {
         zmq_assert (!pipe);
         pipe = pipes[0];
 
-        //  Ask socket to plug into the remote end of the pipe.
+        //  Ask socket to plug into the remote end of the pipe. The weight
+        //  and priority come from the options captured when
+        //  connecting/binding.
+        pipes[1]->set_weight(options.lb_weight);
+        pipes[1]->set_priority(options.rcvpriority);
         send_bind(socket, pipes[1]);
     }
 
@@ -374,6 +604,10 @@ void zmq::session_base_t::detach() {
     //  Send the event to the derived class.
     detached();
 
+    //  Keep the socket from blocking while reconnecting.
+    if (pipe && connect && !options.spill_dir.empty())
+        spill_pending();
+
     //  Just in case there's only a delimiter in the pipe.
     if (pipe)
         pipe->check_read();
@@ -488,7 +722,8 @@ void zmq::session_base_t::start_connecting(bool wait_) {
     }
 
 #if !defined ZMQ_HAVE_WINDOWS && !defined ZMQ_HAVE_OPENVMS
-    if (addr->protocol == "ipc") {
+    //  shm:// connections are set up over a UNIX domain socket too.
+    if (addr->protocol == "ipc" || addr->protocol == "shm") {
         ipc_connecter_t *connecter = new(std::nothrow) ipc_connecter_t(
                 io_thread, this, options, addr, wait_);
         alloc_assert (connecter);
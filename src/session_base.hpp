@@ -21,12 +21,15 @@
 #define __ZMQ_SESSION_BASE_HPP_INCLUDED__
 
 #include <string>
+#include <vector>
+#include <deque>
 #include <stdarg.h>
 
 #include "own.hpp"
 #include "io_object.hpp"
 #include "pipe.hpp"
 #include "socket_base.hpp"
+#include "zap_cache.hpp"
 
 namespace zmq {
 
@@ -36,6 +39,10 @@ namespace zmq {
 
     class socket_base_t;
 
+    class crypto_job_t;
+
+    class spill_t;
+
     struct i_engine;
     struct address_t;
 
@@ -80,6 +87,12 @@ namespace zmq {
         //  longer used.
         int pull_msg(msg_t *msg_);
 
+        //  Puts a message the engine failed to send back in front of the
+        //  messages to be sent, to be pulled again once reconnected.
+        //  Messages are put back newest first. The function takes
+        //  ownership of the message.
+        void return_msg(msg_t *msg_);
+
         //  Receives message from ZAP socket.
         //  Returns 0 on success; -1 otherwise.
         //  The caller is responsible for freeing the message.
@@ -90,6 +103,20 @@ namespace zmq {
         //  The function takes ownership of the message.
         int write_zap_msg(msg_t *msg_);
 
+        //  Hands the job over to a crypto thread. The result is delivered
+        //  to the engine via i_engine::crypto_done.
+        //  Returns 0 on success; -1 if there are no crypto threads, in which
+        //  case the caller is expected to run the job itself.
+        int submit_crypto_job(zmq::crypto_job_t *job_);
+
+        //  CURVE resumption ticket issued by the server. It is kept in the
+        //  session so that it survives reconnections.
+        void set_curve_ticket(const uint8_t *ticket_, const uint8_t *key_);
+
+        bool get_curve_ticket(uint8_t *ticket_, uint8_t *key_);
+
+        void clear_curve_ticket();
+
         socket_base_t *get_socket();
 
     protected:
@@ -113,6 +140,8 @@ namespace zmq {
 
         void process_term(int linger_);
 
+        void process_crypto_done(zmq::crypto_job_t *job_);
+
         //  i_poll_events handlers.
         void timer_event(int id_);
 
@@ -123,6 +152,22 @@ namespace zmq {
         //  Call this function to move on with the delayed process_term.
         void proceed_with_term();
 
+        //  Answers complete ZAP request from the cache if possible,
+        //  otherwise passes it on to the ZAP handler.
+        void send_zap_request();
+
+        //  Fills the reply from the cache into the queue of frames to be
+        //  read by the mechanism.
+        void push_cached_zap_reply(const msg_t &request_id_,
+                                   const zap_reply_t &reply_);
+
+        //  Drops the ZAP request frames held back.
+        void clear_zap_frames();
+
+        //  While there is no engine, moves the messages queued by the
+        //  socket from the pipe to the spill queue.
+        void spill_pending();
+
         //  If true, this session (re)connects to the peer. Otherwise, it's
         //  a transient session created by the listener.
         bool connect;
@@ -133,6 +178,23 @@ namespace zmq {
         //  Pipe used to exchange messages with ZAP socket.
         zmq::pipe_t *zap_pipe;
 
+        //  ZAP request frames held back till the request is complete,
+        //  so that it can be answered from the cache.
+        std::vector<msg_t> zap_request;
+
+        //  Reply taken from the cache, yet to be read by the mechanism.
+        std::deque<msg_t> zap_cached_reply;
+
+        //  Cache key and domain of the request sent to the ZAP handler.
+        //  Empty if the reply is not to be cached.
+        std::string zap_cache_key;
+        std::string zap_cache_domain;
+
+        //  Reply of the ZAP handler being read, and the number of frames
+        //  read so far.
+        zap_reply_t zap_reply;
+        int zap_reply_frames;
+
         //  This set is added to with pipes we are disconnecting, but haven't yet completed
         std::set<pipe_t *> terminating_pipes;
 
@@ -165,6 +227,19 @@ namespace zmq {
         //  Protocol and address to use when connecting.
         const address_t *addr;
 
+        //  Messages queued while disconnected, if ZMQ_SPILL_DIR is set.
+        //  They are sent before those still in the pipe.
+        spill_t *spill;
+
+        //  Messages returned by the last engine, if ZMQ_RESEND_UNSENT is
+        //  set. They are sent before any other.
+        std::deque<msg_t> returned;
+
+        //  CURVE resumption ticket and the key that goes with it.
+        bool has_curve_ticket;
+        uint8_t curve_ticket[curve_ticket_keys_t::ticket_size];
+        uint8_t curve_ticket_key[curve_ticket_keys_t::key_size];
+
         session_base_t(const session_base_t &);
 
         const session_base_t &operator=(const session_base_t &);
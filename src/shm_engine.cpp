@@ -0,0 +1,586 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "shm_engine.hpp"
+
+#if defined ZMQ_HAVE_SHM
+
+#include <new>
+#include <stdio.h>
+#include <string.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include "io_thread.hpp"
+#include "session_base.hpp"
+#include "socket_base.hpp"
+#include "v2_encoder.hpp"
+#include "v2_decoder.hpp"
+#include "config.hpp"
+#include "random.hpp"
+#include "wire.hpp"
+#include "ip.hpp"
+#include "err.hpp"
+#include "clock.hpp"
+
+#ifdef MSG_NOSIGNAL
+#define ZMQ_SHM_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define ZMQ_SHM_SEND_FLAGS 0
+#endif
+
+zmq::shm_engine_t::shm_engine_t(fd_t fd_, const options_t &options_,
+                                const std::string &endpoint_,
+                                bool as_server_) :
+        s(fd_),
+        as_server(as_server_),
+        segment(NULL),
+        segment_size(0),
+        hello_bytes(0),
+        encoder(NULL),
+        decoder(NULL),
+        session(NULL),
+        options(options_),
+        endpoint(endpoint_),
+        plugged(false),
+        read_msg(&shm_engine_t::read_identity),
+        write_msg(&shm_engine_t::write_identity),
+        input_stopped(false),
+        output_stopped(false),
+        output_blocked(false),
+        socket(NULL),
+        handshake_started(0),
+        has_stats_timer(false),
+        tracer(NULL),
+        trace_countdown(0),
+        trace_writing(false),
+        trace_pushing(false) {
+    memset(&stats, 0, sizeof(stats));
+    memset(&unpublished, 0, sizeof(unpublished));
+
+    int rc = tx_msg.init();
+    errno_assert (rc == 0);
+
+    //  Put the socket into non-blocking mode.
+    unblock_socket(s);
+
+#ifdef SO_NOSIGPIPE
+    //  Make sure that SIGPIPE signal is not generated when waking up
+    //  a peer that has already closed the connection.
+    int set = 1;
+    rc = setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, &set, sizeof(int));
+    errno_assert (rc == 0);
+#endif
+}
+
+zmq::shm_engine_t::~shm_engine_t() {
+    zmq_assert (!plugged);
+
+    if (s != retired_fd) {
+        int rc = close(s);
+        errno_assert (rc == 0);
+        s = retired_fd;
+    }
+
+    if (segment) {
+        int rc = munmap(segment, segment_size);
+        errno_assert (rc == 0);
+        segment = NULL;
+    }
+
+    //  The accepting side normally removes the name as soon as it maps
+    //  the segment. Do it here in case it never got that far.
+    if (!name.empty())
+        shm_unlink(name.c_str());
+
+    int rc = tx_msg.close();
+    errno_assert (rc == 0);
+
+    delete encoder;
+    delete decoder;
+}
+
+void zmq::shm_engine_t::plug(io_thread_t *io_thread_,
+                             session_base_t *session_) {
+    zmq_assert (!plugged);
+    plugged = true;
+
+    //  Connect to session object.
+    zmq_assert (!session);
+    zmq_assert (session_);
+    session = session_;
+    socket = session->get_socket();
+    tracer = socket->get_tracer();
+
+    //  Connect to I/O threads poller object.
+    io_object_t::plug(io_thread_);
+    handshake_started = clock_t::now_us();
+    handle = add_fd(s);
+    set_pollin(handle);
+
+    //  The connecting side sets the segment up straight away; the
+    //  accepting side waits for it to be announced.
+    if (!as_server) {
+        if (create_segment() == -1) {
+            error();
+            return;
+        }
+        start();
+    }
+}
+
+void zmq::shm_engine_t::unplug() {
+    zmq_assert (plugged);
+    plugged = false;
+
+    //  Cancel all fd subscriptions.
+    rm_fd(handle);
+
+    if (has_stats_timer) {
+        cancel_timer(stats_timer);
+        has_stats_timer = false;
+    }
+    publish_stats();
+
+    //  Disconnect from I/O threads poller object.
+    io_object_t::unplug();
+
+    session = NULL;
+}
+
+void zmq::shm_engine_t::terminate() {
+    unplug();
+    delete this;
+}
+
+void zmq::shm_engine_t::in_event() {
+    //  Drain the socket. On the accepting side the announcement of the
+    //  segment comes first; everything else is wake-up bytes.
+    while (true) {
+        unsigned char buffer[256];
+        unsigned char *pos = buffer;
+        size_t size = sizeof(buffer);
+        if (!segment) {
+            pos = hello + hello_bytes;
+            size = hello_size - hello_bytes;
+        }
+
+        const ssize_t rc = recv(s, pos, size, 0);
+
+        //  The peer has closed the connection. Deliver what it has left
+        //  in the ring before detaching from the session.
+        if (rc == 0) {
+            if (segment && consume() == -1)
+                return;
+            error();
+            return;
+        }
+        if (rc == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                break;
+            errno_assert (errno != EBADF
+                          && errno != EFAULT
+                          && errno != EINVAL
+                          && errno != ENOMEM
+                          && errno != ENOTSOCK);
+            error();
+            return;
+        }
+
+        if (!segment) {
+            hello_bytes += rc;
+            if (hello_bytes < hello_size)
+                continue;
+            if (open_segment() == -1) {
+                error();
+                return;
+            }
+            start();
+            return;
+        }
+    }
+
+    if (!segment)
+        return;
+
+    //  A wake-up means data was written to the inbound ring or space was
+    //  freed in the outbound one.
+    if (consume() == -1)
+        return;
+    if (output_blocked) {
+        output_blocked = false;
+        produce();
+    }
+}
+
+void zmq::shm_engine_t::restart_output() {
+    output_stopped = false;
+    if (segment && !output_blocked)
+        produce();
+}
+
+void zmq::shm_engine_t::restart_input() {
+    zmq_assert (input_stopped);
+    zmq_assert (session != NULL);
+    zmq_assert (decoder != NULL);
+
+    int rc = (this->*write_msg)(decoder->msg());
+    if (rc == -1) {
+        if (errno == EAGAIN)
+            session->flush();
+        else
+            error();
+        return;
+    }
+    if (unlikely (trace_pushing)) {
+        tracer->recv_pushed(tracer_t::now());
+        trace_pushing = false;
+    }
+
+    input_stopped = false;
+    consume();
+}
+
+void zmq::shm_engine_t::zap_msg_available() {
+    //  No security mechanism runs over shm://, so no ZAP requests are made.
+    zmq_assert (false);
+}
+
+void zmq::shm_engine_t::crypto_done() {
+    //  No handshake is ever offloaded to the crypto threads.
+    zmq_assert (false);
+}
+
+int zmq::shm_engine_t::create_segment() {
+    const uint32_t ring_size = shm_ring_size;
+    const size_t size = shm_segment_t::total_size(ring_size);
+
+    char buffer[name_size];
+    snprintf(buffer, sizeof(buffer), "/zmq-%d-%08x", (int) getpid(),
+             (unsigned int) generate_random());
+
+    int fd = shm_open(buffer, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1)
+        return -1;
+    name = buffer;
+
+    int rc = ftruncate(fd, (off_t) size);
+    void *area = MAP_FAILED;
+    if (rc == 0)
+        area = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    rc = close(fd);
+    errno_assert (rc == 0);
+    if (area == MAP_FAILED)
+        return -1;
+
+    //  Fresh shared memory is zeroed, which is also the initial state of
+    //  the ring counters.
+    segment = new(area) shm_segment_t;
+    segment_size = size;
+    segment->magic = shm_segment_t::magic_value;
+    segment->ring_size = ring_size;
+
+    //  Announce the segment. A freshly connected socket has room for it.
+    unsigned char announcement[hello_size];
+    memset(announcement, 0, sizeof(announcement));
+    put_uint32(announcement, shm_segment_t::magic_value);
+    put_uint32(announcement + 4, ring_size);
+    memcpy(announcement + 8, name.c_str(), name.size());
+    const ssize_t nbytes = send(s, announcement, sizeof(announcement),
+                                ZMQ_SHM_SEND_FLAGS);
+    if (nbytes != (ssize_t) sizeof(announcement))
+        return -1;
+    return 0;
+}
+
+int zmq::shm_engine_t::open_segment() {
+    const uint32_t ring_size = get_uint32(hello + 4);
+    if (get_uint32(hello) != shm_segment_t::magic_value || ring_size == 0 ||
+        (ring_size & (ring_size - 1)) != 0) {
+        errno = EPROTO;
+        return -1;
+    }
+
+    //  Only segments created by this transport may be opened, and thus
+    //  unlinked, on behalf of the peer.
+    char buffer[name_size + 1];
+    memcpy(buffer, hello + 8, name_size);
+    buffer[name_size] = 0;
+    if (strncmp(buffer, "/zmq-", 5) != 0) {
+        errno = EPROTO;
+        return -1;
+    }
+
+    int fd = shm_open(buffer, O_RDWR, 0);
+    if (fd == -1)
+        return -1;
+
+    //  Both sides have the segment open now; its name is not needed.
+    shm_unlink(buffer);
+
+    const size_t size = shm_segment_t::total_size(ring_size);
+    struct stat st;
+    int rc = fstat(fd, &st);
+    void *area = MAP_FAILED;
+    if (rc == 0 && (size_t) st.st_size >= size)
+        area = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    rc = close(fd);
+    errno_assert (rc == 0);
+    if (area == MAP_FAILED) {
+        errno = EPROTO;
+        return -1;
+    }
+
+    segment = (shm_segment_t *) area;
+    segment_size = size;
+    if (segment->magic != shm_segment_t::magic_value ||
+        segment->ring_size != ring_size) {
+        errno = EPROTO;
+        return -1;
+    }
+    return 0;
+}
+
+void zmq::shm_engine_t::start() {
+    const uint32_t ring_size = segment->ring_size;
+    const int out = as_server ? 1 : 0;
+    tx.init(&segment->rings[out], segment->data(out), ring_size);
+    rx.init(&segment->rings[1 - out], segment->data(1 - out), ring_size);
+
+    encoder = new(std::nothrow) v2_encoder_t(out_batch_size);
+    alloc_assert (encoder);
+
+    decoder = new(std::nothrow) v2_decoder_t(in_batch_size,
+                                             options.maxmsgsize);
+    alloc_assert (decoder);
+
+    //  The segment is the whole handshake; there is no security mechanism.
+    socket->event_handshake_succeeded(endpoint, s, std::string(), ZMQ_NULL, false,
+                                      clock_t::now_us() - handshake_started);
+
+    produce();
+
+    //  The peer may have written before this side was listening for
+    //  wake-ups.
+    consume();
+}
+
+void zmq::shm_engine_t::produce() {
+    //  Commits are accounted in one go to keep the stats lock off the
+    //  per-message path.
+    uint64_t produced = 0;
+    uint64_t commits = 0;
+
+    while (true) {
+        unsigned char *area;
+        const size_t space = tx.write_area(&area);
+        if (space == 0) {
+            if (tx.sleep_writer()) {
+                output_blocked = true;
+                break;
+            }
+            continue;
+        }
+
+        //  Encode straight into the ring. Zero means the encoder is done
+        //  with the current message and a new one has to be loaded.
+        const size_t n = encoder->encode(&area, space);
+        if (n == 0) {
+            if ((this->*read_msg)(&tx_msg) == -1) {
+                output_stopped = true;
+                break;
+            }
+            if (unlikely (tx_msg.flags() & msg_t::trace_out)) {
+                tx_msg.reset_flags(msg_t::trace_out);
+                tracer->send_loaded(tracer_t::now());
+                trace_writing = true;
+            }
+            encoder->load_msg(&tx_msg);
+            stats.msgs_out++;
+            continue;
+        }
+
+        produced += n;
+        commits++;
+        if (tx.commit(n))
+            notify();
+        if (unlikely (trace_writing)) {
+            tracer->send_written(tracer_t::now());
+            trace_writing = false;
+        }
+    }
+
+    if (commits) {
+        stats.bytes_out += produced;
+        account_stats(0, produced, 0, commits);
+    }
+}
+
+int zmq::shm_engine_t::consume() {
+    while (!input_stopped) {
+        unsigned char *area;
+        const size_t size = rx.read_area(&area);
+        if (size == 0) {
+            if (rx.sleep_reader())
+                break;
+            continue;
+        }
+
+        const uint64_t read_tsc = tracer->enabled() ? tracer_t::now() : 0;
+
+        //  Decode straight out of the ring.
+        size_t used = 0;
+        int rc = 0;
+        while (used < size) {
+            size_t processed = 0;
+            rc = decoder->decode(area + used, size - used, processed);
+            zmq_assert (processed <= size - used);
+            used += processed;
+            if (rc != 1)
+                break;
+            rc = push_decoded(read_tsc);
+            if (rc == -1)
+                break;
+            stats.msgs_in++;
+        }
+
+        if (used > 0) {
+            stats.bytes_in += used;
+            account_stats(used, 0, 1, 0);
+            if (rx.release(used))
+                notify();
+        }
+
+        //  Tear down the connection if we have failed to decode input data
+        //  or the session has rejected the message.
+        if (rc == -1) {
+            if (errno != EAGAIN) {
+                error();
+                return -1;
+            }
+            input_stopped = true;
+        }
+    }
+
+    session->flush();
+    return 0;
+}
+
+int zmq::shm_engine_t::push_decoded(uint64_t read_tsc_) {
+    //  The identity of the peer is not traced.
+    if (unlikely (tracer->enabled()) &&
+          write_msg == &shm_engine_t::push_msg_to_session &&
+          tracer->sample_recv(trace_countdown, read_tsc_)) {
+        decoder->msg()->set_flags(msg_t::trace_in);
+        trace_pushing = true;
+    }
+
+    const int rc = (this->*write_msg)(decoder->msg());
+    if (rc == 0 && unlikely (trace_pushing)) {
+        tracer->recv_pushed(tracer_t::now());
+        trace_pushing = false;
+    }
+    return rc;
+}
+
+void zmq::shm_engine_t::notify() {
+    const unsigned char wakeup = 0;
+    const ssize_t nbytes = send(s, &wakeup, 1, ZMQ_SHM_SEND_FLAGS);
+
+    //  A full socket buffer already holds wake-ups the peer hasn't seen.
+    //  Failures because the peer is gone are noticed when reading.
+    if (nbytes == -1)
+        errno_assert (errno != EBADF
+                      && errno != EFAULT
+                      && errno != EINVAL
+                      && errno != ENOTSOCK);
+}
+
+int zmq::shm_engine_t::read_identity(msg_t *msg_) {
+    int rc = msg_->init_size(options.identity_size);
+    errno_assert (rc == 0);
+    if (options.identity_size > 0)
+        memcpy(msg_->data(), options.identity, options.identity_size);
+    read_msg = &shm_engine_t::pull_msg_from_session;
+    return 0;
+}
+
+int zmq::shm_engine_t::write_identity(msg_t *msg_) {
+    if (options.recv_identity) {
+        msg_->set_flags(msg_t::identity);
+        int rc = session->push_msg(msg_);
+        errno_assert (rc == 0);
+    }
+    else {
+        int rc = msg_->close();
+        errno_assert (rc == 0);
+        rc = msg_->init();
+        errno_assert (rc == 0);
+    }
+    write_msg = &shm_engine_t::push_msg_to_session;
+    return 0;
+}
+
+int zmq::shm_engine_t::pull_msg_from_session(msg_t *msg_) {
+    return session->pull_msg(msg_);
+}
+
+int zmq::shm_engine_t::push_msg_to_session(msg_t *msg_) {
+    return session->push_msg(msg_);
+}
+
+void zmq::shm_engine_t::timer_event(int id_) {
+    zmq_assert (id_ == stats_timer_id);
+    has_stats_timer = false;
+    publish_stats();
+}
+
+void zmq::shm_engine_t::account_stats(uint64_t bytes_in_, uint64_t bytes_out_,
+                                      uint64_t reads_, uint64_t writes_) {
+    unpublished.bytes_in += bytes_in_;
+    unpublished.bytes_out += bytes_out_;
+    unpublished.reads += reads_;
+    unpublished.writes += writes_;
+    if (!has_stats_timer) {
+        stats_timer = add_timer(engine_stats_ivl, stats_timer_id);
+        has_stats_timer = true;
+    }
+}
+
+void zmq::shm_engine_t::publish_stats() {
+    if (unpublished.reads || unpublished.writes)
+        socket->add_engine_stats(unpublished);
+}
+
+void zmq::shm_engine_t::error() {
+    zmq_assert (session);
+    socket->event_disconnected(endpoint, s, std::string(), stats);
+    session->flush();
+    session->detach();
+    unplug();
+    delete this;
+}
+
+#endif
@@ -0,0 +1,229 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ZMQ_SHM_ENGINE_HPP_INCLUDED__
+#define __ZMQ_SHM_ENGINE_HPP_INCLUDED__
+
+#include "shm_ring.hpp"
+
+#if defined ZMQ_HAVE_SHM
+
+#include <stddef.h>
+#include <string>
+
+#include "fd.hpp"
+#include "i_engine.hpp"
+#include "io_object.hpp"
+#include "i_encoder.hpp"
+#include "i_decoder.hpp"
+#include "options.hpp"
+#include "msg.hpp"
+#include "socket_base.hpp"
+
+namespace zmq {
+
+    class io_thread_t;
+
+    class session_base_t;
+
+    class socket_base_t;
+
+    //  Engine of the shm:// transport. Messages travel through a pair of
+    //  byte rings in a POSIX shared memory segment; the UNIX domain socket
+    //  the connection was established over only carries the name of the
+    //  segment and single-byte wake-ups. A wake-up is sent only when the
+    //  other side has found its ring empty or full and gone to sleep, so
+    //  a busy connection makes no system calls at all.
+    //
+    //  The connecting side creates the segment and sends its name, the
+    //  accepting side maps it and removes the name right away. Frames are
+    //  encoded in ZMTP/2.0 framing straight into the ring and decoded
+    //  straight out of it, so every message body is copied exactly once
+    //  in each process. No security mechanism is run; the segment is only
+    //  accessible to the user that created it.
+
+    class shm_engine_t : public io_object_t, public i_engine {
+    public:
+
+        shm_engine_t(fd_t fd_, const options_t &options_,
+                     const std::string &endpoint_, bool as_server_);
+
+        ~shm_engine_t();
+
+        //  i_engine interface implementation.
+        void plug(zmq::io_thread_t *io_thread_,
+                  zmq::session_base_t *session_);
+
+        void terminate();
+
+        void restart_input();
+
+        void restart_output();
+
+        void zap_msg_available();
+
+        void crypto_done();
+
+        //  i_poll_events interface implementation.
+        void in_event();
+        void timer_event(int id_);
+
+    private:
+
+        //  Size of the message that announces the segment: magic, ring
+        //  size and the zero-padded segment name.
+        enum {
+            hello_size = 64,
+            name_size = hello_size - 8
+        };
+
+        //  Unplug the engine from the session.
+        void unplug();
+
+        //  Function to handle disconnections.
+        void error();
+
+        //  Creates the segment and sends its name to the peer (connecting
+        //  side) or maps the segment the peer has announced (accepting
+        //  side). Return -1 on failure.
+        int create_segment();
+
+        int open_segment();
+
+        //  Starts the message flow once the segment is mapped.
+        void start();
+
+        //  Moves messages from the session to the outbound ring until
+        //  either runs out.
+        void produce();
+
+        //  Moves messages from the inbound ring to the session. Returns -1
+        //  if the engine was destroyed because of an error.
+        int consume();
+
+        //  Sends a wake-up byte to the peer.
+        void notify();
+
+        //  Counts traffic for ZMQ_STATS, making sure it gets reported to
+        //  the socket within engine_stats_ivl.
+        void account_stats(uint64_t bytes_in_, uint64_t bytes_out_,
+                           uint64_t reads_, uint64_t writes_);
+
+        //  Reports the traffic counted so far to the socket.
+        void publish_stats();
+
+        int read_identity(msg_t *msg_);
+
+        int write_identity(msg_t *msg_);
+
+        int pull_msg_from_session(msg_t *msg_);
+
+        int push_msg_to_session(msg_t *msg_);
+
+        //  Pushes the decoded message to the session, tracing it if it
+        //  is sampled.
+        int push_decoded(uint64_t read_tsc_);
+
+        //  Underlying UNIX domain socket.
+        fd_t s;
+
+        handle_t handle;
+
+        //  True iff this is the accepting side of the connection.
+        bool as_server;
+
+        //  Mapped segment, NULL until it is created or announced.
+        shm_segment_t *segment;
+        size_t segment_size;
+
+        //  Name of the segment created by the connecting side.
+        std::string name;
+
+        //  Announcement being received by the accepting side.
+        unsigned char hello[hello_size];
+        size_t hello_bytes;
+
+        shm_ring_t tx;
+        shm_ring_t rx;
+
+        msg_t tx_msg;
+
+        i_encoder *encoder;
+        i_decoder *decoder;
+
+        //  The session this engine is attached to.
+        zmq::session_base_t *session;
+
+        options_t options;
+
+        // String representation of endpoint
+        std::string endpoint;
+
+        bool plugged;
+
+        int (shm_engine_t::*read_msg)(msg_t *msg_);
+
+        int (shm_engine_t::*write_msg)(msg_t *msg_);
+
+        //  True iff the session couldn't take the last decoded message.
+        bool input_stopped;
+
+        //  True iff the session has no message to send.
+        bool output_stopped;
+
+        //  True iff the outbound ring is full and the peer was asked for
+        //  a wake-up once it frees some space.
+        bool output_blocked;
+
+        // Socket
+        zmq::socket_base_t *socket;
+
+        //  When the engine was plugged, to time the segment set-up.
+        uint64_t handshake_started;
+
+        //  Traffic of the connection, for the monitor.
+        connection_stats_t stats;
+
+        //  Traffic not reported to the socket yet, and the timer to report
+        //  it, if it is running.
+        enum {stats_timer_id = 0x83};
+        engine_stats_t unpublished;
+        bool has_stats_timer;
+        timer_handle_t stats_timer;
+
+        //  Latency tracing: the tracer of the socket, messages to be
+        //  decoded before the next one is traced and whether a traced
+        //  message is waiting to be committed to the ring or pushed to
+        //  the session.
+        tracer_t *tracer;
+        int trace_countdown;
+        bool trace_writing;
+        bool trace_pushing;
+
+        shm_engine_t(const shm_engine_t &);
+
+        const shm_engine_t &operator=(const shm_engine_t &);
+    };
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,186 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ZMQ_SHM_RING_HPP_INCLUDED__
+#define __ZMQ_SHM_RING_HPP_INCLUDED__
+
+#include "platform.hpp"
+#include "atomic_counter.hpp"
+
+//  The shm:// transport needs POSIX shared memory and atomic counters
+//  that work across processes.
+#if !defined ZMQ_HAVE_WINDOWS && !defined ZMQ_HAVE_OPENVMS && \
+    defined ZMQ_ATOMIC_COUNTER_SHAREABLE
+#define ZMQ_HAVE_SHM
+#endif
+
+#if defined ZMQ_HAVE_SHM
+
+#include <stddef.h>
+
+#include "stdint.hpp"
+#include "err.hpp"
+
+namespace zmq {
+
+    //  Control block of one direction of a shm:// connection. It lives in
+    //  the shared segment; every counter has a cache line of its own so
+    //  that the two processes don't false-share.
+    //
+    //  'tail' and 'head' count the bytes ever written and read, modulo
+    //  2^32. The asleep flags are set by a side that found the ring empty
+    //  (reader) or full (writer) and are cleared by the other side, which
+    //  then sends a wake-up byte over the connection's UNIX socket.
+    struct shm_ring_ctl_t {
+        atomic_counter_t tail;
+        unsigned char pad0[64 - sizeof(atomic_counter_t)];
+        atomic_counter_t head;
+        unsigned char pad1[64 - sizeof(atomic_counter_t)];
+        atomic_counter_t reader_asleep;
+        unsigned char pad2[64 - sizeof(atomic_counter_t)];
+        atomic_counter_t writer_asleep;
+        unsigned char pad3[64 - sizeof(atomic_counter_t)];
+    };
+
+    //  Layout of the shared segment: the header followed by the data
+    //  areas of the two rings. Ring 0 carries data from the connecting
+    //  side to the accepting side, ring 1 the other way round.
+    struct shm_segment_t {
+        uint32_t magic;
+        uint32_t ring_size;
+        unsigned char pad[64 - 2 * sizeof(uint32_t)];
+        shm_ring_ctl_t rings[2];
+
+        enum {
+            magic_value = 0x7a6d5348
+        };
+
+        static size_t total_size(uint32_t ring_size_) {
+            return sizeof(shm_segment_t) + 2 * (size_t) ring_size_;
+        }
+
+        unsigned char *data(int ring_) {
+            return (unsigned char *) this + sizeof(shm_segment_t) +
+                   ring_ * (size_t) ring_size;
+        }
+    };
+
+    //  Process-local view of one ring. A ring has exactly one writer and
+    //  one reader, each running in the I/O thread of its own process.
+    //  Positions published by the other side are read with add(0) so that
+    //  the access acts as a full memory barrier on every platform.
+    class shm_ring_t {
+    public:
+
+        inline shm_ring_t() :
+                ctl(NULL),
+                data(NULL),
+                size(0) {
+        }
+
+        inline void init(shm_ring_ctl_t *ctl_, unsigned char *data_,
+                         uint32_t size_) {
+            //  Positions wrap at 2^32, so the size has to divide it.
+            zmq_assert (size_ > 0 && (size_ & (size_ - 1)) == 0);
+            ctl = ctl_;
+            data = data_;
+            size = size_;
+        }
+
+        //  Writer: returns the number of contiguous free bytes and points
+        //  data_ at them.
+        inline size_t write_area(unsigned char **data_) {
+            const uint32_t tail = ctl->tail.get();
+            const uint32_t used = tail - ctl->head.add(0);
+            const uint32_t offset = tail & (size - 1);
+            *data_ = data + offset;
+            return contiguous(offset, size - used);
+        }
+
+        //  Writer: publishes size_ bytes written to the area returned by
+        //  write_area. Returns true if the reader has to be woken up.
+        inline bool commit(size_t size_) {
+            ctl->tail.add((uint32_t) size_);
+            return wake(ctl->reader_asleep);
+        }
+
+        //  Writer: called when the ring is full. Returns true if it is
+        //  still full after the reader was asked for a wake-up.
+        inline bool sleep_writer() {
+            if (!ctl->writer_asleep.get())
+                ctl->writer_asleep.add(1);
+            return ctl->tail.get() - ctl->head.add(0) == size;
+        }
+
+        //  Reader: returns the number of contiguous bytes available and
+        //  points data_ at them.
+        inline size_t read_area(unsigned char **data_) {
+            const uint32_t head = ctl->head.get();
+            const uint32_t used = ctl->tail.add(0) - head;
+            const uint32_t offset = head & (size - 1);
+            *data_ = data + offset;
+            return contiguous(offset, used);
+        }
+
+        //  Reader: frees size_ bytes. Returns true if the writer has to be
+        //  woken up.
+        inline bool release(size_t size_) {
+            ctl->head.add((uint32_t) size_);
+            return wake(ctl->writer_asleep);
+        }
+
+        //  Reader: called when the ring is empty. Returns true if it is
+        //  still empty after the writer was asked for a wake-up.
+        inline bool sleep_reader() {
+            if (!ctl->reader_asleep.get())
+                ctl->reader_asleep.add(1);
+            return ctl->tail.add(0) == ctl->head.get();
+        }
+
+    private:
+
+        inline size_t contiguous(uint32_t offset_, uint32_t available_) {
+            const uint32_t to_end = size - offset_;
+            return available_ < to_end ? available_ : to_end;
+        }
+
+        //  Only the sleeping side sets the flag and only the other side
+        //  clears it, so it is always either 0 or 1.
+        static inline bool wake(atomic_counter_t &asleep_) {
+            if (!asleep_.get())
+                return false;
+            asleep_.sub(1);
+            return true;
+        }
+
+        shm_ring_ctl_t *ctl;
+        unsigned char *data;
+        uint32_t size;
+
+        shm_ring_t(const shm_ring_t &);
+
+        const shm_ring_t &operator=(const shm_ring_t &);
+    };
+
+}
+
+#endif
+
+#endif
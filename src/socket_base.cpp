@@ -20,6 +20,7 @@
 #include <new>
 #include <string>
 #include <algorithm>
+#include <string.h>
 
 #include "platform.hpp"
 
@@ -35,6 +36,7 @@
 #else
 
 #include <unistd.h>
+#include <sched.h>
 
 #endif
 
@@ -54,6 +56,8 @@
 #include "address.hpp"
 #include "ipc_address.hpp"
 #include "tcp_address.hpp"
+#include "shm_ring.hpp"
+#include "ip.hpp"
 
 #ifdef ZMQ_HAVE_OPENPGM
 #include "pgm_socket.hpp"
@@ -91,11 +95,11 @@ zmq::socket_base_t *zmq::socket_base_t::create(int type_, class ctx_t *parent_,
         case ZMQ_PAIR:
             s = new(std::nothrow) pair_t(parent_, tid_, sid_);
             break;
-//        case ZMQ_PUB:
-//            s = new(std::nothrow) pub_t(parent_, tid_, sid_);
-//            break;
-//        case ZMQ_SUB:
-//            s = new(std::nothrow) sub_t(parent_, tid_, sid_);
+        case ZMQ_PUB:
+            s = new(std::nothrow) pub_t(parent_, tid_, sid_);
+            break;
+        case ZMQ_SUB:
+            s = new(std::nothrow) sub_t(parent_, tid_, sid_);
             break;
         case ZMQ_REQ:
             s = new(std::nothrow) req_t(parent_, tid_, sid_);
@@ -109,17 +113,17 @@ zmq::socket_base_t *zmq::socket_base_t::create(int type_, class ctx_t *parent_,
         case ZMQ_ROUTER:
             s = new(std::nothrow) router_t(parent_, tid_, sid_);
             break;
-//        case ZMQ_PULL:
-//            s = new(std::nothrow) pull_t(parent_, tid_, sid_);
-//            break;
-//        case ZMQ_PUSH:
-//            s = new(std::nothrow) push_t(parent_, tid_, sid_);
-//            break;
-//        case ZMQ_XPUB:
-//            s = new(std::nothrow) xpub_t(parent_, tid_, sid_);
-//            break;
-//        case ZMQ_XSUB:
-//            s = new(std::nothrow) xsub_t(parent_, tid_, sid_);
+        case ZMQ_PULL:
+            s = new(std::nothrow) pull_t(parent_, tid_, sid_);
+            break;
+        case ZMQ_PUSH:
+            s = new(std::nothrow) push_t(parent_, tid_, sid_);
+            break;
+        case ZMQ_XPUB:
+            s = new(std::nothrow) xpub_t(parent_, tid_, sid_);
+            break;
+        case ZMQ_XSUB:
+            s = new(std::nothrow) xsub_t(parent_, tid_, sid_);
             break;
         case ZMQ_STREAM:
             s = new(std::nothrow) stream_t(parent_, tid_, sid_);
@@ -129,7 +133,7 @@ zmq::socket_base_t *zmq::socket_base_t::create(int type_, class ctx_t *parent_,
             return NULL;
     }
     // s的mailbox在什么地方设置呢?
-    if (s->mailbox.get_fd() == retired_fd)
+    if (s->mailbox->get_fd() == retired_fd)
         return NULL;
 
     alloc_assert (s);
@@ -141,22 +145,75 @@ zmq::socket_base_t::socket_base_t(ctx_t *parent_, uint32_t tid_, int sid_) :
         tag(0xbaddecaf),
         ctx_terminated(false),
         destroyed(false),
+        mailbox(parent_->acquire_mailbox()),
         last_tsc(0),
         ticks(0),
         rcvmore(false),
         monitor_socket(NULL),
-        monitor_events(0) {
+        monitor_events(0),
+        monitor_ring(NULL),
+        monitor_ring_events(0),
+        msgs_sent(0),
+        bytes_sent(0),
+        msgs_received(0),
+        bytes_received(0),
+        hwm_blocked(0),
+        dropped(0),
+        commands(0),
+        engine_bytes_in(0),
+        engine_bytes_out(0),
+        engine_reads(0),
+        engine_writes(0),
+        pipes_shared(false) {
     options.socket_id = sid_;
     options.ipv6 = (parent_->get(ZMQ_IPV6) != 0);
 }
 
 zmq::socket_base_t::~socket_base_t() {
     stop_monitor();
+    delete monitor_ring;
     zmq_assert (destroyed);
+    get_ctx()->release_mailbox(mailbox);
 }
 
 zmq::mailbox_t *zmq::socket_base_t::get_mailbox() {
-    return &mailbox;
+    return mailbox;
+}
+
+zmq::curve_ticket_keys_t *zmq::socket_base_t::get_curve_ticket_keys() {
+    return &curve_ticket_keys;
+}
+
+void zmq::socket_base_t::add_engine_stats(engine_stats_t &stats_) {
+    stats_sync.lock();
+    engine_bytes_in += stats_.bytes_in;
+    engine_bytes_out += stats_.bytes_out;
+    engine_reads += stats_.reads;
+    engine_writes += stats_.writes;
+    stats_sync.unlock();
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+zmq::tracer_t *zmq::socket_base_t::get_tracer() {
+    return &tracer;
+}
+
+void zmq::socket_base_t::message_dropped() {
+    dropped++;
+}
+
+void zmq::socket_base_t::share_pipes() {
+    pipes_shared = true;
+}
+
+void zmq::socket_base_t::lock_pipes() {
+    if (unlikely (pipes_shared))
+        pipes_sync.lock();
+}
+
+void zmq::socket_base_t::unlock_pipes() {
+    if (unlikely (pipes_shared))
+        pipes_sync.unlock();
 }
 
 void zmq::socket_base_t::stop() {
@@ -190,10 +247,23 @@ int zmq::socket_base_t::parse_uri(const char *uri_,
 int zmq::socket_base_t::check_protocol(const std::string &protocol_) {
     //  First check out whether the protcol is something we are aware of.
     if (protocol_ != "inproc" && protocol_ != "ipc" && protocol_ != "tcp" &&
-        protocol_ != "pgm" && protocol_ != "epgm") {
+        protocol_ != "pgm" && protocol_ != "epgm" && protocol_ != "shm") {
+        errno = EPROTONOSUPPORT;
+        return -1;
+    }
+
+#if !defined ZMQ_HAVE_SHM
+    if (protocol_ == "shm") {
         errno = EPROTONOSUPPORT;
         return -1;
     }
+#endif
+
+    //  The shm:// transport runs no security mechanism.
+    if (protocol_ == "shm" && options.mechanism != ZMQ_NULL) {
+        errno = ENOCOMPATPROTO;
+        return -1;
+    }
     
 
     //  Check whether socket type and transport protocol match.
@@ -213,6 +283,7 @@ int zmq::socket_base_t::check_protocol(const std::string &protocol_) {
 void zmq::socket_base_t::attach_pipe(pipe_t *pipe_, bool subscribe_to_all_) {
     //  First, register the pipe so that we can terminate it later on.
     pipe_->set_event_sink(this);
+    pipe_->set_tracer(&tracer);
     pipes.push_back(pipe_);
 
     //  Let the derived socket type know about new pipe.
@@ -233,6 +304,15 @@ int zmq::socket_base_t::setsockopt(int option_, const void *optval_,
         return -1;
     }
 
+    if (option_ == ZMQ_TRACE) {
+        if (optvallen_ != sizeof(int) || *((int *) optval_) < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        tracer.set_rate(*((int *) optval_));
+        return 0;
+    }
+
     //  First, check whether specific socket type overloads the option.
     int rc = xsetsockopt(option_, optval_, optvallen_);
     if (rc == 0 || errno != EINVAL)
@@ -265,7 +345,7 @@ int zmq::socket_base_t::getsockopt(int option_, void *optval_,
             errno = EINVAL;
             return -1;
         }
-        *((fd_t *) optval_) = mailbox.get_fd();
+        *((fd_t *) optval_) = mailbox->get_fd();
         *optvallen_ = sizeof(fd_t);
         return 0;
     }
@@ -288,6 +368,37 @@ int zmq::socket_base_t::getsockopt(int option_, void *optval_,
         return 0;
     }
 
+    if (option_ == ZMQ_STATS || option_ == ZMQ_PIPE_STATS) {
+        //  Let the pipes catch up with the progress of their peers.
+        int rc = process_commands(0, false);
+        if (rc != 0 && (errno == EINTR || errno == ETERM))
+            return -1;
+        errno_assert (rc == 0);
+        if (option_ == ZMQ_STATS)
+            return get_stats(optval_, optvallen_);
+        return get_pipe_stats(optval_, optvallen_);
+    }
+
+    if (option_ == ZMQ_TRACE) {
+        if (*optvallen_ < sizeof(int)) {
+            errno = EINVAL;
+            return -1;
+        }
+        *((int *) optval_) = tracer.get_rate();
+        *optvallen_ = sizeof(int);
+        return 0;
+    }
+
+    if (option_ == ZMQ_TRACE_STATS) {
+        if (*optvallen_ < sizeof(zmq_trace_stats_t)) {
+            errno = EINVAL;
+            return -1;
+        }
+        tracer.get_stats((zmq_trace_stats_t *) optval_);
+        *optvallen_ = sizeof(zmq_trace_stats_t);
+        return 0;
+    }
+
     if (option_ == ZMQ_LAST_ENDPOINT) {
         if (*optvallen_ < last_endpoint.size() + 1) {
             errno = EINVAL;
@@ -327,7 +438,9 @@ int zmq::socket_base_t::bind(const char *addr_) {
         endpoint_t endpoint = {this, options};
         int rc = register_endpoint(addr_, endpoint);
         if (rc == 0) {
+            lock_pipes();
             connect_pending(addr_, this);
+            unlock_pipes();
             last_endpoint.assign(addr_);
         }
         return rc;
@@ -366,9 +479,9 @@ int zmq::socket_base_t::bind(const char *addr_) {
     }
 
 #if !defined ZMQ_HAVE_WINDOWS && !defined ZMQ_HAVE_OPENVMS
-    if (protocol == "ipc") {
+    if (protocol == "ipc" || protocol == "shm") {
         ipc_listener_t *listener = new(std::nothrow) ipc_listener_t(
-                io_thread, this, options);
+                io_thread, this, options, protocol == "shm");
         alloc_assert (listener);
         int rc = listener->set_address(address.c_str());
         if (rc != 0) {
@@ -413,6 +526,122 @@ int zmq::socket_base_t::connect(const char *addr_) {
     if (rc != 0)
         return -1;
 
+    //  Inproc needs neither a session nor an I/O thread: the pipe goes
+    //  straight from this socket to the peer.
+    if (protocol == "inproc") {
+
+        //  Find the peer endpoint.
+        endpoint_t peer = find_endpoint(addr_);
+
+        //  The total HWM for an inproc connection should be the sum of
+        //  the binder's HWM and the connector's HWM. If the peer isn't
+        //  bound yet, the sums are set once it is.
+        int sndhwm = options.sndhwm;
+        int rcvhwm = options.rcvhwm;
+        int64_t sndhwm_bytes = options.sndhwm_bytes;
+        int64_t rcvhwm_bytes = options.rcvhwm_bytes;
+        if (peer.socket != NULL) {
+            sndhwm = options.sndhwm != 0 && peer.options.rcvhwm != 0 ?
+                     options.sndhwm + peer.options.rcvhwm : 0;
+            rcvhwm = options.rcvhwm != 0 && peer.options.sndhwm != 0 ?
+                     options.rcvhwm + peer.options.sndhwm : 0;
+            sndhwm_bytes = options.sndhwm_bytes != 0 &&
+                           peer.options.rcvhwm_bytes != 0 ?
+                           options.sndhwm_bytes + peer.options.rcvhwm_bytes : 0;
+            rcvhwm_bytes = options.rcvhwm_bytes != 0 &&
+                           peer.options.sndhwm_bytes != 0 ?
+                           options.rcvhwm_bytes + peer.options.sndhwm_bytes : 0;
+        }
+
+        //  Create a bi-directional pipe to connect the peers.
+        object_t *parents[2] = {this, peer.socket == NULL ? this : peer.socket};
+        pipe_t *new_pipes[2] = {NULL, NULL};
+
+        bool conflate = options.conflate &&
+                        (options.type == ZMQ_DEALER ||
+                         options.type == ZMQ_PULL ||
+                         options.type == ZMQ_PUSH ||
+                         options.type == ZMQ_PUB ||
+                         options.type == ZMQ_SUB);
+
+        int hwms[2] = {conflate ? -1 : sndhwm, conflate ? -1 : rcvhwm};
+        bool conflates[2] = {conflate, conflate};
+        int64_t byte_hwms[2] = {conflate ? 0 : sndhwm_bytes,
+                                conflate ? 0 : rcvhwm_bytes};
+        int conflate_keys[2] = {options.conflate_key, options.conflate_key};
+        rc = pipepair(parents, new_pipes, hwms, conflates, byte_hwms,
+                      conflate_keys);
+        errno_assert (rc == 0);
+
+        //  Attach local end of the pipe to this socket object.
+        new_pipes[0]->set_weight(options.lb_weight);
+        new_pipes[0]->set_priority(options.rcvpriority);
+        lock_pipes();
+        attach_pipe(new_pipes[0]);
+
+        if (!peer.socket) {
+            //  The peer doesn't exist yet so we don't know whether
+            //  to send the identity message or not. To resolve this,
+            //  we always send our identity and drop it later if
+            //  the peer doesn't expect it.
+            msg_t id;
+            rc = id.init_size(options.identity_size);
+            errno_assert (rc == 0);
+            memcpy(id.data(), options.identity, options.identity_size);
+            id.set_flags(msg_t::identity);
+            bool written = new_pipes[0]->write(&id);
+            zmq_assert (written);
+            new_pipes[0]->flush();
+
+            endpoint_t endpoint = {this, options};
+            pending_connection_t pending_connection =
+                {endpoint, new_pipes[0], new_pipes[1]};
+            pend_connection(addr_, pending_connection);
+        }
+        else {
+            //  If required, send the identity of the local socket to the peer.
+            if (peer.options.recv_identity) {
+                msg_t id;
+                rc = id.init_size(options.identity_size);
+                errno_assert (rc == 0);
+                memcpy(id.data(), options.identity, options.identity_size);
+                id.set_flags(msg_t::identity);
+                bool written = new_pipes[0]->write(&id);
+                zmq_assert (written);
+                new_pipes[0]->flush();
+            }
+
+            //  If required, send the identity of the peer to the local socket.
+            if (options.recv_identity) {
+                msg_t id;
+                rc = id.init_size(peer.options.identity_size);
+                errno_assert (rc == 0);
+                memcpy(id.data(), peer.options.identity,
+                       peer.options.identity_size);
+                id.set_flags(msg_t::identity);
+                bool written = new_pipes[1]->write(&id);
+                zmq_assert (written);
+                new_pipes[1]->flush();
+            }
+
+            //  Attach remote end of the pipe to the peer socket. Note that
+            //  peer's seqnum was incremented in find_endpoint function. We
+            //  don't need it increased here. The peer's own thread picks
+            //  the command up on its next call, so the connect never waits.
+            new_pipes[1]->set_weight(peer.options.lb_weight);
+            new_pipes[1]->set_priority(peer.options.rcvpriority);
+            send_bind(peer.socket, new_pipes[1], false);
+        }
+        unlock_pipes();
+
+        //  Save last endpoint URI
+        last_endpoint.assign(addr_);
+
+        //  Remember inproc connections for disconnect.
+        inprocs.insert(inprocs_t::value_type(std::string(addr_), new_pipes[0]));
+
+        return 0;
+    }
 
     //  Choose the I/O thread to run the session in.
     io_thread_t *io_thread = choose_io_thread(options.affinity);
@@ -435,6 +664,17 @@ int zmq::socket_base_t::connect(const char *addr_) {
             return -1;
         }
     }
+#if !defined ZMQ_HAVE_WINDOWS && !defined ZMQ_HAVE_OPENVMS
+    else if (protocol == "ipc" || protocol == "shm") {
+        paddr->resolved.ipc_addr = new(std::nothrow) ipc_address_t();
+        alloc_assert (paddr->resolved.ipc_addr);
+        int rc = paddr->resolved.ipc_addr->resolve(address.c_str());
+        if (rc != 0) {
+            delete paddr;
+            return -1;
+        }
+    }
+#endif
 
     //  Create session.
     session_base_t *session = session_base_t::create(io_thread, true, this,
@@ -464,11 +704,15 @@ int zmq::socket_base_t::connect(const char *addr_) {
         int hwms[2] = {conflate ? -1 : options.sndhwm,
                        conflate ? -1 : options.rcvhwm};
         bool conflates[2] = {conflate, conflate};
+        int64_t byte_hwms[2] = {conflate ? 0 : options.sndhwm_bytes,
+                                conflate ? 0 : options.rcvhwm_bytes};
+        int conflate_keys[2] = {options.conflate_key, options.conflate_key};
 
 
         // 将 this <===> session进行关联
         // 1. 创建两个 pipe_t (内部管理双向的yquque_t)
-        rc = pipepair(parents, new_pipes, hwms, conflates);
+        rc = pipepair(parents, new_pipes, hwms, conflates, byte_hwms,
+                      conflate_keys);
         errno_assert (rc == 0);
 
         // 有两个概念:
@@ -478,7 +722,11 @@ int zmq::socket_base_t::connect(const char *addr_) {
         //    
         // 2. 将pipe和session关联
         //  Attach local end of the pipe to the socket object.
+        new_pipes[0]->set_weight(options.lb_weight);
+        new_pipes[0]->set_priority(options.rcvpriority);
+        lock_pipes();
         attach_pipe(new_pipes[0], subscribe_to_all);
+        unlock_pipes();
         newpipe = new_pipes[0];
 
         //  Attach remote end of the pipe to the session object later on.
@@ -539,8 +787,10 @@ int zmq::socket_base_t::term_endpoint(const char *addr_) {
             return -1;
         }
 
+        lock_pipes();
         for (inprocs_t::iterator it = range.first; it != range.second; ++it)
             it->second->terminate(true);
+        unlock_pipes();
         inprocs.erase(range.first, range.second);
         return 0;
     }
@@ -552,12 +802,14 @@ int zmq::socket_base_t::term_endpoint(const char *addr_) {
         return -1;
     }
 
+    lock_pipes();
     for (endpoints_t::iterator it = range.first; it != range.second; ++it) {
         //  If we have an associated pipe, terminate it.
         if (it->second.second != NULL)
             it->second.second->terminate(false);
         term_child(it->second.first);
     }
+    unlock_pipes();
     endpoints.erase(range.first, range.second);
     return 0;
 }
@@ -567,6 +819,24 @@ int zmq::socket_base_t::term_endpoint(const char *addr_) {
 // 据说有缓存?
 //
 int zmq::socket_base_t::send(msg_t *msg_, int flags_) {
+    if (likely (!options.thread_safe))
+        return send_internal(msg_, flags_);
+
+    //  Parts sent by different threads would get interleaved.
+    if (unlikely (flags_ & ZMQ_SNDMORE)) {
+        errno = EINVAL;
+        return -1;
+    }
+    return combine(true, msg_, flags_);
+}
+
+int zmq::socket_base_t::recv(msg_t *msg_, int flags_) {
+    if (likely (!options.thread_safe))
+        return recv_internal(msg_, flags_);
+    return combine(false, msg_, flags_);
+}
+
+int zmq::socket_base_t::send_internal(msg_t *msg_, int flags_) {
     //  Check whether the library haven't been shut down yet.
     if (unlikely (ctx_terminated)) {
         errno = ETERM;
@@ -579,10 +849,18 @@ int zmq::socket_base_t::send(msg_t *msg_, int flags_) {
         return -1;
     }
 
+    //  The trace of a message starts right on entry.
+    bool traced = false;
+    if (unlikely (tracer.enabled()))
+        traced = tracer.sample_send(tracer_t::now());
+
     //  Process pending commands, if any.
     int rc = process_commands(0, true);
-    if (unlikely (rc != 0))
+    if (unlikely (rc != 0)) {
+        if (unlikely (traced))
+            tracer.send_failed();
         return -1;
+    }
 
     //  Clear any user-visible flags that are set on the message.
     msg_->reset_flags(msg_t::more);
@@ -590,18 +868,37 @@ int zmq::socket_base_t::send(msg_t *msg_, int flags_) {
     //  At this point we impose the flags on the message.
     if (flags_ & ZMQ_SNDMORE)
         msg_->set_flags(msg_t::more);
+    if (unlikely (traced)) {
+        msg_->set_flags(msg_t::trace_out);
+        tracer.send_queued(tracer_t::now());
+    }
+
+    //  Remember the size, the socket type takes the content over.
+    const size_t size = msg_->size();
 
     //  Try to send the message.
     rc = xsend(msg_);
-    if (rc == 0)
+    if (rc == 0) {
+        bytes_sent += size;
+        if (!(flags_ & ZMQ_SNDMORE))
+            msgs_sent++;
         return 0;
-    if (unlikely (errno != EAGAIN))
+    }
+    if (unlikely (errno != EAGAIN)) {
+        if (unlikely (traced))
+            cancel_send_trace(msg_);
         return -1;
+    }
+    if (hwm_reached())
+        hwm_blocked++;
 
     //  In case of non-blocking send we'll simply propagate
     //  the error - including EAGAIN - up the stack.
-    if (flags_ & ZMQ_DONTWAIT || options.sndtimeo == 0)
+    if (flags_ & ZMQ_DONTWAIT || options.sndtimeo == 0) {
+        if (unlikely (traced))
+            cancel_send_trace(msg_);
         return -1;
+    }
 
     //  Compute the time when the timeout should occur.
     //  If the timeout is infinite, don't care.
@@ -612,25 +909,38 @@ int zmq::socket_base_t::send(msg_t *msg_, int flags_) {
     //  command, process it and try to send the message again.
     //  If timeout is reached in the meantime, return EAGAIN.
     while (true) {
-        if (unlikely (process_commands(timeout, false) != 0))
+        if (unlikely (process_commands(timeout, false) != 0)) {
+            if (unlikely (traced))
+                cancel_send_trace(msg_);
             return -1;
+        }
+        if (unlikely (traced))
+            tracer.send_queued(tracer_t::now());
         rc = xsend(msg_);
         if (rc == 0)
             break;
-        if (unlikely (errno != EAGAIN))
+        if (unlikely (errno != EAGAIN)) {
+            if (unlikely (traced))
+                cancel_send_trace(msg_);
             return -1;
+        }
         if (timeout > 0) {
             timeout = (int) (end - clock.now_ms());
             if (timeout <= 0) {
+                if (unlikely (traced))
+                    cancel_send_trace(msg_);
                 errno = EAGAIN;
                 return -1;
             }
         }
     }
+    bytes_sent += size;
+    if (!(flags_ & ZMQ_SNDMORE))
+        msgs_sent++;
     return 0;
 }
 
-int zmq::socket_base_t::recv(msg_t *msg_, int flags_) {
+int zmq::socket_base_t::recv_internal(msg_t *msg_, int flags_) {
     //  Check whether the library haven't been shut down yet.
     if (unlikely (ctx_terminated)) {
         errno = ETERM;
@@ -740,7 +1050,7 @@ bool zmq::socket_base_t::has_out() {
 void zmq::socket_base_t::start_reaping(poller_t * poller_) {
     //  Plug the socket to the reaper thread.
     poller = poller_;
-    handle = poller->add_fd(mailbox.get_fd(), this);
+    handle = poller->add_fd(mailbox->get_fd(), this);
     poller->set_pollin(handle);
 
     //  Initialise the termination and check whether it can be deallocated
@@ -755,7 +1065,7 @@ int zmq::socket_base_t::process_commands(int timeout_, bool throttle_) {
     if (timeout_ != 0) {
 
         //  If we are asked to wait, simply ask mailbox to wait.
-        rc = mailbox.recv(&cmd, timeout_);
+        rc = mailbox->recv(&cmd, timeout_);
     }
     else {
 
@@ -782,13 +1092,16 @@ int zmq::socket_base_t::process_commands(int timeout_, bool throttle_) {
         }
 
         //  Check whether there are any commands pending for this thread.
-        rc = mailbox.recv(&cmd, 0);
+        rc = mailbox->recv(&cmd, 0);
     }
 
     //  Process all available commands.
     while (rc == 0) {
+        commands++;
+        lock_pipes();
         cmd.destination->process_command(cmd);
-        rc = mailbox.recv(&cmd, 0);
+        unlock_pipes();
+        rc = mailbox->recv(&cmd, 0);
     }
 
     if (errno == EINTR)
@@ -934,6 +1247,9 @@ void zmq::socket_base_t::pipe_terminated(pipe_t *pipe_) {
         }
     }
 
+    //  Keep what the pipe discarded in the socket totals.
+    dropped += pipe_->get_dropped();
+
     //  Remove the pipe from the list of attached pipes and confirm its
     //  termination if we are already shutting down.
     pipes.erase(pipe_);
@@ -948,6 +1264,216 @@ void zmq::socket_base_t::extract_flags(msg_t *msg_) {
 
     //  Remove MORE flag.
     rcvmore = msg_->flags() & msg_t::more ? true : false;
+
+    bytes_received += msg_->size();
+    if (!rcvmore)
+        msgs_received++;
+}
+
+bool zmq::socket_base_t::hwm_reached() {
+    for (pipes_t::size_type i = 0; i != pipes.size(); i++)
+        if (!pipes[i]->check_hwm())
+            return true;
+    return false;
+}
+
+void zmq::socket_base_t::cancel_send_trace(msg_t *msg_) {
+    msg_->reset_flags(msg_t::trace_out);
+    tracer.send_failed();
+}
+
+static void yield_thread() {
+#if defined ZMQ_HAVE_WINDOWS
+    Sleep(0);
+#else
+    sched_yield();
+#endif
+}
+
+int zmq::socket_base_t::combine(bool is_send_, msg_t *msg_, int flags_) {
+    //  Requests never block, so that a thread waiting for the socket does
+    //  not hold up the others. Waiting is done here, between attempts.
+    int timeout = (flags_ & ZMQ_DONTWAIT) ? 0 :
+        (is_send_ ? options.sndtimeo : options.rcvtimeo);
+    uint64_t end = timeout > 0 ? clock_t::now_us() / 1000 + timeout : 0;
+
+    request_t request;
+    request.is_send = is_send_;
+    request.msg = msg_;
+    request.flags = flags_ | ZMQ_DONTWAIT;
+    request.refresh = false;
+
+    while (true) {
+        submit(&request);
+        if (request.rc == 0 || request.err != EAGAIN || timeout == 0) {
+            if (request.rc != 0)
+                errno = request.err;
+            return request.rc;
+        }
+
+        int slice = thread_safe_wait_slice;
+        if (timeout > 0) {
+            int64_t left = (int64_t) (end - clock_t::now_us() / 1000);
+            if (left <= 0) {
+                errno = EAGAIN;
+                return -1;
+            }
+            if (left < slice)
+                slice = (int) left;
+        }
+
+        //  Pipes being activated or attached show up as commands. The
+        //  next attempt processes them even if sends are throttled.
+        if (unlikely (mailbox->wait(slice) == -1 && errno == EINTR))
+            return -1;
+        request.refresh = true;
+    }
+}
+
+void zmq::socket_base_t::submit(request_t *request_) {
+    request_->state.set(request_t::pending);
+
+    //  The request is counted before it is pushed, so that the thread
+    //  running the current batch waits for it instead of leaving it
+    //  behind unnoticed.
+    bool first = (pending_requests.add(1) == 0);
+    request_t *head = NULL;
+    while (true) {
+        request_->next = head;
+        request_t *old = requests.cas(head, request_);
+        if (old == head)
+            break;
+        head = old;
+    }
+
+    request_t *batch;
+    if (first)
+        batch = take_requests();
+    else {
+        while (request_->state.get() == request_t::pending)
+            yield_thread();
+        if (request_->state.get() == request_t::done)
+            return;
+        batch = request_;
+    }
+
+    //  Run the batch on behalf of the threads that submitted it. Once a
+    //  request is marked done its thread may return and unwind it.
+    uint32_t count = 0;
+    while (batch) {
+        request_t *request = batch;
+        batch = batch->next;
+        int rc;
+        if (request->refresh && process_commands(0, false) != 0)
+            rc = -1;
+        else
+        if (request->is_send)
+            rc = send_internal(request->msg, request->flags);
+        else
+            rc = recv_single(request->msg, request->flags);
+        request->rc = rc;
+        request->err = rc == 0 ? 0 : errno;
+        if (request != request_)
+            request->state.cas(request_t::pending, request_t::done);
+        count++;
+    }
+
+    //  Requests that came in meanwhile are run by one of their threads,
+    //  so that no thread keeps serving the others for long.
+    if (pending_requests.sub(count)) {
+        request_t *next = take_requests();
+        next->state.cas(request_t::pending, request_t::promoted);
+    }
+}
+
+int zmq::socket_base_t::recv_single(msg_t *msg_, int flags_) {
+    int rc = recv_internal(msg_, flags_);
+    if (rc != 0 || likely (!(msg_->flags() & msg_t::more)))
+        return rc;
+
+    //  Messages are delivered whole, so the other parts are here already.
+    //  Discard them all, so that the next receive starts with a message.
+    while (msg_->flags() & msg_t::more) {
+        rc = recv_internal(msg_, flags_ | ZMQ_DONTWAIT);
+        if (rc != 0)
+            return rc;
+    }
+    rc = msg_->close();
+    errno_assert (rc == 0);
+    rc = msg_->init();
+    errno_assert (rc == 0);
+    message_dropped();
+    errno = EPROTO;
+    return -1;
+}
+
+zmq::socket_base_t::request_t *zmq::socket_base_t::take_requests() {
+    //  A request may be counted but not pushed yet.
+    request_t *list;
+    while (!(list = requests.xchg(NULL)))
+        yield_thread();
+
+    //  The stack holds the newest request first.
+    request_t *batch = NULL;
+    while (list) {
+        request_t *next = list->next;
+        list->next = batch;
+        batch = list;
+        list = next;
+    }
+    return batch;
+}
+
+int zmq::socket_base_t::get_stats(void *optval_, size_t *optvallen_) {
+    if (*optvallen_ < sizeof(zmq_socket_stats_t)) {
+        errno = EINVAL;
+        return -1;
+    }
+    zmq_socket_stats_t *stats = (zmq_socket_stats_t *) optval_;
+    stats->msgs_sent = msgs_sent;
+    stats->bytes_sent = bytes_sent;
+    stats->msgs_received = msgs_received;
+    stats->bytes_received = bytes_received;
+    stats->hwm_blocked = hwm_blocked;
+    stats->dropped = dropped;
+    for (pipes_t::size_type i = 0; i != pipes.size(); i++)
+        stats->dropped += pipes[i]->get_dropped();
+    stats->commands = commands;
+    stats->pipes = pipes.size();
+
+    stats_sync.lock();
+    stats->engine_bytes_in = engine_bytes_in;
+    stats->engine_bytes_out = engine_bytes_out;
+    stats->engine_reads = engine_reads;
+    stats->engine_writes = engine_writes;
+    stats_sync.unlock();
+
+    *optvallen_ = sizeof(zmq_socket_stats_t);
+    return 0;
+}
+
+int zmq::socket_base_t::get_pipe_stats(void *optval_, size_t *optvallen_) {
+    //  Report as many pipes as fit; ZMQ_STATS tells how many there are.
+    const size_t count = std::min(*optvallen_ / sizeof(zmq_pipe_stats_t),
+                                  (size_t) pipes.size());
+    zmq_pipe_stats_t *stats = (zmq_pipe_stats_t *) optval_;
+    for (size_t i = 0; i != count; i++) {
+        pipe_t *pipe = pipes[i];
+        const blob_t identity = pipe->get_identity();
+        memset(stats[i].identity, 0, sizeof(stats[i].identity));
+        const size_t identity_size = std::min(identity.size(),
+                                              sizeof(stats[i].identity));
+        if (identity_size)
+            memcpy(stats[i].identity, identity.data(), identity_size);
+        stats[i].identity_size = (uint8_t) identity_size;
+        stats[i].outbound_depth = pipe->get_outbound_depth();
+        stats[i].msgs_written = pipe->get_msgs_written();
+        stats[i].msgs_read = pipe->get_msgs_read();
+        stats[i].write_blocked = pipe->get_write_blocked();
+        stats[i].dropped = pipe->get_dropped();
+    }
+    *optvallen_ = count * sizeof(zmq_pipe_stats_t);
+    return 0;
 }
 
 int zmq::socket_base_t::monitor(const char *addr_, int events_) {
@@ -999,7 +1525,38 @@ int zmq::socket_base_t::monitor(const char *addr_, int events_) {
     return rc;
 }
 
+int zmq::socket_base_t::monitor_ring_start(int events_, int capacity_) {
+    if (unlikely (ctx_terminated)) {
+        errno = ETERM;
+        return -1;
+    }
+
+    if (!monitor_ring) {
+        if (events_ == 0)
+            return 0;
+        if (capacity_ <= 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        monitor_ring = new(std::nothrow) monitor_ring_t((uint32_t) capacity_);
+        alloc_assert (monitor_ring);
+    }
+    monitor_ring_events = events_;
+    return 0;
+}
+
+int zmq::socket_base_t::monitor_ring_read(zmq_monitor_record_t *records_,
+                                          int count_) {
+    if (!monitor_ring) {
+        errno = EINVAL;
+        return -1;
+    }
+    return monitor_ring->read(records_, count_);
+}
+
 void zmq::socket_base_t::event_connected(std::string &addr_, int fd_) {
+    if (monitor_ring_events & ZMQ_EVENT_CONNECTED)
+        monitor_record(ZMQ_EVENT_CONNECTED, fd_, addr_, fd_);
     if (monitor_events & ZMQ_EVENT_CONNECTED) {
         zmq_event_t event;
         event.event = ZMQ_EVENT_CONNECTED;
@@ -1009,6 +1566,8 @@ void zmq::socket_base_t::event_connected(std::string &addr_, int fd_) {
 }
 
 void zmq::socket_base_t::event_connect_delayed(std::string &addr_, int err_) {
+    if (monitor_ring_events & ZMQ_EVENT_CONNECT_DELAYED)
+        monitor_record(ZMQ_EVENT_CONNECT_DELAYED, err_, addr_, retired_fd);
     if (monitor_events & ZMQ_EVENT_CONNECT_DELAYED) {
         zmq_event_t event;
         event.event = ZMQ_EVENT_CONNECT_DELAYED;
@@ -1018,6 +1577,8 @@ void zmq::socket_base_t::event_connect_delayed(std::string &addr_, int err_) {
 }
 
 void zmq::socket_base_t::event_connect_retried(std::string &addr_, int interval_) {
+    if (monitor_ring_events & ZMQ_EVENT_CONNECT_RETRIED)
+        monitor_record(ZMQ_EVENT_CONNECT_RETRIED, interval_, addr_, retired_fd);
     if (monitor_events & ZMQ_EVENT_CONNECT_RETRIED) {
         zmq_event_t event;
         event.event = ZMQ_EVENT_CONNECT_RETRIED;
@@ -1027,6 +1588,8 @@ void zmq::socket_base_t::event_connect_retried(std::string &addr_, int interval_
 }
 
 void zmq::socket_base_t::event_listening(std::string &addr_, int fd_) {
+    if (monitor_ring_events & ZMQ_EVENT_LISTENING)
+        monitor_record(ZMQ_EVENT_LISTENING, fd_, addr_, retired_fd);
     if (monitor_events & ZMQ_EVENT_LISTENING) {
         zmq_event_t event;
         event.event = ZMQ_EVENT_LISTENING;
@@ -1036,6 +1599,8 @@ void zmq::socket_base_t::event_listening(std::string &addr_, int fd_) {
 }
 
 void zmq::socket_base_t::event_bind_failed(std::string &addr_, int err_) {
+    if (monitor_ring_events & ZMQ_EVENT_BIND_FAILED)
+        monitor_record(ZMQ_EVENT_BIND_FAILED, err_, addr_, retired_fd);
     if (monitor_events & ZMQ_EVENT_BIND_FAILED) {
         zmq_event_t event;
         event.event = ZMQ_EVENT_BIND_FAILED;
@@ -1045,6 +1610,8 @@ void zmq::socket_base_t::event_bind_failed(std::string &addr_, int err_) {
 }
 
 void zmq::socket_base_t::event_accepted(std::string &addr_, int fd_) {
+    if (monitor_ring_events & ZMQ_EVENT_ACCEPTED)
+        monitor_record(ZMQ_EVENT_ACCEPTED, fd_, addr_, fd_);
     if (monitor_events & ZMQ_EVENT_ACCEPTED) {
         zmq_event_t event;
         event.event = ZMQ_EVENT_ACCEPTED;
@@ -1054,6 +1621,8 @@ void zmq::socket_base_t::event_accepted(std::string &addr_, int fd_) {
 }
 
 void zmq::socket_base_t::event_accept_failed(std::string &addr_, int err_) {
+    if (monitor_ring_events & ZMQ_EVENT_ACCEPT_FAILED)
+        monitor_record(ZMQ_EVENT_ACCEPT_FAILED, err_, addr_, retired_fd);
     if (monitor_events & ZMQ_EVENT_ACCEPT_FAILED) {
         zmq_event_t event;
         event.event = ZMQ_EVENT_ACCEPT_FAILED;
@@ -1063,6 +1632,8 @@ void zmq::socket_base_t::event_accept_failed(std::string &addr_, int err_) {
 }
 
 void zmq::socket_base_t::event_closed(std::string &addr_, int fd_) {
+    if (monitor_ring_events & ZMQ_EVENT_CLOSED)
+        monitor_record(ZMQ_EVENT_CLOSED, fd_, addr_, retired_fd);
     if (monitor_events & ZMQ_EVENT_CLOSED) {
         zmq_event_t event;
         event.event = ZMQ_EVENT_CLOSED;
@@ -1072,6 +1643,8 @@ void zmq::socket_base_t::event_closed(std::string &addr_, int fd_) {
 }
 
 void zmq::socket_base_t::event_close_failed(std::string &addr_, int err_) {
+    if (monitor_ring_events & ZMQ_EVENT_CLOSE_FAILED)
+        monitor_record(ZMQ_EVENT_CLOSE_FAILED, err_, addr_, retired_fd);
     if (monitor_events & ZMQ_EVENT_CLOSE_FAILED) {
         zmq_event_t event;
         event.event = ZMQ_EVENT_CLOSE_FAILED;
@@ -1080,7 +1653,20 @@ void zmq::socket_base_t::event_close_failed(std::string &addr_, int err_) {
     }
 }
 
-void zmq::socket_base_t::event_disconnected(std::string &addr_, int fd_) {
+void zmq::socket_base_t::event_disconnected(std::string &addr_, int fd_,
+                                            const std::string &peer_address_,
+                                            const connection_stats_t &stats_) {
+    if (monitor_ring_events & ZMQ_EVENT_DISCONNECTED) {
+        zmq_monitor_record_t record;
+        memset(&record, 0, sizeof(record));
+        strncpy(record.peer_address, peer_address_.c_str(),
+                sizeof(record.peer_address) - 1);
+        record.bytes_in = stats_.bytes_in;
+        record.bytes_out = stats_.bytes_out;
+        record.msgs_in = stats_.msgs_in;
+        record.msgs_out = stats_.msgs_out;
+        monitor_record(record, ZMQ_EVENT_DISCONNECTED, fd_, addr_);
+    }
     if (monitor_events & ZMQ_EVENT_DISCONNECTED) {
         zmq_event_t event;
         event.event = ZMQ_EVENT_DISCONNECTED;
@@ -1089,6 +1675,51 @@ void zmq::socket_base_t::event_disconnected(std::string &addr_, int fd_) {
     }
 }
 
+void zmq::socket_base_t::event_handshake_succeeded(std::string &addr_, int fd_,
+                                                   const std::string &peer_address_,
+                                                   int mechanism_, bool resumed_,
+                                                   uint64_t handshake_time_) {
+    if (monitor_ring_events & ZMQ_EVENT_HANDSHAKE_SUCCEEDED) {
+        zmq_monitor_record_t record;
+        memset(&record, 0, sizeof(record));
+        strncpy(record.peer_address, peer_address_.c_str(),
+                sizeof(record.peer_address) - 1);
+        record.handshake_time = handshake_time_;
+        record.mechanism = mechanism_;
+        record.resumed = resumed_;
+        monitor_record(record, ZMQ_EVENT_HANDSHAKE_SUCCEEDED, fd_, addr_);
+    }
+    if (monitor_events & ZMQ_EVENT_HANDSHAKE_SUCCEEDED) {
+        zmq_event_t event;
+        event.event = ZMQ_EVENT_HANDSHAKE_SUCCEEDED;
+        event.value = fd_;
+        monitor_event(event, addr_);
+    }
+}
+
+void zmq::socket_base_t::monitor_record(int event_, int value_,
+                                        const std::string &addr_,
+                                        fd_t peer_fd_) {
+    zmq_monitor_record_t record;
+    memset(&record, 0, sizeof(record));
+    std::string peer_address;
+    if (peer_fd_ != retired_fd && get_peer_ip_address(peer_fd_, peer_address))
+        strncpy(record.peer_address, peer_address.c_str(),
+                sizeof(record.peer_address) - 1);
+    record.mechanism = options.mechanism;
+    monitor_record(record, event_, value_, addr_);
+}
+
+void zmq::socket_base_t::monitor_record(zmq_monitor_record_t &record_,
+                                        int event_, int value_,
+                                        const std::string &addr_) {
+    record_.timestamp = clock_t::now_us();
+    record_.event = (uint32_t) event_;
+    record_.value = value_;
+    strncpy(record_.endpoint, addr_.c_str(), sizeof(record_.endpoint) - 1);
+    monitor_ring->push(record_);
+}
+
 void zmq::socket_base_t::monitor_event(zmq_event_t event_, const std::string &addr_) {
     if (monitor_socket) {
         const uint16_t eid = (uint16_t) event_.event;
@@ -29,11 +29,15 @@
 #include "stdint.hpp"
 #include "poller.hpp"
 #include "atomic_counter.hpp"
+#include "atomic_ptr.hpp"
 #include "i_poll_events.hpp"
 #include "mailbox.hpp"
 #include "stdint.hpp"
 #include "clock.hpp"
 #include "pipe.hpp"
+#include "curve_ticket_keys.hpp"
+#include "monitor_ring.hpp"
+#include "tracer.hpp"
 
 extern "C"  {
 void zmq_free_event(void *data, void *hint);
@@ -41,6 +45,25 @@ void zmq_free_event(void *data, void *hint);
 
 namespace zmq {
 
+    //  Traffic of a single connection, reported by its engine to the
+    //  monitor ring when the connection goes away.
+    struct connection_stats_t {
+        uint64_t bytes_in;
+        uint64_t bytes_out;
+        uint64_t msgs_in;
+        uint64_t msgs_out;
+    };
+
+    //  Wire traffic an engine has not reported to its socket yet. Engines
+    //  count it locally and report it now and then, so that the socket's
+    //  statistics lock is kept off the read and write path.
+    struct engine_stats_t {
+        uint64_t bytes_in;
+        uint64_t bytes_out;
+        uint64_t reads;
+        uint64_t writes;
+    };
+
     class ctx_t;
 
     class msg_t;
@@ -66,6 +89,19 @@ namespace zmq {
         //  Returns the mailbox associated with this socket.
         mailbox_t *get_mailbox();
 
+        //  Returns keys sealing CURVE resumption tickets issued by the
+        //  socket. This function can be called from a different thread!
+        curve_ticket_keys_t *get_curve_ticket_keys();
+
+        //  Accounts traffic of an engine serving this socket in the
+        //  ZMQ_STATS counters and resets the engine's counts. This
+        //  function is called from I/O threads!
+        void add_engine_stats(engine_stats_t &stats_);
+
+        //  Returns the latency tracer of the socket. This function can be
+        //  called from a different thread!
+        tracer_t *get_tracer();
+
         //  Interrupt blocking call if the socket is stuck in one.
         //  This function can be called from a different thread!
         void stop();
@@ -120,6 +156,14 @@ namespace zmq {
 
         int monitor(const char *endpoint_, int events_);
 
+        //  Structured monitoring into a ring of records. The ring is
+        //  allocated by the first call and lives as long as the socket.
+        int monitor_ring_start(int events_, int capacity_);
+
+        //  Reads records from the ring. This function can be called from
+        //  a different thread, but only one thread may read at a time!
+        int monitor_ring_read(zmq_monitor_record_t *records_, int count_);
+
         void event_connected(std::string &addr_, int fd_);
 
         void event_connect_delayed(std::string &addr_, int err_);
@@ -138,7 +182,14 @@ namespace zmq {
 
         void event_close_failed(std::string &addr_, int fd_);
 
-        void event_disconnected(std::string &addr_, int fd_);
+        void event_disconnected(std::string &addr_, int fd_,
+                                const std::string &peer_address_,
+                                const connection_stats_t &stats_);
+
+        void event_handshake_succeeded(std::string &addr_, int fd_,
+                                       const std::string &peer_address_,
+                                       int mechanism_, bool resumed_,
+                                       uint64_t handshake_time_);
 
     protected:
 
@@ -185,6 +236,29 @@ namespace zmq {
         // Monitor socket cleanup
         void stop_monitor();
 
+        //  Fills in the common fields of a monitor record and adds it to
+        //  the ring. The peer address is looked up if peer_fd_ is valid.
+        void monitor_record(int event_, int value_, const std::string &addr_,
+                            fd_t peer_fd_);
+
+        //  Same as above for a record with event specific fields already
+        //  filled in and the rest zeroed.
+        void monitor_record(zmq_monitor_record_t &record_, int event_,
+                            int value_, const std::string &addr_);
+
+        //  Accounts a message the socket type discarded instead of
+        //  delivering it.
+        void message_dropped();
+
+        //  From now on an I/O thread may flush the pipes on behalf of the
+        //  socket, see xpub_t. The socket uses its pipes under the lock
+        //  taken by lock_pipes then.
+        void share_pipes();
+
+        void lock_pipes();
+
+        void unlock_pipes();
+
     private:
         //  Creates new endpoint ID and adds the endpoint to the map.
         void add_endpoint(const char *addr_, own_t *endpoint_, pipe_t *pipe);
@@ -203,9 +277,64 @@ namespace zmq {
         void check_destroy();
 
         //  Moves the flags from the message to local variables,
-        //  to be later retrieved by getsockopt.
+        //  to be later retrieved by getsockopt, and accounts the message
+        //  in the statistics.
         void extract_flags(msg_t *msg_);
 
+        //  Fill in the ZMQ_STATS and ZMQ_PIPE_STATS results.
+        int get_stats(void *optval_, size_t *optvallen_);
+
+        int get_pipe_stats(void *optval_, size_t *optvallen_);
+
+        //  True if a pipe of the socket is at its high water mark, telling
+        //  a send that failed because of it from one that found no peers.
+        bool hwm_reached();
+
+        //  Gives up the trace of a message that failed to be sent.
+        void cancel_send_trace(msg_t *msg_);
+
+        //  The send and recv of the socket proper. In ZMQ_THREAD_SAFE
+        //  mode they are run by one thread at a time on behalf of all.
+        int send_internal(msg_t *msg_, int flags_);
+
+        int recv_internal(msg_t *msg_, int flags_);
+
+        //  A send or recv of a thread using a ZMQ_THREAD_SAFE socket. It
+        //  lives on the stack of the thread, which waits for its state to
+        //  change. The thread taking requests over runs the whole batch.
+        struct request_t {
+            enum {pending, done, promoted};
+            bool is_send;
+            msg_t *msg;
+            int flags;
+            bool refresh;
+            int rc;
+            int err;
+            atomic_counter_t state;
+            request_t *next;
+        };
+
+        //  Runs a send or recv in ZMQ_THREAD_SAFE mode, waiting for the
+        //  socket outside of it as long as the timeout allows.
+        int combine(bool is_send_, msg_t *msg_, int flags_);
+
+        //  Receives a single-part message. The parts of a message would end
+        //  up in different threads, so a multi-part message is dropped as
+        //  a whole and the receive fails with EPROTO.
+        int recv_single(msg_t *msg_, int flags_);
+
+        //  Has the request run, possibly by another thread.
+        void submit(request_t *request_);
+
+        //  Grabs the requests submitted so far, oldest first.
+        request_t *take_requests();
+
+        //  Requests submitted and not yet taken, newest first, and the
+        //  number of requests not yet completed. The thread bringing it
+        //  up from zero runs the first batch.
+        atomic_ptr_t<request_t> requests;
+        atomic_counter_t pending_requests;
+
         //  Used to check whether the object is a socket.
         uint32_t tag;
 
@@ -241,8 +370,8 @@ namespace zmq {
 
         void process_term(int linger_);
 
-        //  Socket's mailbox object.
-        mailbox_t mailbox;
+        //  Socket's mailbox object, borrowed from the context's pool.
+        mailbox_t *mailbox;
 
         //  List of attached pipes.
         typedef array_t<pipe_t, 3> pipes_t;
@@ -270,9 +399,44 @@ namespace zmq {
         // Bitmask of events being monitored
         int monitor_events;
 
+        //  Ring of structured monitor records and the events it receives.
+        //  I/O threads may be writing to the ring at any time, so it is
+        //  only deallocated together with the socket.
+        monitor_ring_t *monitor_ring;
+        int monitor_ring_events;
+
         // Last socket endpoint resolved URI
         std::string last_endpoint;
 
+        //  Keys sealing CURVE resumption tickets, shared by all sessions.
+        curve_ticket_keys_t curve_ticket_keys;
+
+        //  Statistics owned by the application thread. Messages are
+        //  counted once complete, bytes for every part. The size of the
+        //  parts sent or received so far is kept until the last part.
+        uint64_t msgs_sent;
+        uint64_t bytes_sent;
+        uint64_t msgs_received;
+        uint64_t bytes_received;
+        uint64_t hwm_blocked;
+        uint64_t dropped;
+        uint64_t commands;
+
+        //  Engine statistics, updated from the I/O threads.
+        uint64_t engine_bytes_in;
+        uint64_t engine_bytes_out;
+        uint64_t engine_reads;
+        uint64_t engine_writes;
+        mutex_t stats_sync;
+
+        //  Latency tracing, see ZMQ_TRACE.
+        tracer_t tracer;
+
+        //  Whether the pipes are shared with an I/O thread, and the lock
+        //  serialising their use if so.
+        bool pipes_shared;
+        mutex_t pipes_sync;
+
         socket_base_t(const socket_base_t &);
 
         const socket_base_t &operator=(const socket_base_t &);
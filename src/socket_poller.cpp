@@ -0,0 +1,478 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "platform.hpp"
+
+#if defined ZMQ_HAVE_LINUX
+#include <sys/epoll.h>
+#else
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+#include <unistd.h>
+#include <string.h>
+#include <new>
+
+#include "socket_poller.hpp"
+#include "socket_base.hpp"
+#include "clock.hpp"
+#include "config.hpp"
+#include "err.hpp"
+#include "../include/zmq.h"
+
+//  NetBSD defines (struct kevent).udata as intptr_t, everyone else
+//  as void *.
+#if defined ZMQ_HAVE_NETBSD
+#define kevent_udata_t intptr_t
+#else
+#define kevent_udata_t void *
+#endif
+
+zmq::socket_poller_t::socket_poller_t() :
+        tag(0xdecafbad),
+        generation(0) {
+#if defined ZMQ_HAVE_LINUX
+    poll_fd = epoll_create(1);
+#else
+    poll_fd = kqueue();
+#endif
+    errno_assert (poll_fd != -1);
+}
+
+zmq::socket_poller_t::~socket_poller_t() {
+    //  Mark the poller as dead.
+    tag = 0xdeadbeef;
+
+    for (sockets_t::iterator it = sockets.begin(); it != sockets.end(); ++it)
+        delete it->second;
+    for (fds_t::iterator it = fds.begin(); it != fds.end(); ++it)
+        delete it->second;
+    close(poll_fd);
+}
+
+bool zmq::socket_poller_t::check_tag() {
+    return tag == 0xdecafbad;
+}
+
+int zmq::socket_poller_t::add(socket_base_t *socket_, void *user_data_,
+                              short events_) {
+    if (sockets.find(socket_) != sockets.end()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    //  Sockets are polled for their ZMQ_FD; the actual events are then
+    //  retrieved using ZMQ_EVENTS.
+    fd_t fd;
+    size_t fd_size = sizeof(fd);
+    int rc = socket_->getsockopt(ZMQ_FD, &fd, &fd_size);
+    if (rc != 0)
+        return -1;
+
+    item_t *item = new(std::nothrow) item_t;
+    alloc_assert (item);
+    item->socket = socket_;
+    item->fd = fd;
+    item->user_data = user_data_;
+    item->events = events_;
+    item->pending = false;
+    item->out_generation = 0;
+    item->out_index = 0;
+
+    rc = register_item(item);
+    if (rc != 0) {
+        delete item;
+        return -1;
+    }
+    sockets.insert(sockets_t::value_type(socket_, item));
+
+    //  The socket may have events already and ZMQ_FD won't tell us.
+    item->pending = true;
+    pending.push_back(item);
+    return 0;
+}
+
+int zmq::socket_poller_t::modify(socket_base_t *socket_, short events_) {
+    sockets_t::iterator it = sockets.find(socket_);
+    if (it == sockets.end()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    item_t *item = it->second;
+    item->events = events_;
+    if (!item->pending) {
+        item->pending = true;
+        pending.push_back(item);
+    }
+    return 0;
+}
+
+int zmq::socket_poller_t::remove(socket_base_t *socket_) {
+    sockets_t::iterator it = sockets.find(socket_);
+    if (it == sockets.end()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    item_t *item = it->second;
+    sockets.erase(it);
+    unregister_item(item);
+    erase_pending(item);
+    delete item;
+    return 0;
+}
+
+int zmq::socket_poller_t::add_fd(fd_t fd_, void *user_data_, short events_) {
+    if (fds.find(fd_) != fds.end()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    item_t *item = new(std::nothrow) item_t;
+    alloc_assert (item);
+    item->socket = NULL;
+    item->fd = fd_;
+    item->user_data = user_data_;
+    item->events = events_;
+    item->pending = false;
+    item->out_generation = 0;
+    item->out_index = 0;
+
+    int rc = register_item(item);
+    if (rc != 0) {
+        delete item;
+        return -1;
+    }
+    fds.insert(fds_t::value_type(fd_, item));
+    return 0;
+}
+
+int zmq::socket_poller_t::modify_fd(fd_t fd_, short events_) {
+    fds_t::iterator it = fds.find(fd_);
+    if (it == fds.end()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    item_t *item = it->second;
+    short old_events = item->events;
+    item->events = events_;
+    int rc = reregister_item(item, old_events);
+    if (rc != 0) {
+        item->events = old_events;
+        return -1;
+    }
+    return 0;
+}
+
+int zmq::socket_poller_t::remove_fd(fd_t fd_) {
+    fds_t::iterator it = fds.find(fd_);
+    if (it == fds.end()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    item_t *item = it->second;
+    fds.erase(it);
+    unregister_item(item);
+    delete item;
+    return 0;
+}
+
+int zmq::socket_poller_t::wait(event_t *events_, int n_events_,
+                               long timeout_) {
+    if (n_events_ <= 0 || !events_) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    generation++;
+    int found = 0;
+
+    zmq::clock_t clock;
+    uint64_t now = 0;
+    uint64_t end = 0;
+    bool first_pass = true;
+
+    while (true) {
+        //  Compute the timeout for the subsequent wait.
+        int timeout;
+        if (first_pass)
+            timeout = 0;
+        else if (timeout_ < 0)
+            timeout = -1;
+        else
+            timeout = (int) (end - now);
+
+        int rc = wait_os(timeout, events_, n_events_, found);
+        if (rc != 0)
+            return -1;
+        rc = check_pending(events_, n_events_, found);
+        if (rc != 0)
+            return -1;
+
+        //  If there are events to return, or the timeout is zero, we can
+        //  exit immediately.
+        if (found || timeout_ == 0)
+            return found;
+
+        //  If timeout is infinite we can just loop until we get some events.
+        if (timeout_ < 0) {
+            first_pass = false;
+            continue;
+        }
+
+        //  The timeout is finite and there are no events. In the first pass
+        //  we compute the time when the polling should time out.
+        if (first_pass) {
+            now = clock.now_ms();
+            end = now + timeout_;
+            if (now == end)
+                return 0;
+            first_pass = false;
+            continue;
+        }
+
+        //  Find out whether timeout have expired.
+        now = clock.now_ms();
+        if (now >= end)
+            return 0;
+    }
+}
+
+bool zmq::socket_poller_t::emit(item_t *item_, short revents_,
+                                event_t *events_, int n_events_, int &found_) {
+    //  The item is reported already; merge the events.
+    if (item_->out_generation == generation) {
+        events_[item_->out_index].events |= revents_;
+        return true;
+    }
+
+    if (found_ == n_events_)
+        return false;
+
+    item_->out_generation = generation;
+    item_->out_index = found_;
+    event_t &event = events_[found_++];
+    event.socket = item_->socket;
+    event.fd = item_->socket ? retired_fd : item_->fd;
+    event.user_data = item_->user_data;
+    event.events = revents_;
+    return true;
+}
+
+int zmq::socket_poller_t::check_pending(event_t *events_, int n_events_,
+                                        int &found_) {
+    //  Ready sockets that were reported are moved to the end of the list
+    //  so that they don't starve the others when events_ is too small
+    //  to hold all of them.
+    reported.clear();
+    size_t kept = 0;
+    int rc = 0;
+
+    size_t i = 0;
+    for (; i != pending.size(); i++) {
+        item_t *item = pending[i];
+        uint32_t zmq_events;
+        size_t zmq_events_size = sizeof(zmq_events);
+        rc = item->socket->getsockopt(ZMQ_EVENTS, &zmq_events,
+                                      &zmq_events_size);
+        if (rc != 0)
+            break;
+
+        short revents = (short) (zmq_events & item->events &
+                                 (ZMQ_POLLIN | ZMQ_POLLOUT));
+        if (!revents) {
+            item->pending = false;
+            continue;
+        }
+
+        if (emit(item, revents, events_, n_events_, found_))
+            reported.push_back(item);
+        else
+            pending[kept++] = item;
+    }
+
+    //  On error, the unchecked sockets stay candidates.
+    for (; i != pending.size(); i++)
+        pending[kept++] = pending[i];
+
+    pending.resize(kept);
+    pending.insert(pending.end(), reported.begin(), reported.end());
+    return rc;
+}
+
+void zmq::socket_poller_t::erase_pending(item_t *item_) {
+    if (!item_->pending)
+        return;
+    for (pending_t::iterator it = pending.begin(); it != pending.end(); ++it)
+        if (*it == item_) {
+            pending.erase(it);
+            break;
+        }
+    item_->pending = false;
+}
+
+#if defined ZMQ_HAVE_LINUX
+
+int zmq::socket_poller_t::register_item(item_t *item_) {
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    if (item_->socket)
+        ev.events = EPOLLIN;
+    else {
+        if (item_->events & ZMQ_POLLIN)
+            ev.events |= EPOLLIN;
+        if (item_->events & ZMQ_POLLOUT)
+            ev.events |= EPOLLOUT;
+    }
+    ev.data.ptr = item_;
+    return epoll_ctl(poll_fd, EPOLL_CTL_ADD, item_->fd, &ev);
+}
+
+int zmq::socket_poller_t::reregister_item(item_t *item_, short) {
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    if (item_->events & ZMQ_POLLIN)
+        ev.events |= EPOLLIN;
+    if (item_->events & ZMQ_POLLOUT)
+        ev.events |= EPOLLOUT;
+    ev.data.ptr = item_;
+    return epoll_ctl(poll_fd, EPOLL_CTL_MOD, item_->fd, &ev);
+}
+
+void zmq::socket_poller_t::unregister_item(item_t *item_) {
+    //  The descriptor may be closed already, in which case the kernel
+    //  has dropped it from the set itself.
+    epoll_event ev;
+    epoll_ctl(poll_fd, EPOLL_CTL_DEL, item_->fd, &ev);
+}
+
+int zmq::socket_poller_t::wait_os(int timeout_, event_t *events_,
+                                  int n_events_, int &found_) {
+    epoll_event ev_buf[max_io_events];
+    int n = epoll_wait(poll_fd, &ev_buf[0], max_io_events, timeout_);
+    if (n == -1) {
+        errno_assert (errno == EINTR);
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        item_t *item = (item_t *) ev_buf[i].data.ptr;
+        if (item->socket) {
+            if (!item->pending) {
+                item->pending = true;
+                pending.push_back(item);
+            }
+            continue;
+        }
+        short revents = 0;
+        if (ev_buf[i].events & EPOLLIN)
+            revents |= ZMQ_POLLIN;
+        if (ev_buf[i].events & EPOLLOUT)
+            revents |= ZMQ_POLLOUT;
+        if (ev_buf[i].events & (EPOLLERR | EPOLLHUP))
+            revents |= ZMQ_POLLERR;
+        emit(item, revents, events_, n_events_, found_);
+    }
+    return 0;
+}
+
+#else
+
+int zmq::socket_poller_t::register_item(item_t *item_) {
+    struct kevent ev[2];
+    int n = 0;
+    if (item_->socket || (item_->events & ZMQ_POLLIN))
+        EV_SET(&ev[n++], item_->fd, EVFILT_READ, EV_ADD, 0, 0,
+               (kevent_udata_t) item_);
+    if (!item_->socket && (item_->events & ZMQ_POLLOUT))
+        EV_SET(&ev[n++], item_->fd, EVFILT_WRITE, EV_ADD, 0, 0,
+               (kevent_udata_t) item_);
+    if (n == 0)
+        return 0;
+    return kevent(poll_fd, ev, n, NULL, 0, NULL) == -1 ? -1 : 0;
+}
+
+int zmq::socket_poller_t::reregister_item(item_t *item_, short old_events_) {
+    struct kevent ev[2];
+    int n = 0;
+    if ((item_->events ^ old_events_) & ZMQ_POLLIN)
+        EV_SET(&ev[n++], item_->fd, EVFILT_READ,
+               item_->events & ZMQ_POLLIN ? EV_ADD : EV_DELETE, 0, 0,
+               (kevent_udata_t) item_);
+    if ((item_->events ^ old_events_) & ZMQ_POLLOUT)
+        EV_SET(&ev[n++], item_->fd, EVFILT_WRITE,
+               item_->events & ZMQ_POLLOUT ? EV_ADD : EV_DELETE, 0, 0,
+               (kevent_udata_t) item_);
+    if (n == 0)
+        return 0;
+    return kevent(poll_fd, ev, n, NULL, 0, NULL) == -1 ? -1 : 0;
+}
+
+void zmq::socket_poller_t::unregister_item(item_t *item_) {
+    //  The descriptor may be closed already, in which case the kernel
+    //  has dropped the filters itself.
+    struct kevent ev;
+    if (item_->socket || (item_->events & ZMQ_POLLIN)) {
+        EV_SET(&ev, item_->fd, EVFILT_READ, EV_DELETE, 0, 0, 0);
+        kevent(poll_fd, &ev, 1, NULL, 0, NULL);
+    }
+    if (!item_->socket && (item_->events & ZMQ_POLLOUT)) {
+        EV_SET(&ev, item_->fd, EVFILT_WRITE, EV_DELETE, 0, 0, 0);
+        kevent(poll_fd, &ev, 1, NULL, 0, NULL);
+    }
+}
+
+int zmq::socket_poller_t::wait_os(int timeout_, event_t *events_,
+                                  int n_events_, int &found_) {
+    timespec ts = {timeout_ / 1000, (timeout_ % 1000) * 1000000};
+    struct kevent ev_buf[max_io_events];
+    int n = kevent(poll_fd, NULL, 0, &ev_buf[0], max_io_events,
+                   timeout_ >= 0 ? &ts : NULL);
+    if (n == -1) {
+        errno_assert (errno == EINTR);
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        item_t *item = (item_t *) ev_buf[i].udata;
+        if (item->socket) {
+            if (!item->pending) {
+                item->pending = true;
+                pending.push_back(item);
+            }
+            continue;
+        }
+        short revents = 0;
+        if (ev_buf[i].flags & EV_ERROR)
+            revents |= ZMQ_POLLERR;
+        else if (ev_buf[i].filter == EVFILT_READ)
+            revents |= ZMQ_POLLIN;
+        else if (ev_buf[i].filter == EVFILT_WRITE)
+            revents |= ZMQ_POLLOUT;
+        emit(item, revents, events_, n_events_, found_);
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,145 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ZMQ_SOCKET_POLLER_HPP_INCLUDED__
+#define __ZMQ_SOCKET_POLLER_HPP_INCLUDED__
+
+#include <map>
+#include <vector>
+
+#include "fd.hpp"
+#include "stdint.hpp"
+
+namespace zmq {
+
+    class socket_base_t;
+
+    //  Persistent set of 0MQ sockets and raw file descriptors backing
+    //  the zmq_poller_* API. Unlike zmq_poll, the items are registered
+    //  with the OS poller (epoll on Linux, kqueue elsewhere) only once
+    //  and ZMQ_EVENTS is queried only for the sockets whose ZMQ_FD has
+    //  fired or that were found ready on the previous call, so the cost
+    //  of a wait depends on the number of ready items rather than on the
+    //  size of the set. Not thread-safe, same as the sockets themselves.
+
+    class socket_poller_t {
+    public:
+
+        socket_poller_t();
+
+        ~socket_poller_t();
+
+        //  Returns false if object is not a poller.
+        bool check_tag();
+
+        struct event_t {
+            socket_base_t *socket;
+            fd_t fd;
+            void *user_data;
+            short events;
+        };
+
+        int add(socket_base_t *socket_, void *user_data_, short events_);
+
+        int modify(socket_base_t *socket_, short events_);
+
+        int remove(socket_base_t *socket_);
+
+        int add_fd(fd_t fd_, void *user_data_, short events_);
+
+        int modify_fd(fd_t fd_, short events_);
+
+        int remove_fd(fd_t fd_);
+
+        //  Fills in up to n_events_ ready items and returns their number.
+        //  Returns 0 if the timeout expired, -1 on error.
+        int wait(event_t *events_, int n_events_, long timeout_);
+
+    private:
+
+        struct item_t {
+            socket_base_t *socket;
+            fd_t fd;
+            void *user_data;
+            short events;
+
+            //  True if the item is a socket on the list of candidates.
+            bool pending;
+
+            //  Position of the item in the output of the current wait,
+            //  valid if out_generation matches the poller's generation.
+            uint64_t out_generation;
+            int out_index;
+        };
+
+        //  Registers, re-registers and unregisters the file descriptor of
+        //  the item with the OS poller.
+        int register_item(item_t *item_);
+        int reregister_item(item_t *item_, short old_events_);
+        void unregister_item(item_t *item_);
+
+        //  Waits for the OS poller. Raw file descriptors that fired are
+        //  reported straight away, sockets become candidates.
+        int wait_os(int timeout_, event_t *events_, int n_events_,
+                    int &found_);
+
+        //  Adds events of the item to the output of the current wait.
+        //  Returns false if there's no room left.
+        bool emit(item_t *item_, short revents_, event_t *events_,
+                  int n_events_, int &found_);
+
+        //  Checks the candidate sockets. Those that are ready are reported
+        //  and stay candidates; the rest are dropped until their ZMQ_FD
+        //  signals again.
+        int check_pending(event_t *events_, int n_events_, int &found_);
+
+        void erase_pending(item_t *item_);
+
+        //  Used to check whether the object is a poller.
+        uint32_t tag;
+
+        //  epoll or kqueue file descriptor.
+        fd_t poll_fd;
+
+        typedef std::map<socket_base_t *, item_t *> sockets_t;
+        sockets_t sockets;
+
+        typedef std::map<fd_t, item_t *> fds_t;
+        fds_t fds;
+
+        //  Sockets that may have events to report.
+        typedef std::vector<item_t *> pending_t;
+        pending_t pending;
+
+        //  Candidates reported by the current wait. Kept as a member so
+        //  that waits do not allocate.
+        pending_t reported;
+
+        //  Incremented with each wait.
+        uint64_t generation;
+
+        socket_poller_t(const socket_poller_t &);
+
+        const socket_poller_t &operator=(const socket_poller_t &);
+    };
+
+}
+
+#endif
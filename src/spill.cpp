@@ -0,0 +1,238 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "platform.hpp"
+
+#if !defined ZMQ_HAVE_WINDOWS
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <stdlib.h>
+#endif
+
+#include <string.h>
+#include <vector>
+
+#include "spill.hpp"
+#include "err.hpp"
+#include "wire.hpp"
+
+namespace zmq {
+
+    //  Records start with the size and the flags of the message. A size
+    //  of all ones marks the rest of the segment as unused.
+    enum {
+        spill_header_size = 8,
+        spill_wrap = 0xffffffff
+    };
+
+}
+
+zmq::spill_t::spill_t(const std::string &dir_, int64_t size_, int hwm_) :
+        memory_msgs(0),
+        dir(dir_),
+        size(0),
+        hwm(hwm_),
+        segment(NULL),
+        segment_failed(false),
+        head(0),
+        tail(0),
+        used(0),
+        has_stalled(false) {
+    //  Keep the records aligned to the header size.
+    if (size_ > 0 && (uint64_t) size_ <= (uint64_t) (size_t) -1)
+        size = (size_t) size_ & ~((size_t) spill_header_size - 1);
+    if (size < 2 * spill_header_size)
+        segment_failed = true;
+
+    int rc = stalled.init();
+    errno_assert (rc == 0);
+}
+
+zmq::spill_t::~spill_t() {
+    while (!memory.empty()) {
+        int rc = memory.front().close();
+        errno_assert (rc == 0);
+        memory.pop_front();
+    }
+    int rc = stalled.close();
+    errno_assert (rc == 0);
+
+#if !defined ZMQ_HAVE_WINDOWS
+    if (segment) {
+        rc = munmap(segment, size);
+        errno_assert (rc == 0);
+    }
+#endif
+}
+
+void zmq::spill_t::push(msg_t *msg_) {
+    zmq_assert (!has_stalled);
+
+    //  Memory takes messages until the watermark is reached; once the
+    //  segment is in use, it takes all of them to keep the order.
+    if (used == 0 && (hwm <= 0 || memory_msgs < hwm)) {
+        if (!(msg_->flags() & msg_t::more))
+            memory_msgs++;
+        memory.push_back(*msg_);
+    }
+    else if (!write_segment(msg_)) {
+        int rc = stalled.move(*msg_);
+        errno_assert (rc == 0);
+        has_stalled = true;
+    }
+    else {
+        int rc = msg_->close();
+        errno_assert (rc == 0);
+    }
+
+    int rc = msg_->init();
+    errno_assert (rc == 0);
+}
+
+bool zmq::spill_t::pull(msg_t *msg_) {
+    if (!memory.empty()) {
+        int rc = msg_->move(memory.front());
+        errno_assert (rc == 0);
+        memory.pop_front();
+        if (!(msg_->flags() & msg_t::more))
+            memory_msgs--;
+        return true;
+    }
+
+    if (used > 0) {
+        read_segment(msg_);
+        return true;
+    }
+
+    if (has_stalled) {
+        int rc = msg_->move(stalled);
+        errno_assert (rc == 0);
+        has_stalled = false;
+        return true;
+    }
+
+    return false;
+}
+
+bool zmq::spill_t::empty() {
+    return memory.empty() && used == 0 && !has_stalled;
+}
+
+bool zmq::spill_t::full() {
+    return has_stalled;
+}
+
+bool zmq::spill_t::open_segment() {
+#if defined ZMQ_HAVE_WINDOWS
+    segment_failed = true;
+    return false;
+#else
+    const std::string name = dir + "/zmq-spill-XXXXXX";
+    std::vector<char> path(name.begin(), name.end());
+    path.push_back(0);
+    const int fd = mkstemp(&path[0]);
+    if (fd == -1) {
+        segment_failed = true;
+        return false;
+    }
+
+    //  Nobody else is to find the file.
+    int rc = unlink(&path[0]);
+    errno_assert (rc == 0);
+
+    void *area = MAP_FAILED;
+    rc = ftruncate(fd, (off_t) size);
+    if (rc == 0)
+        area = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    rc = close(fd);
+    errno_assert (rc == 0);
+    if (area == MAP_FAILED) {
+        segment_failed = true;
+        return false;
+    }
+
+    segment = (unsigned char *) area;
+    return true;
+#endif
+}
+
+bool zmq::spill_t::write_segment(msg_t *msg_) {
+    if (!segment && (segment_failed || !open_segment()))
+        return false;
+
+    const size_t len = spill_header_size +
+        ((msg_->size() + spill_header_size - 1) & ~((size_t) spill_header_size - 1));
+    if (msg_->size() >= spill_wrap || len > size)
+        return false;
+
+    if (used == 0)
+        head = tail = 0;
+
+    //  Records are never split. If the record doesn't fit at the end of
+    //  the segment, the rest of it is skipped.
+    if (tail >= head && used != size) {
+        if (size - tail < len) {
+            if (head < len)
+                return false;
+            put_uint32(segment + tail, spill_wrap);
+            used += size - tail;
+            tail = 0;
+        }
+    }
+    else if (head - tail < len)
+        return false;
+
+    put_uint32(segment + tail, (uint32_t) msg_->size());
+    put_uint32(segment + tail + 4,
+               msg_->flags() & (msg_t::more | msg_t::command));
+    memcpy(segment + tail + spill_header_size, msg_->data(), msg_->size());
+    tail += len;
+    if (tail == size)
+        tail = 0;
+    used += len;
+    return true;
+}
+
+void zmq::spill_t::read_segment(msg_t *msg_) {
+    zmq_assert (used > 0);
+
+    uint32_t msg_size = get_uint32(segment + head);
+    if (msg_size == spill_wrap) {
+        used -= size - head;
+        head = 0;
+        msg_size = get_uint32(segment + head);
+    }
+    const uint32_t flags = get_uint32(segment + head + 4);
+
+    int rc = msg_->close();
+    errno_assert (rc == 0);
+    rc = msg_->init_size(msg_size);
+    errno_assert (rc == 0);
+    memcpy(msg_->data(), segment + head + spill_header_size, msg_size);
+    msg_->set_flags((unsigned char) flags);
+
+    const size_t len = spill_header_size +
+        ((msg_size + spill_header_size - 1) & ~((size_t) spill_header_size - 1));
+    head += len;
+    if (head == size)
+        head = 0;
+    used -= len;
+}
@@ -0,0 +1,97 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ZMQ_SPILL_HPP_INCLUDED__
+#define __ZMQ_SPILL_HPP_INCLUDED__
+
+#include <deque>
+#include <string>
+#include <stddef.h>
+
+#include "stdint.hpp"
+#include "msg.hpp"
+
+namespace zmq {
+
+    //  Queue of messages a session holds while it is disconnected from
+    //  its peer (ZMQ_SPILL_DIR). The first 'hwm' messages are kept in
+    //  memory, messages past that are appended to a segment file mapped
+    //  into memory. The file is unlinked straight away, so it goes away
+    //  with the process. A message that doesn't fit into the segment is
+    //  held back and the queue is full until it is read.
+
+    class spill_t {
+    public:
+
+        spill_t(const std::string &dir_, int64_t size_, int hwm_);
+
+        ~spill_t();
+
+        //  Takes the message over; the message is left empty.
+        void push(msg_t *msg_);
+
+        //  Fetches the oldest message. Returns false if there is none.
+        bool pull(msg_t *msg_);
+
+        bool empty();
+
+        //  True if no more messages are to be pushed.
+        bool full();
+
+    private:
+
+        //  Creates the segment file. Returns false if it can't be done.
+        bool open_segment();
+
+        //  Appends the message to the segment. Returns false if there
+        //  is not enough space.
+        bool write_segment(msg_t *msg_);
+
+        void read_segment(msg_t *msg_);
+
+        //  Messages held in memory and the number of them complete.
+        std::deque<msg_t> memory;
+        int memory_msgs;
+
+        std::string dir;
+        size_t size;
+        int hwm;
+
+        //  The segment, a ring of records, or NULL if not created yet.
+        //  Each record is a header with the size and the flags of the
+        //  message followed by its data, padded to the header alignment.
+        unsigned char *segment;
+        bool segment_failed;
+        size_t head;
+        size_t tail;
+        size_t used;
+
+        //  Message that didn't fit into the segment.
+        msg_t stalled;
+        bool has_stalled;
+
+        spill_t(const spill_t &);
+
+        const spill_t &operator=(const spill_t &);
+    };
+
+}
+
+#endif
@@ -29,6 +29,7 @@
 #endif
 
 #include <string.h>
+#include <algorithm>
 #include <new>
 
 #include "stream_engine.hpp"
@@ -40,10 +41,13 @@
 #include "v2_decoder.hpp"
 #include "null_mechanism.hpp"
 #include "plain_mechanism.hpp"
+#include "curve_client.hpp"
+#include "curve_server.hpp"
 #include "raw_decoder.hpp"
 #include "raw_encoder.hpp"
 #include "ip.hpp"
 #include "wire.hpp"
+#include "clock.hpp"
 
 zmq::stream_engine_t::stream_engine_t(fd_t fd_, const options_t &options_,
                                       const std::string &endpoint_) :
@@ -68,7 +72,27 @@ zmq::stream_engine_t::stream_engine_t(fd_t fd_, const options_t &options_,
         mechanism(NULL),
         input_stopped(false),
         output_stopped(false),
-        socket(NULL) {
+        socket(NULL),
+        handshake_started(0),
+        has_stats_timer(false),
+        tracer(NULL),
+        trace_read_tsc(0),
+        trace_countdown(0),
+        trace_writing(false),
+        trace_pushing(false),
+        has_heartbeat_ivl_timer(false),
+        has_heartbeat_timeout_timer(false),
+        has_heartbeat_ttl_timer(false),
+        heartbeat_timeout_bytes_in(0),
+        heartbeat_ttl_bytes_in(0),
+        ping_pending(false),
+        pong_pending(false),
+        pong_context_size(0),
+        next_read_msg(NULL),
+        tx_more(false) {
+    memset(&stats, 0, sizeof(stats));
+    memset(&unpublished, 0, sizeof(unpublished));
+
     int rc = tx_msg.init();
     errno_assert (rc == 0);
 
@@ -104,6 +128,12 @@ zmq::stream_engine_t::~stream_engine_t() {
     int rc = tx_msg.close();
     errno_assert (rc == 0);
 
+    while (!unsent.empty()) {
+        rc = unsent.front().msg.close();
+        errno_assert (rc == 0);
+        unsent.pop_front();
+    }
+
     delete encoder;
     delete decoder;
     delete mechanism;
@@ -119,10 +149,12 @@ void zmq::stream_engine_t::plug(io_thread_t *io_thread_,
     zmq_assert (session_);
     session = session_;
     socket = session->get_socket();
+    tracer = socket->get_tracer();
 
     //  Connect to I/O threads poller object.
     // 获取io_thread的poller
     io_object_t::plug(io_thread_);
+    handshake_started = clock_t::now_us();
     
     // 和当前socket对应的handle，直接处理网络数据
     handle = add_fd(s);
@@ -169,6 +201,25 @@ void zmq::stream_engine_t::unplug() {
     if (!io_error)
         rm_fd(handle);
 
+    if (has_stats_timer) {
+        cancel_timer(stats_timer);
+        has_stats_timer = false;
+    }
+    publish_stats();
+
+    if (has_heartbeat_ivl_timer) {
+        cancel_timer(heartbeat_ivl_timer);
+        has_heartbeat_ivl_timer = false;
+    }
+    if (has_heartbeat_timeout_timer) {
+        cancel_timer(heartbeat_timeout_timer);
+        has_heartbeat_timeout_timer = false;
+    }
+    if (has_heartbeat_ttl_timer) {
+        cancel_timer(heartbeat_ttl_timer);
+        has_heartbeat_ttl_timer = false;
+    }
+
     //  Disconnect from I/O threads poller object.
     io_object_t::unplug();
 
@@ -223,6 +274,10 @@ void zmq::stream_engine_t::in_event() {
 
         //  Adjust input size
         insize = static_cast <size_t> (rc);
+        stats.bytes_in += insize;
+        account_stats(insize, 0, 1, 0);
+        if (unlikely (tracer->enabled()))
+            trace_read_tsc = tracer_t::now();
     }
 
     int rc = 0;
@@ -235,11 +290,18 @@ void zmq::stream_engine_t::in_event() {
         insize -= processed; // 待处理的数据减少了
         if (rc == 0 || rc == -1)
             break;
-        
+
         // 将解码之后的数据写出去
+        if (unlikely (tracer->enabled()))
+            trace_decoded();
         rc = (this->*write_msg)(decoder->msg());
         if (rc == -1)
             break;
+        stats.msgs_in++;
+        if (unlikely (trace_pushing)) {
+            tracer->recv_pushed(tracer_t::now());
+            trace_pushing = false;
+        }
     }
 
     //  Tear down the connection if we have failed to decode input data
@@ -284,6 +346,12 @@ void zmq::stream_engine_t::out_event() {
             // 读取可能有的Msg
             if ((this->*read_msg)(&tx_msg) == -1)
                 break;
+            stats.msgs_out++;
+            if (unlikely (tx_msg.flags() & msg_t::trace_out)) {
+                tx_msg.reset_flags(msg_t::trace_out);
+                tracer->send_loaded(tracer_t::now());
+                trace_writing = true;
+            }
             
             // 编码数据
             encoder->load_msg(&tx_msg);
@@ -297,6 +365,10 @@ void zmq::stream_engine_t::out_event() {
             outsize += n;
         }
 
+        //  Once encoded, the position where the last message ends is known.
+        if (unlikely (!unsent.empty()) && encoder->message_done())
+            end_unsent();
+
         //  If there is no data to send, stop polling for output.
         // 可能有数据输入的时候就开始 polling
         if (outsize == 0) {
@@ -326,6 +398,18 @@ void zmq::stream_engine_t::out_event() {
 
     outpos += nbytes;
     outsize -= nbytes;
+    if (nbytes > 0) {
+        stats.bytes_out += nbytes;
+        account_stats(0, nbytes, 0, 1);
+        if (unlikely (!unsent.empty()))
+            release_unsent();
+    }
+
+    //  The batch holding the traced message is out.
+    if (unlikely (trace_writing) && outsize == 0) {
+        tracer->send_written(tracer_t::now());
+        trace_writing = false;
+    }
 
     //  If we are still handshaking and there are no data
     //  to send, stop polling for output.
@@ -362,6 +446,10 @@ void zmq::stream_engine_t::restart_input() {
             error();
         return;
     }
+    if (unlikely (trace_pushing)) {
+        tracer->recv_pushed(tracer_t::now());
+        trace_pushing = false;
+    }
 
     while (insize > 0) {
         size_t processed = 0;
@@ -371,9 +459,15 @@ void zmq::stream_engine_t::restart_input() {
         insize -= processed;
         if (rc == 0 || rc == -1)
             break;
+        if (unlikely (tracer->enabled()))
+            trace_decoded();
         rc = (this->*write_msg)(decoder->msg());
         if (rc == -1)
             break;
+        if (unlikely (trace_pushing)) {
+            tracer->recv_pushed(tracer_t::now());
+            trace_pushing = false;
+        }
     }
 
     if (rc == -1 && errno == EAGAIN)
@@ -575,7 +669,8 @@ bool zmq::stream_engine_t::handshake() {
                 mechanism = new (std::nothrow)
                     curve_server_t (session, peer_address, options);
             else
-                mechanism = new (std::nothrow) curve_client_t (options);
+                mechanism = new (std::nothrow)
+                    curve_client_t (session, options);
             alloc_assert (mechanism);
         }
 #endif
@@ -595,6 +690,11 @@ bool zmq::stream_engine_t::handshake() {
     //  Switch into the normal message flow.
     handshaking = false;
 
+    //  Without a security mechanism the connection is ready right away.
+    if (!mechanism)
+        socket->event_handshake_succeeded(endpoint, s, peer_address, ZMQ_NULL, false,
+                                          clock_t::now_us() - handshake_started);
+
     return true;
 }
 
@@ -671,7 +771,26 @@ void zmq::stream_engine_t::zap_msg_available() {
         restart_output();
 }
 
+void zmq::stream_engine_t::crypto_done() {
+    zmq_assert (mechanism != NULL);
+
+    const int rc = mechanism->crypto_done();
+    if (rc == -1) {
+        error();
+        return;
+    }
+    if (input_stopped)
+        restart_input();
+    if (output_stopped)
+        restart_output();
+}
+
 void zmq::stream_engine_t::mechanism_ready() {
+    socket->event_handshake_succeeded(endpoint, s, peer_address,
+                                      options.mechanism,
+                                      mechanism->is_resumed(),
+                                      clock_t::now_us() - handshake_started);
+
     if (options.recv_identity) {
         msg_t identity;
         mechanism->peer_identity(&identity);
@@ -688,13 +807,24 @@ void zmq::stream_engine_t::mechanism_ready() {
 
     read_msg = &stream_engine_t::pull_and_encode;
     write_msg = &stream_engine_t::decode_and_push;
+
+    if (options.heartbeat_ivl > 0) {
+        heartbeat_ivl_timer =
+            add_timer(options.heartbeat_ivl, heartbeat_ivl_timer_id);
+        has_heartbeat_ivl_timer = true;
+    }
 }
 
 //
 // 存在两个概念: session vs. socket, 其中session是服务器本地的状态, 存在缓存
 //
 int zmq::stream_engine_t::pull_msg_from_session(msg_t *msg_) {
-    return session->pull_msg(msg_);
+    if (session->pull_msg(msg_) == -1)
+        return -1;
+    tx_more = (msg_->flags() & msg_t::more) != 0;
+    if (unlikely (options.resend_unsent))
+        retain_unsent(msg_);
+    return 0;
 }
 
 
@@ -712,17 +842,36 @@ int zmq::stream_engine_t::pull_and_encode(msg_t *msg_) {
     // 从session中读取消息
     if (session->pull_msg(msg_) == -1)
         return -1;
+    tx_more = (msg_->flags() & msg_t::more) != 0;
+    //  What goes back to the session is the plain text.
+    if (unlikely (options.resend_unsent))
+        retain_unsent(msg_);
+    //  The mechanism builds a new message; keep it traced.
+    const bool traced = (msg_->flags() & msg_t::trace_out) != 0;
     // 然后解码?
     if (mechanism->encode(msg_) == -1)
         return -1;
+    if (traced)
+        msg_->set_flags(msg_t::trace_out);
     return 0;
 }
 
 int zmq::stream_engine_t::decode_and_push(msg_t *msg_) {
     zmq_assert (mechanism != NULL);
 
+    const bool traced = (msg_->flags() & msg_t::trace_in) != 0;
     if (mechanism->decode(msg_) == -1)
         return -1;
+
+    //  Heartbeats and other commands don't go to the session. They are
+    //  told apart only once the mechanism has authenticated them.
+    if (unlikely (msg_->flags() & msg_t::command)) {
+        trace_pushing = false;
+        process_command(msg_);
+        return 0;
+    }
+    if (traced)
+        msg_->set_flags(msg_t::trace_in);
     if (session->push_msg(msg_) == -1) {
         if (errno == EAGAIN)
             write_msg = &stream_engine_t::push_one_then_decode_and_push;
@@ -754,10 +903,198 @@ int zmq::stream_engine_t::write_subscription_msg(msg_t *msg_) {
     return push_msg_to_session(msg_);
 }
 
+void zmq::stream_engine_t::queue_heartbeat() {
+    if (read_msg != &stream_engine_t::produce_heartbeat) {
+        next_read_msg = read_msg;
+        read_msg = &stream_engine_t::produce_heartbeat;
+    }
+    if (output_stopped)
+        restart_output();
+}
+
+int zmq::stream_engine_t::produce_heartbeat(msg_t *msg_) {
+    //  Commands go between messages only.
+    if (tx_more)
+        return (this->*next_read_msg)(msg_);
+
+    //  A message pulled before is complete; the command doesn't belong
+    //  to it.
+    if (unlikely (!unsent.empty()))
+        end_unsent();
+
+    int rc;
+    unsigned char *data;
+    if (pong_pending) {
+        rc = msg_->init_size(5 + pong_context_size);
+        errno_assert (rc == 0);
+        data = (unsigned char *) msg_->data();
+        memcpy(data, "\4PONG", 5);
+        memcpy(data + 5, pong_context, pong_context_size);
+        pong_pending = false;
+    }
+    else {
+        zmq_assert (ping_pending);
+        rc = msg_->init_size(7);
+        errno_assert (rc == 0);
+        data = (unsigned char *) msg_->data();
+        memcpy(data, "\4PING", 5);
+        put_uint16(data + 5, (uint16_t) (options.heartbeat_ttl / 100));
+        ping_pending = false;
+    }
+    msg_->set_flags(msg_t::command);
+
+    if (!ping_pending && !pong_pending)
+        read_msg = next_read_msg;
+
+    //  Commands are protected by the mechanism like any other message.
+    return mechanism->encode(msg_);
+}
+
+void zmq::stream_engine_t::process_command(msg_t *msg_) {
+    const unsigned char *data = (const unsigned char *) msg_->data();
+    const size_t size = msg_->size();
+
+    //  PING: answer with a PONG carrying the same context and, if the
+    //  peer asks for it, give up on the connection when it falls silent
+    //  for the time to live. PONG and unknown commands need no action;
+    //  having read them is what counts.
+    if (size >= 7 && memcmp(data, "\4PING", 5) == 0) {
+        const int ttl = get_uint16(data + 5) * 100;
+        if (ttl > 0 && !has_heartbeat_ttl_timer) {
+            heartbeat_ttl_bytes_in = stats.bytes_in;
+            heartbeat_ttl_timer = add_timer(ttl, heartbeat_ttl_timer_id);
+            has_heartbeat_ttl_timer = true;
+        }
+        pong_context_size = std::min(size - 7, max_ping_context);
+        memcpy(pong_context, data + 7, pong_context_size);
+        pong_pending = true;
+        queue_heartbeat();
+    }
+
+    int rc = msg_->close();
+    errno_assert (rc == 0);
+    rc = msg_->init();
+    errno_assert (rc == 0);
+}
+
+void zmq::stream_engine_t::account_stats(uint64_t bytes_in_,
+                                         uint64_t bytes_out_,
+                                         uint64_t reads_, uint64_t writes_) {
+    unpublished.bytes_in += bytes_in_;
+    unpublished.bytes_out += bytes_out_;
+    unpublished.reads += reads_;
+    unpublished.writes += writes_;
+    if (!has_stats_timer) {
+        stats_timer = add_timer(engine_stats_ivl, stats_timer_id);
+        has_stats_timer = true;
+    }
+}
+
+void zmq::stream_engine_t::publish_stats() {
+    if (unpublished.reads || unpublished.writes)
+        socket->add_engine_stats(unpublished);
+}
+
+void zmq::stream_engine_t::timer_event(int id_) {
+    if (id_ == stats_timer_id) {
+        has_stats_timer = false;
+        publish_stats();
+        return;
+    }
+
+    if (id_ == heartbeat_ivl_timer_id) {
+        heartbeat_ivl_timer =
+            add_timer(options.heartbeat_ivl, heartbeat_ivl_timer_id);
+        if (!has_heartbeat_timeout_timer) {
+            heartbeat_timeout_bytes_in = stats.bytes_in;
+            heartbeat_timeout_timer =
+                add_timer(options.heartbeat_timeout == -1 ?
+                              options.heartbeat_ivl : options.heartbeat_timeout,
+                          heartbeat_timeout_timer_id);
+            has_heartbeat_timeout_timer = true;
+        }
+        ping_pending = true;
+        queue_heartbeat();
+        return;
+    }
+
+    //  While input is stopped nothing is read, so silence proves nothing.
+    if (id_ == heartbeat_timeout_timer_id) {
+        has_heartbeat_timeout_timer = false;
+        if (stats.bytes_in == heartbeat_timeout_bytes_in && !input_stopped)
+            error();
+        return;
+    }
+
+    zmq_assert (id_ == heartbeat_ttl_timer_id);
+    has_heartbeat_ttl_timer = false;
+    if (stats.bytes_in == heartbeat_ttl_bytes_in && !input_stopped)
+        error();
+}
+
+void zmq::stream_engine_t::trace_decoded() {
+    //  Messages of the handshake don't make it to the session.
+    if (write_msg != &stream_engine_t::push_msg_to_session &&
+        write_msg != &stream_engine_t::decode_and_push)
+        return;
+
+    if (tracer->sample_recv(trace_countdown, trace_read_tsc)) {
+        decoder->msg()->set_flags(msg_t::trace_in);
+        trace_pushing = true;
+    }
+}
+
+void zmq::stream_engine_t::retain_unsent(msg_t *msg_) {
+    //  The message loaded before has been encoded completely by now.
+    if (!unsent.empty())
+        end_unsent();
+
+    unsent.push_back(unsent_t());
+    unsent_t &u = unsent.back();
+    int rc = u.msg.init();
+    errno_assert (rc == 0);
+    rc = u.msg.copy(*msg_);
+    errno_assert (rc == 0);
+    u.msg.reset_flags(msg_t::trace_out);
+    u.end = unknown_end;
+}
+
+void zmq::stream_engine_t::end_unsent() {
+    if (unsent.back().end == unknown_end)
+        unsent.back().end = stats.bytes_out + outsize;
+}
+
+void zmq::stream_engine_t::release_unsent() {
+    //  Multi-part messages are dropped as a whole, once the last part
+    //  is out, so that the peer gets them whole after a reconnect.
+    while (true) {
+        size_t last = 0;
+        while (last < unsent.size() && (unsent[last].msg.flags() & msg_t::more))
+            last++;
+        if (last == unsent.size() || unsent[last].end > stats.bytes_out)
+            return;
+        for (size_t i = 0; i <= last; i++) {
+            int rc = unsent.front().msg.close();
+            errno_assert (rc == 0);
+            unsent.pop_front();
+        }
+    }
+}
+
+void zmq::stream_engine_t::return_unsent() {
+    release_unsent();
+    while (!unsent.empty()) {
+        session->return_msg(&unsent.back().msg);
+        unsent.pop_back();
+    }
+}
+
 void zmq::stream_engine_t::error() {
     zmq_assert (session);
-    socket->event_disconnected(endpoint, s);
+    socket->event_disconnected(endpoint, s, peer_address, stats);
     session->flush();
+    if (unlikely (!unsent.empty()))
+        return_unsent();
     session->detach();
     unplug();
     delete this;
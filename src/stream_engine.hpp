@@ -21,12 +21,14 @@
 #define __ZMQ_STREAM_ENGINE_HPP_INCLUDED__
 
 #include <stddef.h>
+#include <deque>
 
 #include "fd.hpp"
 #include "i_engine.hpp"
 #include "io_object.hpp"
 #include "i_encoder.hpp"
 #include "i_decoder.hpp"
+#include "msg.hpp"
 #include "options.hpp"
 #include "socket_base.hpp"
 #include "../include/zmq.h"
@@ -69,11 +71,15 @@ namespace zmq {
 
         void zap_msg_available();
 
+        void crypto_done();
+
         //  i_poll_events interface implementation.
         void in_event();
 
         void out_event();
 
+        void timer_event(int id_);
+
     private:
 
         //  Unplug the engine from the session.
@@ -120,6 +126,40 @@ namespace zmq {
 
         int write_subscription_msg(msg_t *msg_);
 
+        //  Counts traffic for ZMQ_STATS, making sure it gets reported to
+        //  the socket within engine_stats_ivl.
+        void account_stats(uint64_t bytes_in_, uint64_t bytes_out_,
+                           uint64_t reads_, uint64_t writes_);
+
+        //  Reports the traffic counted so far to the socket.
+        void publish_stats();
+
+        //  Makes the next message sent a PING or PONG command.
+        void queue_heartbeat();
+
+        //  Produces the pending heartbeat command once the message being
+        //  sent is complete, then goes back to the regular read_msg.
+        int produce_heartbeat(msg_t *msg_);
+
+        //  Handles a command received after the handshake.
+        void process_command(msg_t *msg_);
+
+        //  Decides whether the decoded message is to be traced.
+        void trace_decoded();
+
+        //  Keeps a copy of a message pulled from the session till it is
+        //  written completely, for ZMQ_RESEND_UNSENT.
+        void retain_unsent(msg_t *msg_);
+
+        //  Notes where the last message pulled ends in the byte stream.
+        void end_unsent();
+
+        //  Drops the copies of the messages written completely.
+        void release_unsent();
+
+        //  Hands the messages not written completely back to the session.
+        void return_unsent();
+
         size_t add_property(unsigned char *ptr,
                             const char *name, const void *value, size_t value_len);
 
@@ -198,6 +238,71 @@ namespace zmq {
 
         std::string peer_address;
 
+        //  When the engine was plugged, to time the handshake.
+        uint64_t handshake_started;
+
+        //  Traffic of the connection, for the monitor.
+        connection_stats_t stats;
+
+        //  Traffic not reported to the socket yet, and the timer to report
+        //  it, if it is running.
+        enum {stats_timer_id = 0x83};
+        engine_stats_t unpublished;
+        bool has_stats_timer;
+        timer_handle_t stats_timer;
+
+        //  Latency tracing: the tracer of the socket, when the data being
+        //  decoded was read, messages to be decoded before the next one is
+        //  traced and whether a traced message is waiting to be written to
+        //  the socket or pushed to the session.
+        tracer_t *tracer;
+        uint64_t trace_read_tsc;
+        int trace_countdown;
+        bool trace_writing;
+        bool trace_pushing;
+
+        //  Copy of a message pulled from the session and the number of
+        //  bytes written to the socket once it is out. The end is unknown
+        //  till the message has been encoded completely.
+        struct unsent_t {
+            msg_t msg;
+            uint64_t end;
+        };
+        static const uint64_t unknown_end = (uint64_t) -1;
+
+        //  Messages pulled but not completely written yet, oldest first.
+        std::deque<unsent_t> unsent;
+
+        //  Heartbeat timers. Timers are never cancelled on the data path:
+        //  when a timeout fires, the connection is considered dead only if
+        //  no byte has been read since the timer was started. The handles
+        //  of the running timers let unplug cancel them directly.
+        enum {
+            heartbeat_ivl_timer_id = 0x80,
+            heartbeat_timeout_timer_id = 0x81,
+            heartbeat_ttl_timer_id = 0x82
+        };
+        bool has_heartbeat_ivl_timer;
+        bool has_heartbeat_timeout_timer;
+        bool has_heartbeat_ttl_timer;
+        timer_handle_t heartbeat_ivl_timer;
+        timer_handle_t heartbeat_timeout_timer;
+        timer_handle_t heartbeat_ttl_timer;
+        uint64_t heartbeat_timeout_bytes_in;
+        uint64_t heartbeat_ttl_bytes_in;
+
+        //  Commands waiting to be sent, the context of the PING to answer
+        //  and the read_msg to go back to once they are out.
+        bool ping_pending;
+        bool pong_pending;
+        static const size_t max_ping_context = 16;
+        unsigned char pong_context[max_ping_context];
+        size_t pong_context_size;
+        int (stream_engine_t::*next_read_msg)(msg_t *msg_);
+
+        //  True if the last message pulled from the session has more parts.
+        bool tx_more;
+
         stream_engine_t(const stream_engine_t &);
 
         const stream_engine_t &operator=(const stream_engine_t &);
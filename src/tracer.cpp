@@ -0,0 +1,189 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <string.h>
+
+#include "tracer.hpp"
+#include "clock.hpp"
+#include "config.hpp"
+
+zmq::tracer_t::tracer_t() :
+        rate(0),
+        send_countdown(0),
+        calibration_tsc(clock_t::rdtsc()),
+        calibration_us(clock_t::now_us()) {
+    memset(&send_trace, 0, sizeof send_trace);
+    memset(&recv_trace, 0, sizeof recv_trace);
+    memset(&stats, 0, sizeof stats);
+}
+
+zmq::tracer_t::~tracer_t() {
+}
+
+uint64_t zmq::tracer_t::now() {
+    const uint64_t tsc = clock_t::rdtsc();
+    return tsc ? tsc : clock_t::now_us() * 1000;
+}
+
+void zmq::tracer_t::set_rate(int rate_) {
+    scoped_lock_t lock(sync);
+    rate = rate_;
+    send_countdown = rate_;
+    memset(&send_trace, 0, sizeof send_trace);
+    memset(&recv_trace, 0, sizeof recv_trace);
+    memset(&stats, 0, sizeof stats);
+}
+
+int zmq::tracer_t::get_rate() {
+    return rate;
+}
+
+bool zmq::tracer_t::sample_send(uint64_t tsc_) {
+    if (--send_countdown > 0)
+        return false;
+
+    scoped_lock_t lock(sync);
+
+    //  Try again with the next message while a trace is in progress.
+    if (!start(send_trace)) {
+        send_countdown = 1;
+        return false;
+    }
+    send_countdown = rate;
+    send_trace.stamps[0] = tsc_;
+    send_trace.stamped = 1;
+    return true;
+}
+
+void zmq::tracer_t::send_queued(uint64_t tsc_) {
+    scoped_lock_t lock(sync);
+    stamp(send_trace, 1, tsc_, ZMQ_TRACE_SEND_TO_PIPE);
+}
+
+void zmq::tracer_t::send_failed() {
+    scoped_lock_t lock(sync);
+    send_trace.busy = false;
+}
+
+void zmq::tracer_t::send_loaded(uint64_t tsc_) {
+    scoped_lock_t lock(sync);
+    stamp(send_trace, 2, tsc_, ZMQ_TRACE_SEND_TO_PIPE);
+}
+
+void zmq::tracer_t::send_written(uint64_t tsc_) {
+    scoped_lock_t lock(sync);
+    stamp(send_trace, 3, tsc_, ZMQ_TRACE_SEND_TO_PIPE);
+}
+
+bool zmq::tracer_t::sample_recv(int &countdown_, uint64_t read_tsc_) {
+    if (--countdown_ > 0)
+        return false;
+
+    scoped_lock_t lock(sync);
+    if (!start(recv_trace)) {
+        countdown_ = 1;
+        return false;
+    }
+    countdown_ = rate;
+    recv_trace.stamps[0] = read_tsc_;
+    recv_trace.stamps[1] = now();
+    recv_trace.stamped = 3;
+    return true;
+}
+
+void zmq::tracer_t::recv_pushed(uint64_t tsc_) {
+    scoped_lock_t lock(sync);
+    stamp(recv_trace, 2, tsc_, ZMQ_TRACE_WIRE_TO_DECODER);
+}
+
+void zmq::tracer_t::recv_done(uint64_t tsc_) {
+    scoped_lock_t lock(sync);
+    stamp(recv_trace, 3, tsc_, ZMQ_TRACE_WIRE_TO_DECODER);
+}
+
+void zmq::tracer_t::get_stats(zmq_trace_stats_t *stats_) {
+    scoped_lock_t lock(sync);
+    *stats_ = stats;
+}
+
+bool zmq::tracer_t::start(trace_t &trace_) {
+    const uint64_t now_us = clock_t::now_us();
+
+    //  A trace that is stuck, e.g. because its message was dropped
+    //  on the way, is given up after a while.
+    if (trace_.busy) {
+        if (now_us - trace_.started < trace_timeout * 1000)
+            return false;
+        stats.abandoned++;
+    }
+    trace_.busy = true;
+    trace_.started = now_us;
+    trace_.stamped = 0;
+    return true;
+}
+
+void zmq::tracer_t::stamp(trace_t &trace_, int index_, uint64_t tsc_,
+                          int first_stage_) {
+    //  The trace was given up or tracing was reset in the meantime.
+    if (!trace_.busy)
+        return;
+
+    trace_.stamps[index_] = tsc_;
+    trace_.stamped |= 1 << index_;
+    if (trace_.stamped != 15)
+        return;
+    trace_.busy = false;
+
+    //  Nanoseconds per tick of the counter. It has to have run for
+    //  a while to tell its frequency.
+    double ns_per_tick = 1.0;
+    if (calibration_tsc) {
+        const uint64_t elapsed_us = clock_t::now_us() - calibration_us;
+        const uint64_t elapsed_tsc = clock_t::rdtsc() - calibration_tsc;
+        if (elapsed_us < 1000 || elapsed_tsc == 0) {
+            stats.abandoned++;
+            return;
+        }
+        ns_per_tick = elapsed_us * 1000.0 / elapsed_tsc;
+    }
+
+    //  Counters of different cores may be slightly out of step.
+    for (int i = 0; i != 3; i++) {
+        const uint64_t ticks = trace_.stamps[i + 1] > trace_.stamps[i] ?
+                               trace_.stamps[i + 1] - trace_.stamps[i] : 0;
+        record(first_stage_ + i, (uint64_t) (ticks * ns_per_tick));
+    }
+    stats.traced++;
+}
+
+void zmq::tracer_t::record(int stage_, uint64_t ns_) {
+    zmq_trace_stage_t &stage = stats.stages[stage_];
+    if (stage.samples == 0 || ns_ < stage.min)
+        stage.min = ns_;
+    if (ns_ > stage.max)
+        stage.max = ns_;
+    stage.samples++;
+    stage.total += ns_;
+
+    int bucket = 0;
+    while (bucket < 31 && (ns_ >> (bucket + 1)))
+        bucket++;
+    stage.buckets[bucket]++;
+}
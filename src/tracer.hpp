@@ -0,0 +1,142 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ZMQ_TRACER_HPP_INCLUDED__
+#define __ZMQ_TRACER_HPP_INCLUDED__
+
+#include "stdint.hpp"
+#include "mutex.hpp"
+#include "../include/zmq.h"
+
+namespace zmq {
+
+    //  Latency tracing of a socket (ZMQ_TRACE). Messages are sampled and
+    //  stamped with the CPU's timestamp counter at every stage of their
+    //  way through the socket, the application and the I/O thread taking
+    //  turns. There is no room for the stamps in msg_t, so at most one
+    //  message per direction is traced at a time: the message is only
+    //  marked by a flag and the stamps are kept here. Once all the stamps
+    //  are in, the time spent in each stage is added to its histogram.
+    //
+    //  Sending: zmq_msg_send, pipe write, encoder, write to the socket.
+    //  Receiving: read from the socket, decoder, session, read by the
+    //  socket from the pipe.
+
+    class tracer_t {
+    public:
+
+        tracer_t();
+
+        ~tracer_t();
+
+        //  CPU's timestamp counter, or nanoseconds if it's not available.
+        static uint64_t now();
+
+        //  Traces one in rate_ messages; zero switches tracing off. The
+        //  histograms are reset.
+        void set_rate(int rate_);
+
+        int get_rate();
+
+        inline bool enabled() {
+            return rate > 0;
+        }
+
+        //  Called by the application thread for each message sent while
+        //  tracing is enabled. Returns true if the message is to be traced.
+        bool sample_send(uint64_t tsc_);
+
+        //  The traced message is about to be written to the pipe.
+        void send_queued(uint64_t tsc_);
+
+        //  The traced message could not be sent after all.
+        void send_failed();
+
+        //  Called by the I/O thread when the traced message was loaded into
+        //  the encoder and when its data was written to the socket.
+        void send_loaded(uint64_t tsc_);
+
+        void send_written(uint64_t tsc_);
+
+        //  Called by the I/O thread for each decoded message. The countdown
+        //  is owned by the engine, read_tsc_ is when the data was read from
+        //  the socket. Returns true if the message is to be traced.
+        bool sample_recv(int &countdown_, uint64_t read_tsc_);
+
+        //  The traced message was pushed to the session.
+        void recv_pushed(uint64_t tsc_);
+
+        //  Called by the application thread when the socket reads the
+        //  traced message from the pipe.
+        void recv_done(uint64_t tsc_);
+
+        void get_stats(zmq_trace_stats_t *stats_);
+
+    private:
+
+        struct trace_t {
+            bool busy;
+
+            //  When the trace was started, in microseconds.
+            uint64_t started;
+
+            //  Stamps of the four points of the trace and a bitmask of
+            //  those taken so far.
+            uint64_t stamps[4];
+            int stamped;
+        };
+
+        //  Starts the trace unless another one is in progress.
+        bool start(trace_t &trace_);
+
+        //  Takes a stamp; the last one completes the trace and records
+        //  the three stages beginning with first_stage_.
+        void stamp(trace_t &trace_, int index_, uint64_t tsc_,
+                   int first_stage_);
+
+        void record(int stage_, uint64_t ns_);
+
+        int rate;
+
+        //  Messages to be sent before the next one is traced. Owned by
+        //  the application thread.
+        int send_countdown;
+
+        trace_t send_trace;
+        trace_t recv_trace;
+
+        //  Counter and time when the socket was created, to convert
+        //  the counter to nanoseconds.
+        uint64_t calibration_tsc;
+        uint64_t calibration_us;
+
+        zmq_trace_stats_t stats;
+
+        //  Synchronises the application and the I/O threads.
+        mutex_t sync;
+
+        tracer_t(const tracer_t &);
+
+        const tracer_t &operator=(const tracer_t &);
+    };
+
+}
+
+#endif
@@ -20,6 +20,7 @@
 #ifndef __ZMQ_YPIPE_BASE_HPP_INCLUDED__
 #define __ZMQ_YPIPE_BASE_HPP_INCLUDED__
 
+#include "stdint.hpp"
 
 namespace zmq {
     // ypipe_base abstracts ypipe and ypipe_conflate specific
@@ -42,6 +43,12 @@ namespace zmq {
         virtual bool read(T *value_) = 0;
 
         virtual bool probe(bool (*fn)(T &)) = 0;
+
+        //  Number of messages discarded by conflation so far. Pipes that
+        //  never discard anything keep the default.
+        virtual uint32_t dropped() {
+            return 0;
+        }
     };
 }
 
@@ -31,7 +31,8 @@ namespace zmq {
     //  the receiving side to discard all incoming messages but the last one.
     //
     //  reader_awake flag is needed here to mimic ypipe delicate behaviour
-    //  around the reader being asleep (see 'c' pointer being NULL in ypipe.hpp)
+    //  around the reader being asleep (see 'c' pointer being NULL in ypipe.hpp).
+    //  dbuffer reports whether the reader went asleep when a value is written.
 
     template<typename T, int N>
     class ypipe_conflate_t : public ypipe_base_t<T, N> {
@@ -39,7 +40,7 @@ namespace zmq {
 
         //  Initialises the pipe.
         inline ypipe_conflate_t()
-                : reader_awake(false) {
+                : reader_awake(true) {
         }
 
         //  The destructor doesn't have to be virtual. It is mad virtual
@@ -60,7 +61,8 @@ namespace zmq {
         inline void write(const T &value_, bool incomplete_) {
             (void) incomplete_;
 
-            dbuffer.write(value_);
+            if (!dbuffer.write(value_))
+                reader_awake = false;
         }
 
 #ifdef ZMQ_HAVE_OPENVMS
@@ -77,24 +79,19 @@ namespace zmq {
         //  Returns false if the reader thread is sleeping. In that case,
         //  caller is obliged to wake the reader up before using the pipe again.
         inline bool flush() {
-            return reader_awake;
+            bool res = reader_awake;
+            reader_awake = true;
+            return res;
         }
 
         //  Check whether item is available for reading.
         inline bool check_read() {
-            bool res = dbuffer.check_read();
-            if (!res)
-                reader_awake = false;
-
-            return res;
+            return dbuffer.check_read();
         }
 
         //  Reads an item from the pipe. Returns false if there is no value.
         //  available.
         inline bool read(T *value_) {
-            if (!check_read())
-                return false;
-
             return dbuffer.read(value_);
         }
 
@@ -105,6 +102,10 @@ namespace zmq {
             return dbuffer.probe(fn);
         }
 
+        inline uint32_t dropped() {
+            return dbuffer.dropped();
+        }
+
     protected:
 
         dbuffer_t<T> dbuffer;
@@ -0,0 +1,224 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ZMQ_YPIPE_KEYED_HPP_INCLUDED__
+#define __ZMQ_YPIPE_KEYED_HPP_INCLUDED__
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include "platform.hpp"
+#include "blob.hpp"
+#include "mutex.hpp"
+#include "atomic_counter.hpp"
+#include "err.hpp"
+#include "ypipe_base.hpp"
+
+namespace zmq {
+
+    //  Pipe implementing keyed conflation: it keeps the most recent message
+    //  for every key rather than the most recent message overall. The key
+    //  is the first key_size bytes of the first frame of the message, or
+    //  the whole first frame if key_size is negative.
+    //
+    //  Messages are kept in the order their keys first appeared; a newer
+    //  message for a known key replaces the older one in place. A slow
+    //  reader thus gets one coherent value per key, and the pipe never
+    //  grows beyond the number of distinct keys.
+    //
+    //  Writer and reader share the message list under a mutex. Frames of
+    //  the message being written and of the message being read are owned
+    //  by the respective side and are not locked.
+
+    template<typename T, int N>
+    class ypipe_keyed_t : public ypipe_base_t<T, N> {
+    public:
+
+        inline ypipe_keyed_t(int key_size_)
+                : key_size(key_size_), current_pos(0), reader_asleep(false) {
+        }
+
+        inline virtual ~ypipe_keyed_t() {
+            close_frames(pending, 0);
+            close_frames(current, current_pos);
+            for (typename entries_t::iterator it = entries.begin();
+                 it != entries.end(); ++it)
+                close_frames(it->frames, 0);
+        }
+
+        // 写入一帧; 消息完整时按key放入entries
+        inline void write(const T &value_, bool incomplete_) {
+            pending.push_back(value_);
+            if (incomplete_)
+                return;
+
+            scoped_lock_t lock(sync);
+
+            //  Delimiter is never conflated, it has to follow all the data.
+            if (pending.front().is_delimiter()) {
+                entries.push_back(entry_t());
+                entries.back().frames.swap(pending);
+                return;
+            }
+
+            blob_t key = get_key(pending.front());
+            typename index_t::iterator found = index.find(key);
+            if (found != index.end()) {
+                close_frames(found->second->frames, 0);
+                found->second->frames.swap(pending);
+                drops.add(1);
+            }
+            else {
+                entries.push_back(entry_t());
+                entries.back().key = key;
+                entries.back().frames.swap(pending);
+                index.insert(typename index_t::value_type(key, --entries.end()));
+            }
+        }
+
+        //  Only frames of an incomplete message can be taken back.
+        inline bool unwrite(T *value_) {
+            if (pending.empty())
+                return false;
+            *value_ = pending.back();
+            pending.pop_back();
+            return true;
+        }
+
+        //  Returns false if the reader thread is sleeping. In that case,
+        //  caller is obliged to wake the reader up before using the pipe again.
+        inline bool flush() {
+            scoped_lock_t lock(sync);
+            if (reader_asleep && !entries.empty()) {
+                reader_asleep = false;
+                return false;
+            }
+            return true;
+        }
+
+        //  Check whether item is available for reading.
+        inline bool check_read() {
+            if (current_pos < current.size())
+                return true;
+
+            scoped_lock_t lock(sync);
+            if (entries.empty()) {
+                reader_asleep = true;
+                return false;
+            }
+
+            //  Frames already read were passed to the caller, drop them.
+            current.clear();
+            current.swap(entries.front().frames);
+            current_pos = 0;
+            if (!current.front().is_delimiter())
+                index.erase(entries.front().key);
+            entries.pop_front();
+            return true;
+        }
+
+        //  Reads an item from the pipe. Returns false if there is no value.
+        //  available.
+        inline bool read(T *value_) {
+            if (!check_read())
+                return false;
+
+            *value_ = current[current_pos++];
+            if (current_pos == current.size()) {
+                current.clear();
+                current_pos = 0;
+            }
+            return true;
+        }
+
+        //  Applies the function fn to the first elemenent in the pipe
+        //  and returns the value returned by the fn.
+        //  The pipe mustn't be empty or the function crashes.
+        inline bool probe(bool (*fn)(T &)) {
+            return (*fn)(current[current_pos]);
+        }
+
+        //  Number of messages replaced by a newer one with the same key.
+        inline uint32_t dropped() {
+            return drops.get();
+        }
+
+    private:
+
+        typedef std::vector<T> frames_t;
+
+        struct entry_t {
+            blob_t key;
+            frames_t frames;
+        };
+
+        typedef std::list<entry_t> entries_t;
+        typedef std::map<blob_t, typename entries_t::iterator> index_t;
+
+        inline blob_t get_key(T &msg_) {
+            size_t size = msg_.size();
+            if (key_size >= 0 && size > (size_t) key_size)
+                size = key_size;
+            return blob_t((unsigned char *) msg_.data(), size);
+        }
+
+        static inline void close_frames(frames_t &frames_, size_t from_) {
+            for (size_t i = from_; i < frames_.size(); i++) {
+                int rc = frames_[i].close();
+                errno_assert (rc == 0);
+            }
+            frames_.clear();
+        }
+
+        //  Number of bytes of the first frame forming the key.
+        const int key_size;
+
+        //  Frames of the message being written. Owned by the writer.
+        frames_t pending;
+
+        //  Frames of the message being read and the next one to read.
+        //  Owned by the reader.
+        frames_t current;
+        size_t current_pos;
+
+        //  Complete messages in order of first appearance of their keys
+        //  and the index to find them by key. Guarded by sync.
+        entries_t entries;
+        index_t index;
+
+        //  True if the reader found the pipe empty. Guarded by sync.
+        bool reader_asleep;
+
+        mutex_t sync;
+
+        //  Messages replaced so far. Written by the writer, read by either
+        //  side.
+        atomic_counter_t drops;
+
+        //  Disable copying of ypipe object.
+        ypipe_keyed_t(const ypipe_keyed_t &);
+
+        const ypipe_keyed_t &operator=(const ypipe_keyed_t &);
+    };
+
+}
+
+#endif
@@ -0,0 +1,147 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "zap_cache.hpp"
+#include "clock.hpp"
+#include "err.hpp"
+#include "../include/zmq.h"
+
+zmq::zap_cache_t::zap_cache_t() :
+        ttl(0),
+        max_size(ZMQ_ZAP_CACHE_SIZE_DFLT) {
+}
+
+zmq::zap_cache_t::~zap_cache_t() {
+}
+
+void zmq::zap_cache_t::set_ttl(int ttl_) {
+    sync.lock();
+    ttl = ttl_;
+    if (!ttl) {
+        entries.clear();
+        lru.clear();
+    }
+    sync.unlock();
+}
+
+int zmq::zap_cache_t::get_ttl() {
+    sync.lock();
+    int rc = ttl;
+    sync.unlock();
+    return rc;
+}
+
+void zmq::zap_cache_t::set_max_size(int max_size_) {
+    sync.lock();
+    max_size = max_size_;
+    while (entries.size() > (size_t) max_size)
+        erase(entries.find(lru.back()));
+    sync.unlock();
+}
+
+int zmq::zap_cache_t::get_max_size() {
+    sync.lock();
+    int rc = max_size;
+    sync.unlock();
+    return rc;
+}
+
+bool zmq::zap_cache_t::enabled() {
+    return get_ttl() > 0;
+}
+
+bool zmq::zap_cache_t::find(const std::string &key_, zap_reply_t &reply_) {
+    sync.lock();
+
+    entries_t::iterator it = entries.find(key_);
+    if (it == entries.end()) {
+        sync.unlock();
+        return false;
+    }
+
+    if (it->second.expiry <= clock_t::now_us() / 1000) {
+        erase(it);
+        sync.unlock();
+        return false;
+    }
+
+    //  Move the entry to the front of the LRU list.
+    lru.splice(lru.begin(), lru, it->second.lru_pos);
+    reply_ = it->second.reply;
+
+    sync.unlock();
+    return true;
+}
+
+void zmq::zap_cache_t::insert(const std::string &key_,
+                              const std::string &domain_, const zap_reply_t &reply_) {
+    //  Temporary failures (300) and handler errors (500) are not cached.
+    if (reply_.status_code != "200" && reply_.status_code != "400")
+        return;
+
+    sync.lock();
+
+    if (!ttl || !max_size) {
+        sync.unlock();
+        return;
+    }
+
+    entries_t::iterator it = entries.find(key_);
+    if (it != entries.end())
+        erase(it);
+    else
+    if (entries.size() >= (size_t) max_size)
+        erase(entries.find(lru.back()));
+
+    lru.push_front(key_);
+    entry_t &entry = entries[key_];
+    entry.domain = domain_;
+    entry.reply = reply_;
+    entry.expiry = clock_t::now_us() / 1000 + ttl;
+    entry.lru_pos = lru.begin();
+
+    sync.unlock();
+}
+
+void zmq::zap_cache_t::invalidate(const char *domain_) {
+    sync.lock();
+
+    if (!domain_) {
+        entries.clear();
+        lru.clear();
+    }
+    else {
+        entries_t::iterator it = entries.begin();
+        while (it != entries.end()) {
+            entries_t::iterator to_erase = it;
+            ++it;
+            if (to_erase->second.domain == domain_)
+                erase(to_erase);
+        }
+    }
+
+    sync.unlock();
+}
+
+void zmq::zap_cache_t::erase(entries_t::iterator it_) {
+    zmq_assert (it_ != entries.end());
+    lru.erase(it_->second.lru_pos);
+    entries.erase(it_);
+}
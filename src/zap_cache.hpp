@@ -0,0 +1,114 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ZMQ_ZAP_CACHE_HPP_INCLUDED__
+#define __ZMQ_ZAP_CACHE_HPP_INCLUDED__
+
+#include <map>
+#include <list>
+#include <string>
+
+#include "stdint.hpp"
+#include "mutex.hpp"
+
+namespace zmq {
+
+    //  Decision of the ZAP handler as far as the cache is concerned.
+    struct zap_reply_t {
+        std::string status_code;
+        std::string status_text;
+        std::string user_id;
+        std::string metadata;
+    };
+
+    //  Cache of ZAP handler decisions, shared by all the sessions of the
+    //  context. Entries are keyed by domain, address, identity, mechanism
+    //  and credentials, expire after the TTL and the least recently used
+    //  ones are evicted once the cache is full. Disabled if TTL is zero.
+
+    class zap_cache_t {
+    public:
+
+        zap_cache_t();
+
+        ~zap_cache_t();
+
+        void set_ttl(int ttl_);
+
+        int get_ttl();
+
+        void set_max_size(int max_size_);
+
+        int get_max_size();
+
+        //  Returns true if caching is enabled.
+        bool enabled();
+
+        //  Looks up the decision for the key. Returns false if there's no
+        //  such entry or it has already expired.
+        bool find(const std::string &key_, zap_reply_t &reply_);
+
+        //  Stores the decision for the key. Only definite decisions, i.e.
+        //  success (200) and failure (400), are cached.
+        void insert(const std::string &key_, const std::string &domain_,
+                    const zap_reply_t &reply_);
+
+        //  Drops all the entries for the domain, or all the entries
+        //  altogether if domain_ is NULL.
+        void invalidate(const char *domain_);
+
+    private:
+
+        typedef std::list<std::string> lru_t;
+
+        struct entry_t {
+            std::string domain;
+            zap_reply_t reply;
+            uint64_t expiry;
+            lru_t::iterator lru_pos;
+        };
+
+        typedef std::map<std::string, entry_t> entries_t;
+
+        void erase(entries_t::iterator it_);
+
+        //  Cached decisions.
+        entries_t entries;
+
+        //  Keys of the entries, most recently used first.
+        lru_t lru;
+
+        //  Lifetime of an entry in milliseconds; 0 means no caching.
+        int ttl;
+
+        //  Maximum number of entries.
+        int max_size;
+
+        //  Cache is accessed from all the I/O threads.
+        mutex_t sync;
+
+        zap_cache_t(const zap_cache_t &);
+
+        const zap_cache_t &operator=(const zap_cache_t &);
+    };
+
+}
+
+#endif
@@ -65,16 +65,40 @@ struct iovec {
 
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <new>
 #include <sys/poll.h>
 
 #include "proxy.hpp"
 #include "socket_base.hpp"
+#include "socket_poller.hpp"
 #include "ctx.hpp"
 
 //  Compile time check whether msg_t fits into zmq_msg_t.
 typedef char check_msg_t_size[sizeof(zmq::msg_t) == sizeof(zmq_msg_t) ? 1 : -1];
 
+//  zmq_poller_wait_all hands the caller's events to the poller as they are,
+//  so both structures have to be laid out the same.
+typedef zmq::socket_poller_t::event_t poller_event_t;
+typedef char check_poller_event_t_size[
+    sizeof(poller_event_t) == sizeof(zmq_poller_event_t) ? 1 : -1];
+typedef char check_poller_event_t_socket[
+    offsetof(poller_event_t, socket) == offsetof(zmq_poller_event_t, socket) &&
+    sizeof(((poller_event_t *) 0)->socket) ==
+        sizeof(((zmq_poller_event_t *) 0)->socket) ? 1 : -1];
+typedef char check_poller_event_t_fd[
+    offsetof(poller_event_t, fd) == offsetof(zmq_poller_event_t, fd) &&
+    sizeof(((poller_event_t *) 0)->fd) ==
+        sizeof(((zmq_poller_event_t *) 0)->fd) ? 1 : -1];
+typedef char check_poller_event_t_user_data[
+    offsetof(poller_event_t, user_data) ==
+        offsetof(zmq_poller_event_t, user_data) ? 1 : -1];
+typedef char check_poller_event_t_events[
+    offsetof(poller_event_t, events) ==
+        offsetof(zmq_poller_event_t, events) &&
+    sizeof(((poller_event_t *) 0)->events) ==
+        sizeof(((zmq_poller_event_t *) 0)->events) ? 1 : -1];
+
 
 void zmq_version(int *major_, int *minor_, int *patch_) {
     *major_ = ZMQ_VERSION_MAJOR;
@@ -148,6 +172,15 @@ int zmq_ctx_get(void *ctx_, int option_) {
     return ((zmq::ctx_t *) ctx_)->get(option_);
 }
 
+int zmq_ctx_zap_invalidate(void *ctx_, const char *domain_) {
+    if (!ctx_ || !((zmq::ctx_t *) ctx_)->check_tag()) {
+        errno = EFAULT;
+        return -1;
+    }
+    ((zmq::ctx_t *) ctx_)->get_zap_cache()->invalidate(domain_);
+    return 0;
+}
+
 //  Stable/legacy context API
 void *zmq_init(int io_threads_) {
     if (io_threads_ >= 0) {
@@ -221,6 +254,30 @@ int zmq_socket_monitor(void *s_, const char *addr_, int events_) {
     return result;
 }
 
+int zmq_socket_monitor_ring(void *s_, int events_, int capacity_) {
+    if (!s_ || !((zmq::socket_base_t *) s_)->check_tag()) {
+        errno = ENOTSOCK;
+        return -1;
+    }
+    zmq::socket_base_t *s = (zmq::socket_base_t *) s_;
+    int result = s->monitor_ring_start(events_, capacity_);
+    return result;
+}
+
+int zmq_monitor_read(void *s_, zmq_monitor_record_t *records_, int count_) {
+    if (!s_ || !((zmq::socket_base_t *) s_)->check_tag()) {
+        errno = ENOTSOCK;
+        return -1;
+    }
+    if (count_ < 0 || (count_ > 0 && !records_)) {
+        errno = EINVAL;
+        return -1;
+    }
+    zmq::socket_base_t *s = (zmq::socket_base_t *) s_;
+    int result = s->monitor_ring_read(records_, count_);
+    return result;
+}
+
 int zmq_bind(void *s_, const char *addr_) {
     if (!s_ || !((zmq::socket_base_t *) s_)->check_tag()) {
         errno = ENOTSOCK;
@@ -727,6 +784,106 @@ int zmq_poll(zmq_pollitem_t *items_, int nitems_, long timeout_) {
     
 }
 
+// Persistent poller.
+
+void *zmq_poller_new(void) {
+    zmq::socket_poller_t *poller = new(std::nothrow) zmq::socket_poller_t;
+    alloc_assert (poller);
+    return poller;
+}
+
+int zmq_poller_destroy(void **poller_p_) {
+    if (!poller_p_ || !*poller_p_ ||
+        !((zmq::socket_poller_t *) *poller_p_)->check_tag()) {
+        errno = EFAULT;
+        return -1;
+    }
+    delete (zmq::socket_poller_t *) *poller_p_;
+    *poller_p_ = NULL;
+    return 0;
+}
+
+int zmq_poller_add(void *poller_, void *s_, void *user_data_, short events_) {
+    if (!poller_ || !((zmq::socket_poller_t *) poller_)->check_tag()) {
+        errno = EFAULT;
+        return -1;
+    }
+    if (!s_ || !((zmq::socket_base_t *) s_)->check_tag()) {
+        errno = ENOTSOCK;
+        return -1;
+    }
+    return ((zmq::socket_poller_t *) poller_)->add(
+            (zmq::socket_base_t *) s_, user_data_, events_);
+}
+
+int zmq_poller_modify(void *poller_, void *s_, short events_) {
+    if (!poller_ || !((zmq::socket_poller_t *) poller_)->check_tag()) {
+        errno = EFAULT;
+        return -1;
+    }
+    if (!s_ || !((zmq::socket_base_t *) s_)->check_tag()) {
+        errno = ENOTSOCK;
+        return -1;
+    }
+    return ((zmq::socket_poller_t *) poller_)->modify(
+            (zmq::socket_base_t *) s_, events_);
+}
+
+int zmq_poller_remove(void *poller_, void *s_) {
+    if (!poller_ || !((zmq::socket_poller_t *) poller_)->check_tag()) {
+        errno = EFAULT;
+        return -1;
+    }
+    if (!s_ || !((zmq::socket_base_t *) s_)->check_tag()) {
+        errno = ENOTSOCK;
+        return -1;
+    }
+    return ((zmq::socket_poller_t *) poller_)->remove(
+            (zmq::socket_base_t *) s_);
+}
+
+int zmq_poller_add_fd(void *poller_, zmq::fd_t fd_, void *user_data_,
+                      short events_) {
+    if (!poller_ || !((zmq::socket_poller_t *) poller_)->check_tag()) {
+        errno = EFAULT;
+        return -1;
+    }
+    return ((zmq::socket_poller_t *) poller_)->add_fd(fd_, user_data_,
+                                                      events_);
+}
+
+int zmq_poller_modify_fd(void *poller_, zmq::fd_t fd_, short events_) {
+    if (!poller_ || !((zmq::socket_poller_t *) poller_)->check_tag()) {
+        errno = EFAULT;
+        return -1;
+    }
+    return ((zmq::socket_poller_t *) poller_)->modify_fd(fd_, events_);
+}
+
+int zmq_poller_remove_fd(void *poller_, zmq::fd_t fd_) {
+    if (!poller_ || !((zmq::socket_poller_t *) poller_)->check_tag()) {
+        errno = EFAULT;
+        return -1;
+    }
+    return ((zmq::socket_poller_t *) poller_)->remove_fd(fd_);
+}
+
+int zmq_poller_wait(void *poller_, zmq_poller_event_t *event_, long timeout_) {
+    return zmq_poller_wait_all(poller_, event_, 1, timeout_);
+}
+
+int zmq_poller_wait_all(void *poller_, zmq_poller_event_t *events_,
+                        int n_events_, long timeout_) {
+    if (!poller_ || !((zmq::socket_poller_t *) poller_)->check_tag()) {
+        errno = EFAULT;
+        return -1;
+    }
+    //  The public and the internal event structures have the same layout,
+    //  which is checked at the top of this file.
+    return ((zmq::socket_poller_t *) poller_)->wait(
+            (zmq::socket_poller_t::event_t *) events_, n_events_, timeout_);
+}
+
 #if defined ZMQ_POLL_BASED_ON_SELECT
 #undef ZMQ_POLL_BASED_ON_SELECT
 #endif
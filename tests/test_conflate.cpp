@@ -19,6 +19,66 @@
 
 #include "testutil.hpp"
 
+static void test_keyed (void *ctx)
+{
+    const char *bind_to = "tcp://127.0.0.1:5556";
+
+    void *s_in = zmq_socket (ctx, ZMQ_DEALER);
+    assert (s_in);
+
+    int conflate = 1;
+    int rc = zmq_setsockopt (s_in, ZMQ_CONFLATE, &conflate, sizeof(conflate));
+    assert (rc == 0);
+    int key = -1;
+    rc = zmq_setsockopt (s_in, ZMQ_CONFLATE_KEY, &key, sizeof(key));
+    assert (rc == 0);
+
+    rc = zmq_bind (s_in, bind_to);
+    assert (rc == 0);
+
+    void *s_out = zmq_socket (ctx, ZMQ_DEALER);
+    assert (s_out);
+
+    rc = zmq_connect (s_out, bind_to);
+    assert (rc == 0);
+
+    //  Interleave updates for two keys, then one for a third key.
+    int message_count = 20;
+    for (int j = 0; j < message_count; ++j) {
+        rc = zmq_send (s_out, j % 2 ? "B" : "A", 1, ZMQ_SNDMORE);
+        assert (rc == 1);
+        rc = zmq_send (s_out, (void*)&j, sizeof(int), 0);
+        assert (rc == sizeof(int));
+    }
+    rc = zmq_send (s_out, "C", 1, ZMQ_SNDMORE);
+    assert (rc == 1);
+    rc = zmq_send (s_out, (void*)&message_count, sizeof(int), 0);
+    assert (rc == sizeof(int));
+    msleep (SETTLE_TIME);
+
+    //  Only the last message per key is left, in order of first arrival.
+    const char *keys = "ABC";
+    int expected [] = {message_count - 2, message_count - 1, message_count};
+    for (int i = 0; i < 3; i++) {
+        char buf [2];
+        rc = zmq_recv (s_in, buf, sizeof(buf), 0);
+        assert (rc == 1 && buf [0] == keys [i]);
+        int payload_recved = 0;
+        rc = zmq_recv (s_in, (void*)&payload_recved, sizeof(int), 0);
+        assert (rc == sizeof(int));
+        assert (payload_recved == expected [i]);
+    }
+    int payload_recved = 0;
+    rc = zmq_recv (s_in, (void*)&payload_recved, sizeof(int), ZMQ_DONTWAIT);
+    assert (rc == -1 && errno == EAGAIN);
+
+    rc = zmq_close (s_in);
+    assert (rc == 0);
+
+    rc = zmq_close (s_out);
+    assert (rc == 0);
+}
+
 int main (int argc, char *argv [])
 {
     const char *bind_to = "tcp://127.0.0.1:5555";
@@ -65,6 +125,8 @@ int main (int argc, char *argv [])
     rc = zmq_close (s_out);
     assert (rc == 0);
 
+    test_keyed (ctx);
+
     rc = zmq_term (ctx);
     assert (rc == 0);
 
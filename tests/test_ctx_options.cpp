@@ -31,6 +31,19 @@ int main (void)
     assert (zmq_ctx_get (ctx, ZMQ_MAX_SOCKETS) == ZMQ_MAX_SOCKETS_DFLT);
     assert (zmq_ctx_get (ctx, ZMQ_IO_THREADS) == ZMQ_IO_THREADS_DFLT);
     assert (zmq_ctx_get (ctx, ZMQ_IPV6) == 0);
+    assert (zmq_ctx_get (ctx, ZMQ_CRYPTO_THREADS) == ZMQ_CRYPTO_THREADS_DFLT);
+    assert (zmq_ctx_get (ctx, ZMQ_ZAP_CACHE_TTL) == 0);
+    assert (zmq_ctx_get (ctx, ZMQ_ZAP_CACHE_SIZE) == ZMQ_ZAP_CACHE_SIZE_DFLT);
+    assert (zmq_ctx_get (ctx, ZMQ_SOCKET_POOL) == ZMQ_SOCKET_POOL_DFLT);
+
+    rc = zmq_ctx_set (ctx, ZMQ_ZAP_CACHE_TTL, 1000);
+    assert (rc == 0);
+    assert (zmq_ctx_get (ctx, ZMQ_ZAP_CACHE_TTL) == 1000);
+    rc = zmq_ctx_set (ctx, ZMQ_ZAP_CACHE_SIZE, 16);
+    assert (rc == 0);
+    assert (zmq_ctx_get (ctx, ZMQ_ZAP_CACHE_SIZE) == 16);
+    rc = zmq_ctx_zap_invalidate (ctx, NULL);
+    assert (rc == 0);
     
     rc = zmq_ctx_set (ctx, ZMQ_IPV6, true);
     assert (zmq_ctx_get (ctx, ZMQ_IPV6) == 1);
@@ -44,6 +57,30 @@ int main (void)
 
     rc = zmq_close (router);
     assert (rc == 0);
+
+    //  Short-lived sockets recycle the resources of closed ones.
+    rc = zmq_ctx_set (ctx, ZMQ_SOCKET_POOL, 4);
+    assert (rc == 0);
+    assert (zmq_ctx_get (ctx, ZMQ_SOCKET_POOL) == 4);
+    rc = zmq_ctx_set (ctx, ZMQ_SOCKET_POOL, -1);
+    assert (rc == -1 && errno == EINVAL);
+    for (int i = 0; i < 100; i++) {
+        char endpoint [32];
+        sprintf (endpoint, "inproc://pool%d", i);
+        void *server = zmq_socket (ctx, ZMQ_PAIR);
+        assert (server);
+        rc = zmq_bind (server, endpoint);
+        assert (rc == 0);
+        void *client = zmq_socket (ctx, ZMQ_PAIR);
+        assert (client);
+        rc = zmq_connect (client, endpoint);
+        assert (rc == 0);
+        bounce (server, client);
+        rc = zmq_close (client);
+        assert (rc == 0);
+        rc = zmq_close (server);
+        assert (rc == 0);
+    }
     
     rc = zmq_ctx_term (ctx);
     assert (rc == 0);
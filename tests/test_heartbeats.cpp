@@ -0,0 +1,235 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testutil.hpp"
+#if defined (ZMQ_HAVE_WINDOWS)
+#   include <winsock2.h>
+#   include <ws2tcpip.h>
+#   include <stdexcept>
+#   define close closesocket
+#else
+#   include <sys/socket.h>
+#   include <netinet/in.h>
+#   include <arpa/inet.h>
+#   include <unistd.h>
+#endif
+
+static void test_options (void *ctx_)
+{
+    void *socket = zmq_socket (ctx_, ZMQ_DEALER);
+    assert (socket);
+
+    int value;
+    size_t value_size = sizeof (value);
+    int rc = zmq_getsockopt (socket, ZMQ_HEARTBEAT_IVL, &value, &value_size);
+    assert (rc == 0 && value == 0);
+    rc = zmq_getsockopt (socket, ZMQ_HEARTBEAT_TTL, &value, &value_size);
+    assert (rc == 0 && value == 0);
+    rc = zmq_getsockopt (socket, ZMQ_HEARTBEAT_TIMEOUT, &value, &value_size);
+    assert (rc == 0 && value == -1);
+
+    value = 1000;
+    rc = zmq_setsockopt (socket, ZMQ_HEARTBEAT_IVL, &value, sizeof (value));
+    assert (rc == 0);
+    rc = zmq_getsockopt (socket, ZMQ_HEARTBEAT_IVL, &value, &value_size);
+    assert (rc == 0 && value == 1000);
+
+    //  The TTL has to fit 16 bits of deciseconds.
+    value = 6553500;
+    rc = zmq_setsockopt (socket, ZMQ_HEARTBEAT_TTL, &value, sizeof (value));
+    assert (rc == 0);
+    value = 6553600;
+    rc = zmq_setsockopt (socket, ZMQ_HEARTBEAT_TTL, &value, sizeof (value));
+    assert (rc == -1 && errno == EINVAL);
+
+    value = -2;
+    rc = zmq_setsockopt (socket, ZMQ_HEARTBEAT_TIMEOUT, &value, sizeof (value));
+    assert (rc == -1 && errno == EINVAL);
+
+    rc = zmq_close (socket);
+    assert (rc == 0);
+}
+
+static void *heartbeating_dealer (void *ctx_)
+{
+    void *dealer = zmq_socket (ctx_, ZMQ_DEALER);
+    assert (dealer);
+    int value = 50;
+    int rc = zmq_setsockopt (dealer, ZMQ_HEARTBEAT_IVL, &value, sizeof (value));
+    assert (rc == 0);
+    value = 100;
+    rc = zmq_setsockopt (dealer, ZMQ_HEARTBEAT_TIMEOUT, &value,
+                         sizeof (value));
+    assert (rc == 0);
+    rc = zmq_socket_monitor_ring (dealer, ZMQ_EVENT_DISCONNECTED, 16);
+    assert (rc == 0);
+    return dealer;
+}
+
+//  A quiet peer that answers the PINGs stays connected.
+static void test_quiet_peer (void *ctx_)
+{
+    void *server = heartbeating_dealer (ctx_);
+    int rc = zmq_bind (server, "tcp://127.0.0.1:5576");
+    assert (rc == 0);
+    void *client = heartbeating_dealer (ctx_);
+    rc = zmq_connect (client, "tcp://127.0.0.1:5576");
+    assert (rc == 0);
+
+    bounce (server, client);
+    msleep (500);
+    bounce (server, client);
+
+    zmq_monitor_record_t records [16];
+    rc = zmq_monitor_read (server, records, 16);
+    assert (rc == 0);
+    rc = zmq_monitor_read (client, records, 16);
+    assert (rc == 0);
+
+    close_zero_linger (client);
+    close_zero_linger (server);
+}
+
+#ifdef HAVE_LIBSODIUM
+//  Under CURVE, PING and PONG go through the mechanism: they are accepted
+//  by the peer and never reach the application.
+static void test_curve_peer (void *ctx_)
+{
+    char server_public [41];
+    char server_secret [41];
+    char client_public [41];
+    char client_secret [41];
+    int rc = zmq_curve_keypair (server_public, server_secret);
+    assert (rc == 0);
+    rc = zmq_curve_keypair (client_public, client_secret);
+    assert (rc == 0);
+
+    void *server = heartbeating_dealer (ctx_);
+    int as_server = 1;
+    rc = zmq_setsockopt (server, ZMQ_CURVE_SERVER, &as_server, sizeof (int));
+    assert (rc == 0);
+    rc = zmq_setsockopt (server, ZMQ_CURVE_SECRETKEY, server_secret, 40);
+    assert (rc == 0);
+    rc = zmq_bind (server, "tcp://127.0.0.1:5578");
+    assert (rc == 0);
+
+    void *client = heartbeating_dealer (ctx_);
+    rc = zmq_setsockopt (client, ZMQ_CURVE_SERVERKEY, server_public, 40);
+    assert (rc == 0);
+    rc = zmq_setsockopt (client, ZMQ_CURVE_PUBLICKEY, client_public, 40);
+    assert (rc == 0);
+    rc = zmq_setsockopt (client, ZMQ_CURVE_SECRETKEY, client_secret, 40);
+    assert (rc == 0);
+    rc = zmq_connect (client, "tcp://127.0.0.1:5578");
+    assert (rc == 0);
+
+    bounce (server, client);
+    msleep (500);
+
+    //  Nothing but the bounced messages made it through.
+    char buffer [32];
+    rc = zmq_recv (server, buffer, sizeof (buffer), ZMQ_DONTWAIT);
+    assert (rc == -1 && errno == EAGAIN);
+    rc = zmq_recv (client, buffer, sizeof (buffer), ZMQ_DONTWAIT);
+    assert (rc == -1 && errno == EAGAIN);
+    bounce (server, client);
+
+    zmq_monitor_record_t records [16];
+    rc = zmq_monitor_read (server, records, 16);
+    assert (rc == 0);
+    rc = zmq_monitor_read (client, records, 16);
+    assert (rc == 0);
+
+    close_zero_linger (client);
+    close_zero_linger (server);
+}
+#endif
+
+//  A peer that completes the handshake and then falls silent is dropped.
+static void test_dead_peer (void *ctx_)
+{
+    void *server = heartbeating_dealer (ctx_);
+    int rc = zmq_bind (server, "tcp://127.0.0.1:5577");
+    assert (rc == 0);
+
+    struct sockaddr_in ip4addr;
+    ip4addr.sin_family = AF_INET;
+    ip4addr.sin_port = htons (5577);
+    inet_pton (AF_INET, "127.0.0.1", &ip4addr.sin_addr);
+    int s = socket (AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    rc = connect (s, (struct sockaddr*) &ip4addr, sizeof ip4addr);
+    assert (rc > -1);
+
+    //  ZMTP/3.0 greeting with the NULL mechanism, then READY.
+    unsigned char greeting [64];
+    memset (greeting, 0, sizeof (greeting));
+    greeting [0] = 0xff;
+    greeting [8] = 1;
+    greeting [9] = 0x7f;
+    greeting [10] = 3;
+    memcpy (greeting + 12, "NULL", 4);
+    rc = send (s, (const char *) greeting, sizeof (greeting), 0);
+    assert (rc == sizeof (greeting));
+    const char ready [] = "\4\34\5READY\13Socket-Type\0\0\0\6DEALER";
+    rc = send (s, ready, sizeof (ready) - 1, 0);
+    assert (rc == (int) sizeof (ready) - 1);
+
+    //  The server PINGs and, getting no answer, hangs up.
+    msleep (500);
+    zmq_monitor_record_t records [16];
+    rc = zmq_monitor_read (server, records, 16);
+    assert (rc == 1);
+    assert (records [0].event == ZMQ_EVENT_DISCONNECTED);
+
+    char buff [256];
+    size_t received = 0;
+    while (received < sizeof (buff)) {
+        rc = recv (s, buff + received, sizeof (buff) - received, 0);
+        if (rc <= 0)
+            break;
+        received += rc;
+    }
+    bool pinged = false;
+    for (size_t i = 0; i + 5 <= received; i++)
+        if (memcmp (buff + i, "\4PING", 5) == 0)
+            pinged = true;
+    assert (pinged);
+
+    close (s);
+    close_zero_linger (server);
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    test_options (ctx);
+    test_quiet_peer (ctx);
+#ifdef HAVE_LIBSODIUM
+    test_curve_peer (ctx);
+#endif
+    test_dead_peer (ctx);
+
+    int rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+    return 0 ;
+}
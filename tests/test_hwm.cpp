@@ -252,6 +252,72 @@ int test_inproc_bind_and_close_first (int send_hwm, int recv_hwm)
     return send_count;
 }
 
+int test_inproc_bytes (int64_t send_hwm_bytes, int64_t recv_hwm_bytes,
+    size_t msg_size)
+{
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+    int rc;
+
+    //  Only the byte limits apply
+    int hwm = 0;
+    char buf [1000];
+    assert (msg_size <= sizeof (buf));
+    memset (buf, 0, sizeof (buf));
+
+    void *bind_socket = zmq_socket (ctx, ZMQ_PULL);
+    assert (bind_socket);
+    rc = zmq_setsockopt (bind_socket, ZMQ_RCVHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    rc = zmq_setsockopt (bind_socket, ZMQ_RCVHWM_BYTES, &recv_hwm_bytes,
+        sizeof (recv_hwm_bytes));
+    assert (rc == 0);
+    rc = zmq_bind (bind_socket, "inproc://a");
+    assert (rc == 0);
+
+    void *connect_socket = zmq_socket (ctx, ZMQ_PUSH);
+    assert (connect_socket);
+    rc = zmq_setsockopt (connect_socket, ZMQ_SNDHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    rc = zmq_setsockopt (connect_socket, ZMQ_SNDHWM_BYTES, &send_hwm_bytes,
+        sizeof (send_hwm_bytes));
+    assert (rc == 0);
+    rc = zmq_connect (connect_socket, "inproc://a");
+    assert (rc == 0);
+
+    // Send until we block
+    int send_count = 0;
+    while (send_count < MAX_SENDS && zmq_send (connect_socket, buf, msg_size,
+            ZMQ_DONTWAIT) == (int) msg_size)
+        ++send_count;
+
+    // Now receive all sent messages
+    int recv_count = 0;
+    while (zmq_recv (bind_socket, buf, sizeof (buf), ZMQ_DONTWAIT) ==
+            (int) msg_size)
+        ++recv_count;
+
+    assert (send_count == recv_count);
+
+    // Now it should be possible to send one more.
+    rc = zmq_send (connect_socket, buf, msg_size, 0);
+    assert (rc == (int) msg_size);
+    rc = zmq_recv (bind_socket, buf, sizeof (buf), 0);
+    assert (rc == (int) msg_size);
+
+    // Clean up
+    rc = zmq_close (connect_socket);
+    assert (rc == 0);
+
+    rc = zmq_close (bind_socket);
+    assert (rc == 0);
+
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+
+    return send_count;
+}
+
 int main (void)
 {
     setup_test_environment();
@@ -295,5 +361,13 @@ int main (void)
     count = test_inproc_bind_and_close_first (1, 0);
     //assert (count == 1);
 
+    // Byte limits of 1000 on send and 1000 on receive, so 2000 bytes total
+    count = test_inproc_bytes (1000, 1000, 100);
+    assert (count == 20);
+
+    // The last message admitted may overshoot the limit
+    count = test_inproc_bytes (1000, 1000, 300);
+    assert (count == 7);
+
     return 0;
 }
@@ -411,6 +411,51 @@ void test_connect_only ()
     assert (rc == 0);
 }
 
+void test_many_endpoints ()
+{
+    const int no_of_endpoints = 64;
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    //  Endpoints land in different shards of the registry.
+    void *binders [no_of_endpoints];
+    char endpoint [32];
+    for (int i = 0; i < no_of_endpoints; ++i) {
+        binders [i] = zmq_socket (ctx, ZMQ_PAIR);
+        assert (binders [i]);
+        sprintf (endpoint, "inproc://endpoint%d", i);
+        int rc = zmq_bind (binders [i], endpoint);
+        assert (rc == 0);
+    }
+
+    void *dup = zmq_socket (ctx, ZMQ_PAIR);
+    assert (dup);
+    int rc = zmq_bind (dup, "inproc://endpoint7");
+    assert (rc == -1 && errno == EADDRINUSE);
+    rc = zmq_close (dup);
+    assert (rc == 0);
+
+    //  Short-lived sockets connecting to each of them.
+    for (int i = 0; i < no_of_endpoints; ++i) {
+        void *connector = zmq_socket (ctx, ZMQ_PAIR);
+        assert (connector);
+        sprintf (endpoint, "inproc://endpoint%d", i);
+        rc = zmq_connect (connector, endpoint);
+        assert (rc == 0);
+        bounce (binders [i], connector);
+        rc = zmq_close (connector);
+        assert (rc == 0);
+    }
+
+    for (int i = 0; i < no_of_endpoints; ++i) {
+        rc = zmq_close (binders [i]);
+        assert (rc == 0);
+    }
+
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+}
+
 int main (void)
 {
     setup_test_environment();
@@ -423,6 +468,7 @@ int main (void)
     test_simultaneous_connect_bind_threads ();
     test_identity ();
     test_connect_only ();
+    test_many_endpoints ();
 
     return 0;
 }
@@ -0,0 +1,148 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testutil.hpp"
+
+static int read_all (void *socket_, zmq_monitor_record_t *records_, int count_)
+{
+    int n = zmq_monitor_read (socket_, records_, count_);
+    assert (n >= 0);
+    return n;
+}
+
+static zmq_monitor_record_t *find (zmq_monitor_record_t *records_, int count_,
+    uint32_t event_)
+{
+    for (int i = 0; i < count_; i++)
+        if (records_ [i].event == event_)
+            return &records_ [i];
+    return NULL;
+}
+
+static void test_connection_events (void *ctx_)
+{
+    void *rep = zmq_socket (ctx_, ZMQ_REP);
+    assert (rep);
+    int rc = zmq_socket_monitor_ring (rep, ZMQ_EVENT_LISTENING |
+        ZMQ_EVENT_ACCEPTED | ZMQ_EVENT_HANDSHAKE_SUCCEEDED |
+        ZMQ_EVENT_DISCONNECTED, 64);
+    assert (rc == 0);
+    rc = zmq_bind (rep, "tcp://127.0.0.1:5566");
+    assert (rc == 0);
+
+    void *req = zmq_socket (ctx_, ZMQ_REQ);
+    assert (req);
+    rc = zmq_connect (req, "tcp://127.0.0.1:5566");
+    assert (rc == 0);
+    bounce (rep, req);
+    rc = zmq_close (req);
+    assert (rc == 0);
+    msleep (SETTLE_TIME);
+
+    zmq_monitor_record_t records [64];
+    int n = read_all (rep, records, 64);
+    assert (n == 4);
+    assert (records [0].event == ZMQ_EVENT_LISTENING);
+    assert (strcmp (records [0].endpoint, "tcp://127.0.0.1:5566") == 0);
+
+    zmq_monitor_record_t *accepted = find (records, n, ZMQ_EVENT_ACCEPTED);
+    assert (accepted);
+    assert (strcmp (accepted->peer_address, "127.0.0.1") == 0);
+    assert (accepted->timestamp >= records [0].timestamp);
+
+    zmq_monitor_record_t *ready = find (records, n,
+        ZMQ_EVENT_HANDSHAKE_SUCCEEDED);
+    assert (ready);
+    assert (ready->mechanism == ZMQ_NULL);
+    assert (ready->timestamp >= accepted->timestamp);
+
+    zmq_monitor_record_t *gone = find (records, n, ZMQ_EVENT_DISCONNECTED);
+    assert (gone);
+    assert (strcmp (gone->peer_address, "127.0.0.1") == 0);
+    assert (gone->bytes_in > 0 && gone->bytes_out > 0);
+    assert (gone->msgs_in > 0 && gone->msgs_out > 0);
+
+    //  Nothing more to read.
+    n = read_all (rep, records, 64);
+    assert (n == 0);
+
+    rc = zmq_close (rep);
+    assert (rc == 0);
+}
+
+static void test_overflow (void *ctx_)
+{
+    void *pub = zmq_socket (ctx_, ZMQ_PUB);
+    assert (pub);
+
+    //  Reading without a ring is an error.
+    zmq_monitor_record_t records [4];
+    int rc = zmq_monitor_read (pub, records, 4);
+    assert (rc == -1 && errno == EINVAL);
+
+    rc = zmq_socket_monitor_ring (pub, ZMQ_EVENT_LISTENING, 0);
+    assert (rc == -1 && errno == EINVAL);
+    //  The capacity is rounded up to two records.
+    rc = zmq_socket_monitor_ring (pub, ZMQ_EVENT_LISTENING, 1);
+    assert (rc == 0);
+
+    rc = zmq_bind (pub, "tcp://127.0.0.1:5567");
+    assert (rc == 0);
+    rc = zmq_bind (pub, "tcp://127.0.0.1:5568");
+    assert (rc == 0);
+    rc = zmq_bind (pub, "tcp://127.0.0.1:5569");
+    assert (rc == 0);
+
+    //  The first two records made it, the third one was lost.
+    rc = zmq_monitor_read (pub, records, 4);
+    assert (rc == 3);
+    assert (records [0].event == ZMQ_EVENT_LISTENING);
+    assert (strcmp (records [0].endpoint, "tcp://127.0.0.1:5567") == 0);
+    assert (records [1].event == ZMQ_EVENT_LISTENING);
+    assert (strcmp (records [1].endpoint, "tcp://127.0.0.1:5568") == 0);
+    assert (records [2].event == ZMQ_EVENT_MONITOR_OVERFLOW);
+    assert (records [2].value == 1);
+
+    //  Stopped monitoring records nothing.
+    rc = zmq_socket_monitor_ring (pub, 0, 0);
+    assert (rc == 0);
+    rc = zmq_bind (pub, "tcp://127.0.0.1:5570");
+    assert (rc == 0);
+    rc = zmq_monitor_read (pub, records, 4);
+    assert (rc == 0);
+
+    rc = zmq_close (pub);
+    assert (rc == 0);
+}
+
+int main (void)
+{
+    setup_test_environment();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    test_connection_events (ctx);
+    test_overflow (ctx);
+
+    int rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+
+    return 0;
+}
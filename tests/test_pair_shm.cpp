@@ -0,0 +1,86 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testutil.hpp"
+
+int main (void)
+{
+    setup_test_environment();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    void *sb = zmq_socket (ctx, ZMQ_PAIR);
+    assert (sb);
+    int rc = zmq_bind (sb, "shm:///tmp/tester_shm");
+    assert (rc == 0);
+
+    void *sc = zmq_socket (ctx, ZMQ_PAIR);
+    assert (sc);
+    rc = zmq_connect (sc, "shm:///tmp/tester_shm");
+    assert (rc == 0);
+
+    bounce (sb, sc);
+
+    //  Messages larger than a ring wrap around it several times.
+    const size_t size = 10 * 1024 * 1024;
+    char *body = (char *) malloc (size);
+    assert (body);
+    for (size_t i = 0; i < size; ++i)
+        body [i] = (char) (i * 7);
+
+    for (int round = 0; round < 3; ++round) {
+        rc = zmq_send (sc, body, size, 0);
+        assert (rc == (int) size);
+    }
+    zmq_msg_t msg;
+    for (int round = 0; round < 3; ++round) {
+        rc = zmq_msg_init (&msg);
+        assert (rc == 0);
+        rc = zmq_msg_recv (&msg, sb, 0);
+        assert (rc == (int) size);
+        assert (memcmp (zmq_msg_data (&msg), body, size) == 0);
+        rc = zmq_msg_close (&msg);
+        assert (rc == 0);
+    }
+    free (body);
+
+    //  Security mechanisms are not available over shared memory.
+    void *sp = zmq_socket (ctx, ZMQ_PAIR);
+    assert (sp);
+    int as_server = 1;
+    rc = zmq_setsockopt (sp, ZMQ_PLAIN_SERVER, &as_server, sizeof (int));
+    assert (rc == 0);
+    rc = zmq_bind (sp, "shm:///tmp/tester_shm_plain");
+    assert (rc == -1 && zmq_errno () == ENOCOMPATPROTO);
+
+    rc = zmq_close (sp);
+    assert (rc == 0);
+
+    rc = zmq_close (sc);
+    assert (rc == 0);
+
+    rc = zmq_close (sb);
+    assert (rc == 0);
+
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+
+    return 0 ;
+}
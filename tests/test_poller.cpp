@@ -0,0 +1,121 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testutil.hpp"
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    //  Many idle pairs and a single busy one
+    const int count = 100;
+    void *servers [count];
+    void *clients [count];
+    void *poller = zmq_poller_new ();
+    assert (poller);
+
+    for (int i = 0; i < count; i++) {
+        char endpoint [32];
+        sprintf (endpoint, "inproc://poller-%d", i);
+        servers [i] = zmq_socket (ctx, ZMQ_PAIR);
+        assert (servers [i]);
+        int rc = zmq_bind (servers [i], endpoint);
+        assert (rc == 0);
+        clients [i] = zmq_socket (ctx, ZMQ_PAIR);
+        assert (clients [i]);
+        rc = zmq_connect (clients [i], endpoint);
+        assert (rc == 0);
+        rc = zmq_poller_add (poller, servers [i], &servers [i], ZMQ_POLLIN);
+        assert (rc == 0);
+    }
+
+    //  Adding the same socket twice fails
+    int rc = zmq_poller_add (poller, servers [0], NULL, ZMQ_POLLIN);
+    assert (rc == -1 && errno == EINVAL);
+
+    //  Nothing to read yet
+    zmq_poller_event_t events [4];
+    rc = zmq_poller_wait_all (poller, events, 4, 0);
+    assert (rc == 0);
+    rc = zmq_poller_wait_all (poller, events, 4, 50);
+    assert (rc == 0);
+
+    //  Only the socket with a message is reported
+    rc = zmq_send (clients [42], "A", 1, 0);
+    assert (rc == 1);
+    rc = zmq_poller_wait_all (poller, events, 4, -1);
+    assert (rc == 1);
+    assert (events [0].socket == servers [42]);
+    assert (events [0].user_data == &servers [42]);
+    assert (events [0].events == ZMQ_POLLIN);
+
+    //  It stays ready until the message is read
+    rc = zmq_poller_wait (poller, events, 0);
+    assert (rc == 1);
+    assert (events [0].socket == servers [42]);
+    char buf [1];
+    rc = zmq_recv (servers [42], buf, 1, 0);
+    assert (rc == 1);
+    rc = zmq_poller_wait (poller, events, 0);
+    assert (rc == 0);
+
+    //  Several ready sockets are all reported, in turns if need be
+    rc = zmq_send (clients [1], "B", 1, 0);
+    assert (rc == 1);
+    rc = zmq_send (clients [2], "C", 1, 0);
+    assert (rc == 1);
+    rc = zmq_poller_wait (poller, events, 1000);
+    assert (rc == 1);
+    void *first = events [0].socket;
+    rc = zmq_poller_wait (poller, events, 1000);
+    assert (rc == 1);
+    assert (events [0].socket != first);
+    rc = zmq_poller_wait_all (poller, events, 4, 1000);
+    assert (rc == 2);
+
+    //  Modified and removed sockets are no longer reported for reading
+    rc = zmq_poller_modify (poller, servers [1], ZMQ_POLLOUT);
+    assert (rc == 0);
+    rc = zmq_poller_remove (poller, servers [2]);
+    assert (rc == 0);
+    rc = zmq_poller_remove (poller, servers [2]);
+    assert (rc == -1 && errno == EINVAL);
+    rc = zmq_poller_wait_all (poller, events, 4, 0);
+    assert (rc == 1);
+    assert (events [0].socket == servers [1]);
+    assert (events [0].events == ZMQ_POLLOUT);
+
+    rc = zmq_poller_destroy (&poller);
+    assert (rc == 0);
+    assert (poller == NULL);
+
+    for (int i = 0; i < count; i++) {
+        rc = zmq_close (servers [i]);
+        assert (rc == 0);
+        rc = zmq_close (clients [i]);
+        assert (rc == 0);
+    }
+
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+    return 0 ;
+}
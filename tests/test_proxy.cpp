@@ -0,0 +1,217 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testutil.hpp"
+
+//  Sockets handed over to the proxy thread
+struct proxy_sockets_t
+{
+    void *frontend;
+    void *backend;
+    void *control;
+};
+
+static void
+proxy_task (void *arg)
+{
+    proxy_sockets_t *sockets = (proxy_sockets_t *) arg;
+    int rc = zmq_proxy_steerable (sockets->frontend, sockets->backend,
+        NULL, sockets->control);
+    assert (rc == 0);
+}
+
+//  Reads the STATISTICS reply of the proxy.
+static void
+proxy_stats (void *control, uint64_t *stats)
+{
+    int rc = zmq_send (control, "STATISTICS", 10, 0);
+    assert (rc == 10);
+    for (int i = 0; i < 8; i++) {
+        rc = zmq_recv (control, &stats [i], sizeof (uint64_t), 0);
+        assert (rc == sizeof (uint64_t));
+        int more;
+        size_t more_size = sizeof (more);
+        rc = zmq_getsockopt (control, ZMQ_RCVMORE, &more, &more_size);
+        assert (rc == 0);
+        assert (more == (i < 7));
+    }
+}
+
+static void
+test_request_reply (void *ctx)
+{
+    proxy_sockets_t sockets;
+    sockets.frontend = zmq_socket (ctx, ZMQ_ROUTER);
+    assert (sockets.frontend);
+    int rc = zmq_bind (sockets.frontend, "inproc://frontend");
+    assert (rc == 0);
+    sockets.backend = zmq_socket (ctx, ZMQ_DEALER);
+    assert (sockets.backend);
+    rc = zmq_bind (sockets.backend, "inproc://backend");
+    assert (rc == 0);
+    sockets.control = zmq_socket (ctx, ZMQ_REP);
+    assert (sockets.control);
+    rc = zmq_bind (sockets.control, "inproc://control");
+    assert (rc == 0);
+
+    void *client = zmq_socket (ctx, ZMQ_DEALER);
+    assert (client);
+    rc = zmq_connect (client, "inproc://frontend");
+    assert (rc == 0);
+    void *worker = zmq_socket (ctx, ZMQ_DEALER);
+    assert (worker);
+    rc = zmq_connect (worker, "inproc://backend");
+    assert (rc == 0);
+    void *control = zmq_socket (ctx, ZMQ_REQ);
+    assert (control);
+    rc = zmq_connect (control, "inproc://control");
+    assert (rc == 0);
+
+    void *thread = zmq_threadstart (&proxy_task, &sockets);
+
+    //  Send a burst of requests through the proxy and echo them back
+    const int count = 1000;
+    for (int i = 0; i < count; i++) {
+        rc = zmq_send (client, "ABC", 3, 0);
+        assert (rc == 3);
+    }
+    for (int i = 0; i < count; i++) {
+        zmq_msg_t identity;
+        rc = zmq_msg_init (&identity);
+        assert (rc == 0);
+        rc = zmq_msg_recv (&identity, worker, 0);
+        assert (rc > 0);
+        assert (zmq_msg_more (&identity));
+        char buf [3];
+        rc = zmq_recv (worker, buf, 3, 0);
+        assert (rc == 3);
+        rc = zmq_msg_send (&identity, worker, ZMQ_SNDMORE);
+        assert (rc > 0);
+        rc = zmq_send (worker, buf, 3, 0);
+        assert (rc == 3);
+    }
+    for (int i = 0; i < count; i++) {
+        char buf [3];
+        rc = zmq_recv (client, buf, 3, 0);
+        assert (rc == 3);
+        assert (memcmp (buf, "ABC", 3) == 0);
+    }
+
+    //  Each message is an identity frame plus a payload frame on the
+    //  frontend, and the same two frames on the backend
+    uint64_t stats [8];
+    proxy_stats (control, stats);
+    assert (stats [0] == 2 * count);        //  Frontend parts in
+    assert (stats [2] == 2 * count);        //  Frontend parts out
+    assert (stats [4] == 2 * count);        //  Backend parts in
+    assert (stats [6] == 2 * count);        //  Backend parts out
+    assert (stats [5] == stats [1]);        //  Bytes are passed through
+
+    rc = zmq_send (control, "TERMINATE", 9, 0);
+    assert (rc == 9);
+    zmq_threadclose (thread);
+
+    close_zero_linger (control);
+    close_zero_linger (client);
+    close_zero_linger (worker);
+    close_zero_linger (sockets.frontend);
+    close_zero_linger (sockets.backend);
+    close_zero_linger (sockets.control);
+}
+
+//  A PULL to PUSH streamer only forwards one way; the backend has no
+//  input to read replies from.
+static void
+test_streamer (void *ctx)
+{
+    proxy_sockets_t sockets;
+    sockets.frontend = zmq_socket (ctx, ZMQ_PULL);
+    assert (sockets.frontend);
+    int rc = zmq_bind (sockets.frontend, "inproc://streamer-frontend");
+    assert (rc == 0);
+    sockets.backend = zmq_socket (ctx, ZMQ_PUSH);
+    assert (sockets.backend);
+    rc = zmq_bind (sockets.backend, "inproc://streamer-backend");
+    assert (rc == 0);
+    sockets.control = zmq_socket (ctx, ZMQ_REP);
+    assert (sockets.control);
+    rc = zmq_bind (sockets.control, "inproc://streamer-control");
+    assert (rc == 0);
+
+    void *producer = zmq_socket (ctx, ZMQ_PUSH);
+    assert (producer);
+    rc = zmq_connect (producer, "inproc://streamer-frontend");
+    assert (rc == 0);
+    void *consumer = zmq_socket (ctx, ZMQ_PULL);
+    assert (consumer);
+    rc = zmq_connect (consumer, "inproc://streamer-backend");
+    assert (rc == 0);
+    void *control = zmq_socket (ctx, ZMQ_REQ);
+    assert (control);
+    rc = zmq_connect (control, "inproc://streamer-control");
+    assert (rc == 0);
+
+    void *thread = zmq_threadstart (&proxy_task, &sockets);
+
+    const int count = 1000;
+    for (int i = 0; i < count; i++) {
+        rc = zmq_send (producer, &i, sizeof (i), 0);
+        assert (rc == sizeof (i));
+    }
+    for (int i = 0; i < count; i++) {
+        int value;
+        rc = zmq_recv (consumer, &value, sizeof (value), 0);
+        assert (rc == sizeof (value));
+        assert (value == i);
+    }
+
+    uint64_t stats [8];
+    proxy_stats (control, stats);
+    assert (stats [0] == count);            //  Frontend parts in
+    assert (stats [2] == 0);                //  Frontend parts out
+    assert (stats [4] == 0);                //  Backend parts in
+    assert (stats [6] == count);            //  Backend parts out
+
+    //  The proxy thread asserts that zmq_proxy_steerable returned 0.
+    rc = zmq_send (control, "TERMINATE", 9, 0);
+    assert (rc == 9);
+    zmq_threadclose (thread);
+
+    close_zero_linger (control);
+    close_zero_linger (producer);
+    close_zero_linger (consumer);
+    close_zero_linger (sockets.frontend);
+    close_zero_linger (sockets.backend);
+    close_zero_linger (sockets.control);
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    test_request_reply (ctx);
+    test_streamer (ctx);
+
+    int rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+    return 0;
+}
@@ -0,0 +1,227 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testutil.hpp"
+
+//  Topics sharing long prefixes, so that matching has to split and merge
+//  trie nodes and compare labels longer than 16 bytes.
+static const char *topics [] = {
+    "abc",
+    "abd",
+    "ab",
+    "0123456789abcdefghijklmnopqrstuvwxyz",
+    "0123456789abcdefghijklmnopqrstuv-xyz",
+    ""
+};
+static const int topic_count = sizeof (topics) / sizeof (topics [0]);
+
+static void expect_topic (void *sub_, const char *topic_)
+{
+    char buff [64];
+    int rc = zmq_recv (sub_, buff, sizeof (buff), 0);
+    assert (rc == (int) strlen (topic_));
+    assert (memcmp (buff, topic_, rc) == 0);
+}
+
+static void expect_nothing (void *sub_)
+{
+    char buff [64];
+    int rc = zmq_recv (sub_, buff, sizeof (buff), ZMQ_DONTWAIT);
+    assert (rc == -1 && errno == EAGAIN);
+}
+
+static void test_batch (void *ctx_)
+{
+    void *pub = zmq_socket (ctx_, ZMQ_XPUB);
+    assert (pub);
+    int batch = 4;
+    int rc = zmq_setsockopt (pub, ZMQ_XPUB_BATCH, &batch, sizeof (batch));
+    assert (rc == 0);
+    rc = zmq_bind (pub, "tcp://127.0.0.1:5563");
+    assert (rc == 0);
+
+    void *sub = zmq_socket (ctx_, ZMQ_SUB);
+    assert (sub);
+    rc = zmq_setsockopt (sub, ZMQ_SUBSCRIBE, "", 0);
+    assert (rc == 0);
+    rc = zmq_connect (sub, "tcp://127.0.0.1:5563");
+    assert (rc == 0);
+
+    char buff [64];
+    rc = zmq_recv (pub, buff, sizeof (buff), 0);
+    assert (rc == 1 && buff [0] == 1);
+
+    //  An incomplete batch is delivered when the publisher is polled.
+    for (int i = 0; i < 3; i++) {
+        rc = zmq_send (pub, "abc", 3, 0);
+        assert (rc == 3);
+    }
+    int events;
+    size_t events_size = sizeof (events);
+    rc = zmq_getsockopt (pub, ZMQ_EVENTS, &events, &events_size);
+    assert (rc == 0);
+    for (int i = 0; i < 3; i++)
+        expect_topic (sub, "abc");
+
+    //  A complete batch goes out straight away.
+    for (int i = 0; i < 4; i++) {
+        rc = zmq_send (pub, "abd", 3, 0);
+        assert (rc == 3);
+    }
+    for (int i = 0; i < 4; i++)
+        expect_topic (sub, "abd");
+
+    rc = zmq_close (sub);
+    assert (rc == 0);
+    rc = zmq_close (pub);
+    assert (rc == 0);
+}
+
+//  A publisher that is never polled nor called again still delivers an
+//  incomplete batch, shortly after.
+static void test_batch_unpolled (void *ctx_)
+{
+    void *pub = zmq_socket (ctx_, ZMQ_PUB);
+    assert (pub);
+    int batch = 100;
+    int rc = zmq_setsockopt (pub, ZMQ_XPUB_BATCH, &batch, sizeof (batch));
+    assert (rc == 0);
+    rc = zmq_bind (pub, "inproc://batch-unpolled");
+    assert (rc == 0);
+
+    void *sub = zmq_socket (ctx_, ZMQ_SUB);
+    assert (sub);
+    rc = zmq_setsockopt (sub, ZMQ_SUBSCRIBE, "", 0);
+    assert (rc == 0);
+    int timeout = 1000;
+    rc = zmq_setsockopt (sub, ZMQ_RCVTIMEO, &timeout, sizeof (timeout));
+    assert (rc == 0);
+    rc = zmq_connect (sub, "inproc://batch-unpolled");
+    assert (rc == 0);
+    msleep (SETTLE_TIME);
+
+    for (int i = 0; i < 3; i++) {
+        rc = zmq_send (pub, "abc", 3, 0);
+        assert (rc == 3);
+    }
+    for (int i = 0; i < 3; i++)
+        expect_topic (sub, "abc");
+
+    rc = zmq_close (sub);
+    assert (rc == 0);
+    rc = zmq_close (pub);
+    assert (rc == 0);
+}
+
+int main (void)
+{
+    setup_test_environment();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    void *pub = zmq_socket (ctx, ZMQ_XPUB);
+    assert (pub);
+    int rc = zmq_bind (pub, "tcp://127.0.0.1:5562");
+    assert (rc == 0);
+
+    //  One subscriber per topic.
+    void *subs [topic_count];
+    for (int i = 0; i < topic_count; i++) {
+        subs [i] = zmq_socket (ctx, ZMQ_SUB);
+        assert (subs [i]);
+        rc = zmq_setsockopt (subs [i], ZMQ_SUBSCRIBE, topics [i],
+            strlen (topics [i]));
+        assert (rc == 0);
+        rc = zmq_connect (subs [i], "tcp://127.0.0.1:5562");
+        assert (rc == 0);
+    }
+
+    //  Wait until all the subscriptions have reached the publisher.
+    char buff [64];
+    for (int i = 0; i < topic_count; i++) {
+        rc = zmq_recv (pub, buff, sizeof (buff), 0);
+        assert (rc >= 1 && buff [0] == 1);
+    }
+
+    //  Publish every topic once; each subscriber gets exactly the topics
+    //  its subscription is a prefix of.
+    for (int i = 0; i < topic_count; i++) {
+        rc = zmq_send (pub, topics [i], strlen (topics [i]), 0);
+        assert (rc == (int) strlen (topics [i]));
+    }
+    rc = zmq_send (pub, "abcdef", 6, 0);
+    assert (rc == 6);
+    rc = zmq_send (pub, "0123456789abcdefghijklmnopq", 27, 0);
+    assert (rc == 27);
+
+    //  "abc"
+    expect_topic (subs [0], "abc");
+    expect_topic (subs [0], "abcdef");
+    //  "abd"
+    expect_topic (subs [1], "abd");
+    //  "ab"
+    expect_topic (subs [2], "abc");
+    expect_topic (subs [2], "abd");
+    expect_topic (subs [2], "ab");
+    expect_topic (subs [2], "abcdef");
+    //  The two long topics differ at byte 32 only.
+    expect_topic (subs [3], topics [3]);
+    expect_topic (subs [4], topics [4]);
+    //  Everything
+    for (int i = 0; i < topic_count; i++)
+        expect_topic (subs [5], topics [i]);
+    expect_topic (subs [5], "abcdef");
+    expect_topic (subs [5], "0123456789abcdefghijklmnopq");
+
+    msleep (SETTLE_TIME);
+    for (int i = 0; i < topic_count; i++)
+        expect_nothing (subs [i]);
+
+    //  Dropping a subscriber removes its topic from the publisher.
+    rc = zmq_close (subs [2]);
+    assert (rc == 0);
+    rc = zmq_recv (pub, buff, sizeof (buff), 0);
+    assert (rc == 3 && buff [0] == 0 && memcmp (buff + 1, "ab", 2) == 0);
+
+    rc = zmq_send (pub, "abx", 3, 0);
+    assert (rc == 3);
+    expect_topic (subs [5], "abx");
+    msleep (SETTLE_TIME);
+    expect_nothing (subs [0]);
+    expect_nothing (subs [1]);
+
+    //  Clean up.
+    for (int i = 0; i < topic_count; i++) {
+        if (i == 2)
+            continue;
+        rc = zmq_close (subs [i]);
+        assert (rc == 0);
+    }
+    rc = zmq_close (pub);
+    assert (rc == 0);
+
+    test_batch (ctx);
+    test_batch_unpolled (ctx);
+
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testutil.hpp"
+
+static void test_options (void *ctx_)
+{
+    void *socket = zmq_socket (ctx_, ZMQ_PUSH);
+    assert (socket);
+
+    int value;
+    size_t value_size = sizeof (value);
+    int rc = zmq_getsockopt (socket, ZMQ_RESEND_UNSENT, &value, &value_size);
+    assert (rc == 0);
+    assert (value == 0);
+    value = 1;
+    rc = zmq_setsockopt (socket, ZMQ_RESEND_UNSENT, &value, sizeof (value));
+    assert (rc == 0);
+    rc = zmq_getsockopt (socket, ZMQ_RESEND_UNSENT, &value, &value_size);
+    assert (rc == 0);
+    assert (value == 1);
+    value = 2;
+    rc = zmq_setsockopt (socket, ZMQ_RESEND_UNSENT, &value, sizeof (value));
+    assert (rc == -1 && errno == EINVAL);
+
+    rc = zmq_close (socket);
+    assert (rc == 0);
+}
+
+static void *small_buffers_pull (void *ctx_, const char *endpoint_)
+{
+    void *pull = zmq_socket (ctx_, ZMQ_PULL);
+    assert (pull);
+    int value = 1;
+    int rc = zmq_setsockopt (pull, ZMQ_RCVHWM, &value, sizeof (value));
+    assert (rc == 0);
+    value = 4096;
+    rc = zmq_setsockopt (pull, ZMQ_RCVBUF, &value, sizeof (value));
+    assert (rc == 0);
+    value = 0;
+    rc = zmq_setsockopt (pull, ZMQ_LINGER, &value, sizeof (value));
+    assert (rc == 0);
+    rc = zmq_bind (pull, endpoint_);
+    assert (rc == 0);
+    return pull;
+}
+
+static void test_resend (void *ctx_)
+{
+    const int count = 200;
+    const size_t size = 8192;
+
+    void *push = zmq_socket (ctx_, ZMQ_PUSH);
+    assert (push);
+    int value = 1;
+    int rc = zmq_setsockopt (push, ZMQ_RESEND_UNSENT, &value, sizeof (value));
+    assert (rc == 0);
+    value = count;
+    rc = zmq_setsockopt (push, ZMQ_SNDHWM, &value, sizeof (value));
+    assert (rc == 0);
+    value = 4096;
+    rc = zmq_setsockopt (push, ZMQ_SNDBUF, &value, sizeof (value));
+    assert (rc == 0);
+
+    void *pull = small_buffers_pull (ctx_, "tcp://127.0.0.1:5575");
+    rc = zmq_connect (push, "tcp://127.0.0.1:5575");
+    assert (rc == 0);
+
+    //  Two-part messages, far more than the buffers on the way hold.
+    unsigned char body [size];
+    for (int i = 0; i < count; i++) {
+        rc = zmq_send (push, &i, sizeof (i), ZMQ_SNDMORE);
+        assert (rc == sizeof (i));
+        memset (body, i & 0xff, size);
+        rc = zmq_send (push, body, size, 0);
+        assert (rc == (int) size);
+    }
+    msleep (SETTLE_TIME);
+
+    //  Cut the connection in the middle of the stream.
+    rc = zmq_close (pull);
+    assert (rc == 0);
+    msleep (SETTLE_TIME);
+    pull = small_buffers_pull (ctx_, "tcp://127.0.0.1:5575");
+
+    //  What the first peer took is lost; the rest arrives whole and in
+    //  order, starting with the message that was cut off.
+    int timeout = 2000;
+    rc = zmq_setsockopt (pull, ZMQ_RCVTIMEO, &timeout, sizeof (timeout));
+    assert (rc == 0);
+    int expected = -1;
+    while (expected < count - 1) {
+        int seq;
+        rc = zmq_recv (pull, &seq, sizeof (seq), 0);
+        assert (rc == sizeof (seq));
+        assert (expected == -1 || seq == expected + 1);
+        expected = seq;
+
+        int more;
+        size_t more_size = sizeof (more);
+        rc = zmq_getsockopt (pull, ZMQ_RCVMORE, &more, &more_size);
+        assert (rc == 0 && more);
+        rc = zmq_recv (pull, body, size, 0);
+        assert (rc == (int) size);
+        for (size_t j = 0; j < size; j++)
+            assert (body [j] == (seq & 0xff));
+    }
+
+    rc = zmq_close (push);
+    assert (rc == 0);
+    rc = zmq_close (pull);
+    assert (rc == 0);
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    test_options (ctx);
+    test_resend (ctx);
+
+    int rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+    return 0 ;
+}
@@ -89,6 +89,127 @@ static void zap_handler (void *handler)
     zmq_close (handler);
 }
 
+//  --------------------------------------------------------------------------
+//  Resumption tickets: the server reports in its monitor ring whether a
+//  handshake was resumed. Unbinding closes the accepted connections, so
+//  the client reconnects on the same session, which keeps its ticket.
+
+static void *ticket_server (void *ctx_, int ticket_ttl_)
+{
+    void *server = zmq_socket (ctx_, ZMQ_DEALER);
+    assert (server);
+    int as_server = 1;
+    int rc = zmq_setsockopt (server, ZMQ_CURVE_SERVER, &as_server, sizeof (int));
+    assert (rc == 0);
+    rc = zmq_setsockopt (server, ZMQ_CURVE_SECRETKEY, server_secret, 40);
+    assert (rc == 0);
+    rc = zmq_setsockopt (server, ZMQ_CURVE_TICKET_TTL, &ticket_ttl_, sizeof (int));
+    assert (rc == 0);
+    rc = zmq_socket_monitor_ring (server, ZMQ_EVENT_HANDSHAKE_SUCCEEDED, 16);
+    assert (rc == 0);
+    rc = zmq_bind (server, "tcp://127.0.0.1:9997");
+    assert (rc == 0);
+    return server;
+}
+
+static void *ticket_client (void *ctx_, int ticket_ttl_)
+{
+    void *client = zmq_socket (ctx_, ZMQ_DEALER);
+    assert (client);
+    int rc = zmq_setsockopt (client, ZMQ_CURVE_SERVERKEY, server_public, 40);
+    assert (rc == 0);
+    rc = zmq_setsockopt (client, ZMQ_CURVE_PUBLICKEY, client_public, 40);
+    assert (rc == 0);
+    rc = zmq_setsockopt (client, ZMQ_CURVE_SECRETKEY, client_secret, 40);
+    assert (rc == 0);
+    rc = zmq_setsockopt (client, ZMQ_CURVE_TICKET_TTL, &ticket_ttl_, sizeof (int));
+    assert (rc == 0);
+    rc = zmq_connect (client, "tcp://127.0.0.1:9997");
+    assert (rc == 0);
+    return client;
+}
+
+//  Returns whether the server's next handshake was resumed.
+static int handshake_resumed (void *server_)
+{
+    zmq_monitor_record_t record;
+    for (int i = 0; i != 100; i++) {
+        int rc = zmq_monitor_read (server_, &record, 1);
+        assert (rc == 0 || rc == 1);
+        if (rc == 1) {
+            assert (record.event == ZMQ_EVENT_HANDSHAKE_SUCCEEDED);
+            assert (record.mechanism == ZMQ_CURVE);
+            return record.resumed;
+        }
+        msleep (SETTLE_TIME);
+    }
+    assert (false);
+    return -1;
+}
+
+//  Drops the client's connection; it then reconnects.
+static void restart_listener (void *server_)
+{
+    int rc = zmq_unbind (server_, "tcp://127.0.0.1:9997");
+    assert (rc == 0);
+    //  The listener is closed in the background.
+    for (int i = 0; i != 100; i++) {
+        rc = zmq_bind (server_, "tcp://127.0.0.1:9997");
+        if (rc == 0)
+            return;
+        assert (errno == EADDRINUSE);
+        msleep (SETTLE_TIME);
+    }
+    assert (false);
+}
+
+static void test_ticket_resumption (void *ctx_)
+{
+    void *server = ticket_server (ctx_, 60000);
+    void *client = ticket_client (ctx_, 60000);
+    bounce (server, client);
+    assert (handshake_resumed (server) == 0);
+
+    restart_listener (server);
+    bounce (server, client);
+    assert (handshake_resumed (server) == 1);
+
+    close_zero_linger (client);
+    close_zero_linger (server);
+}
+
+static void test_ticket_not_requested (void *ctx_)
+{
+    void *server = ticket_server (ctx_, 60000);
+    void *client = ticket_client (ctx_, 0);
+    bounce (server, client);
+    assert (handshake_resumed (server) == 0);
+
+    restart_listener (server);
+    bounce (server, client);
+    assert (handshake_resumed (server) == 0);
+
+    close_zero_linger (client);
+    close_zero_linger (server);
+}
+
+static void test_ticket_expired (void *ctx_)
+{
+    void *server = ticket_server (ctx_, 200);
+    void *client = ticket_client (ctx_, 60000);
+    bounce (server, client);
+    assert (handshake_resumed (server) == 0);
+
+    //  The expired ticket is refused and the handshake done in full.
+    msleep (500);
+    restart_listener (server);
+    bounce (server, client);
+    assert (handshake_resumed (server) == 0);
+
+    close_zero_linger (client);
+    close_zero_linger (server);
+}
+
 
 int main (void)
 {
@@ -277,5 +398,67 @@ int main (void)
     //  Wait until ZAP handler terminates
     zmq_threadclose (zap_thread);
 
+    //  Check CURVE handshake offloaded to crypto threads, with the
+    //  server issuing resumption tickets
+    ctx = zmq_ctx_new ();
+    assert (ctx);
+    rc = zmq_ctx_set (ctx, ZMQ_CRYPTO_THREADS, 2);
+    assert (rc == 0);
+    assert (zmq_ctx_get (ctx, ZMQ_CRYPTO_THREADS) == 2);
+
+    server = zmq_socket (ctx, ZMQ_DEALER);
+    assert (server);
+    rc = zmq_setsockopt (server, ZMQ_CURVE_SERVER, &as_server, sizeof (int));
+    assert (rc == 0);
+    rc = zmq_setsockopt (server, ZMQ_CURVE_SECRETKEY, server_secret, 40);
+    assert (rc == 0);
+    int ticket_ttl = 60000;
+    rc = zmq_setsockopt (server, ZMQ_CURVE_TICKET_TTL, &ticket_ttl, sizeof (int));
+    assert (rc == 0);
+    ticket_ttl = 0;
+    size_t ticket_ttl_size = sizeof (int);
+    rc = zmq_getsockopt (server, ZMQ_CURVE_TICKET_TTL, &ticket_ttl, &ticket_ttl_size);
+    assert (rc == 0);
+    assert (ticket_ttl == 60000);
+    rc = zmq_bind (server, "tcp://127.0.0.1:9998");
+    assert (rc == 0);
+
+    client = zmq_socket (ctx, ZMQ_DEALER);
+    assert (client);
+    rc = zmq_setsockopt (client, ZMQ_CURVE_SERVERKEY, server_public, 40);
+    assert (rc == 0);
+    rc = zmq_setsockopt (client, ZMQ_CURVE_PUBLICKEY, client_public, 40);
+    assert (rc == 0);
+    rc = zmq_setsockopt (client, ZMQ_CURVE_SECRETKEY, client_secret, 40);
+    assert (rc == 0);
+    rc = zmq_connect (client, "tcp://localhost:9998");
+    assert (rc == 0);
+    bounce (server, client);
+    rc = zmq_close (client);
+    assert (rc == 0);
+
+    client = zmq_socket (ctx, ZMQ_DEALER);
+    assert (client);
+    rc = zmq_setsockopt (client, ZMQ_CURVE_SERVERKEY, garbage_key, 40);
+    assert (rc == 0);
+    rc = zmq_setsockopt (client, ZMQ_CURVE_PUBLICKEY, client_public, 40);
+    assert (rc == 0);
+    rc = zmq_setsockopt (client, ZMQ_CURVE_SECRETKEY, client_secret, 40);
+    assert (rc == 0);
+    rc = zmq_connect (client, "tcp://localhost:9998");
+    assert (rc == 0);
+    expect_bounce_fail (server, client);
+    close_zero_linger (client);
+
+    rc = zmq_close (server);
+    assert (rc == 0);
+
+    test_ticket_resumption (ctx);
+    test_ticket_not_requested (ctx);
+    test_ticket_expired (ctx);
+
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+
     return 0;
 }
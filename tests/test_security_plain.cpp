@@ -30,14 +30,19 @@
 #   include <unistd.h>
 #endif
 
+//  The ZAP socket and a socket telling the main thread about every
+//  request the handler answers.
+struct zap_sockets_t
+{
+    void *zap;
+    void *requests;
+};
+
 static void
-zap_handler (void *ctx)
+zap_handler (void *args)
 {
-    //  Create and bind ZAP socket
-    void *zap = zmq_socket (ctx, ZMQ_REP);
-    assert (zap);
-    int rc = zmq_bind (zap, "inproc://zeromq.zap.01");
-    assert (rc == 0);
+    void *zap = ((zap_sockets_t *) args)->zap;
+    void *requests = ((zap_sockets_t *) args)->requests;
 
     //  Process ZAP requests forever
     while (true) {
@@ -54,7 +59,9 @@ zap_handler (void *ctx)
 
         assert (streq (version, "1.0"));
         assert (streq (mechanism, "PLAIN"));
-        assert (streq (identity, "IDENT"));
+        assert (streq (identity, "IDENT") || streq (identity, "IDENT2"));
+        int rc = zmq_send (requests, "", 0, 0);
+        assert (rc == 0);
 
         s_sendmore (zap, version);
         s_sendmore (zap, sequence);
@@ -80,23 +87,67 @@ zap_handler (void *ctx)
         free (username);
         free (password);
     }
-    rc = zmq_close (zap);
+    int rc = zmq_close (zap);
+    assert (rc == 0);
+    rc = zmq_close (requests);
     assert (rc == 0);
 }
 
+//  Returns the number of requests answered since the last call. The
+//  handler reports a request before replying, so it is counted by the
+//  time the connection it was for is up.
+static int
+zap_requests (void *requests)
+{
+    int count = 0;
+    while (zmq_recv (requests, NULL, 0, ZMQ_DONTWAIT) == 0)
+        count++;
+    assert (zmq_errno () == EAGAIN);
+    return count;
+}
+
+static void *
+plain_client (void *ctx, const char *username, const char *password)
+{
+    void *client = zmq_socket (ctx, ZMQ_DEALER);
+    assert (client);
+    int rc = zmq_setsockopt (client, ZMQ_PLAIN_USERNAME, username, strlen (username));
+    assert (rc == 0);
+    rc = zmq_setsockopt (client, ZMQ_PLAIN_PASSWORD, password, strlen (password));
+    assert (rc == 0);
+    return client;
+}
+
 int main (void)
 {
     setup_test_environment();
     void *ctx = zmq_ctx_new ();
     assert (ctx);
+    int rc = zmq_ctx_set (ctx, ZMQ_ZAP_CACHE_TTL, 60000);
+    assert (rc == 0);
 
     //  Spawn ZAP handler
-    void *zap_thread = zmq_threadstart (&zap_handler, ctx);
+    //  We create and bind ZAP socket in main thread to avoid case
+    //  where child thread does not start up fast enough.
+    zap_sockets_t zap_sockets;
+    zap_sockets.zap = zmq_socket (ctx, ZMQ_REP);
+    assert (zap_sockets.zap);
+    rc = zmq_bind (zap_sockets.zap, "inproc://zeromq.zap.01");
+    assert (rc == 0);
+    void *requests = zmq_socket (ctx, ZMQ_PULL);
+    assert (requests);
+    rc = zmq_bind (requests, "inproc://zap-requests");
+    assert (rc == 0);
+    zap_sockets.requests = zmq_socket (ctx, ZMQ_PUSH);
+    assert (zap_sockets.requests);
+    rc = zmq_connect (zap_sockets.requests, "inproc://zap-requests");
+    assert (rc == 0);
+    void *zap_thread = zmq_threadstart (&zap_handler, &zap_sockets);
 
     //  Server socket will accept connections
     void *server = zmq_socket (ctx, ZMQ_DEALER);
     assert (server);
-    int rc = zmq_setsockopt (server, ZMQ_IDENTITY, "IDENT", 6);
+    rc = zmq_setsockopt (server, ZMQ_IDENTITY, "IDENT", 6);
     assert (rc == 0);
     int as_server = 1;
     rc = zmq_setsockopt (server, ZMQ_PLAIN_SERVER, &as_server, sizeof (int));
@@ -121,6 +172,46 @@ int main (void)
     bounce (server, client);
     rc = zmq_close (client);
     assert (rc == 0);
+    assert (zap_requests (requests) == 1);
+
+    //  Same credentials again are accepted from the ZAP cache
+    client = plain_client (ctx, username, password);
+    rc = zmq_connect (client, "tcp://localhost:9998");
+    assert (rc == 0);
+    bounce (server, client);
+    rc = zmq_close (client);
+    assert (rc == 0);
+    assert (zap_requests (requests) == 0);
+
+    //  Once invalidated, the ZAP handler is asked again
+    rc = zmq_ctx_zap_invalidate (ctx, "");
+    assert (rc == 0);
+    client = plain_client (ctx, username, password);
+    rc = zmq_connect (client, "tcp://localhost:9998");
+    assert (rc == 0);
+    bounce (server, client);
+    rc = zmq_close (client);
+    assert (rc == 0);
+    assert (zap_requests (requests) == 1);
+
+    //  A socket with another identity is not given the cached decision
+    void *server2 = zmq_socket (ctx, ZMQ_DEALER);
+    assert (server2);
+    rc = zmq_setsockopt (server2, ZMQ_IDENTITY, "IDENT2", 7);
+    assert (rc == 0);
+    rc = zmq_setsockopt (server2, ZMQ_PLAIN_SERVER, &as_server, sizeof (int));
+    assert (rc == 0);
+    rc = zmq_bind (server2, "tcp://127.0.0.1:9999");
+    assert (rc == 0);
+    client = plain_client (ctx, username, password);
+    rc = zmq_connect (client, "tcp://localhost:9999");
+    assert (rc == 0);
+    bounce (server2, client);
+    rc = zmq_close (client);
+    assert (rc == 0);
+    assert (zap_requests (requests) == 1);
+    rc = zmq_close (server2);
+    assert (rc == 0);
 
     //  Check PLAIN security with badly configured client (as_server)
     //  This will be caught by the plain_server class, not passed to ZAP
@@ -175,6 +266,8 @@ int main (void)
     //  Shutdown
     rc = zmq_close (server);
     assert (rc == 0);
+    rc = zmq_close (requests);
+    assert (rc == 0);
     rc = zmq_ctx_term (ctx);
     assert (rc == 0);
 
@@ -72,6 +72,122 @@ void test_round_robin_out (void *ctx)
     assert (rc == 0);
 }
 
+void test_weighted_out (void *ctx)
+{
+    void *dealer = zmq_socket (ctx, ZMQ_DEALER);
+    assert (dealer);
+
+    int policy = ZMQ_LB_LEAST_OUTSTANDING;
+    int rc = zmq_setsockopt (dealer, ZMQ_LB_POLICY, &policy, sizeof (int));
+    assert (rc == 0);
+
+    const char *endpoints [] = { "tcp://127.0.0.1:5556", "tcp://127.0.0.1:5557" };
+    const int weights [] = { 1, 3 };
+    void *rep [2];
+    for (size_t peer = 0; peer < 2; ++peer) {
+        rep [peer] = zmq_socket (ctx, ZMQ_REP);
+        assert (rep [peer]);
+
+        int timeout = 100;
+        rc = zmq_setsockopt (rep [peer], ZMQ_RCVTIMEO, &timeout, sizeof (int));
+        assert (rc == 0);
+
+        rc = zmq_bind (rep [peer], endpoints [peer]);
+        assert (rc == 0);
+
+        // The weight is taken when connecting
+        rc = zmq_setsockopt (dealer, ZMQ_LB_WEIGHT, &weights [peer], sizeof (int));
+        assert (rc == 0);
+        rc = zmq_connect (dealer, endpoints [peer]);
+        assert (rc == 0);
+    }
+
+    // Wait for connections.
+    rc = zmq_poll (0, 0, 100);
+    assert (rc == 0);
+
+    for (int round = 0; round < 2; ++round) {
+        // With three times the weight, the second peer takes two requests
+        // before the first one is as cheap.
+        s_send_seq (dealer, 0, "ABC", SEQ_END);
+        s_send_seq (dealer, 0, "DEF", SEQ_END);
+
+        s_recv_seq (rep [1], "ABC", SEQ_END);
+        s_send_seq (rep [1], "ABC", SEQ_END);
+        s_recv_seq (rep [1], "DEF", SEQ_END);
+        s_send_seq (rep [1], "DEF", SEQ_END);
+
+        // Once the replies are in, nothing is outstanding again.
+        s_recv_seq (dealer, 0, "ABC", SEQ_END);
+        s_recv_seq (dealer, 0, "DEF", SEQ_END);
+    }
+
+    char buffer [32];
+    rc = zmq_recv (rep [0], buffer, sizeof (buffer), 0);
+    assert (rc == -1 && zmq_errno () == EAGAIN);
+
+    close_zero_linger (dealer);
+
+    for (size_t peer = 0; peer < 2; ++peer)
+        close_zero_linger (rep [peer]);
+
+    // Wait for disconnects.
+    rc = zmq_poll (0, 0, 100);
+    assert (rc == 0);
+}
+
+void test_weighted_out_pending (void *ctx)
+{
+    void *dealer = zmq_socket (ctx, ZMQ_DEALER);
+    assert (dealer);
+
+    int policy = ZMQ_LB_LEAST_OUTSTANDING;
+    int rc = zmq_setsockopt (dealer, ZMQ_LB_POLICY, &policy, sizeof (int));
+    assert (rc == 0);
+
+    // The peers connect before the dealer binds with their weights.
+    const char *endpoints [] = { "inproc://weighted-0", "inproc://weighted-1" };
+    const int weights [] = { 1, 3 };
+    void *rep [2];
+    for (size_t peer = 0; peer < 2; ++peer) {
+        rep [peer] = zmq_socket (ctx, ZMQ_REP);
+        assert (rep [peer]);
+
+        int timeout = 100;
+        rc = zmq_setsockopt (rep [peer], ZMQ_RCVTIMEO, &timeout, sizeof (int));
+        assert (rc == 0);
+
+        rc = zmq_connect (rep [peer], endpoints [peer]);
+        assert (rc == 0);
+    }
+    for (size_t peer = 0; peer < 2; ++peer) {
+        rc = zmq_setsockopt (dealer, ZMQ_LB_WEIGHT, &weights [peer], sizeof (int));
+        assert (rc == 0);
+        rc = zmq_bind (dealer, endpoints [peer]);
+        assert (rc == 0);
+    }
+
+    s_send_seq (dealer, 0, "ABC", SEQ_END);
+    s_send_seq (dealer, 0, "DEF", SEQ_END);
+
+    s_recv_seq (rep [1], "ABC", SEQ_END);
+    s_send_seq (rep [1], "ABC", SEQ_END);
+    s_recv_seq (rep [1], "DEF", SEQ_END);
+    s_send_seq (rep [1], "DEF", SEQ_END);
+
+    s_recv_seq (dealer, 0, "ABC", SEQ_END);
+    s_recv_seq (dealer, 0, "DEF", SEQ_END);
+
+    char buffer [32];
+    rc = zmq_recv (rep [0], buffer, sizeof (buffer), 0);
+    assert (rc == -1 && zmq_errno () == EAGAIN);
+
+    close_zero_linger (dealer);
+
+    for (size_t peer = 0; peer < 2; ++peer)
+        close_zero_linger (rep [peer]);
+}
+
 void test_fair_queue_in (void *ctx)
 {
     void *receiver = zmq_socket (ctx, ZMQ_DEALER);
@@ -247,6 +363,10 @@ int main (void)
         // test_destroy_queue_on_disconnect (ctx);
     }
 
+    // Least outstanding requests policy with weighted peers.
+    test_weighted_out (ctx);
+    test_weighted_out_pending (ctx);
+
     int rc = zmq_ctx_term (ctx);
     assert (rc == 0);
 
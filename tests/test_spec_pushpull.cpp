@@ -70,6 +70,117 @@ void test_push_round_robin_out (void *ctx)
     assert (rc == 0);
 }
 
+void test_push_credit_out (void *ctx)
+{
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    assert (push);
+
+    int policy = ZMQ_LB_CREDIT;
+    int rc = zmq_setsockopt (push, ZMQ_LB_POLICY, &policy, sizeof (int));
+    assert (rc == 0);
+
+    rc = zmq_bind (push, bind_address);
+    assert (rc == 0);
+
+    void *pulls [2];
+    for (size_t peer = 0; peer < 2; ++peer) {
+        pulls [peer] = zmq_socket (ctx, ZMQ_PULL);
+        assert (pulls [peer]);
+
+        int timeout = 100;
+        rc = zmq_setsockopt (pulls [peer], ZMQ_RCVTIMEO, &timeout, sizeof (int));
+        assert (rc == 0);
+    }
+
+    // First peer gets the first batch of messages
+    rc = zmq_connect (pulls [0], connect_address);
+    assert (rc == 0);
+    rc = zmq_poll (0, 0, 100);
+    assert (rc == 0);
+
+    const size_t count = 10;
+    for (size_t i = 0; i < count; ++i)
+        s_send_seq (push, "ABC", SEQ_END);
+
+    // Nothing was read by the first peer yet, so the second batch all goes
+    // to the newly connected peer instead of being split between them.
+    rc = zmq_connect (pulls [1], connect_address);
+    assert (rc == 0);
+    rc = zmq_poll (0, 0, 100);
+    assert (rc == 0);
+
+    for (size_t i = 0; i < count; ++i)
+        s_send_seq (push, "DEF", SEQ_END);
+
+    for (size_t i = 0; i < count; ++i) {
+        s_recv_seq (pulls [0], "ABC", SEQ_END);
+        s_recv_seq (pulls [1], "DEF", SEQ_END);
+    }
+
+    close_zero_linger (push);
+
+    for (size_t peer = 0; peer < 2; ++peer)
+        close_zero_linger (pulls [peer]);
+
+    // Wait for disconnects.
+    rc = zmq_poll (0, 0, 100);
+    assert (rc == 0);
+}
+
+void test_push_credit_fast_reader (void *ctx)
+{
+    void *push = zmq_socket (ctx, ZMQ_PUSH);
+    assert (push);
+
+    int policy = ZMQ_LB_CREDIT;
+    int rc = zmq_setsockopt (push, ZMQ_LB_POLICY, &policy, sizeof (int));
+    assert (rc == 0);
+
+    rc = zmq_bind (push, "inproc://credit");
+    assert (rc == 0);
+
+    void *pulls [2];
+    for (size_t peer = 0; peer < 2; ++peer) {
+        pulls [peer] = zmq_socket (ctx, ZMQ_PULL);
+        assert (pulls [peer]);
+
+        int timeout = 100;
+        rc = zmq_setsockopt (pulls [peer], ZMQ_RCVTIMEO, &timeout, sizeof (int));
+        assert (rc == 0);
+
+        rc = zmq_connect (pulls [peer], "inproc://credit");
+        assert (rc == 0);
+    }
+
+    // Both peers have the same room left, so they share the first batch.
+    const size_t count = 16;
+    for (size_t i = 0; i < 2 * count; ++i)
+        s_send_seq (push, "ABC", SEQ_END);
+
+    // Only the first peer reads its share. It reports that well below its
+    // low water mark, so the second batch all goes to it.
+    for (size_t i = 0; i < count; ++i)
+        s_recv_seq (pulls [0], "ABC", SEQ_END);
+    rc = zmq_poll (0, 0, 100);
+    assert (rc == 0);
+
+    for (size_t i = 0; i < count; ++i)
+        s_send_seq (push, "DEF", SEQ_END);
+
+    for (size_t i = 0; i < count; ++i) {
+        s_recv_seq (pulls [0], "DEF", SEQ_END);
+        s_recv_seq (pulls [1], "ABC", SEQ_END);
+    }
+    char buffer [4];
+    rc = zmq_recv (pulls [1], buffer, sizeof (buffer), 0);
+    assert (rc == -1 && zmq_errno () == EAGAIN);
+
+    close_zero_linger (push);
+
+    for (size_t peer = 0; peer < 2; ++peer)
+        close_zero_linger (pulls [peer]);
+}
+
 void test_pull_fair_queue_in (void *ctx)
 {
     void *pull = zmq_socket (ctx, ZMQ_PULL);
@@ -150,6 +261,118 @@ void test_pull_fair_queue_in (void *ctx)
     assert (rc == 0);
 }
 
+void test_pull_priority_in (void *ctx)
+{
+    void *pull = zmq_socket (ctx, ZMQ_PULL);
+    assert (pull);
+
+    int timeout = 100;
+    int rc = zmq_setsockopt (pull, ZMQ_RCVTIMEO, &timeout, sizeof (int));
+    assert (rc == 0);
+
+    // Bulk peer keeps the default priority, control peer is read first.
+    void *bulk = zmq_socket (ctx, ZMQ_PUSH);
+    assert (bulk);
+    rc = zmq_bind (bulk, "tcp://127.0.0.1:5556");
+    assert (rc == 0);
+    rc = zmq_connect (pull, "tcp://localhost:5556");
+    assert (rc == 0);
+
+    void *control = zmq_socket (ctx, ZMQ_PUSH);
+    assert (control);
+    rc = zmq_bind (control, "tcp://127.0.0.1:5557");
+    assert (rc == 0);
+    int priority = 1;
+    rc = zmq_setsockopt (pull, ZMQ_RCVPRIORITY, &priority, sizeof (int));
+    assert (rc == 0);
+    rc = zmq_connect (pull, "tcp://localhost:5557");
+    assert (rc == 0);
+
+    // Wait for connections.
+    rc = zmq_poll (0, 0, 100);
+    assert (rc == 0);
+
+    const size_t bulks = 50;
+    for (size_t i = 0; i < bulks; ++i)
+        s_send_seq (bulk, "BULK", SEQ_END);
+    const size_t controls = 5;
+    for (size_t i = 0; i < controls; ++i)
+        s_send_seq (control, "CTL", SEQ_END);
+    rc = zmq_poll (0, 0, 100);
+    assert (rc == 0);
+
+    // Control messages overtake the queued bulk messages.
+    for (size_t i = 0; i < controls; ++i)
+        s_recv_seq (pull, "CTL", SEQ_END);
+
+    // A control flood does not starve the bulk peer.
+    const size_t flood = 100;
+    for (size_t i = 0; i < flood; ++i)
+        s_send_seq (control, "CTL", SEQ_END);
+    rc = zmq_poll (0, 0, 100);
+    assert (rc == 0);
+
+    size_t bulks_first = 0;
+    for (size_t i = 0; i < flood; ++i) {
+        char buffer [8];
+        rc = zmq_recv (pull, buffer, sizeof (buffer), 0);
+        assert (rc > 0 && buffer [rc - 1] == 0);
+        if (streq (buffer, "BULK"))
+            ++bulks_first;
+        else
+            assert (streq (buffer, "CTL"));
+    }
+    assert (bulks_first > 0);
+    assert (bulks_first < bulks);
+
+    close_zero_linger (pull);
+    close_zero_linger (bulk);
+    close_zero_linger (control);
+
+    // Wait for disconnects.
+    rc = zmq_poll (0, 0, 100);
+    assert (rc == 0);
+}
+
+void test_pull_priority_in_pending (void *ctx)
+{
+    void *pull = zmq_socket (ctx, ZMQ_PULL);
+    assert (pull);
+    int rc = zmq_bind (pull, "inproc://bulk");
+    assert (rc == 0);
+    void *bulk = zmq_socket (ctx, ZMQ_PUSH);
+    assert (bulk);
+    rc = zmq_connect (bulk, "inproc://bulk");
+    assert (rc == 0);
+
+    // The control peer connects before the bind that gives it priority.
+    void *control = zmq_socket (ctx, ZMQ_PUSH);
+    assert (control);
+    rc = zmq_connect (control, "inproc://control");
+    assert (rc == 0);
+    int priority = 1;
+    rc = zmq_setsockopt (pull, ZMQ_RCVPRIORITY, &priority, sizeof (int));
+    assert (rc == 0);
+    rc = zmq_bind (pull, "inproc://control");
+    assert (rc == 0);
+
+    const size_t bulks = 10;
+    for (size_t i = 0; i < bulks; ++i)
+        s_send_seq (bulk, "BULK", SEQ_END);
+    const size_t controls = 5;
+    for (size_t i = 0; i < controls; ++i)
+        s_send_seq (control, "CTL", SEQ_END);
+
+    for (size_t i = 0; i < controls; ++i)
+        s_recv_seq (pull, "CTL", SEQ_END);
+    for (size_t i = 0; i < bulks; ++i)
+        s_recv_seq (pull, "BULK", SEQ_END);
+
+    close_zero_linger (pull);
+    close_zero_linger (bulk);
+    close_zero_linger (control);
+}
+
 void test_push_block_on_send_no_peers (void *ctx)
 {
     void *sc = zmq_socket (ctx, ZMQ_PUSH);
@@ -271,6 +494,9 @@ int main (void)
         // round-robin strategy.
         test_push_round_robin_out (ctx);
 
+        // PUSH with ZMQ_LB_CREDIT routes to the peer with the most room left.
+        test_push_credit_out (ctx);
+
         // PULL: SHALL receive incoming messages from its peers using a fair-queuing
         // strategy.
         test_pull_fair_queue_in (ctx);
@@ -286,6 +512,14 @@ int main (void)
         // test_destroy_queue_on_disconnect (ctx);
     }
 
+    // PULL with ZMQ_RCVPRIORITY reads higher priority peers first without
+    // starving the others.
+    test_pull_priority_in (ctx);
+    test_pull_priority_in_pending (ctx);
+
+    // PUSH with ZMQ_LB_CREDIT learns soon that a peer has read its messages.
+    test_push_credit_fast_reader (ctx);
+
     int rc = zmq_ctx_term (ctx);
     assert (rc == 0);
 
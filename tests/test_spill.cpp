@@ -0,0 +1,159 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testutil.hpp"
+
+static void test_options (void *ctx_)
+{
+    void *socket = zmq_socket (ctx_, ZMQ_PUSH);
+    assert (socket);
+
+    char dir [256];
+    size_t dir_size = sizeof (dir);
+    int rc = zmq_getsockopt (socket, ZMQ_SPILL_DIR, dir, &dir_size);
+    assert (rc == 0);
+    assert (dir_size == 1 && dir [0] == 0);
+    rc = zmq_setsockopt (socket, ZMQ_SPILL_DIR, "/tmp", 4);
+    assert (rc == 0);
+    dir_size = sizeof (dir);
+    rc = zmq_getsockopt (socket, ZMQ_SPILL_DIR, dir, &dir_size);
+    assert (rc == 0);
+    assert (dir_size == 5 && strcmp (dir, "/tmp") == 0);
+
+    int64_t size;
+    size_t size_size = sizeof (size);
+    rc = zmq_getsockopt (socket, ZMQ_SPILL_SIZE, &size, &size_size);
+    assert (rc == 0);
+    assert (size == 64 * 1024 * 1024);
+    size = 0;
+    rc = zmq_setsockopt (socket, ZMQ_SPILL_SIZE, &size, sizeof (size));
+    assert (rc == -1 && errno == EINVAL);
+
+    rc = zmq_close (socket);
+    assert (rc == 0);
+}
+
+//  Connects a PUSH socket to an endpoint nobody is bound to yet.
+static void *spilling_push (void *ctx_, const char *endpoint_,
+                            int64_t spill_size_)
+{
+    void *push = zmq_socket (ctx_, ZMQ_PUSH);
+    assert (push);
+    int hwm = 5;
+    int rc = zmq_setsockopt (push, ZMQ_SNDHWM, &hwm, sizeof (hwm));
+    assert (rc == 0);
+    int timeout = 250;
+    rc = zmq_setsockopt (push, ZMQ_SNDTIMEO, &timeout, sizeof (timeout));
+    assert (rc == 0);
+    rc = zmq_setsockopt (push, ZMQ_SPILL_DIR, "/tmp", 4);
+    assert (rc == 0);
+    rc = zmq_setsockopt (push, ZMQ_SPILL_SIZE, &spill_size_,
+                         sizeof (spill_size_));
+    assert (rc == 0);
+    rc = zmq_connect (push, endpoint_);
+    assert (rc == 0);
+    return push;
+}
+
+static void recv_in_order (void *pull_, int count_)
+{
+    int timeout = 1000;
+    int rc = zmq_setsockopt (pull_, ZMQ_RCVTIMEO, &timeout, sizeof (timeout));
+    assert (rc == 0);
+    for (int i = 0; i < count_; i++) {
+        char buff [16];
+        rc = zmq_recv (pull_, buff, sizeof (buff), 0);
+        assert (rc == sizeof (int));
+        int seq;
+        memcpy (&seq, buff, sizeof (seq));
+        assert (seq == i);
+    }
+    char buff [16];
+    timeout = 100;
+    rc = zmq_setsockopt (pull_, ZMQ_RCVTIMEO, &timeout, sizeof (timeout));
+    assert (rc == 0);
+    rc = zmq_recv (pull_, buff, sizeof (buff), 0);
+    assert (rc == -1 && errno == EAGAIN);
+}
+
+static void test_spill (void *ctx_)
+{
+    void *push = spilling_push (ctx_, "tcp://127.0.0.1:5573", 1024 * 1024);
+
+    //  Way past the high water mark, and yet the socket doesn't block.
+    for (int i = 0; i < 1000; i++) {
+        int rc = zmq_send (push, &i, sizeof (i), 0);
+        assert (rc == sizeof (i));
+    }
+
+    void *pull = zmq_socket (ctx_, ZMQ_PULL);
+    assert (pull);
+    int rc = zmq_bind (pull, "tcp://127.0.0.1:5573");
+    assert (rc == 0);
+    recv_in_order (pull, 1000);
+
+    rc = zmq_close (push);
+    assert (rc == 0);
+    rc = zmq_close (pull);
+    assert (rc == 0);
+}
+
+static void test_spill_full (void *ctx_)
+{
+    //  The segment takes a handful of messages only.
+    void *push = spilling_push (ctx_, "tcp://127.0.0.1:5574", 64);
+
+    int sent = 0;
+    while (sent < 1000) {
+        int rc = zmq_send (push, &sent, sizeof (sent), 0);
+        if (rc == -1) {
+            assert (errno == EAGAIN);
+            break;
+        }
+        sent++;
+    }
+    assert (sent > 10 && sent < 1000);
+
+    void *pull = zmq_socket (ctx_, ZMQ_PULL);
+    assert (pull);
+    int rc = zmq_bind (pull, "tcp://127.0.0.1:5574");
+    assert (rc == 0);
+    recv_in_order (pull, sent);
+
+    rc = zmq_close (push);
+    assert (rc == 0);
+    rc = zmq_close (pull);
+    assert (rc == 0);
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    test_options (ctx);
+    test_spill (ctx);
+    test_spill_full (ctx);
+
+    int rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+    return 0 ;
+}
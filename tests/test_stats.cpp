@@ -0,0 +1,180 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testutil.hpp"
+
+static zmq_socket_stats_t get_stats (void *socket_)
+{
+    zmq_socket_stats_t stats;
+    size_t stats_size = sizeof (stats);
+    int rc = zmq_getsockopt (socket_, ZMQ_STATS, &stats, &stats_size);
+    assert (rc == 0);
+    assert (stats_size == sizeof (stats));
+    return stats;
+}
+
+static void test_router (void *ctx_)
+{
+    void *router = zmq_socket (ctx_, ZMQ_ROUTER);
+    assert (router);
+    int rc = zmq_bind (router, "tcp://127.0.0.1:5564");
+    assert (rc == 0);
+
+    void *dealer = zmq_socket (ctx_, ZMQ_DEALER);
+    assert (dealer);
+    rc = zmq_setsockopt (dealer, ZMQ_IDENTITY, "slow", 4);
+    assert (rc == 0);
+    rc = zmq_connect (dealer, "tcp://127.0.0.1:5564");
+    assert (rc == 0);
+
+    //  Two messages in; each gets the identity frame prepended.
+    rc = zmq_send (dealer, "hello", 5, 0);
+    assert (rc == 5);
+    rc = zmq_send (dealer, "world", 5, 0);
+    assert (rc == 5);
+    char buff [16];
+    for (int i = 0; i < 2; i++) {
+        rc = zmq_recv (router, buff, sizeof (buff), 0);
+        assert (rc == 4);
+        rc = zmq_recv (router, buff, sizeof (buff), 0);
+        assert (rc == 5);
+    }
+
+    zmq_socket_stats_t stats = get_stats (router);
+    assert (stats.msgs_received == 2);
+    assert (stats.bytes_received == 18);
+    assert (stats.msgs_sent == 0);
+    assert (stats.pipes == 1);
+    assert (stats.engine_reads > 0);
+    assert (stats.engine_bytes_in > 0);
+
+    //  Unroutable messages are counted as dropped.
+    rc = zmq_send (router, "nobody", 6, ZMQ_SNDMORE);
+    assert (rc == 6);
+    rc = zmq_send (router, "lost", 4, 0);
+    assert (rc == 4);
+    stats = get_stats (router);
+    assert (stats.dropped == 1);
+
+    //  Queue messages for the peer while it is not reading.
+    for (int i = 0; i < 10; i++) {
+        rc = zmq_send (router, "slow", 4, ZMQ_SNDMORE);
+        assert (rc == 4);
+        rc = zmq_send (router, "data", 4, 0);
+        assert (rc == 4);
+    }
+    stats = get_stats (router);
+    assert (stats.msgs_sent == 11);
+    assert (stats.bytes_sent == 90);
+
+    zmq_pipe_stats_t pipes [4];
+    size_t pipes_size = sizeof (pipes);
+    rc = zmq_getsockopt (router, ZMQ_PIPE_STATS, pipes, &pipes_size);
+    assert (rc == 0);
+    assert (pipes_size == sizeof (pipes [0]));
+    assert (pipes [0].identity_size == 4);
+    assert (memcmp (pipes [0].identity, "slow", 4) == 0);
+    assert (pipes [0].msgs_written == 10);
+    assert (pipes [0].msgs_read == 2);
+    assert (pipes [0].outbound_depth <= 10);
+    assert (pipes [0].write_blocked == 0);
+
+    //  A buffer too small for any entry gets none.
+    pipes_size = sizeof (pipes [0]) - 1;
+    rc = zmq_getsockopt (router, ZMQ_PIPE_STATS, pipes, &pipes_size);
+    assert (rc == 0);
+    assert (pipes_size == 0);
+
+    for (int i = 0; i < 10; i++) {
+        rc = zmq_recv (dealer, buff, sizeof (buff), 0);
+        assert (rc == 4);
+    }
+    stats = get_stats (dealer);
+    assert (stats.msgs_sent == 2);
+    assert (stats.msgs_received == 10);
+    assert (stats.commands > 0);
+
+    rc = zmq_close (dealer);
+    assert (rc == 0);
+    rc = zmq_close (router);
+    assert (rc == 0);
+}
+
+static void test_conflate (void *ctx_)
+{
+    void *pull = zmq_socket (ctx_, ZMQ_PULL);
+    assert (pull);
+    int conflate = 1;
+    int rc = zmq_setsockopt (pull, ZMQ_CONFLATE, &conflate, sizeof (conflate));
+    assert (rc == 0);
+    rc = zmq_bind (pull, "tcp://127.0.0.1:5565");
+    assert (rc == 0);
+
+    void *push = zmq_socket (ctx_, ZMQ_PUSH);
+    assert (push);
+    rc = zmq_connect (push, "tcp://127.0.0.1:5565");
+    assert (rc == 0);
+
+    for (int i = 0; i < 3; i++) {
+        rc = zmq_send (push, "tick", 4, 0);
+        assert (rc == 4);
+    }
+    msleep (SETTLE_TIME);
+
+    //  Only the last message survives.
+    char buff [16];
+    rc = zmq_recv (pull, buff, sizeof (buff), 0);
+    assert (rc == 4);
+    zmq_socket_stats_t stats = get_stats (pull);
+    assert (stats.msgs_received == 1);
+    assert (stats.dropped == 2);
+
+    rc = zmq_close (push);
+    assert (rc == 0);
+    rc = zmq_close (pull);
+    assert (rc == 0);
+}
+
+int main (void)
+{
+    setup_test_environment();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    //  A fresh socket has nothing to report.
+    void *pair = zmq_socket (ctx, ZMQ_PAIR);
+    assert (pair);
+    zmq_socket_stats_t stats = get_stats (pair);
+    assert (stats.msgs_sent == 0 && stats.msgs_received == 0);
+    assert (stats.pipes == 0);
+    size_t stats_size = sizeof (stats) - 1;
+    int rc = zmq_getsockopt (pair, ZMQ_STATS, &stats, &stats_size);
+    assert (rc == -1 && errno == EINVAL);
+    rc = zmq_close (pair);
+    assert (rc == 0);
+
+    test_router (ctx);
+    test_conflate (ctx);
+
+    rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+
+    return 0;
+}
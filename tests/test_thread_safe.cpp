@@ -0,0 +1,263 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testutil.hpp"
+
+const int thread_count = 8;
+const int msgs_per_thread = 1000;
+
+struct sender_t
+{
+    void *socket;
+    int id;
+};
+
+static void test_options (void *ctx_)
+{
+    void *socket = zmq_socket (ctx_, ZMQ_PUSH);
+    assert (socket);
+
+    int value;
+    size_t value_size = sizeof (value);
+    int rc = zmq_getsockopt (socket, ZMQ_THREAD_SAFE, &value, &value_size);
+    assert (rc == 0);
+    assert (value == 0);
+    value = 1;
+    rc = zmq_setsockopt (socket, ZMQ_THREAD_SAFE, &value, sizeof (value));
+    assert (rc == 0);
+    rc = zmq_getsockopt (socket, ZMQ_THREAD_SAFE, &value, &value_size);
+    assert (rc == 0);
+    assert (value == 1);
+    value = 2;
+    rc = zmq_setsockopt (socket, ZMQ_THREAD_SAFE, &value, sizeof (value));
+    assert (rc == -1 && errno == EINVAL);
+
+    //  Only single-part messages can be sent.
+    rc = zmq_send (socket, "A", 1, ZMQ_SNDMORE | ZMQ_DONTWAIT);
+    assert (rc == -1 && errno == EINVAL);
+
+    rc = zmq_close (socket);
+    assert (rc == 0);
+
+    //  Sockets routing by envelope can't be shared.
+    const int envelope_types [] = {ZMQ_ROUTER, ZMQ_STREAM, ZMQ_REQ, ZMQ_REP};
+    for (size_t i = 0; i < sizeof (envelope_types) / sizeof (int); i++) {
+        socket = zmq_socket (ctx_, envelope_types [i]);
+        assert (socket);
+        value = 1;
+        rc = zmq_setsockopt (socket, ZMQ_THREAD_SAFE, &value, sizeof (value));
+        assert (rc == -1 && errno == EINVAL);
+        rc = zmq_close (socket);
+        assert (rc == 0);
+    }
+}
+
+static void sender (void *arg_)
+{
+    sender_t *sender = (sender_t *) arg_;
+    for (int i = 0; i < msgs_per_thread; i++) {
+        int data [2] = {sender->id, i};
+        int rc = zmq_send (sender->socket, data, sizeof (data), 0);
+        assert (rc == sizeof (data));
+    }
+}
+
+static void test_concurrent_send (void *ctx_)
+{
+    void *pull = zmq_socket (ctx_, ZMQ_PULL);
+    assert (pull);
+    int rc = zmq_bind (pull, "inproc://thread-safe-send");
+    assert (rc == 0);
+
+    void *push = zmq_socket (ctx_, ZMQ_PUSH);
+    assert (push);
+    int value = 1;
+    rc = zmq_setsockopt (push, ZMQ_THREAD_SAFE, &value, sizeof (value));
+    assert (rc == 0);
+    //  A small HWM makes the senders block and wait for each other.
+    value = 10;
+    rc = zmq_setsockopt (push, ZMQ_SNDHWM, &value, sizeof (value));
+    assert (rc == 0);
+    rc = zmq_connect (push, "inproc://thread-safe-send");
+    assert (rc == 0);
+
+    sender_t senders [thread_count];
+    void *threads [thread_count];
+    for (int i = 0; i < thread_count; i++) {
+        senders [i].socket = push;
+        senders [i].id = i;
+        threads [i] = zmq_threadstart (&sender, &senders [i]);
+    }
+
+    //  Every message arrives once and each thread's in the order sent.
+    int next [thread_count] = {0};
+    for (int i = 0; i < thread_count * msgs_per_thread; i++) {
+        int data [2];
+        rc = zmq_recv (pull, data, sizeof (data), 0);
+        assert (rc == sizeof (data));
+        assert (data [0] >= 0 && data [0] < thread_count);
+        assert (data [1] == next [data [0]]);
+        next [data [0]]++;
+    }
+    for (int i = 0; i < thread_count; i++)
+        zmq_threadclose (threads [i]);
+
+    rc = zmq_close (push);
+    assert (rc == 0);
+    rc = zmq_close (pull);
+    assert (rc == 0);
+}
+
+static void receiver (void *socket_)
+{
+    //  Each thread gets messages until the one ending the test. Multi-part
+    //  messages, made of -2s, are dropped and fail the receive.
+    while (true) {
+        int value;
+        int rc = zmq_recv (socket_, &value, sizeof (value), 0);
+        if (rc == -1) {
+            assert (errno == EPROTO);
+            continue;
+        }
+        assert (rc == sizeof (value));
+        assert (value != -2);
+        if (value == -1)
+            break;
+    }
+}
+
+static void test_concurrent_recv (void *ctx_)
+{
+    void *pull = zmq_socket (ctx_, ZMQ_PULL);
+    assert (pull);
+    int value = 1;
+    int rc = zmq_setsockopt (pull, ZMQ_THREAD_SAFE, &value, sizeof (value));
+    assert (rc == 0);
+    rc = zmq_bind (pull, "inproc://thread-safe-recv");
+    assert (rc == 0);
+
+    void *push = zmq_socket (ctx_, ZMQ_PUSH);
+    assert (push);
+    rc = zmq_connect (push, "inproc://thread-safe-recv");
+    assert (rc == 0);
+
+    void *threads [thread_count];
+    for (int i = 0; i < thread_count; i++)
+        threads [i] = zmq_threadstart (&receiver, pull);
+
+    for (int i = 0; i < thread_count * msgs_per_thread; i++) {
+        if (i % 10 == 0) {
+            value = -2;
+            rc = zmq_send (push, &value, sizeof (value), ZMQ_SNDMORE);
+            assert (rc == sizeof (value));
+            rc = zmq_send (push, &value, sizeof (value), 0);
+            assert (rc == sizeof (value));
+        }
+        rc = zmq_send (push, &i, sizeof (i), 0);
+        assert (rc == sizeof (i));
+    }
+    for (int i = 0; i < thread_count; i++) {
+        value = -1;
+        rc = zmq_send (push, &value, sizeof (value), 0);
+        assert (rc == sizeof (value));
+    }
+    for (int i = 0; i < thread_count; i++)
+        zmq_threadclose (threads [i]);
+
+    //  Nothing is left over.
+    rc = zmq_recv (pull, &value, sizeof (value), ZMQ_DONTWAIT);
+    assert (rc == -1 && errno == EAGAIN);
+
+    zmq_socket_stats_t stats;
+    size_t stats_size = sizeof (stats);
+    rc = zmq_getsockopt (pull, ZMQ_STATS, &stats, &stats_size);
+    assert (rc == 0);
+    assert (stats.dropped == thread_count * msgs_per_thread / 10);
+
+    rc = zmq_close (push);
+    assert (rc == 0);
+    rc = zmq_close (pull);
+    assert (rc == 0);
+}
+
+//  The parts of a message can't be shared out among threads, so a
+//  multi-part message is dropped, failing the receive, and counted.
+static void test_multipart_recv (void *ctx_)
+{
+    void *pull = zmq_socket (ctx_, ZMQ_PULL);
+    assert (pull);
+    int value = 1;
+    int rc = zmq_setsockopt (pull, ZMQ_THREAD_SAFE, &value, sizeof (value));
+    assert (rc == 0);
+    rc = zmq_bind (pull, "inproc://thread-safe-multipart");
+    assert (rc == 0);
+
+    void *push = zmq_socket (ctx_, ZMQ_PUSH);
+    assert (push);
+    rc = zmq_connect (push, "inproc://thread-safe-multipart");
+    assert (rc == 0);
+
+    rc = zmq_send (push, "A", 1, ZMQ_SNDMORE);
+    assert (rc == 1);
+    rc = zmq_send (push, "B", 1, ZMQ_SNDMORE);
+    assert (rc == 1);
+    rc = zmq_send (push, "C", 1, 0);
+    assert (rc == 1);
+    rc = zmq_send (push, "D", 1, 0);
+    assert (rc == 1);
+
+    char buffer [8];
+    rc = zmq_recv (pull, buffer, sizeof (buffer), 0);
+    assert (rc == -1 && errno == EPROTO);
+    rc = zmq_recv (pull, buffer, sizeof (buffer), 0);
+    assert (rc == 1);
+    assert (buffer [0] == 'D');
+    size_t value_size = sizeof (value);
+    rc = zmq_getsockopt (pull, ZMQ_RCVMORE, &value, &value_size);
+    assert (rc == 0);
+    assert (value == 0);
+
+    zmq_socket_stats_t stats;
+    size_t stats_size = sizeof (stats);
+    rc = zmq_getsockopt (pull, ZMQ_STATS, &stats, &stats_size);
+    assert (rc == 0);
+    assert (stats.dropped == 1);
+
+    rc = zmq_close (push);
+    assert (rc == 0);
+    rc = zmq_close (pull);
+    assert (rc == 0);
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    test_options (ctx);
+    test_concurrent_send (ctx);
+    test_concurrent_recv (ctx);
+    test_multipart_recv (ctx);
+
+    int rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+    return 0;
+}
@@ -0,0 +1,205 @@
+/*
+    Copyright (c) 2007-2013 Contributors as noted in the AUTHORS file
+
+    This file is part of 0MQ.
+
+    0MQ is free software; you can redistribute it and/or modify it under
+    the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    0MQ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "testutil.hpp"
+
+static zmq_trace_stats_t get_trace_stats (void *socket_)
+{
+    zmq_trace_stats_t stats;
+    size_t stats_size = sizeof (stats);
+    int rc = zmq_getsockopt (socket_, ZMQ_TRACE_STATS, &stats, &stats_size);
+    assert (rc == 0);
+    assert (stats_size == sizeof (stats));
+    return stats;
+}
+
+//  The last stamp of a trace may be taken a little after the peer has
+//  seen the message, so wait for the traces to complete.
+static zmq_trace_stats_t wait_for_traces (void *socket_, uint64_t traced_)
+{
+    zmq_trace_stats_t stats = get_trace_stats (socket_);
+    for (int i = 0; i < 100 && stats.traced < traced_; i++) {
+        msleep (10);
+        stats = get_trace_stats (socket_);
+    }
+    return stats;
+}
+
+static void check_stages (const zmq_trace_stats_t &stats_, int first_,
+                          uint64_t samples_)
+{
+    for (int i = 0; i != ZMQ_TRACE_STAGES; i++) {
+        const zmq_trace_stage_t &stage = stats_.stages [i];
+        if (i < first_ || i >= first_ + 3) {
+            assert (stage.samples == 0);
+            continue;
+        }
+        assert (stage.samples == samples_);
+        assert (stage.min <= stage.max);
+        assert (stage.total >= stage.max);
+        uint64_t bucketed = 0;
+        for (int j = 0; j != 32; j++)
+            bucketed += stage.buckets [j];
+        assert (bucketed == samples_);
+    }
+}
+
+static void test_options (void *ctx_)
+{
+    void *socket = zmq_socket (ctx_, ZMQ_PUSH);
+    assert (socket);
+
+    int rate;
+    size_t rate_size = sizeof (rate);
+    int rc = zmq_getsockopt (socket, ZMQ_TRACE, &rate, &rate_size);
+    assert (rc == 0);
+    assert (rate == 0);
+
+    rate = -1;
+    rc = zmq_setsockopt (socket, ZMQ_TRACE, &rate, sizeof (rate));
+    assert (rc == -1 && errno == EINVAL);
+
+    rate = 4;
+    rc = zmq_setsockopt (socket, ZMQ_TRACE, &rate, sizeof (rate));
+    assert (rc == 0);
+    rc = zmq_getsockopt (socket, ZMQ_TRACE, &rate, &rate_size);
+    assert (rc == 0);
+    assert (rate == 4);
+
+    zmq_trace_stats_t stats;
+    size_t stats_size = sizeof (stats) - 1;
+    rc = zmq_getsockopt (socket, ZMQ_TRACE_STATS, &stats, &stats_size);
+    assert (rc == -1 && errno == EINVAL);
+
+    rc = zmq_close (socket);
+    assert (rc == 0);
+}
+
+static void test_push_pull (void *ctx_)
+{
+    void *pull = zmq_socket (ctx_, ZMQ_PULL);
+    assert (pull);
+    int rc = zmq_bind (pull, "tcp://127.0.0.1:5571");
+    assert (rc == 0);
+    void *push = zmq_socket (ctx_, ZMQ_PUSH);
+    assert (push);
+    rc = zmq_connect (push, "tcp://127.0.0.1:5571");
+    assert (rc == 0);
+
+    //  Give the timestamp counter time to be calibrated.
+    msleep (SETTLE_TIME);
+
+    int rate = 1;
+    rc = zmq_setsockopt (push, ZMQ_TRACE, &rate, sizeof (rate));
+    assert (rc == 0);
+    rc = zmq_setsockopt (pull, ZMQ_TRACE, &rate, sizeof (rate));
+    assert (rc == 0);
+
+    //  One message in flight at a time, so that each one is traced.
+    char buff [16];
+    zmq_trace_stats_t stats;
+    for (int i = 0; i < 10; i++) {
+        rc = zmq_send (push, "traced", 6, 0);
+        assert (rc == 6);
+        rc = zmq_recv (pull, buff, sizeof (buff), 0);
+        assert (rc == 6);
+        int more;
+        size_t more_size = sizeof (more);
+        rc = zmq_getsockopt (pull, ZMQ_RCVMORE, &more, &more_size);
+        assert (rc == 0);
+        assert (more == 0);
+        stats = wait_for_traces (push, i + 1);
+        assert (stats.traced == (uint64_t) i + 1);
+    }
+
+    stats = get_trace_stats (push);
+    assert (stats.abandoned == 0);
+    check_stages (stats, ZMQ_TRACE_SEND_TO_PIPE, 10);
+
+    stats = wait_for_traces (pull, 10);
+    assert (stats.traced == 10);
+    assert (stats.abandoned == 0);
+    check_stages (stats, ZMQ_TRACE_WIRE_TO_DECODER, 10);
+
+    //  Switching tracing off resets the histograms.
+    rate = 0;
+    rc = zmq_setsockopt (pull, ZMQ_TRACE, &rate, sizeof (rate));
+    assert (rc == 0);
+    rc = zmq_send (push, "quiet", 5, 0);
+    assert (rc == 5);
+    rc = zmq_recv (pull, buff, sizeof (buff), 0);
+    assert (rc == 5);
+    stats = get_trace_stats (pull);
+    assert (stats.traced == 0);
+    check_stages (stats, ZMQ_TRACE_WIRE_TO_DECODER, 0);
+
+    rc = zmq_close (push);
+    assert (rc == 0);
+    rc = zmq_close (pull);
+    assert (rc == 0);
+}
+
+static void test_req_rep (void *ctx_)
+{
+    void *rep = zmq_socket (ctx_, ZMQ_REP);
+    assert (rep);
+    int rc = zmq_bind (rep, "tcp://127.0.0.1:5572");
+    assert (rc == 0);
+    void *req = zmq_socket (ctx_, ZMQ_REQ);
+    assert (req);
+    rc = zmq_connect (req, "tcp://127.0.0.1:5572");
+    assert (rc == 0);
+    msleep (SETTLE_TIME);
+
+    //  Traced replies still pass the checks of the REQ session and
+    //  the envelope delimiters consumed by REQ complete their traces.
+    int rate = 1;
+    rc = zmq_setsockopt (req, ZMQ_TRACE, &rate, sizeof (rate));
+    assert (rc == 0);
+    rc = zmq_setsockopt (rep, ZMQ_TRACE, &rate, sizeof (rate));
+    assert (rc == 0);
+    for (int i = 0; i < 10; i++)
+        bounce (rep, req);
+
+    zmq_trace_stats_t stats = wait_for_traces (req, 2);
+    assert (stats.abandoned == 0);
+    assert (stats.stages [ZMQ_TRACE_SEND_TO_PIPE].samples > 0);
+    assert (stats.stages [ZMQ_TRACE_SESSION_TO_RECV].samples > 0);
+
+    rc = zmq_close (req);
+    assert (rc == 0);
+    rc = zmq_close (rep);
+    assert (rc == 0);
+}
+
+int main (void)
+{
+    setup_test_environment ();
+    void *ctx = zmq_ctx_new ();
+    assert (ctx);
+
+    test_options (ctx);
+    test_push_pull (ctx);
+    test_req_rep (ctx);
+
+    int rc = zmq_ctx_term (ctx);
+    assert (rc == 0);
+    return 0 ;
+}